@@ -7,7 +7,7 @@
 #include <opengl/openglfunctions.h>
 
 
-class BilateralFilter {
+class BilateralFilter : public TextureFilter {
     public:
         // Create a new filter
         BilateralFilter(int width, int height);
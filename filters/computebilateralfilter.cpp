@@ -0,0 +1,74 @@
+#include "computebilateralfilter.h"
+#include "opengl/glutils.h"
+#include <cmath>
+
+// Same window and weights as the OpenCL bilateral filters. FILTER_RADIUS
+// and GROUP_SIZE must match the ones in the shader
+#define FILTER_RADIUS       4
+#define GROUP_SIZE          64
+#define SPATIAL_SCALE       0.0001f
+#define DEPTH_THRESHOLD     0.015f
+
+ComputeBilateralFilter::ComputeBilateralFilter(int width,
+                                               int height,
+                                               GLenum format) :
+_width(width),
+_height(height),
+_format(format) {
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    _program = create_compute_program("shaders/filters/bilateral.comp");
+    _program->bind();
+
+    // Spatial weights, indexed by the distance to the center pixel
+    GLfloat weights[FILTER_RADIUS + 1];
+    for (int d = 0; d <= FILTER_RADIUS; ++d) {
+        float r = d * SPATIAL_SCALE;
+        weights[d] = exp(-r*r);
+    }
+    _program->setUniformValueArray("weights", weights, FILTER_RADIUS + 1, 1);
+    _program->setUniformValue("depth_threshold", DEPTH_THRESHOLD);
+
+    gl.glGenTextures(1, &_temp_texture);
+    gl.glBindTexture(GL_TEXTURE_2D, _temp_texture);
+    gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl.glTexImage2D(GL_TEXTURE_2D,
+                    0,
+                    _format,
+                    _width,
+                    _height,
+                    0,
+                    GL_RED,
+                    GL_FLOAT,
+                    0);
+    gl.glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+ComputeBilateralFilter::~ComputeBilateralFilter() {
+    auto& gl = OpenGLFunctions::getFunctions();
+    gl.glDeleteTextures(1, &_temp_texture);
+}
+
+void ComputeBilateralFilter::filter(GLuint input, GLuint output) {
+    _program->bind();
+    _dispatch(input, _temp_texture, 1, 0);
+    _dispatch(_temp_texture, output, 0, 1);
+}
+
+void ComputeBilateralFilter::_dispatch(GLuint input, GLuint output, int dir_x, int dir_y) {
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    _program->setUniformValue("direction", dir_x, dir_y);
+    gl.glActiveTexture(GL_TEXTURE0);
+    gl.glBindTexture(GL_TEXTURE_2D, input);
+    gl.glBindImageTexture(1, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, _format);
+
+    // One work group per GROUP_SIZE pixels of every line
+    int length = dir_x ? _width : _height;
+    int lines = dir_x ? _height : _width;
+    gl.glDispatchCompute((length + GROUP_SIZE - 1) / GROUP_SIZE, lines, 1);
+
+    // The next pass, or stage, reads what this one wrote
+    gl.glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
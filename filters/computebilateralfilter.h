@@ -0,0 +1,35 @@
+#ifndef _COMPUTE_BILATERAL_FILTER_H_
+#define _COMPUTE_BILATERAL_FILTER_H_
+
+#include "gltexturefilter.h"
+#include <QOpenGLShaderProgram>
+#include <memory>
+
+// Separable bilateral filter implemented as an OpenGL compute shader. It
+// filters the same as SeparableBilateralFilter, but without leaving OpenGL
+class ComputeBilateralFilter : public GLTextureFilter {
+    public:
+        // Create a new filter for textures of the given size and internal
+        // format, either GL_R32F or GL_R16F
+        ComputeBilateralFilter(int width, int height, GLenum format=GL_R32F);
+
+        ~ComputeBilateralFilter();
+
+        void filter(GLuint input, GLuint output);
+
+    private:
+        // Size of the texture to filter
+        int _width, _height;
+
+        // Internal format of the textures
+        GLenum _format;
+
+        std::unique_ptr<QOpenGLShaderProgram> _program;
+
+        // Holds the result of the horizontal pass
+        GLuint _temp_texture;
+
+        void _dispatch(GLuint input, GLuint output, int dir_x, int dir_y);
+};
+
+#endif // _COMPUTE_BILATERAL_FILTER_H_
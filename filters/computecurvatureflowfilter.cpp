@@ -0,0 +1,36 @@
+#include "computecurvatureflowfilter.h"
+#include "opengl/glutils.h"
+
+// Must match the work group size of the shader
+#define GROUP_SIZE  16
+
+ComputeCurvatureFlowFilter::ComputeCurvatureFlowFilter(int width,
+                                                       int height,
+                                                       GLenum format) :
+_width(width),
+_height(height),
+_format(format) {
+    _program = create_compute_program("shaders/filters/curvature_flow.comp");
+}
+
+void ComputeCurvatureFlowFilter::set_projection(const QMatrix4x4& projection) {
+    _program->bind();
+    _program->setUniformValue("proj_x", projection(0, 0));
+    _program->setUniformValue("proj_y", projection(1, 1));
+}
+
+void ComputeCurvatureFlowFilter::filter(GLuint input, GLuint output) {
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    _program->bind();
+    gl.glActiveTexture(GL_TEXTURE0);
+    gl.glBindTexture(GL_TEXTURE_2D, input);
+    gl.glBindImageTexture(1, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, _format);
+
+    gl.glDispatchCompute((_width + GROUP_SIZE - 1) / GROUP_SIZE,
+                         (_height + GROUP_SIZE - 1) / GROUP_SIZE,
+                         1);
+
+    // The next iteration, or stage, reads what this one wrote
+    gl.glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
@@ -0,0 +1,30 @@
+#ifndef _COMPUTE_CURVATURE_FLOW_FILTER_H_
+#define _COMPUTE_CURVATURE_FLOW_FILTER_H_
+
+#include "gltexturefilter.h"
+#include <QOpenGLShaderProgram>
+#include <memory>
+
+// Screen space curvature flow, as an OpenGL compute shader. Every call to
+// filter is one iteration of the flow
+class ComputeCurvatureFlowFilter : public GLTextureFilter {
+    public:
+        // Create a new filter for textures of the given size and internal
+        // format, either GL_R32F or GL_R16F
+        ComputeCurvatureFlowFilter(int width, int height, GLenum format=GL_R32F);
+
+        void filter(GLuint input, GLuint output);
+
+        void set_projection(const QMatrix4x4& projection);
+
+    private:
+        // Size of the texture to filter
+        int _width, _height;
+
+        // Internal format of the textures
+        GLenum _format;
+
+        std::unique_ptr<QOpenGLShaderProgram> _program;
+};
+
+#endif // _COMPUTE_CURVATURE_FLOW_FILTER_H_
@@ -0,0 +1,23 @@
+#ifndef _GL_TEXTURE_FILTER_H_
+#define _GL_TEXTURE_FILTER_H_
+
+#include <opengl/openglfunctions.h>
+#include <QMatrix4x4>
+
+// A filter that runs entirely on OpenGL, so filtering a texture never
+// needs to synchronize OpenGL with OpenCL
+class GLTextureFilter {
+    public:
+        virtual ~GLTextureFilter() {}
+
+        // Applies the filter to the input texture, and puts the result in the
+        // output texture. Both must be of the same size, and of the format the
+        // filter was created for
+        virtual void filter(GLuint input, GLuint output) = 0;
+
+        // Sets the projection the filtered depth was rendered with, for the
+        // filters that depend on it
+        virtual void set_projection(const QMatrix4x4& projection) {}
+};
+
+#endif // _GL_TEXTURE_FILTER_H_
@@ -0,0 +1,114 @@
+#include "separablebilateralfilter.h"
+#include "opencl/clallocator.h"
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Same window and weights as the full bilateral filter
+#define FILTER_RADIUS       4
+#define SPATIAL_SCALE       0.0001f
+#define DEPTH_THRESHOLD     0.015f
+
+// Work group of GROUP_SIZE pixels along the filtered axis, and GROUP_ROWS
+// along the other one
+#define GROUP_SIZE          32
+#define GROUP_ROWS          8
+
+static size_t round_up(size_t value, size_t multiple) {
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+SeparableBilateralFilter::SeparableBilateralFilter(int width,
+                                                   int height) :
+_width(width),
+_height(height) {
+    CLCompiler compiler;
+    compiler.add_file_source("kernels/bilateral_separable.cl");
+    compiler.add_build_option("-cl-std=CL1.2");
+    compiler.add_build_option("-cl-fast-relaxed-math");
+    compiler.add_include_path("kernels");
+    compiler.define_constant("FILTER_RADIUS", FILTER_RADIUS);
+    compiler.define_constant("GROUP_SIZE", GROUP_SIZE);
+    compiler.define_constant("GROUP_ROWS", GROUP_ROWS);
+    compiler.define_constant("DEPTH_THRESHOLD", DEPTH_THRESHOLD);
+    _program = compiler.build();
+
+    _kernel_horizontal = _program->get_native_kernel("bilateral_horizontal");
+    _kernel_vertical = _program->get_native_kernel("bilateral_vertical");
+
+    // Spatial weights, indexed by the distance to the center pixel
+    vector<cl_float> weights(FILTER_RADIUS + 1);
+    for (int d = 0; d <= FILTER_RADIUS; ++d) {
+        float r = d * SPATIAL_SCALE;
+        weights[d] = exp(-r*r);
+    }
+    cl_mem_flags flags = CL_MEM_READ_ONLY;
+    _weights = CLAllocator::alloc_buffer<cl_float>("filter/weights", weights.size(), weights, flags);
+
+    cl_int err;
+    cl_image_format fmt;
+    fmt.image_channel_order = CL_R;
+    fmt.image_channel_data_type = CL_FLOAT;
+
+    cl_image_desc desc = {};
+    desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+    desc.image_width = _width;
+    desc.image_height = _height;
+
+    _temp_image = clCreateImage(CLEnvironment::context(),
+                                CL_MEM_READ_WRITE,
+                                &fmt,
+                                &desc,
+                                nullptr,
+                                &err);
+    CLError::check(err);
+
+    _h_local_size[0] = GROUP_SIZE;
+    _h_local_size[1] = GROUP_ROWS;
+    _h_global_size[0] = round_up(_width, GROUP_SIZE);
+    _h_global_size[1] = round_up(_height, GROUP_ROWS);
+
+    _v_local_size[0] = GROUP_ROWS;
+    _v_local_size[1] = GROUP_SIZE;
+    _v_global_size[0] = round_up(_width, GROUP_ROWS);
+    _v_global_size[1] = round_up(_height, GROUP_SIZE);
+
+    for (auto kernel : {_kernel_horizontal, _kernel_vertical}) {
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), &_weights);
+        clSetKernelArg(kernel, 3, sizeof(cl_int), &_width);
+        clSetKernelArg(kernel, 4, sizeof(cl_int), &_height);
+    }
+}
+
+SeparableBilateralFilter::~SeparableBilateralFilter() {
+    CLAllocator::release_buffer(_temp_image);
+    CLAllocator::release_buffer(_weights);
+}
+
+void SeparableBilateralFilter::filter(cl_mem input, cl_mem output) {
+    clSetKernelArg(_kernel_horizontal, 0, sizeof(cl_mem), &input);
+    clSetKernelArg(_kernel_horizontal, 1, sizeof(cl_mem), &_temp_image);
+    clSetKernelArg(_kernel_vertical, 0, sizeof(cl_mem), &_temp_image);
+    clSetKernelArg(_kernel_vertical, 1, sizeof(cl_mem), &output);
+
+    clEnqueueNDRangeKernel(CLEnvironment::queue(),
+                           _kernel_horizontal,
+                           2,
+                           NULL,
+                           _h_global_size,
+                           _h_local_size,
+                           0,
+                           NULL,
+                           NULL);
+
+    clEnqueueNDRangeKernel(CLEnvironment::queue(),
+                           _kernel_vertical,
+                           2,
+                           NULL,
+                           _v_global_size,
+                           _v_local_size,
+                           0,
+                           NULL,
+                           NULL);
+}
@@ -0,0 +1,43 @@
+#ifndef _SEPARABLE_BILATERAL_FILTER_H_
+#define _SEPARABLE_BILATERAL_FILTER_H_
+
+#include "texturefilter.h"
+#include <opencl/clenvironment.h>
+#include <opencl/clcompiler.h>
+#include <opengl/openglfunctions.h>
+
+// Bilateral filter applied as a horizontal pass followed by a vertical one.
+// Each pass stages a tile of the image in local memory, and the spatial
+// weights come from a lookup table, so no exp is evaluated per sample.
+// The result approximates the full 2D window of BilateralFilter at a
+// fraction of the image reads.
+class SeparableBilateralFilter : public TextureFilter {
+    public:
+        // Create a new filter for R float images of the given size
+        SeparableBilateralFilter(int width, int height);
+
+        ~SeparableBilateralFilter();
+
+        void filter(cl_mem input, cl_mem output);
+
+    private:
+        // Size of the texture to filter
+        int _width, _height;
+
+        std::unique_ptr<CLProgram> _program;
+        cl_kernel _kernel_horizontal;
+        cl_kernel _kernel_vertical;
+
+        // Spatial weights lookup table
+        cl_mem _weights;
+
+        // Holds the result of the horizontal pass
+        cl_mem _temp_image;
+
+        size_t _h_global_size[2];
+        size_t _h_local_size[2];
+        size_t _v_global_size[2];
+        size_t _v_local_size[2];
+};
+
+#endif // _SEPARABLE_BILATERAL_FILTER_H_
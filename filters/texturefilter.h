@@ -5,6 +5,8 @@
 
 class TextureFilter {
     public:
+        virtual ~TextureFilter() {}
+
         // Applies the filter to the origin image, and puts the result in the
         // filtered image
         virtual void filter(cl_mem input, cl_mem output) = 0;
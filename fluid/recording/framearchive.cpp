@@ -0,0 +1,171 @@
+#include "framearchive.h"
+#include "runtimeexception.h"
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+FrameArchive::FrameArchive(const string& path) :
+_path(path),
+_data(nullptr),
+_size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw RunTimeException("Could not open recording " + path + ": " + strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw RunTimeException("Could not stat recording " + path + ": " + strerror(errno));
+    }
+    _size = st.st_size;
+
+    if (_size < sizeof(FrameFileHeader)) {
+        close(fd);
+        throw RunTimeException("Invalid recording " + path + ": file too small");
+    }
+
+    _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        throw RunTimeException("Could not map recording " + path + ": " + strerror(errno));
+    }
+
+    if (!FrameCodec::check_file_header(header())) {
+        munmap(_data, _size);
+        throw RunTimeException("Invalid recording " + path + ": bad magic number or version");
+    }
+
+    if (!_read_index()) {
+        cout << "Recording " << path << " has no index, rebuilding it..." << flush;
+        _rebuild_index();
+        cout << "done!" << endl;
+    }
+
+    // Frames are accessed in any order when seeking
+    madvise(_data, _size, MADV_RANDOM);
+}
+
+FrameArchive::~FrameArchive() {
+    if (_data) {
+        munmap(_data, _size);
+    }
+}
+
+const char* FrameArchive::_at(uint64_t offset) const {
+    return static_cast<const char*>(_data) + offset;
+}
+
+bool FrameArchive::_read_index() {
+    if (_size < sizeof(FrameFileHeader) + sizeof(FrameFileFooter)) {
+        return false;
+    }
+
+    FrameFileFooter footer;
+    memcpy(&footer, _at(_size - sizeof(footer)), sizeof(footer));
+    if (!FrameCodec::check_file_footer(footer)) {
+        return false;
+    }
+
+    // The footer comes from the file, so the index size is computed in a
+    // way that can not overflow before comparing it to the file size
+    uint64_t index_space = _size - sizeof(footer);
+    if (footer.frame_count > index_space / sizeof(uint64_t)) {
+        return false;
+    }
+
+    uint64_t index_size = footer.frame_count * sizeof(uint64_t);
+    if (footer.index_offset != index_space - index_size ||
+        footer.index_offset < sizeof(FrameFileHeader)) {
+        return false;
+    }
+
+    _offsets.resize(footer.frame_count);
+    memcpy(_offsets.data(), _at(footer.index_offset), index_size);
+
+    // Every frame, header and payload, must lie between the file header and the index
+    for (auto offset : _offsets) {
+        if (offset < sizeof(FrameFileHeader) ||
+            offset > footer.index_offset ||
+            sizeof(FrameHeader) > footer.index_offset - offset) {
+            _offsets.clear();
+            return false;
+        }
+
+        FrameHeader h;
+        memcpy(&h, _at(offset), sizeof(h));
+        if (!FrameCodec::check_frame_header(h) ||
+            FrameCodec::frame_size(h) > footer.index_offset - offset) {
+            _offsets.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FrameArchive::_rebuild_index() {
+    _offsets.clear();
+
+    uint64_t offset = sizeof(FrameFileHeader);
+    while (offset + sizeof(FrameHeader) <= _size) {
+        FrameHeader h;
+        memcpy(&h, _at(offset), sizeof(h));
+        if (!FrameCodec::check_frame_header(h)) {
+            break;
+        }
+
+        uint64_t next = offset + FrameCodec::frame_size(h);
+        if (next > _size) {
+            // The last frame was being written when the recording stopped
+            break;
+        }
+
+        _offsets.push_back(offset);
+        offset = next;
+    }
+}
+
+const FrameFileHeader& FrameArchive::header() const {
+    return *static_cast<const FrameFileHeader*>(_data);
+}
+
+size_t FrameArchive::frame_count() const {
+    return _offsets.size();
+}
+
+FrameHeader FrameArchive::frame_header(size_t index) const {
+    if (index >= _offsets.size()) {
+        throw RunTimeException("Frame " + to_string(index) + " out of range in recording " + _path);
+    }
+
+    FrameHeader h;
+    memcpy(&h, _at(_offsets[index]), sizeof(h));
+    return h;
+}
+
+void FrameArchive::read_frame(size_t index, FrameData& frame) const {
+    auto h = frame_header(index);
+    uint64_t offset = _offsets[index];
+    if (offset > _size || FrameCodec::frame_size(h) > _size - offset) {
+        throw RunTimeException("Frame " + to_string(index) + " is truncated in recording " + _path);
+    }
+
+    const char* payload = _at(offset + sizeof(FrameHeader));
+    FrameCodec::decode(h, payload, frame);
+
+    frame.bodies.resize(h.body_count);
+    if (h.body_count > 0) {
+        memcpy(frame.bodies.data(),
+               payload + h.compressed_size,
+               h.body_count * sizeof(CheckpointBody));
+    }
+}
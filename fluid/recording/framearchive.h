@@ -0,0 +1,85 @@
+/**
+ *  @file framearchive.h
+ *  @brief Contains the declaration of the FrameArchive class.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _FRAME_ARCHIVE_H_
+#define _FRAME_ARCHIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "framecodec.h"
+
+/**
+ * @class FrameArchive
+ * @brief Gives random access to the frames of a recording
+ * @details The file is memory mapped read only for the lifetime of the
+ *          archive, so seeking to a frame costs a lookup in the index of
+ *          frames and the decoding of a single frame. If the recording was
+ *          not properly closed (there is no footer), the index is rebuilt by
+ *          walking the frame headers, and a truncated last frame is ignored.
+ */
+class FrameArchive {
+    public:
+        /**
+         * @brief Opens and validates a recording
+         *
+         * @param path The path of the recording file.
+         * @throws RunTimeException if the file is not a valid recording.
+         */
+        FrameArchive(const std::string& path);
+
+        /* Unmaps the file */
+        ~FrameArchive();
+
+        /**
+         * @brief Returns the header of the recording
+         */
+        const FrameFileHeader& header() const;
+
+        /**
+         * @brief Returns the number of frames of the recording
+         */
+        size_t frame_count() const;
+
+        /**
+         * @brief Returns the header of a frame
+         * @details Frames are not aligned in the file, so the header is
+         *          returned as a copy.
+         *
+         * @param index The index of the frame.
+         */
+        FrameHeader frame_header(size_t index) const;
+
+        /**
+         * @brief Decodes a frame, particles and rigid bodies
+         *
+         * @param index The index of the frame.
+         * @param frame The decoded frame.
+         * @throws RunTimeException if the frame is corrupt.
+         */
+        void read_frame(size_t index, FrameData& frame) const;
+
+    private:
+        std::string _path;
+        void* _data;
+        size_t _size;
+
+        // Offset of every frame from the beginning of the file
+        std::vector<uint64_t> _offsets;
+
+        bool _read_index();
+
+        void _rebuild_index();
+
+        const char* _at(uint64_t offset) const;
+
+        FrameArchive(const FrameArchive&);
+        FrameArchive& operator=(const FrameArchive&);
+};
+
+#endif // _FRAME_ARCHIVE_H_
@@ -0,0 +1,179 @@
+#include "framecodec.h"
+#include "runtimeexception.h"
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+static const char FRAME_FILE_MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'R', 'E', 'C'};
+static const char FRAME_MAGIC[4] = {'F', 'R', 'M', '1'};
+static const char FRAME_INDEX_MAGIC[8] = {'F', 'R', 'M', 'I', 'N', 'D', 'E', 'X'};
+
+// Compression level used by zlib. Low levels are much faster, and the
+// delta coded byte planes are already very redundant
+static const int FRAME_COMPRESSION_LEVEL = 3;
+
+/**
+ * @brief Returns the value of a channel of the i-th particle
+ */
+static inline float channel_value(int channel,
+                                  int i,
+                                  const cl_float4* positions,
+                                  const cl_float4* velocities,
+                                  const cl_float* densities) {
+    if (channel < 3) {
+        return positions[i].s[channel];
+    }
+    else if (channel < 6) {
+        return velocities[i].s[channel - 3];
+    }
+    return densities[i];
+}
+
+void FrameCodec::init_file_header(FrameFileHeader& header,
+                                  int interval,
+                                  float time_step,
+                                  float particle_radius) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_FILE_MAGIC, sizeof(FRAME_FILE_MAGIC));
+    header.version = FRAME_FILE_VERSION;
+    header.interval = interval;
+    header.time_step = time_step;
+    header.particle_radius = particle_radius;
+}
+
+bool FrameCodec::check_file_header(const FrameFileHeader& header) {
+    return memcmp(header.magic, FRAME_FILE_MAGIC, sizeof(FRAME_FILE_MAGIC)) == 0 &&
+           header.version == FRAME_FILE_VERSION;
+}
+
+void FrameCodec::init_file_footer(FrameFileFooter& footer,
+                                  uint64_t index_offset,
+                                  uint64_t frame_count) {
+    memset(&footer, 0, sizeof(footer));
+    footer.index_offset = index_offset;
+    footer.frame_count = frame_count;
+    memcpy(footer.magic, FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC));
+}
+
+bool FrameCodec::check_file_footer(const FrameFileFooter& footer) {
+    return memcmp(footer.magic, FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC)) == 0;
+}
+
+bool FrameCodec::check_frame_header(const FrameHeader& header) {
+    return memcmp(header.magic, FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0;
+}
+
+uint64_t FrameCodec::frame_size(const FrameHeader& header) {
+    return sizeof(FrameHeader) +
+           header.compressed_size +
+           (uint64_t)header.body_count * sizeof(CheckpointBody);
+}
+
+QByteArray FrameCodec::encode(uint64_t step,
+                              int count,
+                              const cl_float4* positions,
+                              const cl_float4* velocities,
+                              const cl_float* densities,
+                              FrameHeader& header) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_MAGIC, sizeof(FRAME_MAGIC));
+    header.particle_count = count;
+    header.step = step;
+
+    // Find the quantization range of every channel
+    for (int c = 0; c < FRAME_CHANNEL_COUNT; ++c) {
+        float min_v = numeric_limits<float>::max();
+        float max_v = numeric_limits<float>::lowest();
+        for (int i = 0; i < count; ++i) {
+            float v = channel_value(c, i, positions, velocities, densities);
+            min_v = min(min_v, v);
+            max_v = max(max_v, v);
+        }
+        if (count == 0) {
+            min_v = max_v = 0.0f;
+        }
+        header.channel_min[c] = min_v;
+        header.channel_max[c] = max_v;
+    }
+
+    // Quantize every channel to 16 bits, delta code it along the particles,
+    // and store the low and high bytes in separate planes
+    QByteArray raw(count * 2 * FRAME_CHANNEL_COUNT, 0);
+    auto out = reinterpret_cast<uint8_t*>(raw.data());
+    for (int c = 0; c < FRAME_CHANNEL_COUNT; ++c) {
+        float range = header.channel_max[c] - header.channel_min[c];
+        float scale = range > 0.0f ? 65535.0f / range : 0.0f;
+        uint8_t* lo = out + c * 2 * count;
+        uint8_t* hi = lo + count;
+        uint16_t prev = 0;
+        for (int i = 0; i < count; ++i) {
+            float v = channel_value(c, i, positions, velocities, densities);
+            float q = roundf((v - header.channel_min[c]) * scale);
+            uint16_t qv = (uint16_t)min(max(q, 0.0f), 65535.0f);
+            uint16_t delta = qv - prev;
+            prev = qv;
+            lo[i] = delta & 0xff;
+            hi[i] = delta >> 8;
+        }
+    }
+
+    QByteArray compressed = qCompress(raw, FRAME_COMPRESSION_LEVEL);
+    header.raw_size = raw.size();
+    header.compressed_size = compressed.size();
+
+    return compressed;
+}
+
+void FrameCodec::decode(const FrameHeader& header,
+                        const char* payload,
+                        FrameData& frame) {
+    if (!check_frame_header(header)) {
+        throw RunTimeException("Corrupt frame: bad magic number");
+    }
+
+    int count = header.particle_count;
+    QByteArray raw = qUncompress(reinterpret_cast<const uchar*>(payload),
+                                 header.compressed_size);
+    if ((uint32_t)raw.size() != header.raw_size ||
+        raw.size() != count * 2 * FRAME_CHANNEL_COUNT) {
+        throw RunTimeException("Corrupt frame: unexpected payload size");
+    }
+
+    frame.step = header.step;
+    frame.positions.resize(count);
+    frame.velocities.resize(count);
+    frame.densities.resize(count);
+
+    auto in = reinterpret_cast<const uint8_t*>(raw.constData());
+    for (int c = 0; c < FRAME_CHANNEL_COUNT; ++c) {
+        float range = header.channel_max[c] - header.channel_min[c];
+        float scale = range / 65535.0f;
+        const uint8_t* lo = in + c * 2 * count;
+        const uint8_t* hi = lo + count;
+        uint16_t prev = 0;
+        for (int i = 0; i < count; ++i) {
+            uint16_t qv = prev + (uint16_t)(lo[i] | (hi[i] << 8));
+            prev = qv;
+            float v = header.channel_min[c] + qv * scale;
+            if (c < 3) {
+                frame.positions[i].s[c] = v;
+            }
+            else if (c < 6) {
+                frame.velocities[i].s[c - 3] = v;
+            }
+            else {
+                frame.densities[i] = v;
+            }
+        }
+    }
+
+    // Positions are homogeneous points, velocities are vectors
+    for (int i = 0; i < count; ++i) {
+        frame.positions[i].s[3] = 1.0f;
+        frame.velocities[i].s[3] = 0.0f;
+    }
+}
@@ -0,0 +1,179 @@
+/**
+ *  @file framecodec.h
+ *  @brief Contains the declaration of the FrameCodec class.
+ *
+ *  A recording is a file header followed by a sequence of self contained
+ *  frames. Every frame is a FrameHeader followed by its compressed payload
+ *  and the raw state of the rigid bodies. The payload stores 7 planar 
+ *  channels (position xyz, velocity xyz and density) linearly quantized to 
+ *  16 bits within the range of the frame, delta coded along the particle 
+ *  order, split in byte planes and deflated. When the recording is closed, an
+ *  index with the offset of every frame and a FrameFileFooter are appended.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _FRAME_CODEC_H_
+#define _FRAME_CODEC_H_
+
+#include <CL/cl.h>
+#include <QByteArray>
+#include <cstdint>
+#include <vector>
+
+#include "fluid/simulation/checkpoint.h"
+
+// Current version of the recording layout
+#define FRAME_FILE_VERSION      2
+
+// Number of quantized channels of every frame
+#define FRAME_CHANNEL_COUNT     7
+
+/**
+ * @brief The header found at the beginning of every recording
+ */
+struct FrameFileHeader {
+    char magic[8];
+    uint32_t version;
+    // Number of simulation steps between recorded frames
+    uint32_t interval;
+    float time_step;
+    float particle_radius;
+};
+
+/**
+ * @brief The header of every frame of a recording
+ */
+struct FrameHeader {
+    char magic[4];
+    uint32_t particle_count;
+    // The simulation step the frame was taken at
+    uint64_t step;
+    // Quantization range of every channel
+    float channel_min[FRAME_CHANNEL_COUNT];
+    float channel_max[FRAME_CHANNEL_COUNT];
+    // Size of the quantized data, before and after compression
+    uint32_t raw_size;
+    uint32_t compressed_size;
+    // Number of CheckpointBody entries that follow the payload
+    uint32_t body_count;
+    uint32_t reserved;
+};
+
+/**
+ * @brief The footer found at the end of a closed recording, right after
+ *        the index of frame offsets
+ */
+struct FrameFileFooter {
+    // Offset of the index from the beginning of the file, in bytes
+    uint64_t index_offset;
+    uint64_t frame_count;
+    char magic[8];
+};
+
+/**
+ * @brief The decoded state of the particles of a frame
+ */
+struct FrameData {
+    uint64_t step;
+    std::vector<cl_float4> positions;
+    std::vector<cl_float4> velocities;
+    std::vector<cl_float> densities;
+    std::vector<CheckpointBody> bodies;
+};
+
+/**
+ * @class FrameCodec
+ * @brief Encodes and decodes the frames of a recording
+ * @details The solvers keep the particles sorted by the cell hash of the
+ *          uniform grid, so consecutive particles are close in space. That
+ *          makes the delta between consecutive quantized values small,
+ *          which is what makes the payload compress well. Every frame is
+ *          decoded on its own, no previous frame is ever needed.
+ */
+class FrameCodec {
+    public:
+        /**
+         * @brief Fills the header of a new recording
+         *
+         * @param header The header to fill.
+         * @param interval Simulation steps between frames.
+         * @param time_step The simulation time step.
+         * @param particle_radius The fluid particle radius.
+         */
+        static void init_file_header(FrameFileHeader& header,
+                                     int interval,
+                                     float time_step,
+                                     float particle_radius);
+
+        /**
+         * @brief Validates the header of a recording
+         * @return true if the header belongs to a valid recording
+         */
+        static bool check_file_header(const FrameFileHeader& header);
+
+        /**
+         * @brief Fills the footer of a recording
+         *
+         * @param footer The footer to fill.
+         * @param index_offset Offset of the index of frames.
+         * @param frame_count Number of frames of the recording.
+         */
+        static void init_file_footer(FrameFileFooter& footer,
+                                     uint64_t index_offset,
+                                     uint64_t frame_count);
+
+        /**
+         * @brief Validates the footer of a recording
+         * @return true if the footer belongs to a closed recording
+         */
+        static bool check_file_footer(const FrameFileFooter& footer);
+
+        /**
+         * @brief Validates the header of a frame
+         * @return true if the header belongs to a frame
+         */
+        static bool check_frame_header(const FrameHeader& header);
+
+        /**
+         * @brief Returns the size of a frame, header included
+         */
+        static uint64_t frame_size(const FrameHeader& header);
+
+        /**
+         * @brief Encodes a frame
+         *
+         * @param step The simulation step of the frame.
+         * @param count Number of particles.
+         * @param positions Particle positions.
+         * @param velocities Particle velocities.
+         * @param densities Particle densities.
+         * @param header The header of the encoded frame.
+         * @return The compressed payload of the frame.
+         */
+        static QByteArray encode(uint64_t step,
+                                 int count,
+                                 const cl_float4* positions,
+                                 const cl_float4* velocities,
+                                 const cl_float* densities,
+                                 FrameHeader& header);
+
+        /**
+         * @brief Decodes the particles of a frame
+         * @note The rigid bodies are not decoded, they are stored raw after
+         *       the payload.
+         *
+         * @param header The header of the frame.
+         * @param payload The compressed payload of the frame.
+         * @param frame The decoded frame.
+         * @throws RunTimeException if the payload is corrupt.
+         */
+        static void decode(const FrameHeader& header,
+                           const char* payload,
+                           FrameData& frame);
+
+    private:
+        FrameCodec();
+};
+
+#endif // _FRAME_CODEC_H_
@@ -0,0 +1,282 @@
+#include "framewriter.h"
+#include "framecodec.h"
+#include "fluid/simulation/fluidsimulation.h"
+#include "opencl/clenvironment.h"
+#include "opencl/clallocator.h"
+#include "runtimeexception.h"
+
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Bytes of pinned memory needed by every particle of a slot
+static const size_t BYTES_PER_PARTICLE = 2 * sizeof(cl_float4) + sizeof(cl_float);
+
+/**
+ * @brief Appends the whole data to the file, retrying partial writes
+ * @return false if the data could not be written
+ */
+static bool append_all(int fd, const void* data, size_t size) {
+    auto ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, ptr, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += written;
+        size -= written;
+    }
+    return true;
+}
+
+FrameWriter::FrameWriter(const string& path,
+                         int interval,
+                         float time_step,
+                         float particle_radius,
+                         int ring_size) :
+_path(path),
+_fd(-1),
+_interval(max(interval, 1)),
+_next_slot(0),
+_stop(false),
+_failed(false),
+_file_offset(0),
+_frames_written(0),
+_frames_dropped(0) {
+    _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        throw RunTimeException("Could not create recording file " + path + ": " + strerror(errno));
+    }
+
+    FrameFileHeader header;
+    FrameCodec::init_file_header(header, _interval, time_step, particle_radius);
+    if (!append_all(_fd, &header, sizeof(header))) {
+        close(_fd);
+        throw RunTimeException("Could not write recording file " + path + ": " + strerror(errno));
+    }
+    _file_offset = sizeof(header);
+
+    // Slots are allocated lazily, on the first capture that uses them
+    _slots.resize(max(ring_size, 1));
+    for (auto& slot : _slots) {
+        slot.buffer = nullptr;
+        slot.mapped = nullptr;
+        slot.capacity = 0;
+        slot.positions = slot.velocities = nullptr;
+        slot.densities = nullptr;
+        slot.count = 0;
+        slot.step = 0;
+        slot.event = nullptr;
+        slot.busy = false;
+    }
+
+    _thread = thread(&FrameWriter::_write_loop, this);
+}
+
+FrameWriter::~FrameWriter() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+
+    _write_index();
+
+    for (auto& slot : _slots) {
+        _release_slot(slot);
+    }
+
+    close(_fd);
+
+    cout << "Recorded " << _frames_written << " frames to " << _path;
+    if (_frames_dropped > 0) {
+        cout << " (" << _frames_dropped << " dropped)";
+    }
+    cout << endl;
+}
+
+int FrameWriter::interval() const {
+    return _interval;
+}
+
+unsigned long FrameWriter::frames_written() const {
+    lock_guard<mutex> lock(_mutex);
+    return _frames_written;
+}
+
+unsigned long FrameWriter::frames_dropped() const {
+    lock_guard<mutex> lock(_mutex);
+    return _frames_dropped;
+}
+
+void FrameWriter::capture(FluidSimulation& simulation) {
+    int index;
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_failed) {
+            return;
+        }
+        // Slots are used round robin and written in order, so if the next
+        // one is still busy, all of them are
+        if (_slots[_next_slot].busy) {
+            ++_frames_dropped;
+            return;
+        }
+        index = _next_slot;
+        _next_slot = (_next_slot + 1) % _slots.size();
+    }
+
+    // The slot is not owned by the writer thread, so it can be touched
+    // without holding the lock
+    auto& slot = _slots[index];
+    int count = simulation.particle_count();
+    if (count > slot.capacity) {
+        _resize_slot(slot, count);
+    }
+
+    slot.count = count;
+    slot.step = simulation.step_count();
+    slot.bodies = simulation.bodies_state();
+    slot.event = nullptr;
+    if (count > 0) {
+        simulation.download_particles(slot.positions,
+                                      slot.velocities,
+                                      slot.densities,
+                                      &slot.event);
+    }
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        slot.busy = true;
+        _pending.push_back(index);
+    }
+    _cond.notify_one();
+}
+
+void FrameWriter::_resize_slot(_Slot& slot, int capacity) {
+    _release_slot(slot);
+
+    // Memory allocated by the device as host memory is pinned, so the
+    // downloads are plain DMA transfers. The buffer remains mapped for its
+    // whole life, and the mapped pointer is the destination of the reads
+    size_t size = capacity * BYTES_PER_PARTICLE;
+    cl_mem_flags flags = CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR;
+    slot.buffer = CLAllocator::alloc_buffer<char>("recorder/staging", size, flags);
+
+    cl_int err;
+    slot.mapped = clEnqueueMapBuffer(CLEnvironment::queue(),
+                                     slot.buffer,
+                                     CL_TRUE,
+                                     CL_MAP_READ | CL_MAP_WRITE,
+                                     0,
+                                     size,
+                                     0,
+                                     nullptr,
+                                     nullptr,
+                                     &err);
+    CLError::check(err);
+
+    auto base = static_cast<char*>(slot.mapped);
+    slot.capacity = capacity;
+    slot.positions = reinterpret_cast<cl_float4*>(base);
+    slot.velocities = reinterpret_cast<cl_float4*>(base + capacity * sizeof(cl_float4));
+    slot.densities = reinterpret_cast<cl_float*>(base + 2 * capacity * sizeof(cl_float4));
+}
+
+void FrameWriter::_release_slot(_Slot& slot) {
+    if (slot.buffer == nullptr) {
+        return;
+    }
+
+    clEnqueueUnmapMemObject(CLEnvironment::queue(),
+                            slot.buffer,
+                            slot.mapped,
+                            0,
+                            nullptr,
+                            nullptr);
+    clFinish(CLEnvironment::queue());
+    CLAllocator::release_buffer(slot.buffer);
+
+    slot.buffer = nullptr;
+    slot.mapped = nullptr;
+    slot.capacity = 0;
+}
+
+void FrameWriter::_write_loop() {
+    while (true) {
+        int index;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _cond.wait(lock, [this]{ return _stop || !_pending.empty(); });
+            if (_pending.empty()) {
+                // Stopped, and every frame has been written
+                return;
+            }
+            index = _pending.front();
+            _pending.pop_front();
+        }
+
+        auto& slot = _slots[index];
+        if (slot.event != nullptr) {
+            clWaitForEvents(1, &slot.event);
+            clReleaseEvent(slot.event);
+            slot.event = nullptr;
+        }
+
+        bool ok;
+        {
+            // Nobody else writes to the file, so there is no need to lock
+            // while encoding
+            FrameHeader header;
+            QByteArray payload = FrameCodec::encode(slot.step,
+                                                    slot.count,
+                                                    slot.positions,
+                                                    slot.velocities,
+                                                    slot.densities,
+                                                    header);
+            header.body_count = slot.bodies.size();
+            ok = !_failed &&
+                 append_all(_fd, &header, sizeof(header)) &&
+                 append_all(_fd, payload.constData(), payload.size()) &&
+                 append_all(_fd, slot.bodies.data(), slot.bodies.size() * sizeof(CheckpointBody));
+            if (ok) {
+                _frame_offsets.push_back(_file_offset);
+                _file_offset += FrameCodec::frame_size(header);
+            }
+        }
+
+        lock_guard<mutex> lock(_mutex);
+        if (ok) {
+            ++_frames_written;
+        }
+        else if (!_failed) {
+            cerr << "Could not write recording file " << _path << ": " << strerror(errno) << endl;
+            _failed = true;
+        }
+        slot.busy = false;
+    }
+}
+
+void FrameWriter::_write_index() {
+    if (_failed) {
+        // Readers rebuild the index of a recording without footer
+        return;
+    }
+
+    FrameFileFooter footer;
+    FrameCodec::init_file_footer(footer, _file_offset, _frame_offsets.size());
+    bool ok = append_all(_fd, _frame_offsets.data(), _frame_offsets.size() * sizeof(uint64_t)) &&
+              append_all(_fd, &footer, sizeof(footer));
+    if (!ok) {
+        cerr << "Could not write the index of recording " << _path << ": " << strerror(errno) << endl;
+    }
+}
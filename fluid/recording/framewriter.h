@@ -0,0 +1,143 @@
+/**
+ *  @file framewriter.h
+ *  @brief Contains the declaration of the FrameWriter class.
+ *
+ *  The FrameWriter records the state of the fluid every few simulation steps
+ *  without ever stalling the simulation on disk. See framecodec.h for the
+ *  layout of the recording.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _FRAME_WRITER_H_
+#define _FRAME_WRITER_H_
+
+#include <CL/cl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "fluid/simulation/checkpoint.h"
+
+class FluidSimulation;
+
+/**
+ * @class FrameWriter
+ * @brief Streams compressed particle frames to a file
+ * @details The particles are downloaded with non blocking reads into a ring
+ *          of pinned host buffers. A background thread waits for each
+ *          download, encodes the frame and appends it to the file. If every
+ *          slot of the ring is still waiting to be written, the frame is
+ *          dropped instead of waiting, so the simulation never blocks on
+ *          disk. The index of frames is written when the writer is
+ *          destroyed.
+ */
+class FrameWriter {
+    public:
+        /**
+         * @brief Creates a new recording
+         *
+         * @param path The path of the recording file.
+         * @param interval Simulation steps between recorded frames.
+         * @param time_step The simulation time step.
+         * @param particle_radius The fluid particle radius.
+         * @param ring_size Number of frames that can be in flight.
+         * @throws RunTimeException if the file could not be created.
+         */
+        FrameWriter(const std::string& path,
+                    int interval,
+                    float time_step,
+                    float particle_radius,
+                    int ring_size=4);
+
+        /**
+         * @brief Writes all pending frames, and closes the file
+         */
+        ~FrameWriter();
+
+        /**
+         * @brief Returns the number of steps between recorded frames
+         */
+        int interval() const;
+
+        /**
+         * @brief Captures the current state of the simulation
+         * @details Only the downloads are enqueued here. The frame is
+         *          encoded and written by the background thread.
+         *
+         * @param simulation The fluid simulation to capture.
+         */
+        void capture(FluidSimulation& simulation);
+
+        /**
+         * @brief Returns the number of frames written so far
+         */
+        unsigned long frames_written() const;
+
+        /**
+         * @brief Returns the number of frames dropped because the writer
+         *        could not keep up with the simulation
+         */
+        unsigned long frames_dropped() const;
+
+    private:
+        // A slot of the ring of host buffers
+        struct _Slot {
+            // Device buffers allocated as pinned host memory, kept mapped
+            cl_mem buffer;
+            void* mapped;
+            int capacity;
+
+            cl_float4* positions;
+            cl_float4* velocities;
+            cl_float* densities;
+
+            std::vector<CheckpointBody> bodies;
+
+            int count;
+            uint64_t step;
+            cl_event event;
+            bool busy;
+        };
+
+        std::string _path;
+        int _fd;
+        int _interval;
+
+        std::vector<_Slot> _slots;
+        int _next_slot;
+
+        // Slots waiting to be written, in capture order
+        std::deque<int> _pending;
+
+        std::thread _thread;
+        mutable std::mutex _mutex;
+        std::condition_variable _cond;
+        bool _stop;
+        bool _failed;
+
+        // Offset of every frame written, and of the end of the file. Only
+        // the writer thread touches them until it is joined
+        std::vector<uint64_t> _frame_offsets;
+        uint64_t _file_offset;
+
+        unsigned long _frames_written;
+        unsigned long _frames_dropped;
+
+        void _resize_slot(_Slot& slot, int capacity);
+
+        void _release_slot(_Slot& slot);
+
+        void _write_loop();
+
+        void _write_index();
+
+        FrameWriter(const FrameWriter&);
+        FrameWriter& operator=(const FrameWriter&);
+};
+
+#endif // _FRAME_WRITER_H_
@@ -36,6 +36,14 @@ class FluidRenderer {
          */
         virtual void reset(int particle_count) = 0;
 
+        /**
+         * @brief Tells if the renderer writes the background itself
+         * @details A renderer that does so writes every pixel of the destination,
+         *          sampling the background texture where there is no fluid,
+         *          so the scene does not have to copy the background first.
+         */
+        virtual bool composites_background() const { return false; }
+
         /**
          * Virtual destructor
          */
@@ -0,0 +1,155 @@
+#include "particleculler.h"
+#include "opengl/openglfunctions.h"
+#include <QVector4D>
+
+using namespace std;
+
+// Must match the work group size of the shader
+#define GROUP_SIZE  256
+
+// Layout of the commands read by glDrawArraysIndirect
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+};
+
+ParticleCuller::ParticleCuller(float lod_distance,
+                               float particle_spacing,
+                               int max_lod_level,
+                               bool with_metrics) :
+_lod_distance(lod_distance),
+_particle_spacing(particle_spacing),
+_max_lod_level(max_lod_level),
+_with_metrics(with_metrics),
+_visible_metrics(0),
+_capacity(0) {
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    _program = create_compute_program("shaders/particles_cull.comp");
+
+    gl.glGenBuffers(1, &_visible_particles);
+    if (_with_metrics) {
+        gl.glGenBuffers(1, &_visible_metrics);
+    }
+
+    DrawArraysIndirectCommand command = {0, 1, 0, 0};
+    gl.glGenBuffers(1, &_draw_command);
+    gl.glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _draw_command);
+    gl.glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+    gl.glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+ParticleCuller::~ParticleCuller() {
+    auto& gl = OpenGLFunctions::getFunctions();
+    gl.glDeleteBuffers(1, &_visible_particles);
+    gl.glDeleteBuffers(1, &_draw_command);
+    if (_visible_metrics) {
+        gl.glDeleteBuffers(1, &_visible_metrics);
+    }
+}
+
+GLuint ParticleCuller::visible_particles() const {
+    return _visible_particles;
+}
+
+GLuint ParticleCuller::visible_metrics() const {
+    return _visible_metrics;
+}
+
+GLuint ParticleCuller::draw_command() const {
+    return _draw_command;
+}
+
+void ParticleCuller::_reserve(int particle_count) {
+    if (particle_count <= _capacity) {
+        return;
+    }
+
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    // Re-specifying the storage keeps the name, so VAOs that source the
+    // buffer are still valid
+    _capacity = particle_count;
+    gl.glBindBuffer(GL_ARRAY_BUFFER, _visible_particles);
+    gl.glBufferData(GL_ARRAY_BUFFER, _capacity * 4 * sizeof(GLfloat), nullptr, GL_DYNAMIC_COPY);
+    if (_with_metrics) {
+        gl.glBindBuffer(GL_ARRAY_BUFFER, _visible_metrics);
+        gl.glBufferData(GL_ARRAY_BUFFER, _capacity * 4 * sizeof(GLfloat), nullptr, GL_DYNAMIC_COPY);
+    }
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleCuller::cull(GLuint vbo_particles,
+                          int particle_count,
+                          const QMatrix4x4& mv_matrix,
+                          const QMatrix4x4& projection,
+                          float point_radius,
+                          GLuint vbo_metrics) {
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    _reserve(particle_count);
+
+    // The shader counts the selected particles from zero
+    DrawArraysIndirectCommand command = {0, 1, 0, 0};
+    gl.glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _draw_command);
+    gl.glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+    gl.glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    if (particle_count == 0) {
+        return;
+    }
+
+    // Frustum planes, in the space of the particles, from the rows of the
+    // model view projection matrix
+    QMatrix4x4 mvp = projection * mv_matrix;
+    QVector4D planes[6] = {
+        mvp.row(3) + mvp.row(0),
+        mvp.row(3) - mvp.row(0),
+        mvp.row(3) + mvp.row(1),
+        mvp.row(3) - mvp.row(1),
+        mvp.row(3) + mvp.row(2),
+        mvp.row(3) - mvp.row(2)
+    };
+    for (auto& plane : planes) {
+        plane /= plane.toVector3D().length();
+    }
+
+    _program->bind();
+    _program->setUniformValue("mv_matrix", mv_matrix);
+    _program->setUniformValueArray("frustum_planes", planes, 6);
+    _program->setUniformValue("particle_count", (GLuint)particle_count);
+    _program->setUniformValue("point_radius", point_radius);
+    _program->setUniformValue("lod_distance", _lod_distance);
+    _program->setUniformValue("max_lod_level", _max_lod_level);
+    // A particle is dropped or kept as a whole while it stays in a cell
+    // about its size, so the subsample barely changes between frames. The
+    // point sprites are much larger than the particles, their cells would
+    // hold dozens of them
+    _program->setUniformValue("lod_quantum", _particle_spacing);
+
+    bool with_metrics = _with_metrics && vbo_metrics != 0;
+    _program->setUniformValue("with_metrics", with_metrics);
+
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo_particles);
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _visible_particles);
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _draw_command);
+    if (with_metrics) {
+        gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, vbo_metrics);
+        gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _visible_metrics);
+    }
+
+    gl.glDispatchCompute((particle_count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+    if (with_metrics) {
+        gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+        gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, 0);
+    }
+
+    // The draw reads the particles as vertices, and the count as a command
+    gl.glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
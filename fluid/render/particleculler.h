@@ -0,0 +1,95 @@
+#ifndef _PARTICLE_CULLER_H_
+#define _PARTICLE_CULLER_H_
+
+#include "opengl/glutils.h"
+#include <QMatrix4x4>
+#include <memory>
+
+/**
+ * @class ParticleCuller
+ * @brief Selects the particles to draw on the GPU
+ * @details A compute shader drops the particles outside the view frustum and,
+ *          past a distance from the camera, draws a stable subsample of them
+ *          with enlarged point sprites. The selected particles are compacted
+ *          to a buffer, and their count is written to an indirect draw
+ *          command, so the CPU never reads it back. The metrics of the
+ *          particles, if any, are compacted along with them.
+ */
+class ParticleCuller {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param lod_distance Distance from the camera where the subsampling
+         *                     starts. Zero keeps every visible particle.
+         * @param particle_spacing The spacing of the simulation particles,
+         *                         the positions are quantized by it.
+         * @param max_lod_level At least one of 2^max_lod_level particles is
+         *                      kept.
+         * @param with_metrics Whether the metrics of the particles are
+         *                     compacted too.
+         */
+        ParticleCuller(float lod_distance,
+                       float particle_spacing,
+                       int max_lod_level=4,
+                       bool with_metrics=false);
+
+        ~ParticleCuller();
+
+        /**
+         * @brief Selects the particles to draw
+         *
+         * @param vbo_particles The VBO with the positions of the particles.
+         * @param particle_count The number of particles in the VBO.
+         * @param mv_matrix The current model view transformation.
+         * @param projection The projection of the camera.
+         * @param point_radius The radius of the particles point sprites.
+         * @param vbo_metrics The VBO with a vec4 of metrics per particle,
+         *                    only read if the culler was built with them.
+         */
+        void cull(GLuint vbo_particles,
+                  int particle_count,
+                  const QMatrix4x4& mv_matrix,
+                  const QMatrix4x4& projection,
+                  float point_radius,
+                  GLuint vbo_metrics=0);
+
+        /**
+         * @brief Buffer with the selected particles
+         * @details One vec4 per particle, with the position in xyz and the
+         *          factor to enlarge its point sprite by in w. The buffer
+         *          keeps its name when it grows.
+         */
+        GLuint visible_particles() const;
+
+        /**
+         * @brief Buffer with the metrics of the selected particles, in the
+         *        same order. Zero if the culler was built without them
+         */
+        GLuint visible_metrics() const;
+
+        /**
+         * @brief Buffer with the indirect command that draws the selected
+         *        particles, for glDrawArraysIndirect
+         */
+        GLuint draw_command() const;
+
+    private:
+        float _lod_distance;
+        float _particle_spacing;
+        int _max_lod_level;
+        bool _with_metrics;
+
+        std::unique_ptr<QOpenGLShaderProgram> _program;
+
+        GLuint _visible_particles;
+        GLuint _visible_metrics;
+        GLuint _draw_command;
+
+        // Number of particles the visible buffer has room for
+        int _capacity;
+
+        void _reserve(int particle_count);
+};
+
+#endif // _PARTICLE_CULLER_H_
@@ -2,16 +2,55 @@
 #include "runtimeexception.h"
 #include <opencl/clenvironment.h>
 #include <opengl/openglfunctions.h>
+#include <kernels/common.h>
+#include "profiling/frameprofiler.h"
 #include <CL/cl_gl.h>
 #include <sstream>
 
 using namespace std;
 
+// Radius of the point sprites
+#define POINT_RADIUS    (0.125f * 0.5f)
+
+// The component of the metrics a coloring shows, and the value drawn with
+// the hottest color. The lists are fitted to the scene, so their counts are
+// against the length they start with. The densities are off by a few
+// percent at most, past that the solver did not converge
+static void metric_range(ParticleColoring coloring, int& component, float& max_value) {
+    switch (coloring) {
+        case NEIGHBOUR_COUNT:
+            component = 0;
+            max_value = NEIGH_LIST_DEFAULT_LENGTH;
+            break;
+        case TRUNCATED_LISTS:
+            component = 1;
+            max_value = 1.0f;
+            break;
+        case DENSITY_ERROR:
+            component = 2;
+            max_value = 0.05f;
+            break;
+        case BOUNDARY_NEIGHBOURS:
+            component = 3;
+            max_value = NEIGH_LIST_DEFAULT_LENGTH;
+            break;
+        default:
+            component = -1;
+            max_value = 1.0f;
+    }
+}
+
 ParticlesRenderer::ParticlesRenderer(int viewport_width,
                                      int viewport_height,
                                      int particle_count,
-                                     GLuint vbo_particles) :
+                                     float lod_distance,
+                                     float particle_spacing,
+                                     GLuint vbo_particles,
+                                     ParticleColoring coloring,
+                                     GLuint vbo_metrics) :
 _vbo_particles(vbo_particles),
+_vbo_metrics(coloring != FLUID_COLOR ? vbo_metrics : 0),
+_coloring(_vbo_metrics ? coloring : FLUID_COLOR),
 _particle_count(particle_count),
 _viewport_w(viewport_width),
 _viewport_h(viewport_height) {
@@ -22,20 +61,37 @@ _viewport_h(viewport_height) {
 
     _shader->bind();
 
+    _culler = make_unique<ParticleCuller>(lod_distance, particle_spacing, 4, _vbo_metrics != 0);
+
     // Create a VAO for this stage
     gl.glGenVertexArrays(1, &_vao);
     gl.glBindVertexArray(_vao);
 
-    // Bind the VBO to the shader
+    // Bind the visible particles to the shader. The w component is the
+    // factor to enlarge the point sprite by, so it must not be normalized
     auto particle_pos_loc = _shader->attributeLocation("particle_pos");
-    gl.glBindBuffer(GL_ARRAY_BUFFER, _vbo_particles);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, _culler->visible_particles());
     gl.glVertexAttribPointer(particle_pos_loc,
                              4,
                              GL_FLOAT,
-                             GL_TRUE,
+                             GL_FALSE,
                              0,
                              NULL);
     _shader->enableAttributeArray(particle_pos_loc);
+
+    // The metrics follow the particles through the culling
+    if (_vbo_metrics) {
+        auto particle_metrics_loc = _shader->attributeLocation("particle_metrics");
+        gl.glBindBuffer(GL_ARRAY_BUFFER, _culler->visible_metrics());
+        gl.glVertexAttribPointer(particle_metrics_loc,
+                                 4,
+                                 GL_FLOAT,
+                                 GL_FALSE,
+                                 0,
+                                 NULL);
+        _shader->enableAttributeArray(particle_metrics_loc);
+    }
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void ParticlesRenderer::render(const Camera& camera,
@@ -47,6 +103,17 @@ void ParticlesRenderer::render(const Camera& camera,
                                GLuint cube_map_texture) {
     auto& gl = OpenGLFunctions::getFunctions();
 
+    // Culling and drawing are the only stage, the final one
+    FrameProfiler::begin(FramePhase::RENDER_FINAL);
+
+    // Select the particles to draw, before binding anything for the draw
+    _culler->cull(_vbo_particles,
+                  _particle_count,
+                  mv_matrix,
+                  camera.projection(),
+                  POINT_RADIUS,
+                  _vbo_metrics);
+
     gl.glBindFramebuffer(GL_FRAMEBUFFER, dest_fbo);
 
     _shader->bind();
@@ -71,22 +138,32 @@ void ParticlesRenderer::render(const Camera& camera,
 
     // Get perspective info to calculate point sprite size
     auto perspective = camera.perspective();
-    _shader->setUniformValue("point_radius", 0.125f * 0.5f);
+    _shader->setUniformValue("point_radius", POINT_RADIUS);
     _shader->setUniformValue("point_scale", perspective.width * tanf(perspective.fov * (0.5f * 3.1415926535f/180.0f)));
     _shader->setUniformValue("near_plane", perspective.nearPlane);
     _shader->setUniformValue("far_plane", perspective.farPlane);
 
+    int metric;
+    float metric_max;
+    metric_range(_coloring, metric, metric_max);
+    _shader->setUniformValue("metric", metric);
+    _shader->setUniformValue("metric_max", metric_max);
+
     // Render particles as point sprites
     gl.glEnable(GL_DEPTH_TEST);
     gl.glEnable(GL_PROGRAM_POINT_SIZE);
 
-    // Bind vertex array and draw it
+    // Bind vertex array and draw it, the count of particles is on the GPU
     gl.glBindVertexArray(_vao);
-    gl.glDrawArrays(GL_POINTS, 0, _particle_count);
+    gl.glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _culler->draw_command());
+    gl.glDrawArraysIndirect(GL_POINTS, 0);
+    gl.glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 
     gl.glDisable(GL_PROGRAM_POINT_SIZE);
 
     gl.glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    FrameProfiler::end(FramePhase::RENDER_FINAL);
 }
 
 void ParticlesRenderer::reset(int particle_count) {
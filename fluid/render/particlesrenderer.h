@@ -2,16 +2,36 @@
 #define _PARTICLES_RENDERER_H_
 
 #include "fluidrenderer.h"
+#include "particleculler.h"
+#include <memory>
 
 // Renders the fluid using the screen space fluid rendering technique
 class ParticlesRenderer : public FluidRenderer {
 
     public:
 
+        /**
+         * @brief Constructor
+         * 
+         * @param viewport_width The width of the viewport
+         * @param viewport_height The height of the viewport
+         * @param particle_count Number of fluid particles
+         * @param lod_distance Distance where the subsampling starts
+         * @param particle_spacing The spacing of the simulation particles
+         * @param vbo_particles The VBO with the positions of the particles
+         * @param coloring What the particles are colored by
+         * @param vbo_metrics The VBO with the costs of the particles, as
+         *                    written by the solver. Zero draws the fluid
+         *                    color, whatever the coloring.
+         */
         ParticlesRenderer(int viewport_width,
                           int viewport_height,
                           int particle_count,
-                          GLuint vbo_particles);
+                          float lod_distance,
+                          float particle_spacing,
+                          GLuint vbo_particles,
+                          ParticleColoring coloring=FLUID_COLOR,
+                          GLuint vbo_metrics=0);
 
         ~ParticlesRenderer();
 
@@ -44,6 +64,11 @@ class ParticlesRenderer : public FluidRenderer {
         // The vbo that holds the particles positions
         GLuint _vbo_particles;
 
+        // The vbo that holds the costs of the particles, zero if they are
+        // not drawn
+        GLuint _vbo_metrics;
+        ParticleColoring _coloring;
+
         GLuint _vao;
 
         // The number of particles being rendered
@@ -54,6 +79,9 @@ class ParticlesRenderer : public FluidRenderer {
 
         // Shader programs
         std::unique_ptr<QOpenGLShaderProgram> _shader;
+
+        // Selects the particles to draw, the VAO sources its output
+        std::unique_ptr<ParticleCuller> _culler;
 };
 
 #endif // _PARTICLES_RENDERER_H_
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "resolutioncontroller.h"
+#include <algorithm>
+
+using namespace std;
+
+// Weight of the last frame in the moving average
+#define SMOOTHING           0.1f
+
+// The scale changes by this amount every time
+#define SCALE_STEP          0.05f
+
+// Frames to wait after a change
+#define COOLDOWN_FRAMES     30
+
+// The scale is lowered above target * (1 + TOLERANCE), and raised below
+// target * (1 - HEADROOM). The gap between both keeps the scale stable
+#define TOLERANCE           0.05f
+#define HEADROOM            0.20f
+
+ResolutionController::ResolutionController(float target_frame_time,
+                                           float min_scale,
+                                           float max_scale,
+                                           float initial_scale) :
+_target_frame_time(target_frame_time),
+_min_scale(min_scale),
+_max_scale(max_scale),
+_scale(min(max(initial_scale, min_scale), max_scale)),
+_avg_frame_time(target_frame_time),
+_cooldown(COOLDOWN_FRAMES) {
+
+}
+
+bool ResolutionController::update(float frame_time) {
+    _avg_frame_time += SMOOTHING * (frame_time - _avg_frame_time);
+
+    if (_cooldown > 0) {
+        --_cooldown;
+        return false;
+    }
+
+    float new_scale = _scale;
+    if (_avg_frame_time > _target_frame_time * (1.0f + TOLERANCE)) {
+        new_scale = max(_scale - SCALE_STEP, _min_scale);
+    }
+    else if (_avg_frame_time < _target_frame_time * (1.0f - HEADROOM)) {
+        new_scale = min(_scale + SCALE_STEP, _max_scale);
+    }
+
+    if (new_scale == _scale) {
+        return false;
+    }
+
+    _scale = new_scale;
+    _cooldown = COOLDOWN_FRAMES;
+    return true;
+}
+
+float ResolutionController::scale() const {
+    return _scale;
+}
+
+float ResolutionController::frame_time() const {
+    return _avg_frame_time;
+}
@@ -0,0 +1,64 @@
+/**
+ *  @file resolutioncontroller.h
+ *  @brief Contains the declaration of the ResolutionController class.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _RESOLUTION_CONTROLLER_H_
+#define _RESOLUTION_CONTROLLER_H_
+
+/**
+ * @class ResolutionController
+ * @brief Picks a rendering resolution scale that holds a target frame time
+ * @details The frame time is smoothed with an exponential moving average.
+ *          When it is above the target the scale is lowered, and when it is
+ *          well below the target the scale is raised again. The scale moves
+ *          in fixed steps, and after every change the controller waits some
+ *          frames for the frame time to settle, so it does not oscillate.
+ */
+class ResolutionController {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param target_frame_time The frame time to hold, in milliseconds.
+         * @param min_scale The smallest scale allowed.
+         * @param max_scale The largest scale allowed.
+         * @param initial_scale The scale to start with.
+         */
+        ResolutionController(float target_frame_time,
+                             float min_scale,
+                             float max_scale,
+                             float initial_scale);
+
+        /**
+         * @brief Feeds the time of the last frame
+         *
+         * @param frame_time The time of the last frame, in milliseconds.
+         * @return true if the scale changed.
+         */
+        bool update(float frame_time);
+
+        /**
+         * @brief Returns the current scale
+         */
+        float scale() const;
+
+        /**
+         * @brief Returns the smoothed frame time, in milliseconds
+         */
+        float frame_time() const;
+
+    private:
+        float _target_frame_time;
+        float _min_scale, _max_scale;
+        float _scale;
+
+        float _avg_frame_time;
+
+        // Frames to wait before the next change
+        int _cooldown;
+};
+
+#endif // _RESOLUTION_CONTROLLER_H_
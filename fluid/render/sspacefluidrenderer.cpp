@@ -1,35 +1,139 @@
 #include "sspacefluidrenderer.h"
 #include "runtimeexception.h"
+#include "filters/bilateralfilter.h"
+#include "filters/separablebilateralfilter.h"
+#include "filters/computebilateralfilter.h"
+#include "filters/computecurvatureflowfilter.h"
 #include <opencl/clenvironment.h>
+#include <opencl/clallocator.h>
+#include "profiling/frameprofiler.h"
 #include <CL/cl_gl.h>
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
-#define RESOLUTION_FACTOR       (1.00f)
-#define ADJUST_RESOLUTION(X)    (X/RESOLUTION_FACTOR)
+// The smallest fraction of the viewport the first stages may render at
+#define MIN_RESOLUTION_SCALE    (0.25f)
 
 SSpaceFluidRenderer::SSpaceFluidRenderer(int viewport_width,
                                          int viewport_height,
                                          int filter_iterations,
+                                         DepthFilter depth_filter,
+                                         float resolution_scale,
+                                         float target_frame_time,
+                                         bool reduced_precision,
                                          int particle_count,
                                          GLuint vbo_particles) :
 _vbo_particles(vbo_particles),
 _particle_count(particle_count),
-_depth_filter(ADJUST_RESOLUTION(viewport_width), ADJUST_RESOLUTION(viewport_height)),
+_depth_filter_type(depth_filter),
 _filter_iterations(filter_iterations),
 _viewport_w(viewport_width),
-_viewport_h(viewport_height) {
+_viewport_h(viewport_height),
+_resolution_scale(min(max(resolution_scale, MIN_RESOLUTION_SCALE), 1.0f)),
+_depth_format(reduced_precision ? GL_R16F : GL_R32F) {
     // First thing, initialize the viewport quad
     _init_viewport_quad();
 
     // Initialize all the stages of the screen space fluid rendering, including
     // all the fbo's, textures, and shaders
-    int h = ADJUST_RESOLUTION(viewport_height);
-    int w = ADJUST_RESOLUTION(viewport_width);
+    _update_target_size();
+    int w = _target_w;
+    int h = _target_h;
+
+    _depth_images[0] = _depth_images[1] = nullptr;
+    _init_depth_filter(w, h);
     _init_depth_stage(w, h);
     _init_blur_stage(w, h);
-    _init_normals_stage(w, h);
+    _init_shared_images();
     _init_final_stage();
+
+    if (target_frame_time > 0.0f) {
+        _resolution_controller = make_unique<ResolutionController>(target_frame_time,
+                                                                   MIN_RESOLUTION_SCALE,
+                                                                   1.0f,
+                                                                   _resolution_scale);
+    }
+    _last_frame = chrono::steady_clock::now();
+}
+
+float SSpaceFluidRenderer::resolution_scale() const {
+    return _resolution_scale;
+}
+
+void SSpaceFluidRenderer::set_resolution_scale(float scale) {
+    scale = min(max(scale, MIN_RESOLUTION_SCALE), 1.0f);
+    if (scale == _resolution_scale) {
+        return;
+    }
+
+    _resolution_scale = scale;
+    _update_target_size();
+    _resize_targets(_target_w, _target_h);
+}
+
+void SSpaceFluidRenderer::_update_target_size() {
+    _target_w = max(1, (int)(_viewport_w * _resolution_scale));
+    _target_h = max(1, (int)(_viewport_h * _resolution_scale));
+}
+
+void SSpaceFluidRenderer::_init_depth_filter(int width, int height) {
+    _depth_filter.reset();
+    _gl_depth_filter.reset();
+
+    if (_depth_filter_type == COMPUTE_BILATERAL) {
+        _gl_depth_filter = make_unique<ComputeBilateralFilter>(width, height, _depth_format);
+    }
+    else if (_depth_filter_type == COMPUTE_CURVATURE_FLOW) {
+        _gl_depth_filter = make_unique<ComputeCurvatureFlowFilter>(width, height, _depth_format);
+    }
+    else if (_depth_filter_type == SEPARABLE_BILATERAL) {
+        _depth_filter = make_unique<SeparableBilateralFilter>(width, height);
+    }
+    else {
+        _depth_filter = make_unique<BilateralFilter>(width, height);
+    }
+}
+
+void SSpaceFluidRenderer::_init_shared_images() {
+    // Only the OpenCL filters need access to the depth textures
+    if (!_depth_filter) {
+        return;
+    }
+
+    _depth_images[0] = CLAllocator::alloc_gl_texture("renderer/depth", _depth_texture);
+    _depth_images[1] = CLAllocator::alloc_gl_texture("renderer/blurred_depth", _blurred_depth_texture);
+}
+
+void SSpaceFluidRenderer::_release_shared_images() {
+    CLAllocator::release_buffer(_depth_images[0]);
+    CLAllocator::release_buffer(_depth_images[1]);
+    _depth_images[0] = _depth_images[1] = nullptr;
+}
+
+void SSpaceFluidRenderer::_resize_targets(int width, int height) {
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    // The shared images refer to the old storage of the textures
+    _release_shared_images();
+
+    // The textures keep their names, so the fbo attachments are still valid
+    gl.glBindTexture(GL_TEXTURE_2D, _depth_texture);
+    gl.glTexImage2D(GL_TEXTURE_2D, 0, _depth_format, width, height, 0, GL_RED, GL_FLOAT, 0);
+    gl.glBindTexture(GL_TEXTURE_2D, _blurred_depth_texture);
+    gl.glTexImage2D(GL_TEXTURE_2D, 0, _depth_format, width, height, 0, GL_RED, GL_FLOAT, 0);
+    gl.glBindTexture(GL_TEXTURE_2D, 0);
+
+    gl.glBindRenderbuffer(GL_RENDERBUFFER, _depth_fbo_depth_buffer);
+    gl.glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+    gl.glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    _depth_stage_shader->bind();
+    _depth_stage_shader->setUniformValue("viewport_res_factor", 1.0f / _resolution_scale);
+
+    // Filters are sized for the textures
+    _init_depth_filter(width, height);
+    _init_shared_images();
 }
 
 void SSpaceFluidRenderer::render(const Camera& camera,
@@ -41,17 +145,33 @@ void SSpaceFluidRenderer::render(const Camera& camera,
                                  GLuint cube_map_texture) {
     auto& gl = OpenGLFunctions::getFunctions();
 
-    gl.glViewport(0, 0, ADJUST_RESOLUTION(_viewport_w), ADJUST_RESOLUTION(_viewport_h));
+    // The time between two renders is the whole frame time
+    auto now = chrono::steady_clock::now();
+    float frame_time = chrono::duration<float, milli>(now - _last_frame).count();
+    _last_frame = now;
+    if (_resolution_controller && _resolution_controller->update(frame_time)) {
+        set_resolution_scale(_resolution_controller->scale());
+    }
+
+    gl.glViewport(0, 0, _target_w, _target_h);
+    FrameProfiler::begin(FramePhase::RENDER_DEPTH);
     _render_depth_stage(mv_matrix, camera, bkg_depth_texture);
+    FrameProfiler::end(FramePhase::RENDER_DEPTH);
+
+    // The OpenCL filter runs on the queue, where it is timed
+    FrameProfiler::begin(FramePhase::RENDER_BLUR,
+                         _gl_depth_filter ? FrameTimer::GL : FrameTimer::QUEUE);
     _render_blur_stage(mv_matrix, camera);
-    _render_normals_stage(camera);
+    FrameProfiler::end(FramePhase::RENDER_BLUR);
     
     gl.glViewport(0, 0, _viewport_w, _viewport_h);
+    FrameProfiler::begin(FramePhase::RENDER_FINAL);
     _render_final_stage(mv_matrix,
                         camera,
                         dest_fbo,
                         background_texture,
                         cube_map_texture);
+    FrameProfiler::end(FramePhase::RENDER_FINAL);
 }
 
 void SSpaceFluidRenderer::_init_viewport_quad() {
@@ -103,9 +223,10 @@ void SSpaceFluidRenderer::_init_depth_stage(int width, int height) {
     _depth_stage_shader->bind();
 
     // Initialize some uniform values
-    _depth_stage_shader->setUniformValue("viewport_res_factor", RESOLUTION_FACTOR);
-    _depth_stage_shader->setUniformValue("bkg_width", width*RESOLUTION_FACTOR);
-    _depth_stage_shader->setUniformValue("bkg_height", height*RESOLUTION_FACTOR);
+    // The background depth is at the full viewport resolution
+    _depth_stage_shader->setUniformValue("viewport_res_factor", 1.0f / _resolution_scale);
+    _depth_stage_shader->setUniformValue("bkg_width", (float)_viewport_w);
+    _depth_stage_shader->setUniformValue("bkg_height", (float)_viewport_h);
     _depth_stage_shader->setUniformValue("bkg_depth_texture", 0);
 
     // Bind the VBO to the shader
@@ -131,7 +252,7 @@ void SSpaceFluidRenderer::_init_depth_stage(int width, int height) {
 
     gl.glTexImage2D(GL_TEXTURE_2D,
                     0,
-                    GL_R32F,
+                    _depth_format,
                     width,
                     height,
                     0,
@@ -139,16 +260,6 @@ void SSpaceFluidRenderer::_init_depth_stage(int width, int height) {
                     GL_FLOAT,
                     0);
 
-    // Create a opencl 2D image to have shared access to the texture
-    cl_int err;
-    _depth_images[0] = clCreateFromGLTexture2D(CLEnvironment::context(),
-                                           CL_MEM_READ_WRITE,
-                                           GL_TEXTURE_2D,
-                                           0,
-                                           _depth_texture,
-                                           &err);
-    CLError::check(err);
-
     // Create the framebuffer and bind it for configuration
     gl.glGenFramebuffers(1, &_depth_fbo);
     gl.glBindFramebuffer(GL_FRAMEBUFFER, _depth_fbo);
@@ -202,7 +313,7 @@ void SSpaceFluidRenderer::_init_blur_stage(int width, int height) {
 
     gl.glTexImage2D(GL_TEXTURE_2D,
                     0,
-                    GL_R32F,
+                    _depth_format,
                     width,
                     height,
                     0,
@@ -210,103 +321,10 @@ void SSpaceFluidRenderer::_init_blur_stage(int width, int height) {
                     GL_FLOAT,
                     0);
 
-    // Create a opencl 2D image to have shared access to the texture
-    cl_int err;
-    _depth_images[1] = clCreateFromGLTexture2D(CLEnvironment::context(),
-                                           CL_MEM_READ_WRITE,
-                                           GL_TEXTURE_2D,
-                                           0,
-                                           _blurred_depth_texture,
-                                           &err);
-    CLError::check(err);
-
     // Unbind texture for safety return
     gl.glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void SSpaceFluidRenderer::_init_normals_stage(int width, int height) {
-    auto& gl = OpenGLFunctions::getFunctions();
-
-    // Create a VAO for this stage
-    gl.glGenVertexArrays(1, &_normals_stage_vao);
-    gl.glBindVertexArray(_normals_stage_vao);
-
-    // Load and bind the shader program for this stage
-    _normals_stage_shader = create_shader_program("shaders/sspace_fluid_rendering/normals_stage.vert",
-                                                  "shaders/sspace_fluid_rendering/normals_stage.frag");
-
-    _normals_stage_shader->bind();
-
-    // Configure uniform sampler for depth texture
-    gl.glActiveTexture(GL_TEXTURE0);
-    gl.glBindTexture(GL_TEXTURE0, _blurred_depth_texture);
-    _normals_stage_shader->setUniformValue("depth_texture", 0);
-
-    // Configure the inputs of the shader
-    auto v_pos_location = _normals_stage_shader->attributeLocation("quad_vertex_pos");
-    auto t_coord_location = _normals_stage_shader->attributeLocation("quad_text_coord");
-
-    _normals_stage_shader->enableAttributeArray(v_pos_location);
-    _normals_stage_shader->enableAttributeArray(t_coord_location);
-
-    gl.glBindBuffer(GL_ARRAY_BUFFER, _quad_data_vbo);
-    gl.glVertexAttribPointer(v_pos_location,
-                             2,
-                             GL_FLOAT,
-                             GL_FALSE,
-                             4 * sizeof(GLfloat), // 3 for position, 2 for vertex coord
-                             0);
-
-    gl.glVertexAttribPointer(t_coord_location,
-                             2,
-                             GL_FLOAT,
-                             GL_FALSE,
-                             4 * sizeof(GLfloat), // 3 for position, 2 for vertex coord
-                             (GLvoid*)(2 * sizeof(GLfloat)));
-
-    // Create the texture to store the normals values
-    gl.glGenTextures(1, &_normals_texture);
-
-    // Bind it, and initialize it
-    gl.glBindTexture(GL_TEXTURE_2D, _normals_texture);
-
-    gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    gl.glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    gl.glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    gl.glTexImage2D(GL_TEXTURE_2D,
-                    0,
-                    GL_RGB32F,
-                    width,
-                    height,
-                    0,
-                    GL_RGBA,
-                    GL_FLOAT,
-                    0);
-
-    // Create the framebuffer and bind it for configuration
-    gl.glGenFramebuffers(1, &_normals_fbo);
-    gl.glBindFramebuffer(GL_FRAMEBUFFER, _normals_fbo);
-
-    gl.glReadBuffer(GL_NONE);
-    gl.glDrawBuffer(GL_COLOR_ATTACHMENT0);
-    gl.glBindTexture(GL_TEXTURE_2D, _normals_texture);
-    gl.glFramebufferTexture(GL_FRAMEBUFFER,
-                            GL_COLOR_ATTACHMENT0,
-                            _normals_texture,
-                            0);
-
-    // Check FBO status
-    auto status = gl.glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if(status != GL_FRAMEBUFFER_COMPLETE) {
-        throw RunTimeException("Normals stage framebuffer initializaction failed, CANNOT use this FBO");
-    }
-
-    // Unbind texture and fbo for safety return
-    gl.glBindTexture(GL_TEXTURE_2D, 0);
-    gl.glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
 void SSpaceFluidRenderer::_init_final_stage() {
     auto& gl = OpenGLFunctions::getFunctions();
 
@@ -317,9 +335,8 @@ void SSpaceFluidRenderer::_init_final_stage() {
     _final_stage_shader->bind();
 
     _final_stage_shader->setUniformValue("blurred_depth_texture", 0);
-    _final_stage_shader->setUniformValue("normals_texture", 1);
-    _final_stage_shader->setUniformValue("background_texture", 2);
-    _final_stage_shader->setUniformValue("cube_map_texture", 3);
+    _final_stage_shader->setUniformValue("background_texture", 1);
+    _final_stage_shader->setUniformValue("cube_map_texture", 2);
 
     // Allocate vertex array
     gl.glGenVertexArrays(1, &_final_stage_vao);
@@ -363,7 +380,9 @@ void SSpaceFluidRenderer::_render_depth_stage(const QMatrix4x4& mv_matrix,
     // Get perspective info to calculate point sprite size
     auto perspective = camera.perspective();
     _depth_stage_shader->setUniformValue("point_radius", 0.125f * 0.5f);
-    _depth_stage_shader->setUniformValue("point_scale", perspective.width * tanf(perspective.fov * (0.5f * 3.1415926535f/180.0f)));  
+    // Point sprites shrink with the resolution of this stage
+    float point_scale = perspective.width * tanf(perspective.fov * (0.5f * 3.1415926535f/180.0f));
+    _depth_stage_shader->setUniformValue("point_scale", point_scale * _resolution_scale);
 
     gl.glActiveTexture(GL_TEXTURE0);
     gl.glBindTexture(GL_TEXTURE_2D, bkg_depth_texture);
@@ -386,6 +405,16 @@ void SSpaceFluidRenderer::_render_depth_stage(const QMatrix4x4& mv_matrix,
 }
 
 void SSpaceFluidRenderer::_render_blur_stage(const QMatrix4x4& mv_matrix, const Camera& camera) {
+    if (_gl_depth_filter) {
+        // Everything stays in OpenGL, so there is no need to sync with OpenCL
+        _gl_depth_filter->set_projection(camera.projection());
+        for (int i=0; i < _filter_iterations; ++i) {
+            _gl_depth_filter->filter(_depth_texture, _blurred_depth_texture);
+            _gl_depth_filter->filter(_blurred_depth_texture, _depth_texture);
+        }
+        return;
+    }
+
     clEnqueueAcquireGLObjects(CLEnvironment::queue(),
                               2,
                               _depth_images,
@@ -394,8 +423,8 @@ void SSpaceFluidRenderer::_render_blur_stage(const QMatrix4x4& mv_matrix, const
                               NULL);
 
     for (int i=0; i < _filter_iterations; ++i) {
-        _depth_filter.filter(_depth_images[0], _depth_images[1]);
-        _depth_filter.filter(_depth_images[1], _depth_images[0]);
+        _depth_filter->filter(_depth_images[0], _depth_images[1]);
+        _depth_filter->filter(_depth_images[1], _depth_images[0]);
     }
     
     clEnqueueReleaseGLObjects(CLEnvironment::queue(),
@@ -406,35 +435,6 @@ void SSpaceFluidRenderer::_render_blur_stage(const QMatrix4x4& mv_matrix, const
                               NULL);
 }
 
-void SSpaceFluidRenderer::_render_normals_stage(const Camera& camera) {
-    auto& gl = OpenGLFunctions::getFunctions();
-    _normals_stage_shader->bind();
-
-    // Configure shader uniforms
-    auto perspective = camera.perspective();
-    _normals_stage_shader->setUniformValue("inv_projection", camera.projection().inverted());
-
-    // Configure the sampler
-    gl.glActiveTexture(GL_TEXTURE0);
-    gl.glBindTexture(GL_TEXTURE_2D, _depth_texture);
-
-    // Bind depth fbo
-    gl.glBindFramebuffer(GL_FRAMEBUFFER, _normals_fbo);
-    gl.glClear(GL_COLOR_BUFFER_BIT);
-
-    // Bind VAO and render the quad that fills the viewport
-    gl.glBindVertexArray(_normals_stage_vao);
-
-    // Render the quad
-    gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _quad_indices_vbo);
-    gl.glDrawElements(GL_TRIANGLES,
-                      6, // The number of elements of the indices array
-                      GL_UNSIGNED_SHORT,
-                      0);
-
-    gl.glBindFramebuffer(GL_FRAMEBUFFER, 0); // Unbind fbo
-}
-
 void SSpaceFluidRenderer::_render_final_stage(const QMatrix4x4& mv_matrix,
                                               const Camera& camera, 
                                               GLuint dest_fbo, 
@@ -460,21 +460,23 @@ void SSpaceFluidRenderer::_render_final_stage(const QMatrix4x4& mv_matrix,
     gl.glActiveTexture(GL_TEXTURE0);
     gl.glBindTexture(GL_TEXTURE_2D, _depth_texture);
 
+    // The background is sampled in place, and written wherever there is
+    // no fluid, so the destination needs no copy of the scene
     gl.glActiveTexture(GL_TEXTURE1);
-    gl.glBindTexture(GL_TEXTURE_2D, _normals_texture);
-
-    gl.glActiveTexture(GL_TEXTURE2);
     gl.glBindTexture(GL_TEXTURE_2D, bkg_texture);
 
-    gl.glActiveTexture(GL_TEXTURE3);
+    gl.glActiveTexture(GL_TEXTURE2);
     gl.glBindTexture(GL_TEXTURE_CUBE_MAP, cube_map_texture);
-    _final_stage_shader->setUniformValue("cube_map_texture", 3);
+    _final_stage_shader->setUniformValue("cube_map_texture", 2);
 
+    // Every pixel is written, whatever the depth of the destination
+    gl.glDisable(GL_DEPTH_TEST);
     gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _quad_indices_vbo);
     gl.glDrawElements(GL_TRIANGLES,
                       6, // The number of elements of the indices array
                       GL_UNSIGNED_SHORT,
                       0);
+    gl.glEnable(GL_DEPTH_TEST);
 
     gl.glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -483,9 +485,12 @@ void SSpaceFluidRenderer::reset(int particle_count) {
     _particle_count = particle_count;
 }
 
+bool SSpaceFluidRenderer::composites_background() const {
+    return true;
+}
+
 SSpaceFluidRenderer::~SSpaceFluidRenderer() {  
     _release_final_stage();
-    _release_normals_stage();
     _release_blur_stage();
     _release_depth_stage();
     _release_viewport_quad();
@@ -503,15 +508,10 @@ void SSpaceFluidRenderer::_release_depth_stage() {
 void SSpaceFluidRenderer::_release_blur_stage() {
     auto& gl = OpenGLFunctions::getFunctions();
 
-    gl.glDeleteTextures(1, &_blurred_depth_texture);
-}
-
-void SSpaceFluidRenderer::_release_normals_stage() {
-    auto& gl = OpenGLFunctions::getFunctions();
+    // The shared images must go before the textures they refer to
+    _release_shared_images();
 
-    gl.glDeleteFramebuffers(1, &_normals_fbo);
-    gl.glDeleteTextures(1, &_normals_texture);
-    gl.glDeleteVertexArrays(1, &_normals_stage_vao);
+    gl.glDeleteTextures(1, &_blurred_depth_texture);
 }
 
 void SSpaceFluidRenderer::_release_viewport_quad() {
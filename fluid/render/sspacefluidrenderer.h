@@ -2,7 +2,12 @@
 #define _SSPACE_FLUID_RENDERER_H_
 
 #include "fluidrenderer.h"
-#include "filters/bilateralfilter.h"
+#include "filters/texturefilter.h"
+#include "filters/gltexturefilter.h"
+#include "settings/graphicssettings.h"
+#include "resolutioncontroller.h"
+#include <chrono>
+#include <memory>
 
 // Renders the fluid using the screen space fluid rendering technique
 class SSpaceFluidRenderer : public FluidRenderer {
@@ -12,6 +17,10 @@ class SSpaceFluidRenderer : public FluidRenderer {
         SSpaceFluidRenderer(int viewport_width,
                             int viewport_height,
                             int filter_iterations,
+                            DepthFilter depth_filter,
+                            float resolution_scale,
+                            float target_frame_time,
+                            bool reduced_precision,
                             int particle_count,
                             GLuint vbo_particles);
 
@@ -42,6 +51,27 @@ class SSpaceFluidRenderer : public FluidRenderer {
          */
         void reset(int particle_count);
 
+        /**
+         * @brief The final stage writes every pixel, fluid or background
+         */
+        bool composites_background() const;
+
+        /**
+         * @brief Returns the fraction of the viewport the depth and blur
+         *        stages are rendered at
+         */
+        float resolution_scale() const;
+
+        /**
+         * @brief Sets the fraction of the viewport the depth and blur 
+         *        stages are rendered at
+         * @details The intermediate textures are reallocated, and the final
+         *          stage upsamples them to the viewport.
+         * 
+         * @param scale The new scale, clamped to [0.25, 1]
+         */
+        void set_resolution_scale(float scale);
+
     private:
         // The vbo that holds the particles positions
         GLuint _vbo_particles;
@@ -49,11 +79,18 @@ class SSpaceFluidRenderer : public FluidRenderer {
         // The number of particles being rendered
         int _particle_count;
 
+        // The filter to apply, the filters are rebuilt when resized
+        DepthFilter _depth_filter_type;
+
         // The filter function to apply to the depth buffer
-        BilateralFilter _depth_filter;
+        std::unique_ptr<TextureFilter> _depth_filter;
+
+        // Alternatively, a filter that runs on OpenGL. When set, the depth
+        // buffer is never shared with OpenCL
+        std::unique_ptr<GLTextureFilter> _gl_depth_filter;
         
         // This two cl_mem buffers are used for the opengl-opencl interop
-        // when filtering the depth buffer
+        // when filtering the depth buffer with an OpenCL filter
         cl_mem _depth_images[2];
         
         // The number of iterations the filter will be applied. Consider that
@@ -64,10 +101,21 @@ class SSpaceFluidRenderer : public FluidRenderer {
         // be reduced during the filtering stage.
         int _viewport_w, _viewport_h;
 
+        // The size of the viewport during the depth and blur stages
+        float _resolution_scale;
+        int _target_w, _target_h;
+
+        // Internal format of the depth textures, GL_R32F or GL_R16F
+        GLenum _depth_format;
+
+        // Adjusts the resolution scale to hold a frame time, null if the
+        // scale is fixed
+        std::unique_ptr<ResolutionController> _resolution_controller;
+        std::chrono::steady_clock::time_point _last_frame;
+
         // Shader programs
         std::unique_ptr<QOpenGLShaderProgram> _depth_stage_shader;
         std::unique_ptr<QOpenGLShaderProgram> _blur_stage_shader;
-        std::unique_ptr<QOpenGLShaderProgram> _normals_stage_shader;
         std::unique_ptr<QOpenGLShaderProgram> _final_stage_shader;
 
         // This VBO holds the quad data (vertices + texture coordinates)
@@ -79,37 +127,36 @@ class SSpaceFluidRenderer : public FluidRenderer {
         // VAO's for the different stages
         GLuint _depth_stage_vao;
         GLuint _blur_stage_vao;
-        GLuint _normals_stage_vao;
         GLuint _final_stage_vao;
 
         // Framebuffers
         GLuint _depth_fbo, _depth_fbo_depth_buffer;
         GLuint _blur_fbo;
-        GLuint _normals_fbo;
 
         // Textures for the fbo's
         GLuint _depth_texture;
         GLuint _blurred_depth_texture;
-        GLuint _normals_texture;
 
         // Initialization functions
+        void _update_target_size();
+        void _init_depth_filter(int width, int height);
+        void _init_shared_images();
+        void _release_shared_images();
+        void _resize_targets(int width, int height);
         void _init_viewport_quad();
         void _init_depth_stage(int width, int height);
         void _init_blur_stage(int width, int height);
-        void _init_normals_stage(int width, int height);
         void _init_final_stage();
 
         // Release functions
         void _release_viewport_quad();
         void _release_depth_stage();
         void _release_blur_stage();
-        void _release_normals_stage();
         void _release_final_stage();
 
         // Rendering stages
         void _render_depth_stage(const QMatrix4x4& mv_matrix, const Camera& camera, GLuint bkg_depth_texture);
         void _render_blur_stage(const QMatrix4x4& mv_matrix, const Camera& camera);
-        void _render_normals_stage(const Camera& camera);
         void _render_final_stage(const QMatrix4x4& mv_matrix, const Camera& camera, GLuint bkg_fbo, GLuint bkg_texture, GLuint cube_map_texture);
 
 };
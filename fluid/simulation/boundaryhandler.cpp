@@ -8,6 +8,12 @@
 #include "opencl/algorithms/clreduce.h"
 #include "mullerconstants.h"
 
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+
 using namespace std;
 
 BoundaryHandler::BoundaryHandler(const Grid& grid,
@@ -16,6 +22,7 @@ BoundaryHandler::BoundaryHandler(const Grid& grid,
                                  float rest_density,
                                  float phi_coefficient) :
 _count(0),
+_batching(false),
 _particle_spacing(2 * particle_radius),
 _support_radius(support_radius),
 _rest_density(rest_density),
@@ -33,7 +40,8 @@ _fluid_force(nullptr),
 _hashes(nullptr),
 _mask(nullptr),
 _image_positions(nullptr),
-_image_phi(nullptr) {
+_image_phi(nullptr),
+_program_support_radius(0.0f) {
 
 }
 
@@ -42,6 +50,16 @@ BoundaryHandler::~BoundaryHandler() {
 }
 
 void BoundaryHandler::_release() {
+    // Sub-buffers first, so their parents can be reused right away
+    for (auto& rb_info : _bodies) {
+        CLAllocator::release_buffer(rb_info.raw_sub_buffer);
+        CLAllocator::release_buffer(rb_info.transformed_sub_buffer);
+        CLAllocator::release_buffer(rb_info.phi_sub_buffer);
+        CLAllocator::release_buffer(rb_info.vel_sub_buffer);
+        CLAllocator::release_buffer(rb_info.torque);
+        CLAllocator::release_buffer(rb_info.forces);
+    }
+
     CLAllocator::release_buffer(_image_phi);
     CLAllocator::release_buffer(_image_positions);
     
@@ -56,19 +74,14 @@ void BoundaryHandler::_release() {
     CLAllocator::release_buffer(_fluid_force);
     CLAllocator::release_buffer(_hashes);
     CLAllocator::release_buffer(_mask);
-
-    for (auto& rb_info : _bodies) {
-        CLAllocator::release_buffer(rb_info.torque);
-        CLAllocator::release_buffer(rb_info.forces);
-    }
 }
 
 void BoundaryHandler::set_particle_radius(float particle_radius) {
-    if (_count > 0) {
-        float new_particle_spacing = 2 * particle_radius;
-        if (_particle_spacing != new_particle_spacing) {
-            _particle_spacing = new_particle_spacing;
-            // Must rebuild all surfaces
+    float new_particle_spacing = 2 * particle_radius;
+    if (_particle_spacing != new_particle_spacing) {
+        _particle_spacing = new_particle_spacing;
+        if (!_bodies.empty() && !_batching) {
+            // Must resample all surfaces
             _sample_surfaces();
         }
     }
@@ -79,11 +92,14 @@ float BoundaryHandler::particle_radius() const {
 }
 
 void BoundaryHandler::set_support_radius(float support_radius) {
-    if (_count > 0) {
-        if (_support_radius != support_radius) {
-            _support_radius = support_radius;
-            // Must rebuild all surfaces
-            _sample_surfaces();
+    if (_support_radius != support_radius) {
+        _support_radius = support_radius;
+        if (_count > 0) {
+            // The samplings do not depend on the support radius, only phi
+            // does, and the kernels
+            _poly6_eval = MullerConstants::default_eval(_support_radius);
+            _build_kernels();
+            _update_phi();
         }
     }
 }
@@ -99,72 +115,181 @@ void BoundaryHandler::add_boundary(shared_ptr<RigidBody> boundary,
     _SurfaceInfo info;
     info.raw_sub_buffer = nullptr;
     info.transformed_sub_buffer = nullptr;
+    info.phi_sub_buffer = nullptr;
     info.vel_sub_buffer = nullptr;
     info.forces = nullptr;
     info.torque = nullptr;
     info.body = boundary;
+    info.id = boundary_id;
     info.can_move = can_move;
+    info.sampling = nullptr;
+    info.sampling_key = 0;
+    info.particle_count = 0;
+    info.buff_origin = 0;
+    info.buff_size = 0;
     _bodies.push_back(info);
 
-    // Now rebuild all internal buffers
-    _sample_surfaces();
+    // Only the new body is sampled, but all buffers grow
+    if (!_batching) {
+        _sample_surfaces();
+    }
 }
 
-void BoundaryHandler::_clear() {
-    _release();
-    _particles.clear();
-    _count = 0;
+void BoundaryHandler::begin_batch() {
+    _batching = true;
+}
+
+void BoundaryHandler::commit() {
+    if (_batching) {
+        _batching = false;
+        _sample_surfaces();
+    }
 }
 
 void BoundaryHandler::_sample_surfaces() {
-    _clear();
+    // Bodies without a sampling for the current spacing
+    vector<size_t> pending;
+    for (size_t i = 0; i < _bodies.size(); ++i) {
+        auto key = SamplingCache::key(*_bodies[i].body, _particle_spacing);
+        if (!_bodies[i].sampling || _bodies[i].sampling_key != key) {
+            _bodies[i].sampling_key = key;
+            pending.push_back(i);
+        }
+    }
 
-    // Now resample all bodies
-    for (auto& s_info : _bodies) {
-        auto sampling = s_info.body->surface_sampling(_particle_spacing);
-        
-        // Copy the new particles
-        for (auto& pos : sampling) {
-            cl_float4 cl_pos;
-            cl_pos.s[0] = pos.x();
-            cl_pos.s[1] = pos.y();
-            cl_pos.s[2] = pos.z();
-            cl_pos.s[3] = 1;
-            _particles.push_back(cl_pos);
+    if (pending.empty()) {
+        return;
+    }
+
+    _sample_bodies(pending);
+
+    // The previous positions and phi are kept, to copy the particles of the
+    // bodies that were not sampled again
+    cl_mem old_raw_positions = _raw_positions;
+    cl_mem old_phi = _phi;
+    vector<int> old_origins(_bodies.size(), -1);
+    if (old_raw_positions != nullptr) {
+        for (size_t i = 0; i < _bodies.size(); ++i) {
+            old_origins[i] = _bodies[i].buff_origin;
         }
-        
-        s_info.particle_count = sampling.size();
-        s_info.buff_origin = _count;
-        s_info.buff_size = sampling.size();
+        for (auto i : pending) {
+            old_origins[i] = -1;
+        }
+    }
+
+    _raw_positions = nullptr;
+    _phi = nullptr;
+    _release();
+
+    // All bodies are laid out again, one after the other
+    _count = 0;
+    for (auto& rb_info : _bodies) {
+        rb_info.particle_count = rb_info.sampling->size();
+        rb_info.buff_origin = _count;
+        rb_info.buff_size = rb_info.particle_count;
+        _count += rb_info.particle_count;
+    }
 
-        // We update the total number of particles of this boundary handler
-        _count = _particles.size();
-    }  
-    
     _poly6_eval = MullerConstants::default_eval(_support_radius);
 
     _alloc_buffers();
 
     _build_kernels();
 
-    _compute_boundary_phi();
+    for (size_t i = 0; i < _bodies.size(); ++i) {
+        auto& rb_info = _bodies[i];
+        if (old_origins[i] >= 0) {
+            CLAllocator::copy_buffer_range<cl_float4>(old_raw_positions,
+                                                      _raw_positions,
+                                                      old_origins[i],
+                                                      rb_info.buff_origin,
+                                                      rb_info.buff_size);
+            CLAllocator::copy_buffer_range<cl_float>(old_phi,
+                                                     _phi,
+                                                     old_origins[i],
+                                                     rb_info.buff_origin,
+                                                     rb_info.buff_size);
+        }
+        else {
+            CLAllocator::upload_to_buffer_range(rb_info.sampling->data(),
+                                                rb_info.buff_size,
+                                                _raw_positions,
+                                                rb_info.buff_origin);
+            _compute_boundary_phi(rb_info);
+        }
+    }
+
+    CLAllocator::release_buffer(old_raw_positions);
+    CLAllocator::release_buffer(old_phi);
 
     sync(true);
 }
 
+void BoundaryHandler::_sample_bodies(const vector<size_t>& bodies) {
+    // One job for every distinct surface, bodies that share it share the
+    // sampling
+    vector<pair<uint64_t, vector<size_t> > > jobs;
+    for (auto i : bodies) {
+        auto key = _bodies[i].sampling_key;
+        auto job = find_if(jobs.begin(), jobs.end(), [key](const pair<uint64_t, vector<size_t> >& j) {
+            return j.first == key;
+        });
+        if (job == jobs.end()) {
+            jobs.push_back(make_pair(key, vector<size_t>()));
+            job = jobs.end() - 1;
+        }
+        job->second.push_back(i);
+    }
+
+    vector<Sampling> samplings(jobs.size());
+    atomic<size_t> next_job(0);
+    auto worker = [&]() {
+        for (size_t j = next_job++; j < jobs.size(); j = next_job++) {
+            auto& body = *_bodies[jobs[j].second.front()].body;
+            samplings[j] = _sampling_cache.get(body, jobs[j].first, _particle_spacing);
+        }
+    };
+
+    // The calling thread is one of the workers
+    size_t thread_count = min<size_t>(max(1u, thread::hardware_concurrency()), jobs.size());
+    vector<future<void> > workers;
+    for (size_t t = 1; t < thread_count; ++t) {
+        workers.push_back(async(launch::async, worker));
+    }
+    worker();
+    for (auto& w : workers) {
+        w.get();
+    }
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        for (auto i : jobs[j].second) {
+            _bodies[i].sampling = samplings[j];
+        }
+    }
+}
+
+void BoundaryHandler::_update_phi() {
+    for (auto& rb_info : _bodies) {
+        _compute_boundary_phi(rb_info);
+    }
+
+    // Sorts the new phi values
+    sync(true);
+}
+
 void BoundaryHandler::_alloc_buffers() {
     cl_int err;
-    _raw_positions = CLAllocator::alloc_buffer<cl_float4>(_count, _particles);
-    _unsorted_positions = CLAllocator::alloc_buffer<cl_float4>(_count, _particles);
-    _sorted_positions = CLAllocator::alloc_buffer<cl_float4>(_count);
-    _velocities = CLAllocator::alloc_buffer<cl_float4>(_count);
-    _sorted_velocities = CLAllocator::alloc_buffer<cl_float4>(_count);
-    _cell_intervals = CLAllocator::alloc_buffer<cl_int2>(_grid.cell_count());
-    _phi = CLAllocator::alloc_buffer<cl_float>(_count);
-    _sorted_phi = CLAllocator::alloc_buffer<cl_float>(_count);
-    _fluid_force = CLAllocator::alloc_buffer<cl_float4>(_count);
-    _hashes = CLAllocator::alloc_buffer<cl_uint>(_count);
-    _mask = CLAllocator::alloc_buffer<cl_int>(_count);
+    _raw_positions = CLAllocator::alloc_buffer<cl_float4>("boundary/raw_positions", _count);
+    _unsorted_positions = CLAllocator::alloc_buffer<cl_float4>("boundary/unsorted_positions", _count);
+    _sorted_positions = CLAllocator::alloc_buffer<cl_float4>("boundary/sorted_positions", _count);
+    _velocities = CLAllocator::alloc_buffer<cl_float4>("boundary/velocities", _count);
+    _sorted_velocities = CLAllocator::alloc_buffer<cl_float4>("boundary/sorted_velocities", _count);
+    _cell_intervals = CLAllocator::alloc_buffer<cl_int2>("boundary/cell_intervals", _grid.cell_count());
+    _phi = CLAllocator::alloc_buffer<cl_float>("boundary/phi", _count);
+    _sorted_phi = CLAllocator::alloc_buffer<cl_float>("boundary/sorted_phi", _count);
+    _fluid_force = CLAllocator::alloc_buffer<cl_float4>("boundary/fluid_force", _count);
+    _hashes = CLAllocator::alloc_buffer<cl_uint>("boundary/hashes", _count);
+    _mask = CLAllocator::alloc_buffer<cl_int>("boundary/mask", _count);
 
     
     //_image_velocities = CLAllocator::alloc_1d_image_from_buff(_count, CL_RGBA, _sorted_velocities);
@@ -208,8 +333,8 @@ void BoundaryHandler::_alloc_buffers() {
                                                    &r,
                                                    NULL);
 
-        rb_info.forces = CLAllocator::alloc_buffer<cl_float4>(rb_info.particle_count);
-        rb_info.torque = CLAllocator::alloc_buffer<cl_float4>(rb_info.particle_count);
+        rb_info.forces = CLAllocator::alloc_buffer<cl_float4>("boundary/rigid_body_forces", rb_info.particle_count);
+        rb_info.torque = CLAllocator::alloc_buffer<cl_float4>("boundary/rigid_body_torque", rb_info.particle_count);
     }
 }
 
@@ -235,17 +360,21 @@ void BoundaryHandler::_sort_positions() {
                                  _count);
 }
 
-void BoundaryHandler::_compute_boundary_phi() {
-    for (auto& rb_info : _bodies) {
-        _kernel_boundary_phi->set_arg(0, &rb_info.transformed_sub_buffer);
-        _kernel_boundary_phi->set_arg(1, &rb_info.phi_sub_buffer);
-        _kernel_boundary_phi->set_arg(2, &_rest_density);
-        _kernel_boundary_phi->set_arg(3, &_poly6_eval);
-        _kernel_boundary_phi->set_arg(4, &_phi_coefficient);
-        _kernel_boundary_phi->set_arg(5, &rb_info.particle_count);
-
-        CLError::check(_kernel_boundary_phi->run(rb_info.particle_count));
+void BoundaryHandler::_compute_boundary_phi(const _SurfaceInfo& rb_info) {
+    if (rb_info.particle_count == 0) {
+        return;
     }
+
+    // Phi only depends on the distances between the particles of the body,
+    // so the untransformed positions are used
+    _kernel_boundary_phi->set_arg(0, &rb_info.raw_sub_buffer);
+    _kernel_boundary_phi->set_arg(1, &rb_info.phi_sub_buffer);
+    _kernel_boundary_phi->set_arg(2, &_rest_density);
+    _kernel_boundary_phi->set_arg(3, &_poly6_eval);
+    _kernel_boundary_phi->set_arg(4, &_phi_coefficient);
+    _kernel_boundary_phi->set_arg(5, &rb_info.particle_count);
+
+    CLError::check(_kernel_boundary_phi->run(rb_info.particle_count));
 }
 
 void BoundaryHandler::sync(bool sync_all) {
@@ -363,13 +492,67 @@ void BoundaryHandler::build_neighbourhood(cl_mem ref_positions,
                                  neigh_list,
                                  neigh_list_length,
                                  max_list_length,
-                                 particle_count);
+                                 particle_count,
+                                 NeighbourList::BOUNDARY);
     }
     else {
         CLAllocator::fill_buffer(neigh_list_length, 0, particle_count);
     }
 }
 
+vector<CheckpointBody> BoundaryHandler::bodies_state() const {
+    vector<CheckpointBody> state;
+    for (auto& rb_info : _bodies) {
+        CheckpointBody b;
+        memset(&b, 0, sizeof(b));
+        strncpy(b.id, rb_info.id.c_str(), CHECKPOINT_ID_LENGTH - 1);
+
+        auto p = rb_info.body->position();
+        auto q = rb_info.body->rotation();
+        auto v = rb_info.body->linear_vel();
+        auto w = rb_info.body->angular_vel();
+        for (int i = 0; i < 3; ++i) {
+            b.position[i] = p[i];
+            b.linear_vel[i] = v[i];
+            b.angular_vel[i] = w[i];
+        }
+        b.rotation[0] = q.x();
+        b.rotation[1] = q.y();
+        b.rotation[2] = q.z();
+        b.rotation[3] = q.w();
+
+        state.push_back(b);
+    }
+
+    return state;
+}
+
+void BoundaryHandler::restore_bodies_state(const vector<CheckpointBody>& bodies) {
+    for (auto& b : bodies) {
+        for (auto& rb_info : _bodies) {
+            if (rb_info.id == b.id) {
+                // Rotation must be set first, as it resets the motion state
+                rb_info.body->set_rotation(btQuaternion(b.rotation[0],
+                                                        b.rotation[1],
+                                                        b.rotation[2],
+                                                        b.rotation[3]));
+                rb_info.body->set_position(btVector3(b.position[0],
+                                                     b.position[1],
+                                                     b.position[2]));
+                rb_info.body->set_linear_vel(btVector3(b.linear_vel[0],
+                                                       b.linear_vel[1],
+                                                       b.linear_vel[2]));
+                rb_info.body->set_angular_vel(btVector3(b.angular_vel[0],
+                                                        b.angular_vel[1],
+                                                        b.angular_vel[2]));
+                break;
+            }
+        }
+    }
+
+    sync(true);
+}
+
 cl_mem* BoundaryHandler::positions_buffer() {
     return &_sorted_positions;
 }
@@ -397,11 +580,30 @@ int BoundaryHandler::particle_count() const {
 void BoundaryHandler::set_phi_coefficient(float phi_coeff) {
     _phi_coefficient = phi_coeff;
 
-    // Now rebuild all internal buffers
-    _sample_surfaces();
+    if (_count > 0) {
+        _update_phi();
+    }
+}
+
+void BoundaryHandler::set_rest_density(float rest_density) {
+    if (rest_density == _rest_density) {
+        return;
+    }
+
+    _rest_density = rest_density;
+
+    if (_count > 0) {
+        _update_phi();
+    }
 }
 
 void BoundaryHandler::_build_kernels() {
+    // Counts are kernel arguments, the program only changes with the
+    // support radius
+    if (_program && _program_support_radius == _support_radius) {
+        return;
+    }
+
     CLCompiler compiler;
     compiler.add_file_source("kernels/boundary.cl");
     compiler.add_build_option("-cl-std=CL1.2");
@@ -409,9 +611,9 @@ void BoundaryHandler::_build_kernels() {
     compiler.add_build_option("-cl-mad-enable");
     compiler.add_include_path("kernels");
     compiler.define_constant("SUPPORT_RADIUS", _support_radius);
-    compiler.define_constant("BOUNDARY_PARTICLE_COUNT", _count);
     compiler.define_constant("USE_MULLER_KERNELS");
     _program = compiler.build();
+    _program_support_radius = _support_radius;
 
     _kernel_boundary_phi = _program->get_kernel("compute_boundary_phi");
     _kernel_fluid_force = _program->get_kernel("compute_fluid_force");
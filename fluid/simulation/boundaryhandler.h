@@ -2,6 +2,8 @@
 #define _BOUNDARY_HANDLER_H_ 
 
 #include "grid.h"
+#include "checkpoint.h"
+#include "samplingcache.h"
 #include "scene/rigidbody.h"
 #include "opencl/clcompiler.h"
 #include <LinearMath/btVector3.h>
@@ -49,6 +51,20 @@ class BoundaryHandler {
                           const std::string& boundary_id,
                           bool can_move=false);
 
+        /**
+         * @brief Starts a batch of boundaries
+         * @details Until commit is called, add_boundary only records the 
+         *          bodies, and they are all sampled, concurrently, on 
+         *          commit.
+         */
+        void begin_batch();
+
+        /**
+         * @brief Samples the boundaries added since begin_batch, and 
+         *        rebuilds the internal buffers once
+         */
+        void commit();
+
         /**
          * @brief Returns the total number of particles that belong to the 
          *        boundary
@@ -70,6 +86,7 @@ class BoundaryHandler {
         /**
          * @brief Updates the particle radius of the boundaries. This will 
          *        trigger a resampling of all surfaces and internal buffers.
+         *        Samplings for a radius used before are taken from the cache.
          * 
          * @param particle_radius The particle radius of the boundaries 
          *                        sampling.
@@ -86,8 +103,8 @@ class BoundaryHandler {
          * @brief Updates the support radius of the boundary handler.
          * 
          * @details Updates the support radius of the boundary handler. This
-         *          will trigger a resampling of all surfaces and internal 
-         *          buffers. This is the internal support radius, used to 
+         *          will trigger a recomputation of the phi of every boundary
+         *          particle. This is the internal support radius, used to 
          *          compute boundary phi values, and neigh lists of 
          *          boundary particles. This can be different to the fluid 
          *          solver support radius.
@@ -110,6 +127,14 @@ class BoundaryHandler {
          */
         void set_phi_coefficient(float phi_coeff);
 
+        /**
+         * @brief Updates the rest density of the fluid
+         *
+         * @param rest_density The rest density, the boundary phi is
+         *        proportional to it.
+         */
+        void set_rest_density(float rest_density);
+
         /**
          * @brief Builds the neigh list for each reference particle.
          * @details Given a buffer of particles (the reference particles, 
@@ -137,6 +162,26 @@ class BoundaryHandler {
                                 cl_mem fluid_cell_intervals,
                                 float particle_mass);
 
+        /**
+         * @brief Returns the state of every rigid body of the boundary
+         * @details The state is the transform and velocities of each body, 
+         *          as Bullet currently holds them.
+         * 
+         * @return A vector with the state of every body, in the same order
+         *         the bodies were added.
+         */
+        std::vector<CheckpointBody> bodies_state() const;
+
+        /**
+         * @brief Restores the state of the rigid bodies of the boundary
+         * @details Every body is matched by its id. Bodies that are not 
+         *          found in the given state are left untouched. After the 
+         *          restore, all boundary particles are synchronized.
+         * 
+         * @param bodies The state of the bodies to restore.
+         */
+        void restore_bodies_state(const std::vector<CheckpointBody>& bodies);
+
         /**
          * @brief A pointer to the positions of boundary particles
          */
@@ -159,6 +204,9 @@ class BoundaryHandler {
         // The total count of particles that belong to the boundary surface
         int _count;
 
+        // Set while a batch of boundaries is being added
+        bool _batching;
+
         float _particle_spacing;
         float _support_radius;
         float _poly6_eval;
@@ -176,6 +224,11 @@ class BoundaryHandler {
             cl_mem forces;
             cl_mem torque;
             std::shared_ptr<RigidBody> body;
+            std::string id;
+            // The sampling of the surface, and the key it was looked up
+            // with. Null until the body is sampled
+            Sampling sampling;
+            uint64_t sampling_key;
             int particle_count;
             // Not in bytes, but in number of elements
             int buff_origin;
@@ -216,19 +269,40 @@ class BoundaryHandler {
         //cl_mem _image_velocities;
 
         std::unique_ptr<CLProgram> _program;
+        // The support radius compiled into the program
+        float _program_support_radius;
+
         std::shared_ptr<CLKernel> _kernel_boundary_phi;
         std::shared_ptr<CLKernel> _kernel_fluid_force;
         std::shared_ptr<CLKernel> _kernel_transform_particles;
 
-        // This buffer holds all particles of boundaries together
-        std::vector<cl_float4> _particles;
+        // Samplings of the surfaces of the bodies, for every spacing used
+        SamplingCache _sampling_cache;
 
         /**
-         * @brief [brief description]
-         * @details [long description]
+         * @brief Samples the bodies that have no sampling for the current 
+         *        spacing, and rebuilds the internal buffers
+         * @details Distinct surfaces are sampled concurrently, and bodies 
+         *          that share a surface share its sampling. Only the 
+         *          particles of the bodies that were sampled are uploaded, 
+         *          and only their phi is computed, the rest is copied on 
+         *          the device from the previous buffers.
          */
         void _sample_surfaces();
 
+        /**
+         * @brief Looks up or samples the given bodies, concurrently
+         * 
+         * @param bodies Indices of the bodies within _bodies.
+         */
+        void _sample_bodies(const std::vector<std::size_t>& bodies);
+
+        /**
+         * @brief Recomputes the phi of every boundary particle, after a 
+         *        change of the support radius, or the phi coefficient
+         */
+        void _update_phi();
+
         /**
          * @brief Releases all internal buffers
          */
@@ -245,11 +319,11 @@ class BoundaryHandler {
         void _sort_positions();
 
         /**
-         * @brief Computes the phi factor for each boudnary particle. This 
-         * value is used in density estimation for particles close to the 
-         * boundary.
+         * @brief Computes the phi factor for each boudnary particle of a 
+         * body. This value is used in density estimation for particles close
+         * to the boundary.
          */
-        void _compute_boundary_phi();
+        void _compute_boundary_phi(const _SurfaceInfo& rb_info);
 
         /**
          * @brief Builds (compiles and link) the OpenCL program, reinitializes
@@ -257,10 +331,6 @@ class BoundaryHandler {
          */
         void _build_kernels();
 
-        /**
-         * @brief Clears the internal state
-         */
-        void _clear();
 };
 
 #endif // _STATIC_BOUNDARY_H_ 
\ No newline at end of file
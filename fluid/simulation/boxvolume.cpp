@@ -9,27 +9,20 @@ _center(center) {
 }
 
 vector<cl_float4> BoxVolume::particles(float particle_radius) {
+    VolumeLattice l;
+    lattice(particle_radius, l);
+
     vector<cl_float4> particles;
+    particles.reserve(l.size[0] * l.size[1] * l.size[2]);
 
-    float particle_spacing = 2 * particle_radius; 
-    float extent_x = _size.getX();
-    float extent_y = _size.getY();
-    float extent_z = _size.getZ();
-    int ppside_x = ceil(extent_x / particle_spacing); //nx
-    int ppside_y = ceil(extent_y / particle_spacing);
-    int ppside_z = ceil(extent_z / particle_spacing);
-    float delta_x = extent_x / ppside_x; //d
-    float delta_y = extent_y / ppside_y;
-    float delta_z = extent_z / ppside_z;
-
-    for (int j=0; j<ppside_y; ++j) {
-        for (int i=0; i<ppside_x; ++i) {
-            for (int k=0; k<ppside_z; ++k) {
+    for (int j=0; j<l.size[1]; ++j) {
+        for (int i=0; i<l.size[0]; ++i) {
+            for (int k=0; k<l.size[2]; ++k) {
                 // Initialize positions
                 cl_float4 p;
-                p.s[0] = i * delta_x + _center.getX() - _size.getX() / 2.0;
-                p.s[1] = j * delta_y + _center.getY() - _size.getY() / 2.0;
-                p.s[2] = k * delta_z + _center.getZ() - _size.getZ() / 2.0;
+                p.s[0] = l.origin[0] + i * l.delta[0];
+                p.s[1] = l.origin[1] + j * l.delta[1];
+                p.s[2] = l.origin[2] + k * l.delta[2];
                 p.s[3] = 1; // Homogeneous system
                 particles.push_back(p);
             }
@@ -38,3 +31,17 @@ vector<cl_float4> BoxVolume::particles(float particle_radius) {
 
     return particles;
 }
+
+bool BoxVolume::lattice(float particle_radius, VolumeLattice& lattice) {
+    float particle_spacing = 2 * particle_radius; 
+    for (int axis=0; axis<3; ++axis) {
+        float extent = _size[axis];
+        int ppside = ceil(extent / particle_spacing); //nx
+        lattice.size[axis] = ppside;
+        lattice.delta[axis] = extent / ppside; //d
+        lattice.origin[axis] = _center[axis] - extent / 2.0;
+    }
+    lattice.offset = 0;
+
+    return true;
+}
@@ -11,6 +11,8 @@ class BoxVolume : public FluidVolume {
 
         std::vector<cl_float4> particles(float particle_radius);
 
+        bool lattice(float particle_radius, VolumeLattice& lattice);
+
     private:
         btVector3 _size, _center;
 
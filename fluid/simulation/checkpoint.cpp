@@ -0,0 +1,356 @@
+#include "checkpoint.h"
+#include "opencl/clenvironment.h"
+#include "runtimeexception.h"
+
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char CHECKPOINT_MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P'};
+
+/**
+ * @brief Rounds up an offset to the checkpoint alignment
+ */
+static uint64_t align_offset(uint64_t offset) {
+    return (offset + CHECKPOINT_ALIGNMENT - 1) & ~((uint64_t)CHECKPOINT_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Writes the whole data at the given offset, retrying partial writes
+ */
+static void write_all(int fd, const void* data, size_t size, uint64_t offset, const string& path) {
+    auto ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, ptr, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw RunTimeException("Could not write checkpoint file " + path + ": " + strerror(errno));
+        }
+        ptr += written;
+        offset += written;
+        size -= written;
+    }
+}
+
+CheckpointWriter::CheckpointWriter(const PhysicsSettings& fluid_settings,
+                                   const SimulationSettings& sim_settings,
+                                   uint64_t step) {
+    memset(&_header, 0, sizeof(_header));
+    memcpy(_header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    _header.version = CHECKPOINT_VERSION;
+    _header.step = step;
+    _header.sim_method = sim_settings.sim_method;
+
+    _header.time_step = sim_settings.time_step;
+    _header.max_vel = sim_settings.max_vel;
+    _header.fluid_particle_radius = sim_settings.fluid_particle_radius;
+    _header.fluid_support_radius = sim_settings.fluid_support_radius;
+    _header.pcisph_max_iterations = sim_settings.pcisph_max_iterations;
+    _header.pcisph_error_ratio = sim_settings.pcisph_error_ratio;
+
+    _header.rest_density = fluid_settings.rest_density;
+    _header.k_viscosity = fluid_settings.k_viscosity;
+    _header.gravity = fluid_settings.gravity;
+    _header.gas_stiffness = fluid_settings.gas_stiffness;
+    _header.surface_tension = fluid_settings.surface_tension;
+}
+
+void CheckpointWriter::set_container_size(const cl_float4& container_size) {
+    for (int i = 0; i < 4; ++i) {
+        _header.container_size[i] = container_size.s[i];
+    }
+}
+
+void CheckpointWriter::_add_buffer(CheckpointTag tag,
+                                   cl_mem buffer,
+                                   size_t element_size,
+                                   size_t count) {
+    // The particle count of the checkpoint is the size of the positions
+    if (tag == CHECKPOINT_POSITIONS) {
+        _header.particle_count = count;
+    }
+
+    _PendingSection p;
+    p.section.tag = tag;
+    p.section.element_size = element_size;
+    p.section.count = count;
+    p.section.offset = 0;
+    p.buffer = buffer;
+    _sections.push_back(p);
+}
+
+void CheckpointWriter::add_bodies(const vector<CheckpointBody>& bodies) {
+    _bodies = bodies;
+
+    _PendingSection p;
+    p.section.tag = CHECKPOINT_BODIES;
+    p.section.element_size = sizeof(CheckpointBody);
+    p.section.count = bodies.size();
+    p.section.offset = 0;
+    p.buffer = nullptr;
+    _sections.push_back(p);
+}
+
+void CheckpointWriter::write(const string& path) const {
+    // Compute the layout of the file: header, section table, and then every
+    // payload at an aligned offset
+    auto header = _header;
+    header.section_count = _sections.size();
+
+    vector<CheckpointSection> table;
+    uint64_t offset = sizeof(CheckpointHeader) + _sections.size() * sizeof(CheckpointSection);
+    for (auto& p : _sections) {
+        auto s = p.section;
+        s.offset = align_offset(offset);
+        offset = s.offset + s.element_size * s.count;
+        table.push_back(s);
+    }
+    uint64_t file_size = align_offset(offset);
+
+    // Write everything to a temporary file first
+    string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw RunTimeException("Could not create checkpoint file " + tmp_path + ": " + strerror(errno));
+    }
+
+    try {
+        if (ftruncate(fd, file_size) != 0) {
+            throw RunTimeException("Could not resize checkpoint file " + tmp_path + ": " + strerror(errno));
+        }
+
+        write_all(fd, &header, sizeof(header), 0, tmp_path);
+        if (!table.empty()) {
+            write_all(fd, table.data(), table.size() * sizeof(CheckpointSection), sizeof(header), tmp_path);
+        }
+
+        for (size_t i = 0; i < _sections.size(); ++i) {
+            auto& s = table[i];
+            size_t bytes = s.element_size * s.count;
+            if (bytes == 0) {
+                continue;
+            }
+
+            if (s.tag == CHECKPOINT_BODIES) {
+                write_all(fd, _bodies.data(), bytes, s.offset, tmp_path);
+            }
+            else {
+                // Map the device buffer, and write it straight from the
+                // mapped region
+                cl_int err;
+                void* mapped = clEnqueueMapBuffer(CLEnvironment::queue(),
+                                                  _sections[i].buffer,
+                                                  CL_TRUE,
+                                                  CL_MAP_READ,
+                                                  0,
+                                                  bytes,
+                                                  0,
+                                                  nullptr,
+                                                  nullptr,
+                                                  &err);
+                CLError::check(err);
+
+                write_all(fd, mapped, bytes, s.offset, tmp_path);
+
+                err = clEnqueueUnmapMemObject(CLEnvironment::queue(),
+                                              _sections[i].buffer,
+                                              mapped,
+                                              0,
+                                              nullptr,
+                                              nullptr);
+                CLError::check(err);
+            }
+        }
+
+        if (fsync(fd) != 0) {
+            throw RunTimeException("Could not flush checkpoint file " + tmp_path + ": " + strerror(errno));
+        }
+    }
+    catch (...) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        throw;
+    }
+
+    close(fd);
+
+    // The rename is atomic, the previous checkpoint (if any) remains valid
+    // until this point
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw RunTimeException("Could not rename checkpoint file " + tmp_path + ": " + strerror(errno));
+    }
+}
+
+CheckpointReader::CheckpointReader(const string& path) :
+_path(path),
+_data(nullptr),
+_size(0),
+_header(nullptr),
+_sections(nullptr) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw RunTimeException("Could not open checkpoint file " + path + ": " + strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw RunTimeException("Could not stat checkpoint file " + path + ": " + strerror(errno));
+    }
+    _size = st.st_size;
+
+    if (_size < sizeof(CheckpointHeader)) {
+        close(fd);
+        throw RunTimeException("Invalid checkpoint file " + path + ": file too small");
+    }
+
+    _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        throw RunTimeException("Could not map checkpoint file " + path + ": " + strerror(errno));
+    }
+
+    _header = static_cast<const CheckpointHeader*>(_data);
+    if (memcmp(_header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        munmap(_data, _size);
+        throw RunTimeException("Invalid checkpoint file " + path + ": bad magic number");
+    }
+    if (_header->version != CHECKPOINT_VERSION) {
+        munmap(_data, _size);
+        throw RunTimeException("Unsupported checkpoint version " + to_string(_header->version) + " in " + path);
+    }
+
+    if (_header->particle_count < 0) {
+        munmap(_data, _size);
+        throw RunTimeException("Invalid checkpoint file " + path + ": negative particle count");
+    }
+
+    uint64_t table_end = sizeof(CheckpointHeader) + (uint64_t)_header->section_count * sizeof(CheckpointSection);
+    if (table_end > _size) {
+        munmap(_data, _size);
+        throw RunTimeException("Invalid checkpoint file " + path + ": truncated section table");
+    }
+    _sections = reinterpret_cast<const CheckpointSection*>(static_cast<const char*>(_data) + sizeof(CheckpointHeader));
+
+    for (uint32_t i = 0; i < _header->section_count; ++i) {
+        // Checked so no product or sum can overflow
+        auto& s = _sections[i];
+        if (s.offset > _size ||
+            (s.element_size > 0 && s.count > (_size - s.offset) / s.element_size)) {
+            munmap(_data, _size);
+            throw RunTimeException("Invalid checkpoint file " + path + ": truncated section");
+        }
+    }
+
+    // Sections are read once, sequentially
+    madvise(_data, _size, MADV_SEQUENTIAL);
+}
+
+CheckpointReader::~CheckpointReader() {
+    if (_data) {
+        munmap(_data, _size);
+    }
+}
+
+const CheckpointHeader& CheckpointReader::header() const {
+    return *_header;
+}
+
+SimulationSettings CheckpointReader::simulation_settings() const {
+    SimulationSettings s;
+    s.time_step = _header->time_step;
+    s.max_vel = _header->max_vel;
+    s.fluid_particle_radius = _header->fluid_particle_radius;
+    s.fluid_support_radius = _header->fluid_support_radius;
+    s.pcisph_max_iterations = _header->pcisph_max_iterations;
+    s.pcisph_error_ratio = _header->pcisph_error_ratio;
+    s.sim_method = (SimulationSettings::Method)_header->sim_method;
+    return s;
+}
+
+PhysicsSettings CheckpointReader::physics_settings() const {
+    PhysicsSettings p;
+    p.rest_density = _header->rest_density;
+    p.k_viscosity = _header->k_viscosity;
+    p.gravity = _header->gravity;
+    p.gas_stiffness = _header->gas_stiffness;
+    p.surface_tension = _header->surface_tension;
+    return p;
+}
+
+cl_float4 CheckpointReader::container_size() const {
+    cl_float4 c;
+    for (int i = 0; i < 4; ++i) {
+        c.s[i] = _header->container_size[i];
+    }
+    return c;
+}
+
+const CheckpointSection* CheckpointReader::_find(CheckpointTag tag) const {
+    for (uint32_t i = 0; i < _header->section_count; ++i) {
+        if (_sections[i].tag == tag) {
+            return &_sections[i];
+        }
+    }
+    return nullptr;
+}
+
+bool CheckpointReader::has_section(CheckpointTag tag) const {
+    return _find(tag) != nullptr;
+}
+
+void CheckpointReader::_require(CheckpointTag tag, size_t element_size, size_t count) const {
+    auto s = _find(tag);
+    if (s == nullptr) {
+        throw RunTimeException("Checkpoint " + _path + " has no section " + to_string(tag));
+    }
+    if (s->element_size != element_size) {
+        throw RunTimeException("Checkpoint " + _path + ": unexpected element size in section " + to_string(tag));
+    }
+    if (s->count != count) {
+        throw RunTimeException("Checkpoint " + _path + ": section " + to_string(tag) + " has " +
+                               to_string(s->count) + " elements, " + to_string(count) + " expected");
+    }
+}
+
+void CheckpointReader::_upload(CheckpointTag tag, cl_mem dst, size_t element_size) const {
+    auto s = _find(tag);
+    if (s == nullptr) {
+        throw RunTimeException("Checkpoint " + _path + " has no section " + to_string(tag));
+    }
+    if (s->element_size != element_size) {
+        throw RunTimeException("Checkpoint " + _path + ": unexpected element size in section " + to_string(tag));
+    }
+    if (s->count == 0) {
+        return;
+    }
+
+    cl_int err = clEnqueueWriteBuffer(CLEnvironment::queue(),
+                                      dst,
+                                      CL_TRUE,
+                                      0,
+                                      s->element_size * s->count,
+                                      static_cast<const char*>(_data) + s->offset,
+                                      0,
+                                      nullptr,
+                                      nullptr);
+    CLError::check(err);
+}
+
+vector<CheckpointBody> CheckpointReader::bodies() const {
+    vector<CheckpointBody> bodies;
+    auto s = _find(CHECKPOINT_BODIES);
+    if (s != nullptr && s->element_size == sizeof(CheckpointBody)) {
+        auto first = reinterpret_cast<const CheckpointBody*>(static_cast<const char*>(_data) + s->offset);
+        bodies.assign(first, first + s->count);
+    }
+    return bodies;
+}
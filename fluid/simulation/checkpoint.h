@@ -0,0 +1,272 @@
+/**
+ *  @file checkpoint.h
+ *  @brief Contains the declaration of the checkpoint reader and writer.
+ *
+ *  A checkpoint is a binary snapshot of the full state of a fluid solver. The
+ *  file starts with a fixed size header, followed by a table of sections.
+ *  Every section payload starts at an offset aligned to
+ *  CHECKPOINT_ALIGNMENT bytes, so once the file is memory mapped, any
+ *  section can be handed directly to clEnqueueWriteBuffer without copies.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <CL/cl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "settings/settings.h"
+
+// Current version of the checkpoint layout. Bump it on every change to the
+// header, the section table or the meaning of any section
+#define CHECKPOINT_VERSION      1
+
+// Every section payload starts at a multiple of this value (a page)
+#define CHECKPOINT_ALIGNMENT    4096
+
+// Max length of a rigid body id, including the null terminator
+#define CHECKPOINT_ID_LENGTH    64
+
+/**
+ * @brief Identifies the content of a section of a checkpoint
+ */
+enum CheckpointTag : uint32_t {
+    CHECKPOINT_POSITIONS       = 1,
+    CHECKPOINT_VELOCITIES      = 2,
+    CHECKPOINT_HALF_VELOCITIES = 3,
+    CHECKPOINT_PRESSURES       = 4,
+    CHECKPOINT_BODIES          = 5
+};
+
+/**
+ * @brief The header found at the beginning of every checkpoint file
+ */
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    // Number of simulation steps performed when the checkpoint was taken
+    uint64_t step;
+    int32_t sim_method;
+    int32_t particle_count;
+
+    // Simulation settings
+    float time_step;
+    float max_vel;
+    float fluid_particle_radius;
+    float fluid_support_radius;
+    int32_t pcisph_max_iterations;
+    float pcisph_error_ratio;
+
+    // Physics settings
+    float rest_density;
+    float k_viscosity;
+    float gravity;
+    float gas_stiffness;
+    float surface_tension;
+
+    // Limits of the rectangular container
+    float container_size[4];
+};
+
+/**
+ * @brief An entry of the section table
+ */
+struct CheckpointSection {
+    uint32_t tag;
+    uint32_t element_size;
+    uint64_t count;
+    // Offset of the payload from the beginning of the file, in bytes
+    uint64_t offset;
+};
+
+/**
+ * @brief The state of a rigid body, as stored in the bodies section
+ */
+struct CheckpointBody {
+    char id[CHECKPOINT_ID_LENGTH];
+    float position[4];
+    float rotation[4];
+    float linear_vel[4];
+    float angular_vel[4];
+};
+
+/**
+ * @class CheckpointWriter
+ * @brief Collects the state of a solver and writes it to disk
+ * @details Device buffers are not downloaded when added, but when the file
+ *          is written. Each buffer is mapped and written straight to the
+ *          file, so no host copy of the state is ever made. The file is
+ *          first written to a temporary path and then renamed, so a
+ *          preempted run never leaves a truncated checkpoint behind.
+ */
+class CheckpointWriter {
+    public:
+        /**
+         * @brief Creates a new writer
+         *
+         * @param fluid_settings The physics settings of the solver.
+         * @param sim_settings The simulation settings of the solver.
+         * @param step The number of steps simulated so far.
+         */
+        CheckpointWriter(const PhysicsSettings& fluid_settings,
+                         const SimulationSettings& sim_settings,
+                         uint64_t step);
+
+        /**
+         * @brief Sets the limits of the rectangular container
+         *
+         * @param container_size Width, height and depth of the container.
+         */
+        void set_container_size(const cl_float4& container_size);
+
+        /**
+         * @brief Adds a device buffer as a new section
+         * @note The buffer must remain valid (and acquired, if it is shared
+         *       with OpenGL) until write is called.
+         *
+         * @param tag The tag of the section.
+         * @param buffer The device buffer.
+         * @param count The number of elements to save.
+         * @tparam T Type of each element of the buffer.
+         */
+        template<class T>
+        void add_buffer(CheckpointTag tag, cl_mem buffer, size_t count) {
+            _add_buffer(tag, buffer, sizeof(T), count);
+        }
+
+        /**
+         * @brief Adds the state of a set of rigid bodies as a new section
+         *
+         * @param bodies The state of every body.
+         */
+        void add_bodies(const std::vector<CheckpointBody>& bodies);
+
+        /**
+         * @brief Writes the checkpoint to disk
+         *
+         * @param path The path of the checkpoint file.
+         * @throws RunTimeException if the file could not be written.
+         */
+        void write(const std::string& path) const;
+
+    private:
+        struct _PendingSection {
+            CheckpointSection section;
+            cl_mem buffer;
+        };
+
+        CheckpointHeader _header;
+        std::vector<_PendingSection> _sections;
+        std::vector<CheckpointBody> _bodies;
+
+        void _add_buffer(CheckpointTag tag,
+                         cl_mem buffer,
+                         size_t element_size,
+                         size_t count);
+};
+
+/**
+ * @class CheckpointReader
+ * @brief Memory maps a checkpoint file
+ * @details The file is mapped read only for the lifetime of the reader.
+ *          Sections are uploaded to the device directly from the mapping.
+ */
+class CheckpointReader {
+    public:
+        /**
+         * @brief Opens and validates a checkpoint file
+         *
+         * @param path The path of the checkpoint file.
+         * @throws RunTimeException if the file is not a valid checkpoint.
+         */
+        CheckpointReader(const std::string& path);
+
+        /* Unmaps the file */
+        ~CheckpointReader();
+
+        /**
+         * @brief Returns the header of the checkpoint
+         */
+        const CheckpointHeader& header() const;
+
+        /**
+         * @brief Returns the simulation settings stored in the checkpoint
+         */
+        SimulationSettings simulation_settings() const;
+
+        /**
+         * @brief Returns the physics settings stored in the checkpoint
+         */
+        PhysicsSettings physics_settings() const;
+
+        /**
+         * @brief Returns the container limits stored in the checkpoint
+         */
+        cl_float4 container_size() const;
+
+        /**
+         * @brief Tells if the checkpoint has a section with the given tag
+         */
+        bool has_section(CheckpointTag tag) const;
+
+        /**
+         * @brief Checks that a section is there, with the given size
+         * @details Solvers check every section they read before changing
+         *          any of their state, so a bad file leaves them untouched.
+         *
+         * @param tag The tag of the section.
+         * @param count The number of elements the section must have.
+         * @tparam T Type of each element of the section.
+         * @throws RunTimeException if the section is missing, or its
+         *         element size or count do not match.
+         */
+        template<class T>
+        void require(CheckpointTag tag, size_t count) const {
+            _require(tag, sizeof(T), count);
+        }
+
+        /**
+         * @brief Uploads a section to a device buffer
+         * @details The upload is blocking, and the data is read from the
+         *          memory mapped file.
+         *
+         * @param tag The tag of the section.
+         * @param dst The destination buffer. It must be big enough to hold
+         *            the whole section.
+         * @tparam T Type of each element of the buffer.
+         * @throws RunTimeException if the section is missing or the element
+         *         size does not match.
+         */
+        template<class T>
+        void upload(CheckpointTag tag, cl_mem dst) const {
+            _upload(tag, dst, sizeof(T));
+        }
+
+        /**
+         * @brief Returns the state of the rigid bodies stored in the file
+         */
+        std::vector<CheckpointBody> bodies() const;
+
+    private:
+        std::string _path;
+        void* _data;
+        size_t _size;
+
+        const CheckpointHeader* _header;
+        const CheckpointSection* _sections;
+
+        const CheckpointSection* _find(CheckpointTag tag) const;
+
+        void _require(CheckpointTag tag, size_t element_size, size_t count) const;
+        void _upload(CheckpointTag tag, cl_mem dst, size_t element_size) const;
+
+        CheckpointReader(const CheckpointReader&);
+        CheckpointReader& operator=(const CheckpointReader&);
+};
+
+#endif // _CHECKPOINT_H_
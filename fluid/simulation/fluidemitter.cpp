@@ -0,0 +1,59 @@
+#include "fluidemitter.h"
+
+#include <cmath>
+
+using namespace std;
+
+// Layers of particles reserved for an emitter that does not set its
+// max_particles
+#define DEFAULT_EMITTER_LAYERS  100
+
+FluidEmitter::FluidEmitter(const btVector3& center, const btVector3& direction, float speed) :
+_center(center),
+_direction(direction.normalized()),
+_speed(speed),
+_start(0.0f),
+_stop(-1.0f),
+_max_particles(0) {
+
+}
+
+cl_float4 FluidEmitter::velocity() const {
+    cl_float4 v;
+    v.s[0] = _direction.getX() * _speed;
+    v.s[1] = _direction.getY() * _speed;
+    v.s[2] = _direction.getZ() * _speed;
+    v.s[3] = 0;
+    return v;
+}
+
+float FluidEmitter::speed() const {
+    return _speed;
+}
+
+void FluidEmitter::set_active_interval(float start, float stop) {
+    _start = start;
+    _stop = stop;
+}
+
+bool FluidEmitter::is_active(float time) const {
+    return time >= _start && (_stop < 0.0f || time < _stop);
+}
+
+void FluidEmitter::set_max_particles(int max_particles) {
+    _max_particles = max_particles;
+}
+
+int FluidEmitter::max_particles(float particle_radius) const {
+    if (_max_particles > 0) {
+        return _max_particles;
+    }
+    return DEFAULT_EMITTER_LAYERS * layer(particle_radius).size();
+}
+
+void FluidEmitter::_plane_axes(btVector3& u, btVector3& v) const {
+    // Any axis not parallel to the direction will do
+    btVector3 axis = fabs(_direction.getX()) < 0.9f ? btVector3(1, 0, 0) : btVector3(0, 1, 0);
+    u = _direction.cross(axis).normalized();
+    v = _direction.cross(u);
+}
@@ -0,0 +1,92 @@
+#ifndef _FLUID_EMITTER_H_
+#define _FLUID_EMITTER_H_
+
+#include <vector>
+#include <CL/cl.h>
+#include <LinearMath/btVector3.h>
+
+/**
+ * @class FluidEmitter
+ * @brief Base class of the inflows of fluid
+ * @details An emitter adds layers of particles on a plane, moving along the
+ *          normal of the plane at a constant speed. A new layer is emitted
+ *          every time the previous one has moved a particle spacing away.
+ *          The shape of a layer is defined by the extending class.
+ */
+class FluidEmitter {
+
+    public:
+        /**
+         * @brief Creates a new emitter
+         * 
+         * @param center The center of the emitter plane.
+         * @param direction The direction the fluid flows, normal to the plane.
+         * @param speed The speed of the emitted particles.
+         */
+        FluidEmitter(const btVector3& center, const btVector3& direction, float speed);
+
+        virtual ~FluidEmitter() {};
+
+        /**
+         * @brief Returns the positions of the particles of a layer
+         * 
+         * @param particle_radius The radius of a fluid particle.
+         */
+        virtual std::vector<cl_float4> layer(float particle_radius) const = 0;
+
+        /**
+         * @brief Returns the velocity of the emitted particles
+         */
+        cl_float4 velocity() const;
+
+        /**
+         * @brief Returns the speed of the emitted particles
+         */
+        float speed() const;
+
+        /**
+         * @brief Limits the emission to an interval of simulated time
+         * 
+         * @param start The time emission starts, in seconds.
+         * @param stop The time emission stops, in seconds. Negative to 
+         *             never stop.
+         */
+        void set_active_interval(float start, float stop);
+
+        /**
+         * @brief Tells if the emitter is emitting at a given time
+         */
+        bool is_active(float time) const;
+
+        /**
+         * @brief Sets how many particles of the solver buffers are reserved 
+         *        for this emitter
+         * @details Once the reserved capacity is used up, the emitter stops 
+         *          until sinks remove enough particles.
+         */
+        void set_max_particles(int max_particles);
+
+        /**
+         * @brief Returns how many particles are reserved for this emitter
+         * @details Defaults to DEFAULT_EMITTER_LAYERS layers.
+         * 
+         * @param particle_radius The radius of a fluid particle.
+         */
+        int max_particles(float particle_radius) const;
+
+    protected:
+        btVector3 _center, _direction;
+        float _speed;
+
+        /**
+         * @brief Returns two unit vectors that span the emitter plane
+         */
+        void _plane_axes(btVector3& u, btVector3& v) const;
+
+    private:
+        float _start, _stop;
+        int _max_particles;
+
+};
+
+#endif // _FLUID_EMITTER_H_
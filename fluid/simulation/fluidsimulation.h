@@ -11,9 +11,15 @@
 #ifndef _FLUID_SIMULATION_H_
 #define _FLUID_SIMULATION_H_
 
+#include <CL/cl.h>
+
 #include "settings/settings.h"
 #include "scene/rigidbody.h"
 #include "fluidvolume.h"
+#include "fluidemitter.h"
+#include "fluidsink.h"
+#include "checkpoint.h"
+#include "grid.h"
 
 /**
  * @class FluidSimulation
@@ -47,6 +53,21 @@ class FluidSimulation {
         virtual void reset(const PhysicsSettings& fluid_settings,
                            const SimulationSettings& sim_settings) = 0;
 
+        /**
+         * @brief Updates the settings of the running simulation
+         * @details Coefficients, like the viscosity, the gravity or the time
+         *          step, are passed to the kernels in place, and the state of
+         *          the fluid is kept. Structural settings, like the particle
+         *          and support radii, need a reset.
+         *
+         * @param fluid_settings Physical properties of the fluid.
+         * @param sim_settings Parameters of the simulation.
+         * @return True if the settings were applied, false if they need a
+         *         reset.
+         */
+        virtual bool update_settings(const PhysicsSettings& fluid_settings,
+                                     const SimulationSettings& sim_settings) = 0;
+
         /**
          * @brief Returs the number of particles used by the solver.
          * @return The count of particles being used in the simulation.
@@ -89,6 +110,112 @@ class FluidSimulation {
          * @param volume An instance of a fluid volume.
          */
         virtual void add_volume(const std::shared_ptr<FluidVolume> volume) = 0;
+
+        /**
+         * @brief Adds an inflow of fluid to the simulation
+         * @details Particles are emitted into capacity reserved when the 
+         *          solver is initialized, so no buffer grows while 
+         *          simulating.
+         * 
+         * @param emitter An instance of a fluid emitter.
+         */
+        virtual void add_emitter(const std::shared_ptr<FluidEmitter> emitter) = 0;
+
+        /**
+         * @brief Adds an outflow of fluid to the simulation
+         * @details Particles that enter the sink are removed, and their 
+         *          place in the buffers is reused by the emitters.
+         * 
+         * @param sink An instance of a fluid sink.
+         */
+        virtual void add_sink(const std::shared_ptr<FluidSink> sink) = 0;
+
+        /**
+         * @brief Starts a batch of volumes and boundaries
+         * @details Until commit is called, add_volume and add_boundary only
+         *          record what is added. Use this to build a scene with 
+         *          one buffer allocation, one boundary sampling pass and one
+         *          kernel compilation, instead of one per volume and body.
+         */
+        virtual void begin_batch() = 0;
+
+        /**
+         * @brief Applies everything added since begin_batch at once
+         */
+        virtual void commit() = 0;
+
+        /**
+         * @brief Returns the number of steps simulated since the last reset
+         */
+        virtual unsigned long step_count() const = 0;
+
+        /**
+         * @brief Saves the full state of the solver to a checkpoint file
+         * @details The checkpoint holds the particles state, the state of 
+         *          every rigid body coupled with the fluid, the settings and 
+         *          the step counter. See checkpoint.h for the file layout.
+         * 
+         * @param path The path of the checkpoint file.
+         */
+        virtual void save_checkpoint(const std::string& path) = 0;
+
+        /**
+         * @brief Restores the full state of the solver from a checkpoint file
+         * @details The solver is reinitialized with the settings and 
+         *          particles stored in the checkpoint. The fluid volumes are 
+         *          not used, and no relaxation step is performed.
+         * 
+         * @param path The path of the checkpoint file.
+         */
+        virtual void load_checkpoint(const std::string& path) = 0;
+
+        /**
+         * @brief Enqueues the download of the particles state
+         * @details The reads are non blocking. The destination memory must
+         *          remain valid until the returned event completes, so it is
+         *          meant to be pinned host memory. All three arrays are 
+         *          written in the same particle order.
+         * 
+         * @param positions Destination of the particle positions.
+         * @param velocities Destination of the particle velocities.
+         * @param densities Destination of the particle densities.
+         * @param event Returns an event that completes with the last read.
+         */
+        virtual void download_particles(cl_float4* positions,
+                                        cl_float4* velocities,
+                                        cl_float* densities,
+                                        cl_event* event) = 0;
+
+        /**
+         * @brief Returns the state of every rigid body coupled with the fluid
+         */
+        virtual std::vector<CheckpointBody> bodies_state() const = 0;
+
+        /**
+         * @brief Returns the particles as binned in the uniform grid by the 
+         *        last simulation step
+         * @details The positions are those at the beginning of the last 
+         *          step, when the neighbourhood search was done.
+         * 
+         * @param particles The particles and the cell intervals.
+         * @return false if the solver has no uniform grid.
+         */
+        virtual bool particle_grid(ParticleGrid& particles) const = 0;
+
+        /**
+         * @brief Sets the OpenGL buffer the solver writes the cost of every
+         *        particle to, on every step
+         * @details One float4 per particle, in the order of the positions 
+         *          VBO: the length of the fluid neighbourhood list, 1 if a
+         *          neighbourhood list is full (0 otherwise), the density 
+         *          error relative to the rest density, and the length of 
+         *          the boundary neighbourhood list. The buffer is sized by
+         *          the solver, as the positions VBO.
+         * 
+         * @param vbo The buffer, or zero to stop writing the metrics.
+         * @return false if the solver does not compute the metrics.
+         */
+        virtual bool set_metrics_buffer(GLuint vbo) = 0;
 };
 
 #endif // _FLUID_SIMULATION_H_
\ No newline at end of file
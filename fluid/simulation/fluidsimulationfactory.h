@@ -4,6 +4,7 @@
 #include <memory>
 #include "fluid/simulation/wcsphsimluation.h"
 #include "fluid/simulation/pcisphsimluation.h"
+#include "fluid/simulation/replaysimulation.h"
 #include "settings/settings.h"
 
 
@@ -34,6 +35,14 @@ class FluidSimulationFactory {
                         )
                     );
                     break;
+                case SimulationSettings::Method::REPLAY:
+                    return std::unique_ptr<ReplaySimulation>(
+                        new ReplaySimulation(
+                                sim_settings,
+                                vbo_fluid_particles
+                        )
+                    );
+                    break;
                 default:
                     throw RunTimeException("Unknown simulation method!");
             }
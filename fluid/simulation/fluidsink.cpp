@@ -0,0 +1,25 @@
+#include "fluidsink.h"
+
+FluidSink::FluidSink(const btVector3& size, const btVector3& center) :
+_size(size),
+_center(center) {
+
+}
+
+cl_float4 FluidSink::min() const {
+    cl_float4 p;
+    p.s[0] = _center.getX() - _size.getX() / 2.0f;
+    p.s[1] = _center.getY() - _size.getY() / 2.0f;
+    p.s[2] = _center.getZ() - _size.getZ() / 2.0f;
+    p.s[3] = 0;
+    return p;
+}
+
+cl_float4 FluidSink::max() const {
+    cl_float4 p;
+    p.s[0] = _center.getX() + _size.getX() / 2.0f;
+    p.s[1] = _center.getY() + _size.getY() / 2.0f;
+    p.s[2] = _center.getZ() + _size.getZ() / 2.0f;
+    p.s[3] = 0;
+    return p;
+}
@@ -0,0 +1,31 @@
+#ifndef _FLUID_SINK_H_
+#define _FLUID_SINK_H_
+
+#include <CL/cl.h>
+#include <LinearMath/btVector3.h>
+
+/**
+ * @class FluidSink
+ * @brief A box shaped outflow. Fluid particles that enter it are removed
+ */
+class FluidSink {
+
+    public:
+        FluidSink(const btVector3& size, const btVector3& center);
+
+        /**
+         * @brief Returns the lowest corner of the box
+         */
+        cl_float4 min() const;
+
+        /**
+         * @brief Returns the highest corner of the box
+         */
+        cl_float4 max() const;
+
+    private:
+        btVector3 _size, _center;
+
+};
+
+#endif // _FLUID_SINK_H_
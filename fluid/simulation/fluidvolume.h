@@ -4,11 +4,58 @@
 #include <vector>
 #include <CL/cl.h>
 
+#include "kernels/common.h"
+
+/**
+ * @brief Particles laid out in host memory as an array of records
+ * @details Each record holds the position, and optionally the velocity, as
+ *          three floats. The memory belongs to the volume, it is typically
+ *          a mapped file.
+ */
+struct ParticleArray {
+    const char* data;
+    int count;
+    // The size of a record in bytes. It is a multiple of 4
+    int stride;
+    // The offsets in bytes of the position and the velocity within a
+    // record. The velocity offset is negative if there is none
+    int position_offset;
+    int velocity_offset;
+};
+
 class FluidVolume {
 
     public:
         virtual std::vector<cl_float4> particles(float particle_radius) = 0;
 
+        /**
+         * @brief Describes the particles of the volume as a regular lattice
+         * @details Volumes that are a lattice have their particles generated
+         *          on the device (see VolumeFiller), without building them
+         *          on the host. The offset is not set.
+         *
+         * @param particle_radius The radius of the particles.
+         * @param lattice The lattice of the volume.
+         * @return True if the volume is a lattice, false if the particles
+         *         must be taken from particles().
+         */
+        virtual bool lattice(float particle_radius, VolumeLattice& lattice) {
+            return false;
+        }
+
+        /**
+         * @brief Gives the particles of the volume as an array of records
+         * @details Such volumes are streamed to the device in chunks (see
+         *          VolumeFiller), without a copy on the host.
+         *
+         * @param array The particles of the volume.
+         * @return True if the volume is an array, false if the particles
+         *         must be taken from particles().
+         */
+        virtual bool particle_array(ParticleArray& array) {
+            return false;
+        }
+
 };
 
-#endif // _FLUID_VOLUME_H_
\ No newline at end of file
+#endif // _FLUID_VOLUME_H_
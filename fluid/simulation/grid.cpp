@@ -1,18 +1,50 @@
 #include "grid.h"
 #include "opencl/clallocator.h"
 #include "opencl/clmisc.h"
+#include "profiling/frameprofiler.h"
+#include <algorithm>
 #include <vector>
 
 using namespace std;
 
+// The length of the lists is a multiple of this, and never less
+#define NEIGH_LIST_LENGTH_STEP      8
+// Consecutive statistics with lists too long before they shrink
+#define NEIGH_LIST_SHRINK_READS     60
+
+// The list length for the most neighbours seen, with a quarter on top so a
+// little compression does not overflow it again
+static int needed_list_length(int max_neighbours) {
+    int length = max_neighbours + max_neighbours / 4 + 1;
+    length = (length + NEIGH_LIST_LENGTH_STEP - 1) / NEIGH_LIST_LENGTH_STEP * NEIGH_LIST_LENGTH_STEP;
+    return max(length, NEIGH_LIST_LENGTH_STEP);
+}
+
 Grid::Grid(float size, float cell_size) {
     // Initialize grid info struct
     _reset(size, cell_size);
     _sqr_support_radius = cell_size * cell_size;
+
+    for (auto& slot : _neigh_stats) {
+        slot.buffer = CLAllocator::alloc_buffer<cl_int>("grid/neigh_stats", 3);
+        slot.event = nullptr;
+        slot.count = 0;
+        slot.length = 0;
+        slot.last = NeighbourStats{0, 0.0f, 0, 0, 0};
+        slot.reads = 0;
+        slot.fitted_reads = 0;
+        slot.sparse_reads = 0;
+    }
 }
 
 Grid::~Grid() {
-
+    for (auto& slot : _neigh_stats) {
+        if (slot.event) {
+            clWaitForEvents(1, &slot.event);
+            clReleaseEvent(slot.event);
+        }
+        CLAllocator::release_buffer(slot.buffer);
+    }
 }
 
 int Grid::cell_count() const {
@@ -100,16 +132,103 @@ void Grid::compute_neigh_list(cl_mem ref_positions,
                               cl_mem neigh_list,
                               cl_mem neigh_list_length,
                               int max_list_length,
-                              int count) const {
+                              int count,
+                              NeighbourList list) const {
+    auto& slot = _neigh_stats[(int)list];
+
+    // The statistics of an earlier step, if read by now
+    neighbour_stats(list);
+
+    CLAllocator::fill_buffer<cl_int>(slot.buffer, 0, 3);
+
     _kernel_neigh_list->set_arg(0, &ref_positions);
     _kernel_neigh_list->set_arg(1, &neigh_positions);
     _kernel_neigh_list->set_arg(2, &intervals);
     _kernel_neigh_list->set_arg(3, &neigh_list);
     _kernel_neigh_list->set_arg(4, &neigh_list_length);
-    _kernel_neigh_list->set_arg(5, &_grid_info);
-    _kernel_neigh_list->set_arg(6, &count);
+    _kernel_neigh_list->set_arg(5, &slot.buffer);
+    _kernel_neigh_list->set_arg(6, &_grid_info);
+    _kernel_neigh_list->set_arg(7, &count);
+    _kernel_neigh_list->set_arg(8, &max_list_length);
 
     // Now call the kernel
     auto err = _kernel_neigh_list->run(count);
     CLError::check(err);
-}
\ No newline at end of file
+
+    // Only one read in flight, as they share the host copy. The queue is in
+    // order, so a read still pending gets the statistics of its own step
+    if (!slot.event) {
+        err = clEnqueueReadBuffer(CLEnvironment::queue(), slot.buffer, CL_FALSE, 0,
+                                  sizeof(slot.host), slot.host,
+                                  0, nullptr, &slot.event);
+        CLError::check(err);
+        slot.count = count;
+        slot.length = max_list_length;
+    }
+}
+
+NeighbourStats Grid::neighbour_stats(NeighbourList list) const {
+    auto& slot = _neigh_stats[(int)list];
+    if (!slot.event) {
+        return slot.last;
+    }
+
+    cl_int status;
+    clGetEventInfo(slot.event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, nullptr);
+    if (status != CL_COMPLETE) {
+        return slot.last;
+    }
+    clReleaseEvent(slot.event);
+    slot.event = nullptr;
+
+    auto& stats = slot.last;
+    stats.particle_count = slot.count;
+    stats.mean = slot.count > 0 ? (float)slot.host[0] / slot.count : 0.0f;
+    stats.max = slot.host[1];
+    stats.truncated = slot.host[2];
+    stats.list_length = slot.length;
+    ++slot.reads;
+
+    if (list == NeighbourList::FLUID) {
+        FrameProfiler::set(FrameCounter::NEIGHBOURS_MEAN, stats.mean);
+        FrameProfiler::set(FrameCounter::NEIGHBOURS_MAX, stats.max);
+        FrameProfiler::set(FrameCounter::NEIGHBOUR_TRUNCATIONS, stats.truncated);
+    }
+    else {
+        FrameProfiler::set(FrameCounter::BOUNDARY_NEIGHBOURS_MAX, stats.max);
+        FrameProfiler::set(FrameCounter::BOUNDARY_NEIGHBOUR_TRUNCATIONS, stats.truncated);
+    }
+
+    return stats;
+}
+
+int Grid::fit_list_length(NeighbourList list, int length) const {
+    auto stats = neighbour_stats(list);
+    auto& slot = _neigh_stats[(int)list];
+
+    // Nothing new since the last call
+    if (slot.reads == slot.fitted_reads) {
+        return length;
+    }
+    slot.fitted_reads = slot.reads;
+
+    int needed = needed_list_length(stats.max);
+    if (stats.max > length) {
+        slot.sparse_reads = 0;
+        return needed;
+    }
+
+    // Only lists of the current length tell whether it is too long, as
+    // the statistics may be of lists built before a change
+    if (stats.list_length == length && needed < length * 3 / 4) {
+        if (++slot.sparse_reads >= NEIGH_LIST_SHRINK_READS) {
+            slot.sparse_reads = 0;
+            return needed;
+        }
+    }
+    else {
+        slot.sparse_reads = 0;
+    }
+
+    return length;
+}
@@ -16,6 +16,49 @@
 #include "kernels/common.h"
 #include <memory>
 
+/**
+ * @brief A set of particles binned in the uniform grid
+ * @details The particles are sorted by cell, and for every cell of the grid
+ *          the interval of particles within is known. This is the state a
+ *          solver leaves behind after its neighbourhood search.
+ */
+struct ParticleGrid {
+    // Sorted particle positions
+    cl_mem positions;
+    // For every cell, the interval [a,b) of particles within
+    cl_mem cell_intervals;
+    GridInfo grid_info;
+    int particle_count;
+
+    float particle_mass;
+    float rest_density;
+    float support_radius;
+};
+
+/**
+ * @brief The neighbourhood lists of a step, each with its own statistics
+ */
+enum class NeighbourList {
+    FLUID,
+    BOUNDARY,
+    COUNT
+};
+
+/**
+ * @brief Statistics of the neighbourhood lists of a step
+ */
+struct NeighbourStats {
+    // The particles the lists were built for, zero if none was read yet
+    int particle_count;
+    float mean;
+    // The most neighbours of a particle, stored or not
+    int max;
+    // Particles with more neighbours than fit in their list
+    int truncated;
+    // The length the lists were built with
+    int list_length;
+};
+
 /**
  * @class Grid
  * @brief The uniform grid
@@ -106,8 +149,11 @@ class Grid {
          * @param neigh_list A buffer to save the neigh list for every ref particle.
          * @param neigh_list_length A buffer to save the neigh list length for 
          *                          every ref particle.
-         * @param max_list_length The max length of each neigh list.
+         * @param max_list_length The max length of each neigh list. The
+         *                        neighbours past it are counted in the
+         *                        statistics, but dropped.
          * @param count The number of ref particles.
+         * @param list Which lists these are, for their statistics.
          */
         void compute_neigh_list(cl_mem ref_positions,
                                 cl_mem neigh_positions,
@@ -115,7 +161,33 @@ class Grid {
                                 cl_mem neigh_list,
                                 cl_mem neigh_list_length,
                                 int max_list_length,
-                                int count) const;
+                                int count,
+                                NeighbourList list=NeighbourList::FLUID) const;
+
+        /**
+         * @brief Returns the statistics of the last neighbourhood lists
+         *        read back
+         * @details The statistics are read without waiting for the device,
+         *          so they are of a step a frame or so behind. They are also
+         *          handed to the FrameProfiler.
+         */
+        NeighbourStats neighbour_stats(NeighbourList list=NeighbourList::FLUID) const;
+
+        /**
+         * @brief Returns the length the neighbourhood lists need, from the
+         *        statistics read back
+         * @details As soon as a particle had more neighbours than fit, the
+         *          length grows past the most neighbours seen, with some
+         *          headroom. It only shrinks once the lists were well below
+         *          their length for a number of steps in a row, so it does
+         *          not flap. The statistics are a step or so behind, so the
+         *          steps in flight still run with the lists they had.
+         * 
+         * @param list Which lists.
+         * @param length The length the lists have now.
+         * @return The length to give the lists, the same if it is fine.
+         */
+        int fit_list_length(NeighbourList list, int length) const;
 
         /**
          * @brief Returns grid info
@@ -148,6 +220,25 @@ class Grid {
 
         GridInfo _grid_info;
 
+        // Sum of the list lengths, max neighbours and truncated lists, and
+        // their host copy, read without blocking. Bookkeeping, so it changes
+        // in const builds
+        struct _StatsSlot {
+            cl_mem buffer;
+            cl_int host[3];
+            cl_event event;
+            int count;
+            int length;
+            NeighbourStats last;
+            // Statistics read, and how many of them were used by
+            // fit_list_length
+            unsigned long reads;
+            unsigned long fitted_reads;
+            // Consecutive reads where the lists were too long
+            int sparse_reads;
+        };
+        mutable _StatsSlot _neigh_stats[(int)NeighbourList::COUNT];
+
         // Auxiliary
         const cl_int2 _zero_int2 = {{0, 0}};
 
@@ -0,0 +1,44 @@
+#include "nozzleemitter.h"
+
+#include <cmath>
+
+using namespace std;
+
+NozzleEmitter::NozzleEmitter(const btVector3& center, 
+                             const btVector3& direction, 
+                             float speed,
+                             float radius) :
+FluidEmitter(center, direction, speed),
+_radius(radius) {
+
+}
+
+vector<cl_float4> NozzleEmitter::layer(float particle_radius) const {
+    vector<cl_float4> particles;
+
+    btVector3 u, v;
+    _plane_axes(u, v);
+
+    // A square lattice, clipped to the disk
+    float particle_spacing = 2 * particle_radius;
+    int n = floor(_radius / particle_spacing);
+    for (int i=-n; i<=n; ++i) {
+        for (int j=-n; j<=n; ++j) {
+            float x = i * particle_spacing;
+            float y = j * particle_spacing;
+            if (x*x + y*y > _radius*_radius) {
+                continue;
+            }
+
+            auto pos = _center + x * u + y * v;
+            cl_float4 p;
+            p.s[0] = pos.getX();
+            p.s[1] = pos.getY();
+            p.s[2] = pos.getZ();
+            p.s[3] = 1; // Homogeneous system
+            particles.push_back(p);
+        }
+    }
+
+    return particles;
+}
@@ -0,0 +1,25 @@
+#ifndef _NOZZLE_EMITTER_H_
+#define _NOZZLE_EMITTER_H_
+
+#include "fluidemitter.h"
+
+/**
+ * @class NozzleEmitter
+ * @brief Emits the fluid through a disk
+ */
+class NozzleEmitter : public FluidEmitter {
+
+    public:
+        NozzleEmitter(const btVector3& center, 
+                      const btVector3& direction, 
+                      float speed,
+                      float radius);
+
+        std::vector<cl_float4> layer(float particle_radius) const;
+
+    private:
+        float _radius;
+
+};
+
+#endif // _NOZZLE_EMITTER_H_
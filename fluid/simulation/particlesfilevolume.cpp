@@ -0,0 +1,218 @@
+#include "particlesfilevolume.h"
+#include "runtimeexception.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Size in bytes of a PLY scalar type, or 0 if unknown
+static int ply_type_size(const string& type) {
+    if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") {
+        return 1;
+    }
+    if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") {
+        return 2;
+    }
+    if (type == "int" || type == "uint" || type == "int32" || type == "uint32" ||
+        type == "float" || type == "float32") {
+        return 4;
+    }
+    if (type == "double" || type == "float64") {
+        return 8;
+    }
+    return 0;
+}
+
+ParticlesFileVolume::ParticlesFileVolume(const string& filename, bool raw_velocities) :
+_filename(filename),
+_data(nullptr),
+_size(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw RunTimeException("Could not open particles file " + filename + ": " + strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw RunTimeException("Could not stat particles file " + filename + ": " + strerror(errno));
+    }
+    _size = st.st_size;
+
+    if (_size == 0) {
+        close(fd);
+        throw RunTimeException("Invalid particles file " + filename + ": empty file");
+    }
+
+    _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        throw RunTimeException("Could not map particles file " + filename + ": " + strerror(errno));
+    }
+
+    // The particles are streamed once, front to back
+    madvise(_data, _size, MADV_SEQUENTIAL);
+
+    if (_size >= 4 && memcmp(_data, "ply\n", 4) == 0) {
+        _parse_ply();
+    }
+    else {
+        _parse_raw(raw_velocities);
+    }
+}
+
+ParticlesFileVolume::~ParticlesFileVolume() {
+    if (_data) {
+        munmap(_data, _size);
+    }
+}
+
+vector<cl_float4> ParticlesFileVolume::particles(float particle_radius) {
+    vector<cl_float4> particles(_array.count);
+
+    for (int i=0; i<_array.count; ++i) {
+        const char* record = _array.data + (size_t)i * _array.stride;
+        memcpy(particles[i].s, record + _array.position_offset, 3 * sizeof(float));
+        particles[i].s[3] = 1; // Homogeneous system
+    }
+
+    return particles;
+}
+
+bool ParticlesFileVolume::particle_array(ParticleArray& array) {
+    array = _array;
+    return true;
+}
+
+void ParticlesFileVolume::_parse_ply() {
+    auto text = static_cast<const char*>(_data);
+
+    // The header is text, up to and including the end_header line
+    const char* marker = "end_header\n";
+    auto end = search(text, text + _size, marker, marker + strlen(marker));
+    if (end == text + _size) {
+        _fail("PLY header not terminated");
+    }
+    size_t header_size = (end - text) + strlen(marker);
+
+    istringstream header(string(text, header_size));
+    string line;
+    bool in_vertex = false;
+    bool vertex_seen = false;
+    long long count = 0;
+    int stride = 0;
+    int offsets[6] = {-1, -1, -1, -1, -1, -1};
+    const char* names[6] = {"x", "y", "z", "vx", "vy", "vz"};
+
+    while (getline(header, line)) {
+        istringstream words(line);
+        string keyword;
+        words >> keyword;
+
+        if (keyword == "format") {
+            string format;
+            words >> format;
+            if (format != "binary_little_endian") {
+                _fail("only binary_little_endian PLY files are supported");
+            }
+        }
+        else if (keyword == "element") {
+            string name;
+            words >> name;
+            if (vertex_seen) {
+                // Elements after the vertices are not read
+                in_vertex = false;
+                continue;
+            }
+            if (name != "vertex") {
+                _fail("the vertex element must be the first one");
+            }
+            words >> count;
+            in_vertex = true;
+            vertex_seen = true;
+        }
+        else if (keyword == "property" && in_vertex) {
+            string type, name;
+            words >> type >> name;
+            if (type == "list") {
+                _fail("list properties of vertices are not supported");
+            }
+
+            int size = ply_type_size(type);
+            if (size == 0) {
+                _fail("unknown property type " + type);
+            }
+
+            for (int c=0; c<6; ++c) {
+                if (name == names[c]) {
+                    if (type != "float" && type != "float32") {
+                        _fail("property " + name + " must be a float");
+                    }
+                    offsets[c] = stride;
+                }
+            }
+            stride += size;
+        }
+    }
+
+    if (!vertex_seen || offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0) {
+        _fail("no vertex positions");
+    }
+
+    // The records are read as floats on the device
+    for (int c=0; c<6; ++c) {
+        if (offsets[c] >= 0 && offsets[c] % 4 != 0) {
+            _fail("vertex properties must be aligned to 4 bytes");
+        }
+    }
+    if (stride % 4 != 0) {
+        _fail("vertex properties must be aligned to 4 bytes");
+    }
+
+    // Position and velocity are read as three consecutive floats
+    if (offsets[1] != offsets[0] + 4 || offsets[2] != offsets[0] + 8) {
+        _fail("the x, y and z properties must be consecutive");
+    }
+    bool velocities = offsets[3] >= 0 || offsets[4] >= 0 || offsets[5] >= 0;
+    if (velocities && (offsets[3] < 0 || offsets[4] != offsets[3] + 4 || offsets[5] != offsets[3] + 8)) {
+        _fail("the vx, vy and vz properties must be consecutive");
+    }
+
+    if (count < 0 || count > INT_MAX || header_size + (size_t)count * stride > _size) {
+        _fail("truncated vertex element");
+    }
+
+    _array.data = text + header_size;
+    _array.count = count;
+    _array.stride = stride;
+    _array.position_offset = offsets[0];
+    _array.velocity_offset = velocities ? offsets[3] : -1;
+}
+
+void ParticlesFileVolume::_parse_raw(bool velocities) {
+    int stride = (velocities ? 6 : 3) * sizeof(float);
+    if (_size % stride != 0 || _size / stride > INT_MAX) {
+        _fail("the size is not a whole number of particles");
+    }
+
+    _array.data = static_cast<const char*>(_data);
+    _array.count = _size / stride;
+    _array.stride = stride;
+    _array.position_offset = 0;
+    _array.velocity_offset = velocities ? 3 * sizeof(float) : -1;
+}
+
+void ParticlesFileVolume::_fail(const string& reason) {
+    munmap(_data, _size);
+    _data = nullptr;
+    throw RunTimeException("Invalid particles file " + _filename + ": " + reason);
+}
@@ -0,0 +1,68 @@
+/**
+ *  @file particlesfilevolume.h
+ *  @brief Contains the declaration of the ParticlesFileVolume class.
+ *
+ *  A fluid volume whose particles are read from a file, so a simulation
+ *  can start from a state produced elsewhere. Binary little endian PLY
+ *  files are read from the vertex element, with the position in the x, y
+ *  and z properties and, optionally, the velocity in vx, vy and vz. Any
+ *  other file is taken as a raw array of little endian floats, three per
+ *  particle for the position, followed by three for the velocity if asked.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _PARTICLES_FILE_VOLUME_H_
+#define _PARTICLES_FILE_VOLUME_H_
+
+#include "fluidvolume.h"
+#include <string>
+
+class ParticlesFileVolume : public FluidVolume {
+
+    public:
+        /**
+         * @brief Maps a particles file
+         * @details The file is mapped, not read, and its pages are only
+         *          loaded while they are streamed to the device.
+         *
+         * @param filename The path of the file.
+         * @param raw_velocities For raw files, whether each position is
+         *        followed by a velocity. PLY files describe it themselves.
+         * @throws RunTimeException if the file can not be mapped, or is not
+         *         a supported particles file.
+         */
+        ParticlesFileVolume(const std::string& filename, bool raw_velocities=false);
+
+        ~ParticlesFileVolume();
+
+        std::vector<cl_float4> particles(float particle_radius);
+
+        bool particle_array(ParticleArray& array);
+
+    private:
+        std::string _filename;
+        void* _data;
+        std::size_t _size;
+        ParticleArray _array;
+
+        ParticlesFileVolume(const ParticlesFileVolume&);
+        ParticlesFileVolume& operator=(const ParticlesFileVolume&);
+
+        /**
+         * @brief Reads the header of a PLY file, and fills in the array
+         */
+        void _parse_ply();
+
+        /**
+         * @brief Fills in the array of a raw file
+         */
+        void _parse_raw(bool velocities);
+
+        /**
+         * @brief Unmaps the file and throws an exception
+         */
+        void _fail(const std::string& reason);
+};
+
+#endif // _PARTICLES_FILE_VOLUME_H_
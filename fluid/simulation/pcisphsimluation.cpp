@@ -2,12 +2,17 @@
 
 #include "pcisphsimluation.h"
 #include "fluidvolume.h"
+#include "volumefiller.h"
+#include "checkpoint.h"
 #include "opencl/clallocator.h"
 #include "opencl/algorithms/clsort.h"
 #include "opencl/algorithms/clshuffle.h"
 #include "opencl/algorithms/clreduce.h"
+#include "profiling/frameprofiler.h"
+#include "runtimeexception.h"
 
 #include <CL/cl_gl.h>
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -20,10 +25,21 @@ PCISPHSimulation::PCISPHSimulation(const PhysicsSettings& fluid_settings,
                                    const SimulationSettings& sim_settings,
                                    GLuint vbo_positions) :
 _particle_count(0),
+_capacity(0),
+_step(0),
+_batching(false),
+_pending_solver_init(false),
+_pending_kernels(false),
+_sink_boxes(nullptr),
+_dead_count(nullptr),
+_dead_count_host(0),
+_dead_count_event(nullptr),
 _vbo_positions(vbo_positions),
+_vbo_metrics(0),
 _positions_unsorted(nullptr),
 _positions_sorted(nullptr),
 _positions_predicted(nullptr),
+_metrics(nullptr),
 _hashes(nullptr),
 _mask(nullptr),
 _velocities_unsorted(nullptr),
@@ -37,6 +53,7 @@ _particle_force(nullptr),
 _pressure_force(nullptr),
 _normals(nullptr),
 _cell_intervals(nullptr),
+_cell_intervals_count(0),
 _neigh_list_length(nullptr),
 _neighbourhood_list(nullptr),
 _sb_neigh_list(nullptr),
@@ -46,7 +63,11 @@ _image_predicted_positions(nullptr),
 _image_velocities(nullptr),
 _image_densities(nullptr),
 _image_normals(nullptr),
-_image_pressures(nullptr)
+_image_pressures(nullptr),
+_program_support_radius(0.0f),
+_program_computes_boundary(false),
+_max_neigh_list_length(NEIGH_LIST_DEFAULT_LENGTH),
+_max_sb_neigh_list_length(NEIGH_LIST_DEFAULT_LENGTH)
 {
     // Initialize internal parameters
     _initialize_params(fluid_settings, sim_settings);
@@ -66,16 +87,33 @@ int PCISPHSimulation::particle_count() const {
 }
 
 void PCISPHSimulation::simulate() {   
+    _emit_particles();
     _simulate_pcisph_step(_min_iterations, _max_iterations);
+    ++_step;
+}
+
+unsigned long PCISPHSimulation::step_count() const {
+    return _step;
 }
 
 void PCISPHSimulation::_simulate_pcisph_step(int min_iter, int max_iter) {
+    // The particles killed by the sinks in the last step are still in the 
+    // buffers. They are dropped after the sort
+    int dead_count = _wait_dead_count();
+
+    if (_particle_count <= 0) {
+        return;
+    }
+
     CLAllocator::lock_gl_buffers(_gl_shared_buffers);
 
+    FrameProfiler::begin(FramePhase::BOUNDARY_SYNC);
     _boundary_handler->sync();
+    FrameProfiler::end(FramePhase::BOUNDARY_SYNC);
 
     // First, compute the hash for every particle. The hash depends on the 
     // position within the uniform grid
+    FrameProfiler::begin(FramePhase::SORT);
     _grid->compute_hashes(_positions_unsorted, 
                           _hashes, 
                           _mask, 
@@ -85,6 +123,20 @@ void PCISPHSimulation::_simulate_pcisph_step(int min_iter, int max_iter) {
     // to sort the rest of the buffers
     clsort<cl_uint, cl_int>(_hashes, _mask, _particle_count);
 
+    // Dead particles have the highest hash, so they are now at the end. 
+    // Dropping them from the count compacts the buffers, as only the live 
+    // ones are shuffled, and written back by the time integration
+    if (dead_count > 0) {
+        _particle_count -= dead_count;
+        _setup_fluid_params();
+
+        if (_particle_count <= 0) {
+            FrameProfiler::end(FramePhase::SORT);
+            CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+            return;
+        }
+    }
+
     // Now, suffle the positions and velocities
     clshuffle<cl_float4>(_positions_unsorted, _mask, _positions_sorted, _particle_count);
     clshuffle<cl_float4>(_velocities_unsorted, _mask, _velocities_sorted, _particle_count);
@@ -95,8 +147,11 @@ void PCISPHSimulation::_simulate_pcisph_step(int min_iter, int max_iter) {
                                   _hashes,
                                   _cell_intervals, 
                                   _particle_count);
+    FrameProfiler::end(FramePhase::SORT);
 
     // And now, compute the neighbourhood list for every fluid particle
+    FrameProfiler::begin(FramePhase::NEIGHBOURS);
+    _fit_neigh_lists();
     _grid->compute_neigh_list(_positions_sorted,
                               //_positions_sorted,
                               _image_positions,
@@ -111,22 +166,31 @@ void PCISPHSimulation::_simulate_pcisph_step(int min_iter, int max_iter) {
     _boundary_handler->build_neighbourhood(_positions_sorted,
                                            _sb_neigh_list,
                                            _sb_neigh_list_length,
-                                           _max_neigh_list_length,
+                                           _max_sb_neigh_list_length,
                                            _particle_count);
+    FrameProfiler::end(FramePhase::NEIGHBOURS);
     
     // Compute initial densities
+    FrameProfiler::begin(FramePhase::DENSITY);
     CLAllocator::fill_buffer(_pressures, 0.0f, _particle_count);
     _kernel_initial_density->run(_particle_count);
+    FrameProfiler::end(FramePhase::DENSITY);
 
     // Compute particles normals for the surface tension model
+    FrameProfiler::begin(FramePhase::FORCES);
     _kernel_normals->run(_particle_count);
 
     // Compute the initial forces: viscosity, surface tension, and
     // rigid body interaction
     CLAllocator::fill_buffer(_pressure_force, CL_FLOAT4_ZERO, _particle_count);
     _kernel_initial_forces->run(_particle_count);
+    FrameProfiler::end(FramePhase::FORCES);
 
+    FrameProfiler::begin(FramePhase::PRESSURE_SOLVE);
+    int iterations = 0;
     for (int i=1; i <= max_iter; ++i) {
+        iterations = i;
+
         // Predict the positions and velocities of the particles to
         // temporal buffers with the current forces
         _kernel_predict_pos->set_arg(4, &_positions_predicted);
@@ -146,89 +210,324 @@ void PCISPHSimulation::_simulate_pcisph_step(int min_iter, int max_iter) {
             }
         }
     }
+    FrameProfiler::end(FramePhase::PRESSURE_SOLVE);
+    FrameProfiler::count(FrameCounter::PCISPH_ITERATIONS, iterations);
+
+    // The particles are in the order the integration leaves them in the
+    // positions VBO, so the metrics match them
+    if (_metrics) {
+        _kernel_particle_metrics->run(_particle_count);
+    }
 
     // Update rigid bodies
+    FrameProfiler::begin(FramePhase::RIGID_COUPLING);
     _boundary_handler->apply_fluid_forces(_image_positions,
                                           _image_velocities,
                                           _image_densities,
                                           _image_pressures,
                                           _cell_intervals,
                                           _particle_mass);
+    FrameProfiler::end(FramePhase::RIGID_COUPLING);
 
     // Predict the velocities and positions with the final 
     // pressure force
+    FrameProfiler::begin(FramePhase::INTEGRATION);
     _kernel_predict_vel_n_pos->set_arg(4, &_positions_unsorted);
     _kernel_predict_vel_n_pos->set_arg(5, &_velocities_unsorted);
     _kernel_predict_vel_n_pos->run(_particle_count);
 
+    if (!_sinks.empty()) {
+        // The count is only needed by the next step, so it is not waited for
+        cl_int err = clEnqueueReadBuffer(CLEnvironment::queue(), _dead_count, CL_FALSE, 0, 
+                                         sizeof(cl_int), &_dead_count_host,
+                                         0, nullptr, &_dead_count_event);
+        CLError::check(err);
+        CLAllocator::fill_buffer<cl_int>(_dead_count, 0, 1);
+    }
+    FrameProfiler::end(FramePhase::INTEGRATION);
+
     CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
 }
 
-void PCISPHSimulation::_initialize_buffers() {
+void PCISPHSimulation::_emit_particles() {
+    float time = _step * _dt;
+    float particle_spacing = 2.0f * _particle_radius;
+    int emitted = 0;
+
+    for (auto& info : _emitter_infos) {
+        if (!info.emitter->is_active(time)) {
+            continue;
+        }
+
+        // A new layer once the last one has moved away a particle spacing
+        info.distance += info.emitter->speed() * _dt;
+        if (info.distance < particle_spacing) {
+            continue;
+        }
+
+        if (_particle_count + info.layer_size > _capacity) {
+            if (!info.exhausted) {
+                cout << "Emitter capacity used up, waiting for the sinks" << endl;
+                info.exhausted = true;
+            }
+            info.distance = particle_spacing;
+            continue;
+        }
+        info.exhausted = false;
+        info.distance -= particle_spacing;
+
+        if (emitted == 0) {
+            CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+        }
+        CLAllocator::copy_buffer_range<cl_float4>(info.positions, _positions_unsorted, 0, _particle_count, info.layer_size);
+        CLAllocator::copy_buffer_range<cl_float4>(info.velocities, _velocities_unsorted, 0, _particle_count, info.layer_size);
+        _particle_count += info.layer_size;
+        emitted += info.layer_size;
+    }
+
+    if (emitted > 0) {
+        CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+        _setup_fluid_params();
+    }
+}
+
+int PCISPHSimulation::_wait_dead_count() {
+    if (_dead_count_event) {
+        CLError::check(clWaitForEvents(1, &_dead_count_event));
+        clReleaseEvent(_dead_count_event);
+        _dead_count_event = nullptr;
+    }
+
+    int dead_count = _dead_count_host;
+    _dead_count_host = 0;
+    return dead_count;
+}
+
+int PCISPHSimulation::_emitters_capacity() const {
+    int capacity = 0;
+    for (auto& e : _emitters) {
+        capacity += e->max_particles(_particle_radius);
+    }
+    return capacity;
+}
+
+void PCISPHSimulation::_initialize_emitters() {
+    _release_emitters();
+
+    for (auto& e : _emitters) {
+        auto layer = e->layer(_particle_radius);
+        if (layer.empty()) {
+            continue;
+        }
+
+        _EmitterInfo info;
+        info.emitter = e;
+        info.layer_size = layer.size();
+        info.positions = CLAllocator::alloc_buffer<cl_float4>("solver/emitter_positions", layer.size(), layer);
+        info.velocities = CLAllocator::alloc_buffer<cl_float4>("solver/emitter_velocities", layer.size(), e->velocity());
+        // The first layer is emitted right away
+        info.distance = 2.0f * _particle_radius;
+        info.exhausted = false;
+        _emitter_infos.push_back(info);
+    }
+
+    vector<cl_float4> boxes;
+    for (auto& s : _sinks) {
+        boxes.push_back(s->min());
+        boxes.push_back(s->max());
+    }
+    if (!boxes.empty()) {
+        _sink_boxes = CLAllocator::alloc_buffer<cl_float4>("solver/sink_boxes", boxes.size(), boxes);
+    }
+
+    _dead_count = CLAllocator::alloc_buffer<cl_int>("solver/dead_count", 1, 0);
+    _dead_count_host = 0;
+}
+
+void PCISPHSimulation::_release_emitters() {
+    for (auto& info : _emitter_infos) {
+        CLAllocator::release_buffer(info.positions);
+        CLAllocator::release_buffer(info.velocities);
+    }
+    _emitter_infos.clear();
+
+    CLAllocator::release_buffer(_sink_boxes);
+    CLAllocator::release_buffer(_dead_count);
+    _sink_boxes = nullptr;
+    _dead_count = nullptr;
+
+    if (_dead_count_event) {
+        clReleaseEvent(_dead_count_event);
+        _dead_count_event = nullptr;
+    }
+}
+
+void PCISPHSimulation::_initialize_buffers(const VolumeFiller& filler) {
+    // Room is made for every particle, but the kernels only run over the
+    // generated ones until the given ones are added
+    _alloc_buffers(filler.particle_count());
+    _particle_count = filler.particle_count() - filler.given_particle_count();
+    _initialize_emitters();
+
+    // Generate the particles in the device buffers
+    if (_particle_count > 0) {
+        CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+        filler.fill_generated(_positions_unsorted);
+        CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+    }
+}
+
+void PCISPHSimulation::_alloc_buffers(int particle_count) {
+    _particle_count = particle_count;
+
+    // The emitters add particles into capacity reserved up front
+    int capacity = particle_count + _emitters_capacity();
+
+    // The buffers are kept if they can hold the particles, only the count
+    // the kernels run over changes
+    if (_capacity > 0 && capacity <= _capacity) {
+        CLAllocator::fill_buffer(_velocities_unsorted, CL_FLOAT4_ZERO, _capacity);
+        _alloc_cell_intervals();
+        return;
+    }
+
     // Wait to opengl to finish before resizing buffer
     OpenGLFunctions::getFunctions().glFinish();
 
     _release_buffers();
 
-    // Iterate over all volumes defined to obtain all particles
-    vector<cl_float4> fluid_particles;
-    for (auto v: _volumes) {
-        auto ps = v->particles(_particle_radius);
-        fluid_particles.insert(fluid_particles.end(), ps.begin(), ps.end());
-    }
-    _particle_count = fluid_particles.size();
+    _capacity = capacity;
 
-    _positions_unsorted = CLAllocator::alloc_gl_buffer<cl_float4>(_particle_count, _vbo_positions);
-    _positions_sorted = CLAllocator::alloc_buffer<cl_float4>(_particle_count);
-    _positions_predicted = CLAllocator::alloc_buffer<cl_float4>(_particle_count);
+    _positions_unsorted = CLAllocator::alloc_gl_buffer<cl_float4>("solver/positions", _capacity, _vbo_positions);
 
-    // Upload the particle positions to the device buffer
-    CLAllocator::upload_to_gl_buffer(fluid_particles, _positions_unsorted);
+    // Every other attribute is a sub-buffer of the arena
+    _arena.reserve<cl_float4>(&_positions_sorted, _capacity, "solver/positions_sorted");
+    _arena.reserve<cl_float4>(&_positions_predicted, _capacity, "solver/positions_predicted");
 
     // Initialize buffer for storing the hashes
-    _hashes = CLAllocator::alloc_buffer<cl_uint>(_particle_count);
+    _arena.reserve<cl_uint>(&_hashes, _capacity, "solver/hashes");
 
     // Initialize buffer mask
-    _mask = CLAllocator::alloc_buffer<cl_int>(_particle_count);
+    _arena.reserve<cl_int>(&_mask, _capacity, "solver/mask");
 
     // Initialize the buffers that hold the velocity of particles
-    _velocities_unsorted = CLAllocator::alloc_buffer<cl_float4>(_particle_count, CL_FLOAT4_ZERO);
-    _velocities_sorted = CLAllocator::alloc_buffer<cl_float4>(_particle_count);
-    _velocities_predicted = CLAllocator::alloc_buffer<cl_float4>(_particle_count);
-
-    _mass_densities = CLAllocator::alloc_buffer<cl_float>(_particle_count);
-    _mass_densities_predicted = CLAllocator::alloc_buffer<cl_float>(_particle_count);
-    _mass_density_variation = CLAllocator::alloc_buffer<cl_float>(_particle_count);
-    _pressures = CLAllocator::alloc_buffer<cl_float>(_particle_count);
-    _normals = CLAllocator::alloc_buffer<cl_float4>(_particle_count);
-
-    _particle_force = CLAllocator::alloc_buffer<cl_float4>(_particle_count);
-    _pressure_force = CLAllocator::alloc_buffer<cl_float4>(_particle_count);
-
-    // Now initialize the buffers related to holding particles neighbourhood
-    _cell_intervals = CLAllocator::alloc_buffer<cl_int2>(_grid->info().cells_count);
-
-    // Initialize the buffer to hold the neighbourhood for each particle
-    _neigh_list_length = CLAllocator::alloc_buffer<cl_int>(_particle_count);
-    _neighbourhood_list = CLAllocator::alloc_buffer<cl_int>(_particle_count * _max_neigh_list_length);
-
-    _sb_neigh_list_length = CLAllocator::alloc_buffer<cl_int>(_particle_count);
-    _sb_neigh_list = CLAllocator::alloc_buffer<cl_int>(_particle_count * _max_neigh_list_length);
-
-    _image_positions = CLAllocator::alloc_1d_image_from_buff(_particle_count, CL_RGBA, _positions_sorted);
-    _image_predicted_positions = CLAllocator::alloc_1d_image_from_buff(_particle_count, CL_RGBA, _positions_predicted);
-    _image_velocities = CLAllocator::alloc_1d_image_from_buff(_particle_count, CL_RGBA, _velocities_sorted);
-    _image_densities = CLAllocator::alloc_1d_image_from_buff(_particle_count, CL_R, _mass_densities);
-    _image_normals = CLAllocator::alloc_1d_image_from_buff(_particle_count, CL_RGBA, _normals);
-    _image_pressures = CLAllocator::alloc_1d_image_from_buff(_particle_count, CL_R, _pressures);
+    _arena.reserve<cl_float4>(&_velocities_unsorted, _capacity, "solver/velocities_unsorted");
+    _arena.reserve<cl_float4>(&_velocities_sorted, _capacity, "solver/velocities_sorted");
+    _arena.reserve<cl_float4>(&_velocities_predicted, _capacity, "solver/velocities_predicted");
+
+    _arena.reserve<cl_float>(&_mass_densities, _capacity, "solver/mass_densities");
+    _arena.reserve<cl_float>(&_mass_densities_predicted, _capacity, "solver/mass_densities_predicted");
+    _arena.reserve<cl_float>(&_mass_density_variation, _capacity, "solver/mass_density_variation");
+    _arena.reserve<cl_float>(&_pressures, _capacity, "solver/pressures");
+    _arena.reserve<cl_float4>(&_normals, _capacity, "solver/normals");
+
+    _arena.reserve<cl_float4>(&_particle_force, _capacity, "solver/particle_force");
+    _arena.reserve<cl_float4>(&_pressure_force, _capacity, "solver/pressure_force");
+
+    // Initialize the buffer to hold the length of the neighbourhood of 
+    // each particle. The lists and the cell intervals are allocated on
+    // their own
+    _arena.reserve<cl_int>(&_neigh_list_length, _capacity, "solver/neigh_list_length");
+    _arena.reserve<cl_int>(&_sb_neigh_list_length, _capacity, "solver/sb_neigh_list_length");
+
+    _arena.commit();
+
+    _alloc_neigh_lists();
+    _alloc_cell_intervals();
+
+    CLAllocator::fill_buffer(_velocities_unsorted, CL_FLOAT4_ZERO, _capacity);
+
+    _image_positions = CLAllocator::alloc_1d_image_from_buff(_capacity, CL_RGBA, _positions_sorted);
+    _image_predicted_positions = CLAllocator::alloc_1d_image_from_buff(_capacity, CL_RGBA, _positions_predicted);
+    _image_velocities = CLAllocator::alloc_1d_image_from_buff(_capacity, CL_RGBA, _velocities_sorted);
+    _image_densities = CLAllocator::alloc_1d_image_from_buff(_capacity, CL_R, _mass_densities);
+    _image_normals = CLAllocator::alloc_1d_image_from_buff(_capacity, CL_RGBA, _normals);
+    _image_pressures = CLAllocator::alloc_1d_image_from_buff(_capacity, CL_R, _pressures);
     
     // Reset and store the references to the shared GL buffers
     _gl_shared_buffers.clear();
     _gl_shared_buffers.push_back(_positions_unsorted);
+
+    _alloc_metrics();
+}
+
+void PCISPHSimulation::_alloc_neigh_lists() {
+    CLAllocator::release_buffer(_neighbourhood_list);
+    CLAllocator::release_buffer(_sb_neigh_list);
+
+    _neighbourhood_list = CLAllocator::alloc_buffer<cl_int>("solver/neighbourhood_list", _capacity * _max_neigh_list_length);
+    _sb_neigh_list = CLAllocator::alloc_buffer<cl_int>("solver/sb_neigh_list", _capacity * _max_sb_neigh_list_length);
+}
+
+void PCISPHSimulation::_alloc_cell_intervals() {
+    int cells_count = _grid->info().cells_count;
+    if (_cell_intervals && cells_count == _cell_intervals_count) {
+        return;
+    }
+
+    CLAllocator::release_buffer(_cell_intervals);
+    _cell_intervals = CLAllocator::alloc_buffer<cl_int2>("grid/cell_intervals", cells_count);
+    _cell_intervals_count = cells_count;
+}
+
+void PCISPHSimulation::_fit_neigh_lists() {
+    int length = _grid->fit_list_length(NeighbourList::FLUID, _max_neigh_list_length);
+    int sb_length = _grid->fit_list_length(NeighbourList::BOUNDARY, _max_sb_neigh_list_length);
+    if (length == _max_neigh_list_length && sb_length == _max_sb_neigh_list_length) {
+        return;
+    }
+
+    cout << "Resizing neighbourhood lists to " << length << " fluid and " 
+         << sb_length << " boundary neighbours" << endl;
+
+    // The queue is in order, so the kernels of the last step are done
+    // with the lists before anything reuses them
+    _max_neigh_list_length = length;
+    _max_sb_neigh_list_length = sb_length;
+    _alloc_neigh_lists();
+
+    // The lists are built next, so every kernel must see the new ones
+    _setup_kernel_params();
+}
+
+void PCISPHSimulation::_alloc_metrics() {
+    if (_vbo_metrics == 0 || _capacity <= 0) {
+        return;
+    }
+
+    _metrics = CLAllocator::alloc_gl_buffer<cl_float4>("solver/particle_metrics", _capacity, _vbo_metrics);
+    _gl_shared_buffers.push_back(_metrics);
+}
+
+bool PCISPHSimulation::set_metrics_buffer(GLuint vbo) {
+    if (vbo == _vbo_metrics) {
+        return true;
+    }
+
+    if (_metrics) {
+        // Wait to opengl to finish before releasing the shared buffer
+        OpenGLFunctions::getFunctions().glFinish();
+
+        _gl_shared_buffers.erase(remove(_gl_shared_buffers.begin(), _gl_shared_buffers.end(), _metrics),
+                                 _gl_shared_buffers.end());
+        CLAllocator::release_buffer(_metrics);
+        _metrics = nullptr;
+    }
+
+    _vbo_metrics = vbo;
+    _alloc_metrics();
+
+    if (_metrics && _kernel_particle_metrics) {
+        _setup_kernel_params();
+    }
+    return true;
 }
 
 void PCISPHSimulation::_initialize_params(const PhysicsSettings& fluid_settings,
                                           const SimulationSettings& sim_settings) {
+    _fluid_settings = fluid_settings;
+    _sim_settings = sim_settings;
+
     _dt = sim_settings.time_step;
     _max_vel = sim_settings.max_vel;
     _max_iterations = sim_settings.pcisph_max_iterations;
@@ -265,8 +564,27 @@ void PCISPHSimulation::reset(const PhysicsSettings& fluid_settings,
     _initialize_solver();
 }
 
+bool PCISPHSimulation::update_settings(const PhysicsSettings& fluid_settings,
+                                       const SimulationSettings& sim_settings) {
+    // The radii set the lattice, the grid and the compiled kernels
+    if (sim_settings.fluid_particle_radius != _particle_radius ||
+        sim_settings.fluid_support_radius != _support_radius) {
+        return false;
+    }
+
+    _initialize_params(fluid_settings, sim_settings);
+    _boundary_handler->set_rest_density(_rest_density);
+
+    // It depends on the time step and the particle mass
+    _deduce_density_scale_factor();
+
+    _setup_kernel_params();
+
+    return true;
+}
+
 void PCISPHSimulation::_setup_kernel_params() {   
-    if (_particle_count <= 0) {
+    if (_capacity <= 0) {
         cout << "No fluid particles, skiping kernel params setup" << endl;
         return;
     }
@@ -333,6 +651,11 @@ void PCISPHSimulation::_setup_kernel_params() {
     _kernel_predict_vel_n_pos->set_arg(7, &_g);
     _kernel_predict_vel_n_pos->set_arg(8, &_max_vel);
     _kernel_predict_vel_n_pos->set_arg(9, &_container_size);
+    // Without sinks, something is bound so that the kernel does not fail
+    cl_int sink_count = _sinks.size();
+    _kernel_predict_vel_n_pos->set_arg(11, _sink_boxes ? &_sink_boxes : &_positions_sorted);
+    _kernel_predict_vel_n_pos->set_arg(12, &sink_count);
+    _kernel_predict_vel_n_pos->set_arg(13, &_dead_count);
 
     _kernel_predict_pos->set_arg(0, &_positions_sorted);
     _kernel_predict_pos->set_arg(1, &_velocities_sorted);
@@ -390,6 +713,33 @@ void PCISPHSimulation::_setup_kernel_params() {
     _kernel_compute_pressure_force->set_local_buffer(12, sizeof(cl_float4));
     _kernel_compute_pressure_force->set_local_buffer(13, sizeof(cl_float));
     _kernel_compute_pressure_force->set_local_buffer(14, sizeof(cl_float));
+
+    _kernel_particle_metrics->set_arg(0, &_neigh_list_length);
+    _kernel_particle_metrics->set_arg(1, &_sb_neigh_list_length);
+    _kernel_particle_metrics->set_arg(2, &_mass_density_variation);
+    if (_metrics) {
+        _kernel_particle_metrics->set_arg(3, &_metrics);
+    }
+    _kernel_particle_metrics->set_arg(4, &_max_neigh_list_length);
+    _kernel_particle_metrics->set_arg(5, &_max_sb_neigh_list_length);
+
+    _setup_fluid_params();
+}
+
+void PCISPHSimulation::_setup_fluid_params() {
+    FluidParams fluid;
+    fluid.particle_count = _particle_count;
+    fluid.particle_mass = _particle_mass;
+    fluid.rest_density = _rest_density;
+
+    _kernel_initial_density->set_arg(10, &fluid);
+    _kernel_normals->set_arg(8, &fluid);
+    _kernel_initial_forces->set_arg(16, &fluid);
+    _kernel_predict_vel_n_pos->set_arg(10, &fluid);
+    _kernel_predict_pos->set_arg(9, &fluid);
+    _kernel_update_pressure->set_arg(12, &fluid);
+    _kernel_compute_pressure_force->set_arg(15, &fluid);
+    _kernel_particle_metrics->set_arg(6, &fluid);
 }
 
 void PCISPHSimulation::_release_buffers() {
@@ -401,28 +751,27 @@ void PCISPHSimulation::_release_buffers() {
     CLAllocator::release_buffer(_image_pressures);
 
     CLAllocator::release_buffer(_positions_unsorted);
-    CLAllocator::release_buffer(_positions_sorted);
-    CLAllocator::release_buffer(_positions_predicted);
-    CLAllocator::release_buffer(_hashes);
-    CLAllocator::release_buffer(_mask);
-    CLAllocator::release_buffer(_velocities_unsorted);
-    CLAllocator::release_buffer(_velocities_sorted);
-    CLAllocator::release_buffer(_velocities_predicted);
-    CLAllocator::release_buffer(_mass_densities);
-    CLAllocator::release_buffer(_mass_densities_predicted);
-    CLAllocator::release_buffer(_mass_density_variation);
-    CLAllocator::release_buffer(_pressures);
-    CLAllocator::release_buffer(_particle_force);
-    CLAllocator::release_buffer(_pressure_force);
-    CLAllocator::release_buffer(_cell_intervals);
-    CLAllocator::release_buffer(_neigh_list_length);
+    _positions_unsorted = nullptr;
+
+    if (_metrics) {
+        CLAllocator::release_buffer(_metrics);
+        _metrics = nullptr;
+    }
+
     CLAllocator::release_buffer(_neighbourhood_list);
-    CLAllocator::release_buffer(_normals);
     CLAllocator::release_buffer(_sb_neigh_list);
-    CLAllocator::release_buffer(_sb_neigh_list_length);
+    _neighbourhood_list = nullptr;
+    _sb_neigh_list = nullptr;
+
+    CLAllocator::release_buffer(_cell_intervals);
+    _cell_intervals = nullptr;
+    _cell_intervals_count = 0;
+
+    _arena.release();
 }
 
 PCISPHSimulation::~PCISPHSimulation() {
+    _release_emitters();
     _release_buffers();
 }
 
@@ -482,12 +831,27 @@ void PCISPHSimulation::add_boundary(const shared_ptr<RigidBody> boundary,
                                     boundary_id, 
                                     can_move);
 
+    if (_batching) {
+        _pending_kernels = true;
+        return;
+    }
+
     // We reset all kernel params so that the static boundary buffers are
     // updated
     _build_kernels();
 }
 
 void PCISPHSimulation::_build_kernels() {
+    // The particle count, mass and rest density are kernel arguments, so
+    // the program only depends on the support radius and the boundary
+    bool compute_boundary = _boundary_handler->particle_count() > 0;
+    if (_program &&
+        _program_support_radius == _support_radius &&
+        _program_computes_boundary == compute_boundary) {
+        _setup_kernel_params();
+        return;
+    }
+
     // First, the program must be compiled
     CLCompiler compiler;
     compiler.add_file_source("kernels/pcisph.cl");
@@ -498,17 +862,16 @@ void PCISPHSimulation::_build_kernels() {
     compiler.add_include_path("kernels");
     
     // Define the constants for the program
-    compiler.define_constant("PARTICLE_COUNT", _particle_count);
     compiler.define_constant("SUPPORT_RADIUS", _support_radius);
-    compiler.define_constant("PARTICLE_MASS", _particle_mass);
-    compiler.define_constant("REST_DENSITY", _rest_density);
     compiler.define_constant("USE_MULLER_KERNELS");
-    if (_boundary_handler->particle_count()) {
+    if (compute_boundary) {
         compiler.define_constant("COMPUTE_BOUNDARY", 1);
     }
 
     // Compile!
     _program = compiler.build();
+    _program_support_radius = _support_radius;
+    _program_computes_boundary = compute_boundary;
 
     // Now reinitialize all kernel instances
     _kernel_initial_density = _program->get_kernel("compute_initial_density");
@@ -518,6 +881,7 @@ void PCISPHSimulation::_build_kernels() {
     _kernel_update_pressure = _program->get_kernel("update_pressure");
     _kernel_compute_pressure_force = _program->get_kernel("compute_pressure_force");
     _kernel_normals = _program->get_kernel("compute_normals");
+    _kernel_particle_metrics = _program->get_kernel("write_particle_metrics");
 
     _setup_kernel_params();
 }
@@ -525,18 +889,73 @@ void PCISPHSimulation::_build_kernels() {
 void PCISPHSimulation::add_volume(const std::shared_ptr<FluidVolume> volume) {
     _volumes.push_back(volume);
 
+    if (_batching) {
+        _pending_solver_init = true;
+        return;
+    }
+
     // Reinitialize the whole solver to hold the new particles
     _initialize_solver();
 }
 
+void PCISPHSimulation::add_emitter(const shared_ptr<FluidEmitter> emitter) {
+    _emitters.push_back(emitter);
+
+    if (_batching) {
+        _pending_solver_init = true;
+        return;
+    }
+
+    // The capacity reserved for the emitters changed
+    _initialize_solver();
+}
+
+void PCISPHSimulation::add_sink(const shared_ptr<FluidSink> sink) {
+    _sinks.push_back(sink);
+
+    if (_batching) {
+        _pending_solver_init = true;
+        return;
+    }
+
+    _initialize_solver();
+}
+
+void PCISPHSimulation::begin_batch() {
+    _batching = true;
+    _boundary_handler->begin_batch();
+}
+
+void PCISPHSimulation::commit() {
+    if (!_batching) {
+        return;
+    }
+    _batching = false;
+
+    // All new boundaries are sampled in a single pass
+    _boundary_handler->commit();
+
+    // Initializing the solver also builds the kernels
+    if (_pending_solver_init) {
+        _initialize_solver();
+    }
+    else if (_pending_kernels) {
+        _build_kernels();
+    }
+
+    _pending_solver_init = false;
+    _pending_kernels = false;
+}
+
 void PCISPHSimulation::_initialize_solver() {
     // Reset grid cell size with the new support radius
     _grid->set_cell_size(_support_radius);
 
     // Reinitialize all buffers
-    _initialize_buffers();
+    VolumeFiller filler(_volumes, _particle_radius);
+    _initialize_buffers(filler);
 
-    // Rebuild all kernels
+    // Rebuild the kernels, if anything compiled in changed
     _build_kernels();
 
     // Deduce the density variation scaling factor of PCISPH algorithm
@@ -547,7 +966,22 @@ void PCISPHSimulation::_initialize_solver() {
 
     // Relax particle position, and reset velocities
     _simulate_pcisph_step(_min_iterations, 10000);
-    CLAllocator::fill_buffer(_velocities_unsorted, CL_FLOAT4_ZERO, _particle_count);
+    if (_capacity > 0) {
+        CLAllocator::fill_buffer(_velocities_unsorted, CL_FLOAT4_ZERO, _capacity);
+    }
+
+    // Particles given as they are keep their positions and velocities, they
+    // go after the relaxed ones
+    int given_count = filler.given_particle_count();
+    if (given_count > 0) {
+        CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+        filler.fill_given(_positions_unsorted, _velocities_unsorted, _particle_count);
+        CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+        _particle_count += given_count;
+        _setup_fluid_params();
+    }
+
+    _step = 0;
 }
 
 int PCISPHSimulation::boundary_particle_count() const {
@@ -561,4 +995,135 @@ void PCISPHSimulation::set_rect_limits(float width, float height, float depth) {
     _container_size.s[3] = 0.0f;
 
     _setup_kernel_params();
-}
\ No newline at end of file
+}
+
+void PCISPHSimulation::save_checkpoint(const string& path) {
+    cout << "Saving checkpoint to " << path << "..." << flush;
+
+    // After a step, the unsorted buffers hold the particles in the order of 
+    // the last sort, the same order of the pressures buffer
+    CheckpointWriter writer(_fluid_settings, _sim_settings, _step);
+    writer.set_container_size(_container_size);
+    writer.add_buffer<cl_float4>(CHECKPOINT_POSITIONS, _positions_unsorted, _particle_count);
+    writer.add_buffer<cl_float4>(CHECKPOINT_VELOCITIES, _velocities_unsorted, _particle_count);
+    writer.add_buffer<cl_float>(CHECKPOINT_PRESSURES, _pressures, _particle_count);
+    writer.add_bodies(_boundary_handler->bodies_state());
+
+    CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+    try {
+        writer.write(path);
+    }
+    catch (...) {
+        CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+        throw;
+    }
+    CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+
+    cout << "done!" << endl;
+}
+
+void PCISPHSimulation::load_checkpoint(const string& path) {
+    cout << "Loading checkpoint from " << path << "..." << flush;
+
+    CheckpointReader reader(path);
+    auto& header = reader.header();
+    if (header.sim_method != SimulationSettings::Method::PCISPH) {
+        throw RunTimeException("Checkpoint " + path + " was not saved by a PCISPH solver");
+    }
+
+    // Every section is checked before the solver is touched
+    reader.require<cl_float4>(CHECKPOINT_POSITIONS, header.particle_count);
+    reader.require<cl_float4>(CHECKPOINT_VELOCITIES, header.particle_count);
+    if (reader.has_section(CHECKPOINT_PRESSURES)) {
+        reader.require<cl_float>(CHECKPOINT_PRESSURES, header.particle_count);
+    }
+
+    // Restore the settings the checkpoint was taken with
+    _initialize_params(reader.physics_settings(), reader.simulation_settings());
+    _container_size = reader.container_size();
+
+    _boundary_handler->set_particle_radius(_particle_radius);
+    _boundary_handler->set_support_radius(_support_radius);
+    _grid->set_cell_size(_support_radius);
+
+    // Allocate the buffers, and fill them straight from the mapped file
+    _alloc_buffers(header.particle_count);
+    _initialize_emitters();
+
+    CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+    try {
+        reader.upload<cl_float4>(CHECKPOINT_POSITIONS, _positions_unsorted);
+
+        // Particles killed by a sink in the step before the checkpoint are 
+        // still there, the first step drops them
+        if (!_sinks.empty() && _particle_count > 0) {
+            auto positions = CLAllocator::download_buffer<cl_float4>(_positions_unsorted, _particle_count);
+            _dead_count_host = count_if(positions.begin(), positions.end(), 
+                                        [](const cl_float4& p) { return p.s[3] == 0.0f; });
+        }
+    }
+    catch (...) {
+        CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+        throw;
+    }
+    CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+
+    reader.upload<cl_float4>(CHECKPOINT_VELOCITIES, _velocities_unsorted);
+    if (reader.has_section(CHECKPOINT_PRESSURES)) {
+        reader.upload<cl_float>(CHECKPOINT_PRESSURES, _pressures);
+    }
+
+    // Put the rigid bodies back where they were
+    _boundary_handler->restore_bodies_state(reader.bodies());
+
+    // No relaxation step here, the particles are already in a valid state
+    _build_kernels();
+    _deduce_density_scale_factor();
+    _setup_kernel_params();
+
+    _step = header.step;
+
+    cout << "done!" << endl;
+}
+
+void PCISPHSimulation::download_particles(cl_float4* positions,
+                                          cl_float4* velocities,
+                                          cl_float* densities,
+                                          cl_event* event) {
+    // The reads are enqueued before the release of the shared buffers, so the
+    // in-order queue keeps the positions valid until they are copied
+    CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+
+    auto queue = CLEnvironment::queue();
+    cl_int err = clEnqueueReadBuffer(queue, _positions_unsorted, CL_FALSE, 0,
+                                     sizeof(cl_float4) * _particle_count, positions,
+                                     0, nullptr, nullptr);
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(queue, _velocities_unsorted, CL_FALSE, 0,
+                                  sizeof(cl_float4) * _particle_count, velocities,
+                                  0, nullptr, nullptr);
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(queue, _mass_densities, CL_FALSE, 0,
+                                  sizeof(cl_float) * _particle_count, densities,
+                                  0, nullptr, event);
+    }
+
+    CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+    CLError::check(err);
+}
+
+vector<CheckpointBody> PCISPHSimulation::bodies_state() const {
+    return _boundary_handler->bodies_state();
+}
+
+bool PCISPHSimulation::particle_grid(ParticleGrid& particles) const {
+    particles.positions = _positions_sorted;
+    particles.cell_intervals = _cell_intervals;
+    particles.grid_info = _grid->info();
+    particles.particle_count = _particle_count;
+    particles.particle_mass = _particle_mass;
+    particles.rest_density = _rest_density;
+    particles.support_radius = _support_radius;
+    return true;
+}
@@ -16,10 +16,12 @@
 
 #include "opencl/clenvironment.h"
 #include "opencl/clcompiler.h"
+#include "opencl/clarena.h"
 #include "opengl/openglfunctions.h"
 #include "fluidsimulation.h"
 #include "grid.h"
 #include "boundaryhandler.h"
+#include "volumefiller.h"
 #include "kernels/common.h"
 #include "mullerconstants.h"
 
@@ -57,6 +59,19 @@ class PCISPHSimulation : public FluidSimulation {
         void reset(const PhysicsSettings& fluid_settings,
                    const SimulationSettings& sim_settings);
 
+        /**
+         * @brief Updates the settings of the running simulation
+         * @details Coefficients are set as kernel arguments, keeping the
+         *          state of the fluid. Changing a radius needs a reset.
+         *
+         * @param fluid_settings Physical properties of the fluid.
+         * @param sim_settings Parameters of the simulation.
+         * @return True if the settings were applied, false if they need a
+         *         reset.
+         */
+        bool update_settings(const PhysicsSettings& fluid_settings,
+                             const SimulationSettings& sim_settings);
+
         /**
          * @brief Returs the number of particles used by the solver.
          * @return The count of particles being used in the simulation.
@@ -87,6 +102,31 @@ class PCISPHSimulation : public FluidSimulation {
          */
         void add_volume(const std::shared_ptr<FluidVolume> volume);
 
+        /**
+         * @brief Adds an inflow of fluid to the simulation
+         * 
+         * @param emitter An instance of a fluid emitter.
+         */
+        void add_emitter(const std::shared_ptr<FluidEmitter> emitter);
+
+        /**
+         * @brief Adds an outflow of fluid to the simulation
+         * 
+         * @param sink An instance of a fluid sink.
+         */
+        void add_sink(const std::shared_ptr<FluidSink> sink);
+
+        /**
+         * @brief Starts a batch of volumes and boundaries
+         */
+        void begin_batch();
+
+        /**
+         * @brief Samples the new boundaries, and initializes the solver 
+         *        once for everything added since begin_batch
+         */
+        void commit();
+
         /**
          * @brief Sets the limits of a rectangular container where the 
          * simulation takes place
@@ -97,10 +137,77 @@ class PCISPHSimulation : public FluidSimulation {
          */
         void set_rect_limits(float width, float height, float depth);
 
+        /**
+         * @brief Returns the number of steps simulated since the last reset
+         */
+        unsigned long step_count() const;
+
+        /**
+         * @brief Saves the full state of the solver to a checkpoint file
+         * 
+         * @param path The path of the checkpoint file.
+         */
+        void save_checkpoint(const std::string& path);
+
+        /**
+         * @brief Restores the full state of the solver from a checkpoint file
+         * 
+         * @param path The path of the checkpoint file.
+         */
+        void load_checkpoint(const std::string& path);
+
+        /**
+         * @brief Enqueues the non blocking download of the particles state
+         * 
+         * @param positions Destination of the particle positions.
+         * @param velocities Destination of the particle velocities.
+         * @param densities Destination of the particle densities.
+         * @param event Returns an event that completes with the last read.
+         */
+        void download_particles(cl_float4* positions,
+                                cl_float4* velocities,
+                                cl_float* densities,
+                                cl_event* event);
+
+        /**
+         * @brief Returns the state of every rigid body coupled with the fluid
+         */
+        std::vector<CheckpointBody> bodies_state() const;
+
+        /**
+         * @brief Returns the particles as binned by the last step
+         */
+        bool particle_grid(ParticleGrid& particles) const;
+
+        /**
+         * @brief Sets the OpenGL buffer the costs of the particles are
+         *        written to, after the pressure solve of every step
+         * 
+         * @param vbo The buffer, or zero to stop writing the metrics.
+         * @return Always true.
+         */
+        bool set_metrics_buffer(GLuint vbo);
+
     private:
         // The number of particles of the simulation
         int _particle_count;
 
+        // The number of particles the buffers can hold. The kernels run
+        // over the first _particle_count only
+        int _capacity;
+
+        // The number of steps simulated since the last reset
+        unsigned long _step;
+
+        // Set while a batch is being added, and what must be done on commit
+        bool _batching;
+        bool _pending_solver_init;
+        bool _pending_kernels;
+
+        // A copy of the settings the solver was initialized with
+        PhysicsSettings _fluid_settings;
+        SimulationSettings _sim_settings;
+
         // Uniform grid
         std::unique_ptr<Grid> _grid;
 
@@ -110,6 +217,33 @@ class PCISPHSimulation : public FluidSimulation {
         // A collection of fluid volumes
         std::vector<std::shared_ptr<FluidVolume> > _volumes;
 
+        // Inflows and outflows of fluid
+        std::vector<std::shared_ptr<FluidEmitter> > _emitters;
+        std::vector<std::shared_ptr<FluidSink> > _sinks;
+
+        struct _EmitterInfo {
+            std::shared_ptr<FluidEmitter> emitter;
+            // A layer of particles, copied to the end of the fluid buffers
+            // on every emission
+            cl_mem positions;
+            cl_mem velocities;
+            int layer_size;
+            // The distance the last layer has moved since it was emitted
+            float distance;
+            // Set while there is no capacity left to emit
+            bool exhausted;
+        };
+        std::vector<_EmitterInfo> _emitter_infos;
+
+        // The lowest and highest corners of every sink
+        cl_mem _sink_boxes;
+
+        // The number of particles that entered a sink in the last step. It 
+        // is read without blocking, and only waited for by the next step
+        cl_mem _dead_count;
+        cl_int _dead_count_host;
+        cl_event _dead_count_event;
+
         ///////////////////////////////////////////////////////////////
         /// MEMORY BUFFERS DECLARATIONS ///////////////////////////////
         ///////////////////////////////////////////////////////////////
@@ -119,17 +253,27 @@ class PCISPHSimulation : public FluidSimulation {
         // particles on each simulation step
         GLuint _vbo_positions;
 
+        // Opengl vbo for the costs of the particles, zero if they are not
+        // written
+        GLuint _vbo_metrics;
+
         // OpenGL-OpenCL shared resources list. We collect here all the 
         // shared buffers references to aquire-release all of them at the same
         // time
         std::vector<cl_mem> _gl_shared_buffers;
 
+        // Holds every buffer of the particles, but the shared positions
+        CLArena _arena;
+
         // These two buffers are the memory buffers to store particles
         // positions. The memory is shared with the opengl VBO's
         cl_mem _positions_unsorted;
         cl_mem _positions_sorted;
         cl_mem _positions_predicted;
 
+        // The costs of the particles, shared with the metrics VBO
+        cl_mem _metrics;
+
         // This buffer is used to store the particles hashes. Hashes
         // are computed for each particle using the particle's position.
         // Then the position buffer is sorted according to this buffer
@@ -177,16 +321,22 @@ class PCISPHSimulation : public FluidSimulation {
         // to the cell. If the cell holds no particles, then a=0 and b=0
         cl_mem _cell_intervals;
 
+        // The number of cells the intervals were allocated for. The grid
+        // changes with the support radius, while the particle buffers may
+        // be kept
+        int _cell_intervals_count;
+
         // A buffer that, for every position, has the size of the 
         // neighbourhood list.
         cl_mem _neigh_list_length;
 
         // A buffer that holds, for each particles, a list of indices
         // of the particles in the neighbourhood. It is made of 
-        // #particles * max_neigh_list
+        // #particles * max_neigh_list. It is not in the arena, as it is
+        // resized on its own
         cl_mem _neighbourhood_list;
 
-        // Neigh list for static boundaries
+        // Neigh list for static boundaries, also resized on its own
         cl_mem _sb_neigh_list;
         cl_mem _sb_neigh_list_length;
 
@@ -201,6 +351,11 @@ class PCISPHSimulation : public FluidSimulation {
         ///////////////////////////////////////////////////////////////
 
         std::unique_ptr<CLProgram> _program;
+        // The values compiled into the program. Anything else is passed
+        // as a kernel argument, so it is only rebuilt when these change
+        float _program_support_radius;
+        bool _program_computes_boundary;
+
         std::shared_ptr<CLKernel> _kernel_initial_density;
         std::shared_ptr<CLKernel> _kernel_initial_forces;
         std::shared_ptr<CLKernel> _kernel_initial_st;
@@ -210,6 +365,7 @@ class PCISPHSimulation : public FluidSimulation {
         std::shared_ptr<CLKernel> _kernel_update_pressure;
         std::shared_ptr<CLKernel> _kernel_compute_pressure_force;
         std::shared_ptr<CLKernel> _kernel_compute_boundary_phi;
+        std::shared_ptr<CLKernel> _kernel_particle_metrics;
 
         ///////////////////////////////////////////////////////////////
         /// SIMULATION PARAMETERS /////////////////////////////////////
@@ -247,8 +403,10 @@ class PCISPHSimulation : public FluidSimulation {
         size_t _kernel_local_size;
 
         // For each particle, this is the maximum particles in the
-        // neighbourhood to look at (and save)
-        const int _max_neigh_list_length = NEIGH_LIST_MAX_LENGTH;
+        // neighbourhood to look at (and save), for the fluid and the 
+        // boundary lists. They are fitted to the scene as it runs
+        int _max_neigh_list_length;
+        int _max_sb_neigh_list_length;
 
         // 
         const int _min_iterations = 3;
@@ -278,15 +436,91 @@ class PCISPHSimulation : public FluidSimulation {
         /**
          * @brief Initializes the internal device buffers according to the 
          * fluid particle count
+         * @details Only the particles the filler generates are written.
+         *          Those given as they are, like a previous run read from a
+         *          file, already hold a state worth keeping, so they are
+         *          added after the relaxation.
+         *
+         * @param filler The particles of the volumes.
+         */
+        void _initialize_buffers(const VolumeFiller& filler);
+
+        /**
+         * @brief Sets the live fluid particle count, allocating the internal
+         *        device buffers only if they can not hold that many
+         * @details The buffers are never shrunk. Their contents are not
+         *          kept, and velocities are reset to zero.
+         * 
+         * @param particle_count The number of fluid particles
+         */
+        void _alloc_buffers(int particle_count);
+
+        /**
+         * @brief Shares the metrics VBO with OpenCL, sized to the capacity,
+         *        if there is one
+         */
+        void _alloc_metrics();
+
+        /**
+         * @brief (Re)Allocates the neighbourhood lists for the capacity, 
+         *        with their current length
+         */
+        void _alloc_neigh_lists();
+
+        /**
+         * @brief (Re)Allocates the cell intervals if the cells of the grid
+         *        changed
+         */
+        void _alloc_cell_intervals();
+
+        /**
+         * @brief Grows the neighbourhood lists if a particle had more 
+         *        neighbours than fit, or shrinks them if they are too long
+         * @details The statistics are read without blocking, so this is
+         *          decided with those of a step or so behind.
          */
-        void _initialize_buffers();
+        void _fit_neigh_lists();
 
         /**
-         * @brief Rebuilds the OpenCL program, and reinitializes
-         *        all the kernels
+         * @brief Rebuilds the OpenCL program if the compiled in values
+         *        changed, and sets up all the kernel params
          */ 
         void _build_kernels();
 
+        /**
+         * @brief Sets the FluidParams argument of every kernel, the
+         *        particle count, mass and rest density
+         */
+        void _setup_fluid_params();
+
+        /**
+         * @brief Uploads a layer of every emitter, and the sink boxes
+         */
+        void _initialize_emitters();
+
+        /**
+         * @brief Releases the emitters and sinks device buffers
+         */
+        void _release_emitters();
+
+        /**
+         * @brief Returns the capacity reserved for all the emitters
+         */
+        int _emitters_capacity() const;
+
+        /**
+         * @brief Appends a layer of particles for every emitter due
+         * @details The layers are device to device copies to the end of
+         *          the live particles, within the reserved capacity.
+         */
+        void _emit_particles();
+
+        /**
+         * @brief Waits for the count of particles killed by the sinks in
+         *        the last step, and resets it
+         */
+        int _wait_dead_count();
+
         /**
          * @brief [brief description]
          * @details [long description]
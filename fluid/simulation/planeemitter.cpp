@@ -0,0 +1,46 @@
+#include "planeemitter.h"
+
+#include <cmath>
+
+using namespace std;
+
+PlaneEmitter::PlaneEmitter(const btVector3& center, 
+                           const btVector3& direction, 
+                           float speed,
+                           float width,
+                           float height) :
+FluidEmitter(center, direction, speed),
+_width(width),
+_height(height) {
+
+}
+
+vector<cl_float4> PlaneEmitter::layer(float particle_radius) const {
+    vector<cl_float4> particles;
+
+    btVector3 u, v;
+    _plane_axes(u, v);
+
+    float particle_spacing = 2 * particle_radius;
+    int ppside_u = ceil(_width / particle_spacing);
+    int ppside_v = ceil(_height / particle_spacing);
+    float delta_u = _width / ppside_u;
+    float delta_v = _height / ppside_v;
+
+    for (int i=0; i<ppside_u; ++i) {
+        for (int j=0; j<ppside_v; ++j) {
+            float x = (i + 0.5f) * delta_u - _width / 2.0f;
+            float y = (j + 0.5f) * delta_v - _height / 2.0f;
+
+            auto pos = _center + x * u + y * v;
+            cl_float4 p;
+            p.s[0] = pos.getX();
+            p.s[1] = pos.getY();
+            p.s[2] = pos.getZ();
+            p.s[3] = 1; // Homogeneous system
+            particles.push_back(p);
+        }
+    }
+
+    return particles;
+}
@@ -0,0 +1,26 @@
+#ifndef _PLANE_EMITTER_H_
+#define _PLANE_EMITTER_H_
+
+#include "fluidemitter.h"
+
+/**
+ * @class PlaneEmitter
+ * @brief Emits the fluid through a rectangle
+ */
+class PlaneEmitter : public FluidEmitter {
+
+    public:
+        PlaneEmitter(const btVector3& center, 
+                     const btVector3& direction, 
+                     float speed,
+                     float width,
+                     float height);
+
+        std::vector<cl_float4> layer(float particle_radius) const;
+
+    private:
+        float _width, _height;
+
+};
+
+#endif // _PLANE_EMITTER_H_
@@ -0,0 +1,155 @@
+#include "poissondisksampling.h"
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+// Candidates spread per expected sample. More gets closer to a maximal
+// sampling, at a linear cost
+#define CANDIDATES_PER_SAMPLE   10
+
+// Samples conflict if closer than the min distance and their normals are
+// less than 120 degrees apart, so both sides of thin parts are sampled but
+// the faces around a sharp edge are not oversampled
+#define MIN_NORMAL_DOT          (-0.5f)
+
+// The min distance between samples, relative to the particle spacing. At
+// one spacing the boundary density a fluid particle sees on the bunny is
+// off by 9% on average, and up to 50%, against a dense sampling. At half a
+// spacing it is off by 3%, and up to 17%
+#define MIN_DISTANCE_FACTOR     0.5f
+
+// Fixed, so the same mesh always gives the same sampling
+#define SAMPLING_SEED           5489u
+
+static uint64_t cell_key(int x, int y, int z) {
+    return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+}
+
+vector<btVector3> poisson_disk_sampling(const Mesh& mesh,
+                                        float particle_spacing,
+                                        float inset) {
+    vector<btVector3> sampling;
+    float min_distance = MIN_DISTANCE_FACTOR * particle_spacing;
+
+    auto vertices = mesh.vertices();
+    auto normals = mesh.normals();
+    auto indices = mesh.mesh_indices();
+    size_t triangle_count = mesh.indices_count() / 3;
+
+    auto vertex = [&](mesh_index i) {
+        return btVector3(vertices[3*i + 0], vertices[3*i + 1], vertices[3*i + 2]);
+    };
+    auto normal = [&](mesh_index i) {
+        return btVector3(normals[3*i + 0], normals[3*i + 1], normals[3*i + 2]);
+    };
+
+    // Areas and normals of the triangles. The normal of the mesh is used for
+    // its orientation, and the geometric one where it is missing
+    vector<float> areas(triangle_count);
+    vector<btVector3> triangle_normals(triangle_count);
+    float total_area = 0.0f;
+    for (size_t t = 0; t < triangle_count; ++t) {
+        auto a = vertex(indices[3*t + 0]);
+        auto b = vertex(indices[3*t + 1]);
+        auto c = vertex(indices[3*t + 2]);
+        auto n = (b - a).cross(c - a);
+        areas[t] = 0.5f * n.length();
+        total_area += areas[t];
+
+        auto mesh_n = normal(indices[3*t + 0]) + normal(indices[3*t + 1]) + normal(indices[3*t + 2]);
+        if (mesh_n.length2() > 0.0f) {
+            triangle_normals[t] = mesh_n.normalize();
+        }
+        else if (areas[t] > 0.0f) {
+            triangle_normals[t] = n.normalize();
+        }
+        else {
+            triangle_normals[t] = btVector3(0, 0, 0);
+        }
+    }
+
+    if (total_area <= 0.0f || min_distance <= 0.0f) {
+        return sampling;
+    }
+
+    // Spread the candidates, each triangle gets its share by area
+    default_random_engine generator(SAMPLING_SEED);
+    uniform_real_distribution<float> rnd(0, 1);
+
+    float candidates_per_area = CANDIDATES_PER_SAMPLE / (min_distance * min_distance);
+    vector<btVector3> candidates;
+    vector<int> candidate_triangles;
+    candidates.reserve(candidates_per_area * total_area);
+    candidate_triangles.reserve(candidates_per_area * total_area);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        float expected = candidates_per_area * areas[t];
+        int n = (int)expected + (rnd(generator) < expected - floor(expected) ? 1 : 0);
+
+        auto a = vertex(indices[3*t + 0]);
+        auto b = vertex(indices[3*t + 1]);
+        auto c = vertex(indices[3*t + 2]);
+        for (int k = 0; k < n; ++k) {
+            // http://math.stackexchange.com/questions/18686/uniform-random-point-in-triangle
+            float r1 = sqrt(rnd(generator));
+            float r2 = rnd(generator);
+            candidates.push_back((1.0f - r1)*a + (r1*(1.0f - r2))*b + (r2*r1)*c);
+            candidate_triangles.push_back(t);
+        }
+    }
+
+    vector<int> order(candidates.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    shuffle(order.begin(), order.end(), generator);
+
+    // Accepted samples, bucketed in a grid of cells of the min distance, so
+    // only the 27 cells around a candidate are checked
+    unordered_map<uint64_t, vector<int> > grid;
+    grid.reserve(total_area / (min_distance * min_distance));
+    vector<int> accepted;
+
+    float min_distance2 = min_distance * min_distance;
+    for (int i : order) {
+        auto& p = candidates[i];
+        auto& n = triangle_normals[candidate_triangles[i]];
+        int cx = (int)floor(p.x() / min_distance);
+        int cy = (int)floor(p.y() / min_distance);
+        int cz = (int)floor(p.z() / min_distance);
+
+        bool conflict = false;
+        for (int dx = -1; dx <= 1 && !conflict; ++dx) {
+            for (int dy = -1; dy <= 1 && !conflict; ++dy) {
+                for (int dz = -1; dz <= 1 && !conflict; ++dz) {
+                    auto cell = grid.find(cell_key(cx + dx, cy + dy, cz + dz));
+                    if (cell == grid.end()) {
+                        continue;
+                    }
+                    for (int j : cell->second) {
+                        if ((candidates[j] - p).length2() < min_distance2 &&
+                            triangle_normals[candidate_triangles[j]].dot(n) > MIN_NORMAL_DOT) {
+                            conflict = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (!conflict) {
+            grid[cell_key(cx, cy, cz)].push_back(i);
+            accepted.push_back(i);
+        }
+    }
+
+    sampling.reserve(accepted.size());
+    for (int i : accepted) {
+        sampling.push_back(candidates[i] - inset * triangle_normals[candidate_triangles[i]]);
+    }
+
+    return sampling;
+}
@@ -0,0 +1,30 @@
+#ifndef _POISSON_DISK_SAMPLING_H_
+#define _POISSON_DISK_SAMPLING_H_
+
+#include <vector>
+#include <LinearMath/btVector3.h>
+#include "mesh/mesh.h"
+
+/**
+ * @brief Samples the surface of a triangle mesh with a Poisson disk
+ *        distribution
+ * @details Candidates are spread uniformly over the triangles, by area, and
+ *          accepted in random order only if no accepted sample facing the
+ *          same side is closer than half the particle spacing. The result
+ *          is close to a maximal sampling, about 2.8 / spacing^2 particles
+ *          per unit of area. That is denser than a lattice on flat
+ *          faces, but still sparser than the extra layers of the
+ *          voxelization of a model. Samples on
+ *          opposite sides of thin parts are kept, as their normals face
+ *          away. The sampling is deterministic for a given mesh.
+ *
+ * @param mesh The mesh to sample, in TRIANGLES mode, with outward normals.
+ * @param particle_spacing The spacing of the boundary particles.
+ * @param inset Samples are moved this distance inwards, along the normal.
+ * @return The samples.
+ */
+std::vector<btVector3> poisson_disk_sampling(const Mesh& mesh,
+                                      float particle_spacing,
+                                      float inset=0.0f);
+
+#endif // _POISSON_DISK_SAMPLING_H_
@@ -0,0 +1,182 @@
+#include "replaysimulation.h"
+#include "runtimeexception.h"
+
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+ReplaySimulation::ReplaySimulation(const SimulationSettings& sim_settings,
+                                   GLuint vbo_particles) :
+_vbo_positions(vbo_particles),
+_vbo_capacity(0),
+_frame_index(0) {
+    if (sim_settings.replay_file == "") {
+        throw RunTimeException("No recording to replay, set replay_file");
+    }
+
+    cout << "Opening recording " << sim_settings.replay_file << "..." << flush;
+    _archive = make_unique<FrameArchive>(sim_settings.replay_file);
+    cout << "done! " << _archive->frame_count() << " frames" << endl;
+
+    if (_archive->frame_count() == 0) {
+        throw RunTimeException("Recording " + sim_settings.replay_file + " has no frames");
+    }
+
+    seek(0);
+}
+
+bool ReplaySimulation::update_settings(const PhysicsSettings& fluid_settings,
+                                       const SimulationSettings& sim_settings) {
+    return true;
+}
+
+ReplaySimulation::~ReplaySimulation() {
+
+}
+
+void ReplaySimulation::simulate() {
+    seek((_frame_index + 1) % _archive->frame_count());
+}
+
+void ReplaySimulation::reset(const PhysicsSettings& fluid_settings,
+                             const SimulationSettings& sim_settings) {
+    seek(0);
+}
+
+int ReplaySimulation::particle_count() const {
+    return _frame.positions.size();
+}
+
+void ReplaySimulation::add_boundary(const shared_ptr<RigidBody> boundary,
+                                    const string& boundary_id,
+                                    bool can_move) {
+    _bodies.push_back(make_pair(boundary_id, boundary));
+    _restore_bodies();
+}
+
+int ReplaySimulation::boundary_particle_count() const {
+    return 0;
+}
+
+void ReplaySimulation::add_volume(const shared_ptr<FluidVolume> volume) {
+
+}
+
+void ReplaySimulation::add_emitter(const shared_ptr<FluidEmitter> emitter) {
+
+}
+
+void ReplaySimulation::add_sink(const shared_ptr<FluidSink> sink) {
+
+}
+
+void ReplaySimulation::begin_batch() {
+
+}
+
+void ReplaySimulation::commit() {
+
+}
+
+void ReplaySimulation::set_rect_limits(float width, float height, float depth) {
+
+}
+
+unsigned long ReplaySimulation::step_count() const {
+    return _frame.step;
+}
+
+void ReplaySimulation::save_checkpoint(const string& path) {
+    throw RunTimeException("Checkpoints are not supported when replaying a recording");
+}
+
+void ReplaySimulation::load_checkpoint(const string& path) {
+    throw RunTimeException("Checkpoints are not supported when replaying a recording");
+}
+
+void ReplaySimulation::download_particles(cl_float4* positions,
+                                          cl_float4* velocities,
+                                          cl_float* densities,
+                                          cl_event* event) {
+    size_t count = _frame.positions.size();
+    memcpy(positions, _frame.positions.data(), count * sizeof(cl_float4));
+    memcpy(velocities, _frame.velocities.data(), count * sizeof(cl_float4));
+    memcpy(densities, _frame.densities.data(), count * sizeof(cl_float));
+    *event = nullptr;
+}
+
+vector<CheckpointBody> ReplaySimulation::bodies_state() const {
+    return _frame.bodies;
+}
+
+size_t ReplaySimulation::frame_count() const {
+    return _archive->frame_count();
+}
+
+size_t ReplaySimulation::current_frame() const {
+    return _frame_index;
+}
+
+void ReplaySimulation::seek(size_t index) {
+    _frame_index = min(index, _archive->frame_count() - 1);
+    _archive->read_frame(_frame_index, _frame);
+
+    _upload_positions();
+    _restore_bodies();
+}
+
+void ReplaySimulation::_upload_positions() {
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    size_t count = _frame.positions.size();
+    gl.glBindBuffer(GL_ARRAY_BUFFER, _vbo_positions);
+    if (count > _vbo_capacity) {
+        gl.glBufferData(GL_ARRAY_BUFFER,
+                        count * sizeof(cl_float4),
+                        _frame.positions.data(),
+                        GL_DYNAMIC_DRAW);
+        _vbo_capacity = count;
+    }
+    else if (count > 0) {
+        gl.glBufferSubData(GL_ARRAY_BUFFER,
+                           0,
+                           count * sizeof(cl_float4),
+                           _frame.positions.data());
+    }
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ReplaySimulation::_restore_bodies() {
+    for (auto& b : _frame.bodies) {
+        for (auto& body : _bodies) {
+            if (body.first == b.id) {
+                // Rotation must be set first, as it resets the motion state
+                auto& rb = body.second;
+                rb->set_rotation(btQuaternion(b.rotation[0],
+                                              b.rotation[1],
+                                              b.rotation[2],
+                                              b.rotation[3]));
+                rb->set_position(btVector3(b.position[0],
+                                           b.position[1],
+                                           b.position[2]));
+                rb->set_linear_vel(btVector3(b.linear_vel[0],
+                                             b.linear_vel[1],
+                                             b.linear_vel[2]));
+                rb->set_angular_vel(btVector3(b.angular_vel[0],
+                                              b.angular_vel[1],
+                                              b.angular_vel[2]));
+                break;
+            }
+        }
+    }
+}
+
+bool ReplaySimulation::particle_grid(ParticleGrid& particles) const {
+    return false;
+}
+
+bool ReplaySimulation::set_metrics_buffer(GLuint vbo) {
+    return false;
+}
@@ -0,0 +1,196 @@
+/**
+ *  @file replaysimulation.h
+ *  @brief Contains the declaration of the ReplaySimulation class.
+ *
+ *  This contains the prototype for the ReplaySimulation class. Instead of
+ *  solving the fluid, it plays back a recording made with a FrameWriter.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _REPLAY_SIMULATION_H_
+#define _REPLAY_SIMULATION_H_
+
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "opengl/openglfunctions.h"
+#include "fluidsimulation.h"
+#include "fluid/recording/framearchive.h"
+
+/**
+ * @class ReplaySimulation
+ * @brief Plays back a recording of a fluid simulation
+ * @details Each step advances one recorded frame, looping at the end of the
+ *          recording. The particles of the current frame are uploaded to the
+ *          particles VBO, and the rigid bodies are moved to the recorded
+ *          state, so the scene renders exactly as it did when recorded. No
+ *          OpenCL work is done at all.
+ */
+class ReplaySimulation : public FluidSimulation {
+    public:
+        /**
+         * @brief Opens a recording, and uploads its first frame
+         *
+         * @param sim_settings Parameters of the simulation. The recording
+         *                     is read from replay_file.
+         * @param vbo_particles The VBO where particle positions are stored.
+         * @throws RunTimeException if the recording can not be opened.
+         */
+        ReplaySimulation(const SimulationSettings& sim_settings,
+                         GLuint vbo_particles);
+
+        ~ReplaySimulation();
+
+        /**
+         * @brief Advances to the next frame of the recording
+         */
+        void simulate();
+
+        /**
+         * @brief Goes back to the first frame of the recording
+         * @details The settings are ignored, they are those of the recording.
+         */
+        void reset(const PhysicsSettings& fluid_settings,
+                   const SimulationSettings& sim_settings);
+
+        /**
+         * @brief Does nothing, the settings are those of the recording
+         * @return Always true.
+         */
+        bool update_settings(const PhysicsSettings& fluid_settings,
+                             const SimulationSettings& sim_settings);
+
+        /**
+         * @brief Returns the number of particles of the current frame
+         */
+        int particle_count() const;
+
+        /**
+         * @brief Registers a rigid body, so it can be moved to the state
+         *        recorded in each frame
+         *
+         * @param boundary An instance of a rigid body.
+         * @param boundary_id The id the body was recorded with.
+         */
+        void add_boundary(const std::shared_ptr<RigidBody> boundary,
+                          const std::string& boundary_id,
+                          bool can_move=false);
+
+        /**
+         * @brief No boundary is sampled when replaying, so this is zero
+         */
+        int boundary_particle_count() const;
+
+        /**
+         * @brief Ignored, the particles come from the recording
+         */
+        void add_volume(const std::shared_ptr<FluidVolume> volume);
+
+        /**
+         * @brief Ignored, the particles come from the recording
+         */
+        void add_emitter(const std::shared_ptr<FluidEmitter> emitter);
+
+        /**
+         * @brief Ignored, the particles come from the recording
+         */
+        void add_sink(const std::shared_ptr<FluidSink> sink);
+
+        /**
+         * @brief Nothing to batch, bodies are registered as they are added
+         */
+        void begin_batch();
+
+        /**
+         * @brief Nothing to batch, bodies are registered as they are added
+         */
+        void commit();
+
+        /**
+         * @brief Ignored, the particles come from the recording
+         */
+        void set_rect_limits(float width, float height, float depth);
+
+        /**
+         * @brief Returns the simulation step the current frame was taken at
+         */
+        unsigned long step_count() const;
+
+        /**
+         * @brief Not supported, a recording holds no full solver state
+         * @throws RunTimeException always.
+         */
+        void save_checkpoint(const std::string& path);
+
+        /**
+         * @brief Not supported, a recording holds no full solver state
+         * @throws RunTimeException always.
+         */
+        void load_checkpoint(const std::string& path);
+
+        /**
+         * @brief Copies the particles of the current frame
+         * @details The copy is synchronous, so no event is returned.
+         */
+        void download_particles(cl_float4* positions,
+                                cl_float4* velocities,
+                                cl_float* densities,
+                                cl_event* event);
+
+        /**
+         * @brief Returns the rigid bodies state of the current frame
+         */
+        std::vector<CheckpointBody> bodies_state() const;
+
+        /**
+         * @brief A recording has no uniform grid
+         * @return Always false.
+         */
+        bool particle_grid(ParticleGrid& particles) const;
+
+        /**
+         * @brief A recording has no costs of the particles
+         * @return Always false.
+         */
+        bool set_metrics_buffer(GLuint vbo);
+
+        /**
+         * @brief Returns the number of frames of the recording
+         */
+        size_t frame_count() const;
+
+        /**
+         * @brief Returns the index of the current frame
+         */
+        size_t current_frame() const;
+
+        /**
+         * @brief Jumps to any frame of the recording
+         *
+         * @param index The index of the frame, clamped to the last one.
+         */
+        void seek(size_t index);
+
+    private:
+        std::unique_ptr<FrameArchive> _archive;
+
+        GLuint _vbo_positions;
+
+        // Number of particles the VBO has room for
+        size_t _vbo_capacity;
+
+        // The decoded current frame
+        size_t _frame_index;
+        FrameData _frame;
+
+        // Rigid bodies of the scene, by the id they were recorded with
+        std::vector<std::pair<std::string, std::shared_ptr<RigidBody> > > _bodies;
+
+        void _upload_positions();
+
+        void _restore_bodies();
+};
+
+#endif // _REPLAY_SIMULATION_H_
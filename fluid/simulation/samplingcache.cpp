@@ -0,0 +1,124 @@
+#include "samplingcache.h"
+#include "mesh/meshcache.h"
+
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+uint64_t SamplingCache::key(const RigidBody& body, float particle_spacing) {
+    auto surface = body.sampling_key();
+    uint32_t options[2] = {SAMPLING_CACHE_VERSION, (uint32_t)body.sampling_method()};
+
+    uint64_t h = MeshCache::hash(surface.data(), surface.size());
+    h = MeshCache::hash(&particle_spacing, sizeof(particle_spacing), h);
+    return MeshCache::hash(options, sizeof(options), h);
+}
+
+Sampling SamplingCache::get(const RigidBody& body, uint64_t key, float particle_spacing) {
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto it = _samplings.find(key);
+        if (it != _samplings.end()) {
+            return it->second;
+        }
+    }
+
+    auto path = _path(key);
+    Sampling sampling;
+    if (!path.empty()) {
+        sampling = _read(path);
+    }
+
+    if (!sampling) {
+        auto positions = body.surface_sampling(particle_spacing);
+
+        auto particles = make_shared<vector<cl_float4> >();
+        particles->reserve(positions.size());
+        for (auto& pos : positions) {
+            cl_float4 cl_pos;
+            cl_pos.s[0] = pos.x();
+            cl_pos.s[1] = pos.y();
+            cl_pos.s[2] = pos.z();
+            cl_pos.s[3] = 1;
+            particles->push_back(cl_pos);
+        }
+
+        if (!path.empty()) {
+            _write(path, *particles);
+        }
+        sampling = particles;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    _samplings[key] = sampling;
+    return sampling;
+}
+
+string SamplingCache::_path(uint64_t key) {
+    auto& directory = MeshCache::directory();
+    if (directory.empty()) {
+        return "";
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.samp", (unsigned long long)key);
+    return directory + "/" + name;
+}
+
+Sampling SamplingCache::_read(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        return nullptr;
+    }
+
+    SamplingCacheHeader h;
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) ||
+        memcmp(h.magic, SAMPLING_CACHE_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != SAMPLING_CACHE_VERSION) {
+        cerr << "Ignoring invalid cached sampling " << path << endl;
+        return nullptr;
+    }
+
+    auto particles = make_shared<vector<cl_float4> >(h.particle_count);
+    if (!in.read(reinterpret_cast<char*>(particles->data()), h.particle_count * sizeof(cl_float4))) {
+        cerr << "Ignoring truncated cached sampling " << path << endl;
+        return nullptr;
+    }
+
+    return particles;
+}
+
+void SamplingCache::_write(const string& path, const vector<cl_float4>& sampling) {
+    auto& directory = MeshCache::directory();
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        cerr << "Could not create mesh cache " << directory << ": " << strerror(errno) << endl;
+        return;
+    }
+
+    SamplingCacheHeader h;
+    memcpy(h.magic, SAMPLING_CACHE_MAGIC, sizeof(h.magic));
+    h.version = SAMPLING_CACHE_VERSION;
+    h.particle_count = sampling.size();
+
+    // Written to a temporary file and renamed, so a partial file is never read
+    string tmp_path = path + ".tmp";
+    ofstream out(tmp_path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Could not write cached sampling " << tmp_path << endl;
+        return;
+    }
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char*>(sampling.data()), sampling.size() * sizeof(cl_float4));
+    out.close();
+
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        cerr << "Could not write cached sampling " << path << endl;
+        remove(tmp_path.c_str());
+    }
+}
@@ -0,0 +1,90 @@
+/**
+ *  @file samplingcache.h
+ *  @brief Contains the declaration of the SamplingCache class.
+ *
+ *  Samplings of rigid body surfaces are cached by the key of the surface
+ *  and the particle spacing. They are kept in memory, and written to the
+ *  mesh cache directory (see MeshCache), so sampling a model is only ever
+ *  done once for a given spacing.
+ *
+ *  A sampling file is a SamplingCacheHeader followed by the positions, as
+ *  cl_float4.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _SAMPLING_CACHE_H_
+#define _SAMPLING_CACHE_H_
+
+#include <CL/cl.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "scene/rigidbody.h"
+
+#define SAMPLING_CACHE_MAGIC    "FSMP"
+#define SAMPLING_CACHE_VERSION  2
+
+struct SamplingCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t particle_count;
+};
+
+// Positions of the particles that sample a surface, in body coordinates.
+// Shared by every body with the same surface
+typedef std::shared_ptr<const std::vector<cl_float4> > Sampling;
+
+/**
+ * @class SamplingCache
+ * @brief Caches the surface samplings of rigid bodies
+ */
+class SamplingCache {
+    public:
+        /**
+         * @brief Returns the key of the sampling of a body
+         *
+         * @param body The rigid body.
+         * @param particle_spacing The spacing between particles.
+         */
+        static uint64_t key(const RigidBody& body, float particle_spacing);
+
+        /**
+         * @brief Returns the sampling of the surface of a body
+         * @details The sampling is looked up in memory, then on disk, and
+         *          only sampled if not found. It is safe to call this from
+         *          several threads at once, for bodies of different keys.
+         *
+         * @param body The rigid body.
+         * @param key The key of the sampling, as returned by key().
+         * @param particle_spacing The spacing between particles.
+         */
+        Sampling get(const RigidBody& body, uint64_t key, float particle_spacing);
+
+    private:
+        std::mutex _mutex;
+        std::unordered_map<uint64_t, Sampling> _samplings;
+
+        /**
+         * @brief Returns the path of the file of a sampling, empty if the
+         *        cache directory is disabled
+         */
+        static std::string _path(uint64_t key);
+
+        /**
+         * @brief Reads a sampling file
+         * @return The sampling, or null if the file is missing or invalid.
+         */
+        static Sampling _read(const std::string& path);
+
+        /**
+         * @brief Writes a sampling file. Failures are reported but not fatal
+         */
+        static void _write(const std::string& path, const std::vector<cl_float4>& sampling);
+};
+
+#endif // _SAMPLING_CACHE_H_
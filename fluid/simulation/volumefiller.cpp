@@ -0,0 +1,175 @@
+#include "volumefiller.h"
+#include "opencl/clenvironment.h"
+#include "opencl/clallocator.h"
+#include "opencl/clcompiler.h"
+#include "opencl/clerror.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Particles streamed from an array per chunk. Only one chunk is staged on
+// the device at a time
+#define STREAM_CHUNK_SIZE   (1 << 20)
+
+static CLProgram& program() {
+    // The program does not depend on the scene, it is built once
+    static unique_ptr<CLProgram> program;
+    if (!program) {
+        CLCompiler compiler;
+        compiler.add_file_source("kernels/lattice.cl");
+        compiler.add_file_source("kernels/particlearray.cl");
+        compiler.add_build_option("-cl-std=CL1.2");
+        compiler.add_include_path("kernels");
+        program = compiler.build();
+    }
+    return *program;
+}
+
+VolumeFiller::VolumeFiller(const vector<shared_ptr<FluidVolume> >& volumes,
+                           float particle_radius) :
+_lattice_particle_count(0),
+_array_particle_count(0) {
+    vector<ParticleArray> arrays;
+    for (auto& v : volumes) {
+        VolumeLattice lattice;
+        ParticleArray array;
+        if (v->lattice(particle_radius, lattice)) {
+            int size = lattice.size[0] * lattice.size[1] * lattice.size[2];
+            if (size <= 0) {
+                continue;
+            }
+            // Exclusive scan of the lattice sizes. There are only a handful
+            // of volumes, and the total is needed on the host anyway to size
+            // the buffers
+            lattice.offset = _lattice_particle_count;
+            _lattice_particle_count += size;
+            _lattices.push_back(lattice);
+        }
+        else if (v->particle_array(array)) {
+            if (array.count > 0) {
+                arrays.push_back(array);
+            }
+        }
+        else {
+            auto ps = v->particles(particle_radius);
+            _particles.insert(_particles.end(), ps.begin(), ps.end());
+        }
+    }
+
+    // Arrays go last, after every generated particle
+    for (auto& array : arrays) {
+        _arrays.push_back(make_pair(array, _array_particle_count));
+        _array_particle_count += array.count;
+    }
+}
+
+int VolumeFiller::particle_count() const {
+    return _lattice_particle_count + _array_particle_count + _particles.size();
+}
+
+bool VolumeFiller::has_velocities() const {
+    for (auto& a : _arrays) {
+        if (a.first.velocity_offset >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int VolumeFiller::given_particle_count() const {
+    return _array_particle_count;
+}
+
+void VolumeFiller::fill(cl_mem positions, cl_mem velocities) const {
+    fill_generated(positions);
+    fill_given(positions, velocities, _lattice_particle_count + _particles.size());
+}
+
+void VolumeFiller::fill_generated(cl_mem positions) const {
+    if (!_lattices.empty()) {
+        auto kernel = program().get_kernel("fill_lattices");
+
+        cl_mem lattices = CLAllocator::alloc_buffer<VolumeLattice>("solver/fill_lattices", _lattices.size(), _lattices);
+        int lattice_count = _lattices.size();
+
+        kernel->set_arg(0, &positions);
+        kernel->set_arg(1, &lattices);
+        kernel->set_arg(2, &lattice_count);
+        kernel->set_arg(3, &_lattice_particle_count);
+        auto err = kernel->run(_lattice_particle_count);
+        CLError::check(err);
+
+        // Released once the kernel is done with it
+        CLAllocator::release_buffer(lattices);
+    }
+
+    if (!_particles.empty()) {
+        CLAllocator::upload_to_buffer_range(_particles.data(),
+                                            _particles.size(),
+                                            positions,
+                                            _lattice_particle_count);
+    }
+}
+
+void VolumeFiller::fill_given(cl_mem positions, cl_mem velocities, int offset) const {
+    if (!_arrays.empty()) {
+        _stream_arrays(positions, velocities, offset);
+    }
+}
+
+void VolumeFiller::_stream_arrays(cl_mem positions, cl_mem velocities, int offset) const {
+    auto kernel = program().get_kernel("unpack_particles");
+
+    size_t staging_size = 0;
+    for (auto& a : _arrays) {
+        staging_size = max(staging_size, (size_t)min(a.first.count, STREAM_CHUNK_SIZE) * a.first.stride);
+    }
+    cl_mem staging = CLAllocator::alloc_buffer<char>("solver/fill_staging", staging_size);
+
+    // The kernel always takes a velocities buffer, the offset tells it
+    // whether to write it
+    cl_mem velocities_arg = velocities ? velocities : positions;
+
+    for (auto& a : _arrays) {
+        auto& array = a.first;
+        int stride = array.stride / sizeof(cl_float);
+        int position_offset = array.position_offset / sizeof(cl_float);
+        int velocity_offset = velocities ? array.velocity_offset / (int)sizeof(cl_float) : -1;
+
+        for (int first=0; first<array.count; first+=STREAM_CHUNK_SIZE) {
+            int count = min(STREAM_CHUNK_SIZE, array.count - first);
+
+            // Written straight from the memory of the volume, without
+            // blocking. The queue is in order, so the chunk is in place
+            // before it is unpacked, and the next one waits for it
+            cl_int err = clEnqueueWriteBuffer(CLEnvironment::queue(),
+                                              staging,
+                                              CL_FALSE,
+                                              0,
+                                              (size_t)count * array.stride,
+                                              array.data + (size_t)first * array.stride,
+                                              0,
+                                              nullptr,
+                                              nullptr);
+            CLError::check(err);
+
+            int dst = offset + a.second + first;
+            kernel->set_arg(0, &staging);
+            kernel->set_arg(1, &positions);
+            kernel->set_arg(2, &velocities_arg);
+            kernel->set_arg(3, &stride);
+            kernel->set_arg(4, &position_offset);
+            kernel->set_arg(5, &velocity_offset);
+            kernel->set_arg(6, &dst);
+            kernel->set_arg(7, &count);
+            err = kernel->run(count);
+            CLError::check(err);
+        }
+    }
+
+    // The writes read the memory of the volumes until they are done
+    clFinish(CLEnvironment::queue());
+
+    CLAllocator::release_buffer(staging);
+}
@@ -0,0 +1,110 @@
+/**
+ *  @file volumefiller.h
+ *  @brief Contains the declaration of the VolumeFiller class.
+ *
+ *  The initial particles of the fluid volumes are generated on the device
+ *  when the volume is a lattice, so scene initialization is bound by the
+ *  device bandwidth instead of building and uploading host vectors.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _VOLUME_FILLER_H_
+#define _VOLUME_FILLER_H_
+
+#include "fluidvolume.h"
+#include <CL/cl.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @class VolumeFiller
+ * @brief Fills the positions buffer of a solver with the particles of a list
+ *        of fluid volumes
+ * @details Lattice volumes are placed first, at the offsets given by the
+ *          exclusive scan of their sizes, and filled by a single kernel
+ *          launch. Any other volume generated by the filler is built on the
+ *          host and uploaded next. Particle arrays, given as they are, go
+ *          last, streamed in chunks with non blocking writes straight from
+ *          their memory, so a solver can place them on their own.
+ */
+class VolumeFiller {
+    public:
+        /**
+         * @brief Describes the particles of a list of volumes
+         *
+         * @param volumes The fluid volumes.
+         * @param particle_radius The radius of the particles.
+         */
+        VolumeFiller(const std::vector<std::shared_ptr<FluidVolume> >& volumes,
+                     float particle_radius);
+
+        /**
+         * @brief Returns the number of particles of all the volumes
+         */
+        int particle_count() const;
+
+        /**
+         * @brief Returns whether any volume gives the velocities of its
+         *        particles
+         */
+        bool has_velocities() const;
+
+        /**
+         * @brief Returns the number of particles the volumes give as they
+         *        are, like those read from a file. They are the last ones
+         */
+        int given_particle_count() const;
+
+        /**
+         * @brief Writes the particles to a buffer
+         * @details If the buffers are shared with OpenGL, they must be
+         *          locked. Velocities are only written for the volumes that
+         *          give them, the rest must be set beforehand.
+         *
+         * @param positions The buffer, that must hold particle_count()
+         *        positions.
+         * @param velocities The buffer of the velocities, or null to ignore
+         *        them.
+         */
+        void fill(cl_mem positions, cl_mem velocities=nullptr) const;
+
+        /**
+         * @brief Writes only the particles generated by the filler, those
+         *        of the lattices and the rest of the volumes that are not
+         *        arrays, at the start of a buffer
+         *
+         * @param positions The buffer, that must hold at least
+         *        particle_count() - given_particle_count() positions.
+         */
+        void fill_generated(cl_mem positions) const;
+
+        /**
+         * @brief Writes only the particles given as they are
+         *
+         * @param positions The buffer of the positions.
+         * @param velocities The buffer of the velocities, or null to ignore
+         *        them.
+         * @param offset The index of the first particle written. The
+         *        buffers must hold offset + given_particle_count() particles.
+         */
+        void fill_given(cl_mem positions, cl_mem velocities, int offset) const;
+
+    private:
+        std::vector<VolumeLattice> _lattices;
+        int _lattice_particle_count;
+        // Arrays and the index of their first particle, counted from the
+        // first given particle
+        std::vector<std::pair<ParticleArray, int> > _arrays;
+        int _array_particle_count;
+        // Particles of the volumes that are neither lattices nor arrays
+        std::vector<cl_float4> _particles;
+
+        /**
+         * @brief Streams the particle arrays to the buffers, in chunks
+         */
+        void _stream_arrays(cl_mem positions, cl_mem velocities, int offset) const;
+};
+
+#endif // _VOLUME_FILLER_H_
@@ -1,9 +1,13 @@
 #define CL_USE_DEPRECATED_OPENCL_1_1_APIS   1
 #include "wcsphsimluation.h"
+#include "checkpoint.h"
+#include "volumefiller.h"
+#include "runtimeexception.h"
 #include "opencl/clallocator.h"
 #include "opencl/clcompiler.h"
 #include "opencl/algorithms/clsort.h"
 #include "opencl/algorithms/clshuffle.h"
+#include "profiling/frameprofiler.h"
 
 #include <CL/cl_gl.h>
 #include <cmath>
@@ -15,9 +19,17 @@ using namespace std;
 WCSPHSimulation::WCSPHSimulation(const PhysicsSettings& fluid_settings,
                                  const SimulationSettings& sim_settings,
                                  GLuint vbo_fluid_positions) :
+_step(0),
+_batching(false),
+_pending_solver_init(false),
+_pending_kernels(false),
+_fluid(),
 _vbo_fluid_positions(vbo_fluid_positions),
 _sb_neigh_list(nullptr),
-_sb_neigh_list_length(nullptr) {
+_sb_neigh_list_length(nullptr),
+_program_support_radius(0.0f),
+_max_neigh_list_length(NEIGH_LIST_DEFAULT_LENGTH),
+_max_sb_neigh_list_length(NEIGH_LIST_DEFAULT_LENGTH) {
     // Initialize internal parameters
     _initialize_params(fluid_settings, sim_settings);
 
@@ -40,10 +52,13 @@ int WCSPHSimulation::particle_count() const {
 void WCSPHSimulation::simulate() {
     CLAllocator::lock_gl_buffers(_gl_shared_buffers);
 
+    FrameProfiler::begin(FramePhase::BOUNDARY_SYNC);
     _boundary_handler->sync();
+    FrameProfiler::end(FramePhase::BOUNDARY_SYNC);
 
     // First, compute the hash for every particle. The hash depends on the
     // position within the uniform grid
+    FrameProfiler::begin(FramePhase::SORT);
     _grid->compute_hashes(_fluid.positions,
                           _fluid.hashes,
                           _fluid.mask,
@@ -64,8 +79,11 @@ void WCSPHSimulation::simulate() {
                                   _fluid.hashes,
                                   _fluid.cell_intervals,
                                   _fluid.count);
+    FrameProfiler::end(FramePhase::SORT);
 
     // And now, compute the neighbourhood list for every fluid particle
+    FrameProfiler::begin(FramePhase::NEIGHBOURS);
+    _fit_neigh_lists();
     _grid->compute_neigh_list(_fluid.positions_sorted,
                               _fluid.positions_sorted,
                               _fluid.cell_intervals,
@@ -79,93 +97,134 @@ void WCSPHSimulation::simulate() {
     _boundary_handler->build_neighbourhood(_fluid.positions_sorted,
                                            _sb_neigh_list,
                                            _sb_neigh_list_length,
-                                           _max_neigh_list_length,
+                                           _max_sb_neigh_list_length,
                                            _fluid.count);
+    FrameProfiler::end(FramePhase::NEIGHBOURS);
 
     // Compute initial densities and pressure
+    FrameProfiler::begin(FramePhase::DENSITY);
     _call_kernel(_kernel_density_n_pressure, _fluid.count);
+    FrameProfiler::end(FramePhase::DENSITY);
 
     // Compute particles normals, used by the surface tension model
+    FrameProfiler::begin(FramePhase::FORCES);
     _call_kernel(_kernel_normals, _fluid.count);
 
     // Compute particles acceleration
     _call_kernel(_kernel_acceleration, _fluid.count);
+    FrameProfiler::end(FramePhase::FORCES);
 
     // Update rigid bodies
+    FrameProfiler::begin(FramePhase::RIGID_COUPLING);
     _boundary_handler->apply_fluid_forces(_fluid.positions_sorted,
                                           _fluid.vel_t_sorted,
                                           _fluid.densities,
                                           _fluid.pressures,
                                           _fluid.cell_intervals,
                                           _particle_mass);
+    FrameProfiler::end(FramePhase::RIGID_COUPLING);
 
     // Update positions
+    FrameProfiler::begin(FramePhase::INTEGRATION);
     _call_kernel(_kernel_time_itegration, _fluid.count);
+    FrameProfiler::end(FramePhase::INTEGRATION);
 
     CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+
+    ++_step;
+}
+
+unsigned long WCSPHSimulation::step_count() const {
+    return _step;
 }
 
 void WCSPHSimulation::_initialize_buffers() {
     cout << "Initializing buffers..." << flush;
 
+    VolumeFiller filler(_volumes, _particle_radius);
+
+    _alloc_buffers(filler.particle_count());
+
+    // Generate the particles in the device buffers
+    CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+    filler.fill(_fluid.positions, _fluid.vel_t);
+    CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+
+    // The integration starts from the given velocities
+    if (filler.has_velocities()) {
+        CLAllocator::copy_full_buffer<cl_float4>(_fluid.vel_t, _fluid.vel_half_t, _fluid.count);
+    }
+
+    cout << "done!" << endl;
+}
+
+void WCSPHSimulation::_alloc_buffers(int particle_count) {
+    _fluid.count = particle_count;
+
+    // The buffers are kept if they can hold the particles
+    cl_float4 zero_float4 = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    if (_fluid.capacity > 0 && particle_count <= _fluid.capacity) {
+        CLAllocator::fill_buffer(_fluid.vel_t, zero_float4, _fluid.capacity);
+        CLAllocator::fill_buffer(_fluid.vel_half_t, zero_float4, _fluid.capacity);
+        _alloc_cell_intervals();
+        return;
+    }
+
     // Wait to opengl to finish before resizing buffer
     OpenGLFunctions::getFunctions().glFinish();
 
     _release_buffers();
 
-    // Iterate over all volumes defined to obtain all particles
-    vector<cl_float4> fluid_particles;
-    for (auto v: _volumes) {
-        auto ps = v->particles(_particle_radius);
-        fluid_particles.insert(fluid_particles.end(), ps.begin(), ps.end());
-    }
-    _fluid.count = fluid_particles.size();
+    _fluid.capacity = particle_count;
 
-    _fluid.positions = CLAllocator::alloc_gl_buffer<cl_float4>(_fluid.count, _vbo_fluid_positions);
-    _fluid.positions_sorted = CLAllocator::alloc_buffer<cl_float4>(_fluid.count);
+    _fluid.positions = CLAllocator::alloc_gl_buffer<cl_float4>("solver/positions", _fluid.capacity, _vbo_fluid_positions);
 
-    // Upload the particle positions to the device buffer
-    CLAllocator::upload_to_gl_buffer(fluid_particles, _fluid.positions);
+    // Every other attribute is a sub-buffer of the arena
+    _arena.reserve<cl_float4>(&_fluid.positions_sorted, _fluid.capacity, "solver/positions_sorted");
 
     // Initialize buffer for storing the hashes
-    _fluid.hashes = CLAllocator::alloc_buffer<cl_uint>(_fluid.count);
+    _arena.reserve<cl_uint>(&_fluid.hashes, _fluid.capacity, "solver/hashes");
 
     // Initialize buffer mask
-    _fluid.mask = CLAllocator::alloc_buffer<cl_int>(_fluid.count);
+    _arena.reserve<cl_int>(&_fluid.mask, _fluid.capacity, "solver/mask");
 
     // Initialize the buffers that hold the velocity of particles
-    cl_float4 zero_float4 = {{0.0f, 0.0f, 0.0f, 0.0f}};
-    _fluid.vel_t = CLAllocator::alloc_buffer<cl_float4>(_fluid.count, zero_float4);
-    _fluid.vel_t_sorted = CLAllocator::alloc_buffer<cl_float4>(_fluid.count);
-    _fluid.vel_half_t = CLAllocator::alloc_buffer<cl_float4>(_fluid.count, zero_float4);
-    _fluid.vel_half_t_sorted = CLAllocator::alloc_buffer<cl_float4>(_fluid.count);
+    _arena.reserve<cl_float4>(&_fluid.vel_t, _fluid.capacity, "solver/vel_t");
+    _arena.reserve<cl_float4>(&_fluid.vel_t_sorted, _fluid.capacity, "solver/vel_t_sorted");
+    _arena.reserve<cl_float4>(&_fluid.vel_half_t, _fluid.capacity, "solver/vel_half_t");
+    _arena.reserve<cl_float4>(&_fluid.vel_half_t_sorted, _fluid.capacity, "solver/vel_half_t_sorted");
 
-    _fluid.densities = CLAllocator::alloc_buffer<cl_float>(_fluid.count);
-    _fluid.pressures = CLAllocator::alloc_buffer<cl_float>(_fluid.count);
-    _fluid.accelerations = CLAllocator::alloc_buffer<cl_float4>(_fluid.count);
-    _fluid.normals = CLAllocator::alloc_buffer<cl_float4>(_fluid.count);
+    _arena.reserve<cl_float>(&_fluid.densities, _fluid.capacity, "solver/densities");
+    _arena.reserve<cl_float>(&_fluid.pressures, _fluid.capacity, "solver/pressures");
+    _arena.reserve<cl_float4>(&_fluid.accelerations, _fluid.capacity, "solver/accelerations");
+    _arena.reserve<cl_float4>(&_fluid.normals, _fluid.capacity, "solver/normals");
 
-    // Now initialize the buffers related to holding particles neighbourhood
-    _fluid.cell_intervals = CLAllocator::alloc_buffer<cl_int2>(_grid->info().cells_count);
+    // Initialize the buffer to hold the length of the neighbourhood of 
+    // each particle. The lists and the cell intervals are allocated on
+    // their own
+    _arena.reserve<cl_int>(&_fluid.neigh_list_length, _fluid.capacity, "solver/neigh_list_length");
+    _arena.reserve<cl_int>(&_sb_neigh_list_length, _fluid.capacity, "solver/sb_neigh_list_length");
 
-    // Initialize the buffer to hold the neighbourhood for each particle
-    _fluid.neigh_list_length = CLAllocator::alloc_buffer<cl_int>(_fluid.count);
-    _fluid.neighbourhood_list = CLAllocator::alloc_buffer<cl_int>(_fluid.count * _max_neigh_list_length);
+    _arena.commit();
 
-    _sb_neigh_list_length = CLAllocator::alloc_buffer<cl_int>(_fluid.count);
-    _sb_neigh_list = CLAllocator::alloc_buffer<cl_int>(_fluid.count * _max_neigh_list_length);
+    _alloc_neigh_lists();
+    _alloc_cell_intervals();
+
+    CLAllocator::fill_buffer(_fluid.vel_t, zero_float4, _fluid.capacity);
+    CLAllocator::fill_buffer(_fluid.vel_half_t, zero_float4, _fluid.capacity);
 
     // Reset and store the references to the shared GL buffers
     _gl_shared_buffers.clear();
     _gl_shared_buffers.push_back(_fluid.positions);
-
-    cout << "done!" << endl;
 }
 
 void WCSPHSimulation::_initialize_params(const PhysicsSettings& fluid_settings,
                                         const SimulationSettings& sim_settings) {
     cout << "Initializing internal parameters..." << flush;
 
+    _fluid_settings = fluid_settings;
+    _sim_settings = sim_settings;
+
     _dt = sim_settings.time_step;
     _max_vel = sim_settings.max_vel;
 
@@ -213,6 +272,22 @@ void WCSPHSimulation::reset(const PhysicsSettings& fluid_settings,
     _initialize_solver();
 }
 
+bool WCSPHSimulation::update_settings(const PhysicsSettings& fluid_settings,
+                                      const SimulationSettings& sim_settings) {
+    // The radii set the lattice, the grid and the compiled kernels
+    if (sim_settings.fluid_particle_radius != _particle_radius ||
+        sim_settings.fluid_support_radius != _support_radius) {
+        return false;
+    }
+
+    _initialize_params(fluid_settings, sim_settings);
+    _boundary_handler->set_rest_density(_rest_density);
+
+    _setup_kernel_params();
+
+    return true;
+}
+
 void WCSPHSimulation::_setup_kernel_params() {
     cout << "Setting up kernel parameters..." << flush;
     if (_fluid.count <= 0) {
@@ -264,8 +339,9 @@ void WCSPHSimulation::_setup_kernel_params() {
     clSetKernelArg(_kernel_normals, 3, sizeof(cl_mem), &_fluid.neigh_list_length);
     clSetKernelArg(_kernel_normals, 4, sizeof(cl_mem), &_fluid.neighbourhood_list);
     clSetKernelArg(_kernel_normals, 5, sizeof(cl_float), &_smoothing_constants.poly6_grad);
-    clSetKernelArg(_kernel_normals, 6, sizeof(cl_float), &_particle_mass);
-    clSetKernelArg(_kernel_normals, 7, sizeof(cl_float), &_support_radius);
+    // Local caches, one element per work item
+    clSetKernelArg(_kernel_normals, 6, 128 * sizeof(cl_float4), nullptr);
+    clSetKernelArg(_kernel_normals, 7, 128 * sizeof(cl_float), nullptr);
 
     clSetKernelArg(_kernel_time_itegration, 0, sizeof(cl_mem), &_fluid.positions_sorted);
     clSetKernelArg(_kernel_time_itegration, 1, sizeof(cl_mem), &_fluid.vel_t_sorted);
@@ -278,31 +354,80 @@ void WCSPHSimulation::_setup_kernel_params() {
     clSetKernelArg(_kernel_time_itegration, 8, sizeof(cl_float), &_max_vel);
     clSetKernelArg(_kernel_time_itegration, 9, sizeof(cl_float4), &_container_size);
 
+    _setup_fluid_params();
+
     cout << "done" << endl;
 }
 
+void WCSPHSimulation::_setup_fluid_params() {
+    FluidParams fluid;
+    fluid.particle_count = _fluid.count;
+    fluid.particle_mass = _particle_mass;
+    fluid.rest_density = _rest_density;
+
+    clSetKernelArg(_kernel_density_n_pressure, 14, sizeof(FluidParams), &fluid);
+    clSetKernelArg(_kernel_acceleration, 22, sizeof(FluidParams), &fluid);
+    clSetKernelArg(_kernel_normals, 8, sizeof(FluidParams), &fluid);
+    clSetKernelArg(_kernel_time_itegration, 10, sizeof(FluidParams), &fluid);
+}
+
 void WCSPHSimulation::_release_buffers() {
     cout << "Releasing buffers..." << flush;
     CLAllocator::release_buffer(_fluid.positions);
-    CLAllocator::release_buffer(_fluid.positions_sorted);
-    CLAllocator::release_buffer(_fluid.hashes);
-    CLAllocator::release_buffer(_fluid.mask);
-    CLAllocator::release_buffer(_fluid.vel_t);
-    CLAllocator::release_buffer(_fluid.vel_t_sorted);
-    CLAllocator::release_buffer(_fluid.vel_half_t);
-    CLAllocator::release_buffer(_fluid.vel_half_t_sorted);
-    CLAllocator::release_buffer(_fluid.densities);
-    CLAllocator::release_buffer(_fluid.pressures);
-    CLAllocator::release_buffer(_fluid.accelerations);
-    CLAllocator::release_buffer(_fluid.normals);
-    CLAllocator::release_buffer(_fluid.cell_intervals);
-    CLAllocator::release_buffer(_fluid.neigh_list_length);
+    _fluid.positions = nullptr;
+
     CLAllocator::release_buffer(_fluid.neighbourhood_list);
-    CLAllocator::release_buffer(_sb_neigh_list_length);
     CLAllocator::release_buffer(_sb_neigh_list);
+    _fluid.neighbourhood_list = nullptr;
+    _sb_neigh_list = nullptr;
+
+    CLAllocator::release_buffer(_fluid.cell_intervals);
+    _fluid.cell_intervals = nullptr;
+    _fluid.cell_intervals_count = 0;
+
+    _arena.release();
     cout << "done" << endl;
 }
 
+void WCSPHSimulation::_alloc_neigh_lists() {
+    CLAllocator::release_buffer(_fluid.neighbourhood_list);
+    CLAllocator::release_buffer(_sb_neigh_list);
+
+    _fluid.neighbourhood_list = CLAllocator::alloc_buffer<cl_int>("solver/neighbourhood_list", _fluid.capacity * _max_neigh_list_length);
+    _sb_neigh_list = CLAllocator::alloc_buffer<cl_int>("solver/sb_neigh_list", _fluid.capacity * _max_sb_neigh_list_length);
+}
+
+void WCSPHSimulation::_alloc_cell_intervals() {
+    int cells_count = _grid->info().cells_count;
+    if (_fluid.cell_intervals && cells_count == _fluid.cell_intervals_count) {
+        return;
+    }
+
+    CLAllocator::release_buffer(_fluid.cell_intervals);
+    _fluid.cell_intervals = CLAllocator::alloc_buffer<cl_int2>("grid/cell_intervals", cells_count);
+    _fluid.cell_intervals_count = cells_count;
+}
+
+void WCSPHSimulation::_fit_neigh_lists() {
+    int length = _grid->fit_list_length(NeighbourList::FLUID, _max_neigh_list_length);
+    int sb_length = _grid->fit_list_length(NeighbourList::BOUNDARY, _max_sb_neigh_list_length);
+    if (length == _max_neigh_list_length && sb_length == _max_sb_neigh_list_length) {
+        return;
+    }
+
+    cout << "Resizing neighbourhood lists to " << length << " fluid and " 
+         << sb_length << " boundary neighbours" << endl;
+
+    // The queue is in order, so the kernels of the last step are done
+    // with the lists before anything reuses them
+    _max_neigh_list_length = length;
+    _max_sb_neigh_list_length = sb_length;
+    _alloc_neigh_lists();
+
+    // The lists are built next, so every kernel must see the new ones
+    _setup_kernel_params();
+}
+
 WCSPHSimulation::~WCSPHSimulation() {
     _release_buffers();
 }
@@ -326,6 +451,7 @@ void WCSPHSimulation::_call_kernel(cl_kernel& k,
 
 WCSPHSimulation::FluidData::FluidData() :
 count(0),
+capacity(0),
 positions(nullptr),
 positions_sorted(nullptr),
 vel_t(nullptr),
@@ -350,12 +476,24 @@ void WCSPHSimulation::add_boundary(const shared_ptr<RigidBody> boundary,
                                     boundary_id, 
                                     can_move);
 
+    if (_batching) {
+        _pending_kernels = true;
+        return;
+    }
+
     // We reset all kernel params so that the static boundary buffers are
     // updated
     _build_kernels();
 }
 
 void WCSPHSimulation::_build_kernels() {
+    // The particle count is a kernel argument, so the program only depends
+    // on the support radius
+    if (_program && _program_support_radius == _support_radius) {
+        _setup_kernel_params();
+        return;
+    }
+
     // First, the program must be compiled
     CLCompiler compiler;
     compiler.add_file_source("kernels/wcsph.cl");
@@ -365,10 +503,10 @@ void WCSPHSimulation::_build_kernels() {
     compiler.add_include_path("kernels");
 
     // Define the constants for the program
-    compiler.define_constant("PARTICLE_COUNT", _fluid.count);
     compiler.define_constant("SUPPORT_RADIUS", _support_radius);
     compiler.define_constant("USE_MULLER_KERNELS");
     _program = compiler.build();
+    _program_support_radius = _support_radius;
 
     // Now reinitialize all kernel instances
     _kernel_density_n_pressure = _program->get_native_kernel("compute_density_pressure");
@@ -386,10 +524,49 @@ int WCSPHSimulation::boundary_particle_count() const {
 void WCSPHSimulation::add_volume(const std::shared_ptr<FluidVolume> volume) {
     _volumes.push_back(volume);
 
+    if (_batching) {
+        _pending_solver_init = true;
+        return;
+    }
+
     // Reinitialize the whole solver to hold the new particles
     _initialize_solver();
 }
 
+void WCSPHSimulation::add_emitter(const std::shared_ptr<FluidEmitter> emitter) {
+    throw RunTimeException("Fluid emitters are only supported by the PCISPH solver");
+}
+
+void WCSPHSimulation::add_sink(const std::shared_ptr<FluidSink> sink) {
+    throw RunTimeException("Fluid sinks are only supported by the PCISPH solver");
+}
+
+void WCSPHSimulation::begin_batch() {
+    _batching = true;
+    _boundary_handler->begin_batch();
+}
+
+void WCSPHSimulation::commit() {
+    if (!_batching) {
+        return;
+    }
+    _batching = false;
+
+    // All new boundaries are sampled in a single pass
+    _boundary_handler->commit();
+
+    // Initializing the solver also builds the kernels
+    if (_pending_solver_init) {
+        _initialize_solver();
+    }
+    else if (_pending_kernels) {
+        _build_kernels();
+    }
+
+    _pending_solver_init = false;
+    _pending_kernels = false;
+}
+
 void WCSPHSimulation::_initialize_solver() {
     // Reset grid cell size with the new support radius
     _grid->set_cell_size(_support_radius);
@@ -397,11 +574,13 @@ void WCSPHSimulation::_initialize_solver() {
     // Reinitialize all buffers
     _initialize_buffers();
 
-    // Rebuild all kernels
+    // Rebuild the kernels, if the support radius changed
     _build_kernels();
 
     // Configure kernel parameters once, call them later many times
     _setup_kernel_params();
+
+    _step = 0;
 }
 
 void WCSPHSimulation::set_rect_limits(float width, float height, float depth) {
@@ -411,4 +590,123 @@ void WCSPHSimulation::set_rect_limits(float width, float height, float depth) {
     _container_size.s[3] = 0.0f;
 
     _setup_kernel_params();
-}
\ No newline at end of file
+}
+
+void WCSPHSimulation::save_checkpoint(const string& path) {
+    cout << "Saving checkpoint to " << path << "..." << flush;
+
+    // The leapfrog integration needs both the velocities at t and t-1/2
+    CheckpointWriter writer(_fluid_settings, _sim_settings, _step);
+    writer.set_container_size(_container_size);
+    writer.add_buffer<cl_float4>(CHECKPOINT_POSITIONS, _fluid.positions, _fluid.count);
+    writer.add_buffer<cl_float4>(CHECKPOINT_VELOCITIES, _fluid.vel_t, _fluid.count);
+    writer.add_buffer<cl_float4>(CHECKPOINT_HALF_VELOCITIES, _fluid.vel_half_t, _fluid.count);
+    writer.add_bodies(_boundary_handler->bodies_state());
+
+    CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+    try {
+        writer.write(path);
+    }
+    catch (...) {
+        CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+        throw;
+    }
+    CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+
+    cout << "done!" << endl;
+}
+
+void WCSPHSimulation::load_checkpoint(const string& path) {
+    cout << "Loading checkpoint from " << path << "..." << flush;
+
+    CheckpointReader reader(path);
+    auto& header = reader.header();
+    if (header.sim_method != SimulationSettings::Method::WCSPH) {
+        throw RunTimeException("Checkpoint " + path + " was not saved by a WCSPH solver");
+    }
+
+    // Every section is checked before the solver is touched
+    reader.require<cl_float4>(CHECKPOINT_POSITIONS, header.particle_count);
+    reader.require<cl_float4>(CHECKPOINT_VELOCITIES, header.particle_count);
+    reader.require<cl_float4>(CHECKPOINT_HALF_VELOCITIES, header.particle_count);
+
+    // Restore the settings the checkpoint was taken with
+    _initialize_params(reader.physics_settings(), reader.simulation_settings());
+    _container_size = reader.container_size();
+
+    _boundary_handler->set_particle_radius(_particle_radius);
+    _boundary_handler->set_support_radius(_support_radius);
+    _grid->set_cell_size(_support_radius);
+
+    // Allocate the buffers, and fill them straight from the mapped file
+    _alloc_buffers(header.particle_count);
+
+    CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+    try {
+        reader.upload<cl_float4>(CHECKPOINT_POSITIONS, _fluid.positions);
+    }
+    catch (...) {
+        CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+        throw;
+    }
+    CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+
+    reader.upload<cl_float4>(CHECKPOINT_VELOCITIES, _fluid.vel_t);
+    reader.upload<cl_float4>(CHECKPOINT_HALF_VELOCITIES, _fluid.vel_half_t);
+
+    // Put the rigid bodies back where they were
+    _boundary_handler->restore_bodies_state(reader.bodies());
+
+    _build_kernels();
+    _setup_kernel_params();
+
+    _step = header.step;
+
+    cout << "done!" << endl;
+}
+
+void WCSPHSimulation::download_particles(cl_float4* positions,
+                                         cl_float4* velocities,
+                                         cl_float* densities,
+                                         cl_event* event) {
+    // The reads are enqueued before the release of the shared buffers, so the
+    // in-order queue keeps the positions valid until they are copied
+    CLAllocator::lock_gl_buffers(_gl_shared_buffers);
+
+    auto queue = CLEnvironment::queue();
+    cl_int err = clEnqueueReadBuffer(queue, _fluid.positions, CL_FALSE, 0,
+                                     sizeof(cl_float4) * _fluid.count, positions,
+                                     0, nullptr, nullptr);
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(queue, _fluid.vel_t, CL_FALSE, 0,
+                                  sizeof(cl_float4) * _fluid.count, velocities,
+                                  0, nullptr, nullptr);
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(queue, _fluid.densities, CL_FALSE, 0,
+                                  sizeof(cl_float) * _fluid.count, densities,
+                                  0, nullptr, event);
+    }
+
+    CLAllocator::unlock_gl_buffers(_gl_shared_buffers);
+    CLError::check(err);
+}
+
+vector<CheckpointBody> WCSPHSimulation::bodies_state() const {
+    return _boundary_handler->bodies_state();
+}
+
+bool WCSPHSimulation::particle_grid(ParticleGrid& particles) const {
+    particles.positions = _fluid.positions_sorted;
+    particles.cell_intervals = _fluid.cell_intervals;
+    particles.grid_info = _grid->info();
+    particles.particle_count = _fluid.count;
+    particles.particle_mass = _particle_mass;
+    particles.rest_density = _rest_density;
+    particles.support_radius = _support_radius;
+    return true;
+}
+
+bool WCSPHSimulation::set_metrics_buffer(GLuint vbo) {
+    return false;
+}
@@ -15,6 +15,7 @@
 #include <memory>
 #include "opencl/clenvironment.h"
 #include "opencl/clprogram.h"
+#include "opencl/clarena.h"
 #include "opengl/openglfunctions.h"
 #include "fluidsimulation.h"
 #include "grid.h"
@@ -70,6 +71,19 @@ class WCSPHSimulation : public FluidSimulation {
         void reset(const PhysicsSettings& fluid_settings,
                    const SimulationSettings& sim_settings);
 
+        /**
+         * @brief Updates the settings of the running simulation
+         * @details Coefficients are set as kernel arguments, keeping the
+         *          state of the fluid. Changing a radius needs a reset.
+         *
+         * @param fluid_settings Physical properties of the fluid.
+         * @param sim_settings Parameters of the simulation.
+         * @return True if the settings were applied, false if they need a
+         *         reset.
+         */
+        bool update_settings(const PhysicsSettings& fluid_settings,
+                             const SimulationSettings& sim_settings);
+
         /**
          * @brief Returs the number of particles used by the solver.
          * @return The count of particles being used in the simulation.
@@ -100,6 +114,29 @@ class WCSPHSimulation : public FluidSimulation {
          */
         void add_volume(const std::shared_ptr<FluidVolume> volume);
 
+        /**
+         * @brief Not supported by this solver
+         * @throws RunTimeException always.
+         */
+        void add_emitter(const std::shared_ptr<FluidEmitter> emitter);
+
+        /**
+         * @brief Not supported by this solver
+         * @throws RunTimeException always.
+         */
+        void add_sink(const std::shared_ptr<FluidSink> sink);
+
+        /**
+         * @brief Starts a batch of volumes and boundaries
+         */
+        void begin_batch();
+
+        /**
+         * @brief Samples the new boundaries, and initializes the solver 
+         *        once for everything added since begin_batch
+         */
+        void commit();
+
         /**
          * @brief Sets the limits of a rectangular container where the 
          * simulation takes place
@@ -110,6 +147,54 @@ class WCSPHSimulation : public FluidSimulation {
          */
         void set_rect_limits(float width, float height, float depth);
 
+        /**
+         * @brief Returns the number of steps simulated since the last reset
+         */
+        unsigned long step_count() const;
+
+        /**
+         * @brief Saves the full state of the solver to a checkpoint file
+         * 
+         * @param path The path of the checkpoint file.
+         */
+        void save_checkpoint(const std::string& path);
+
+        /**
+         * @brief Restores the full state of the solver from a checkpoint file
+         * 
+         * @param path The path of the checkpoint file.
+         */
+        void load_checkpoint(const std::string& path);
+
+        /**
+         * @brief Enqueues the non blocking download of the particles state
+         * 
+         * @param positions Destination of the particle positions.
+         * @param velocities Destination of the particle velocities.
+         * @param densities Destination of the particle densities.
+         * @param event Returns an event that completes with the last read.
+         */
+        void download_particles(cl_float4* positions,
+                                cl_float4* velocities,
+                                cl_float* densities,
+                                cl_event* event);
+
+        /**
+         * @brief Returns the state of every rigid body coupled with the fluid
+         */
+        std::vector<CheckpointBody> bodies_state() const;
+
+        /**
+         * @brief Returns the particles as binned by the last step
+         */
+        bool particle_grid(ParticleGrid& particles) const;
+
+        /**
+         * @brief The costs of the particles are only written by PCISPH
+         * @return Always false.
+         */
+        bool set_metrics_buffer(GLuint vbo);
+
     private:
         /* Uniform grid */
         std::unique_ptr<Grid> _grid;
@@ -120,6 +205,18 @@ class WCSPHSimulation : public FluidSimulation {
         /* A collection of fluid volumes */
         std::vector<std::shared_ptr<FluidVolume> > _volumes;
 
+        /* The number of steps simulated since the last reset */
+        unsigned long _step;
+
+        /* Set while a batch is being added, and what must be done on commit */
+        bool _batching;
+        bool _pending_solver_init;
+        bool _pending_kernels;
+
+        /* A copy of the settings the solver was initialized with */
+        PhysicsSettings _fluid_settings;
+        SimulationSettings _sim_settings;
+
         ///////////////////////////////////////////////////////////////
         /// MEMORY BUFFERS DECLARATIONS ///////////////////////////////
         ///////////////////////////////////////////////////////////////
@@ -129,6 +226,9 @@ class WCSPHSimulation : public FluidSimulation {
             /* Number of particles of the fluid simulation */
             int count;
 
+            /* Number of particles the buffers can hold */
+            int capacity;
+
             cl_mem positions, positions_sorted;
             cl_mem vel_t, vel_t_sorted;
             cl_mem vel_half_t, vel_half_t_sorted;
@@ -148,6 +248,9 @@ class WCSPHSimulation : public FluidSimulation {
              */
             cl_mem cell_intervals;
 
+            /* The number of cells the intervals were allocated for */
+            int cell_intervals_count;
+
             /**
              * A buffer that, for every position, has the size of the 
              * neighbourhood list.
@@ -157,7 +260,8 @@ class WCSPHSimulation : public FluidSimulation {
             /**
              * A buffer that holds, for each particles, a list of indices
              * of the particles in the neighbourhood. It is made of 
-             * count * max_neigh_list
+             * count * max_neigh_list. It is not in the arena, as it is
+             * resized on its own
              */
             cl_mem neighbourhood_list;
             
@@ -184,11 +288,17 @@ class WCSPHSimulation : public FluidSimulation {
          */
         std::vector<cl_mem> _gl_shared_buffers;
 
+        /* Holds every buffer of the particles, but the shared positions */
+        CLArena _arena;
+
         ///////////////////////////////////////////////////////////////
         /// OPENCL KERNEL DECLARATIONS ////////////////////////////////
         ///////////////////////////////////////////////////////////////
 
         std::unique_ptr<CLProgram> _program;
+        /* The support radius compiled into the program */
+        float _program_support_radius;
+
         cl_kernel _kernel_density_n_pressure;
         cl_kernel _kernel_acceleration;
         cl_kernel _kernel_time_itegration;
@@ -227,8 +337,10 @@ class WCSPHSimulation : public FluidSimulation {
         cl_float4 _container_size;
 
         // For each particle, this is the maximum particles in the
-        // neighbourhood to look at (and save)
-        const int _max_neigh_list_length = 100;
+        // neighbourhood to look at (and save), for the fluid and the 
+        // boundary lists. They are fitted to the scene as it runs
+        int _max_neigh_list_length;
+        int _max_sb_neigh_list_length;
 
         ///////////////////////////////////////////////////////////////
         /// AUXILIARY METHODS /////////////////////////////////////////
@@ -250,19 +362,47 @@ class WCSPHSimulation : public FluidSimulation {
          */
         void _initialize_buffers();
 
+        /**
+         * @brief Sets the live fluid particle count, allocating the internal
+         *        device buffers only if they can not hold that many
+         * 
+         * @param particle_count The number of fluid particles
+         */
+        void _alloc_buffers(int particle_count);
+
         /**
          * @brief Releses all internal device buffers 
          */
         void _release_buffers();
 
+        /**
+         * @brief (Re)Allocates the neighbourhood lists for the capacity, 
+         *        with their current length
+         */
+        void _alloc_neigh_lists();
+
+        /**
+         * @brief (Re)Allocates the cell intervals if the cells of the grid
+         *        changed
+         */
+        void _alloc_cell_intervals();
+
+        /**
+         * @brief Grows the neighbourhood lists if a particle had more 
+         *        neighbours than fit, or shrinks them if they are too long
+         * @details The statistics are read without blocking, so this is
+         *          decided with those of a step or so behind.
+         */
+        void _fit_neigh_lists();
+
         /**
          * @brief (Re)Initializes the solver internals
          */
         void _initialize_solver();
 
         /**
-         * @brief Rebuilds the OpenCL program, and reinitializes
-         *        all the kernels
+         * @brief Rebuilds the OpenCL program if the support radius
+         *        changed, and sets up all the kernel params
          */ 
         void _build_kernels();
 
@@ -270,6 +410,11 @@ class WCSPHSimulation : public FluidSimulation {
          * @brief Sets up the kernel parameters
          */
         void _setup_kernel_params();
+
+        /**
+         * @brief Sets the FluidParams argument of every kernel
+         */
+        void _setup_fluid_params();
        
         /**
          * @brief Calls a simulation kernel
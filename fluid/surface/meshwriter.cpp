@@ -0,0 +1,93 @@
+#include "meshwriter.h"
+#include "runtimeexception.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+void MeshWriter::write(const string& path, const SurfaceMesh& mesh) {
+    auto ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    if (ext == ".obj" || ext == ".OBJ") {
+        write_obj(path, mesh);
+    }
+    else {
+        write_ply(path, mesh);
+    }
+}
+
+void MeshWriter::write_ply(const string& path, const SurfaceMesh& mesh) {
+    ofstream out(path, ios::binary);
+    if (!out) {
+        throw RunTimeException("Could not open mesh file " + path);
+    }
+
+    size_t face_count = mesh.indices.size() / 3;
+
+    out << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << mesh.vertices.size() << "\n"
+        << "property float x\n"
+        << "property float y\n"
+        << "property float z\n"
+        << "property float nx\n"
+        << "property float ny\n"
+        << "property float nz\n"
+        << "element face " << face_count << "\n"
+        << "property list uchar uint vertex_indices\n"
+        << "end_header\n";
+
+    // Both vertices and faces are packed, so they are written in one go
+    vector<cl_float> vertices(6 * mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+            vertices[6*i + k] = mesh.vertices[i].s[k];
+            vertices[6*i + 3 + k] = mesh.normals[i].s[k];
+        }
+    }
+    out.write(reinterpret_cast<const char*>(vertices.data()),
+              vertices.size() * sizeof(cl_float));
+
+    const size_t face_size = sizeof(uint8_t) + 3 * sizeof(cl_uint);
+    vector<char> faces(face_count * face_size);
+    for (size_t i = 0; i < face_count; ++i) {
+        char* face = faces.data() + i * face_size;
+        face[0] = 3;
+        memcpy(face + 1, &mesh.indices[3*i], 3 * sizeof(cl_uint));
+    }
+    out.write(faces.data(), faces.size());
+
+    if (!out) {
+        throw RunTimeException("Could not write mesh file " + path);
+    }
+}
+
+void MeshWriter::write_obj(const string& path, const SurfaceMesh& mesh) {
+    // Text output is way faster through stdio than through streams
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out) {
+        throw RunTimeException("Could not open mesh file " + path);
+    }
+
+    for (auto& v : mesh.vertices) {
+        fprintf(out, "v %f %f %f\n", v.s[0], v.s[1], v.s[2]);
+    }
+    for (auto& n : mesh.normals) {
+        fprintf(out, "vn %f %f %f\n", n.s[0], n.s[1], n.s[2]);
+    }
+
+    // OBJ indices start at one
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        cl_uint a = mesh.indices[i] + 1;
+        cl_uint b = mesh.indices[i + 1] + 1;
+        cl_uint c = mesh.indices[i + 2] + 1;
+        fprintf(out, "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c);
+    }
+
+    bool failed = ferror(out);
+    fclose(out);
+    if (failed) {
+        throw RunTimeException("Could not write mesh file " + path);
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ *  @file meshwriter.h
+ *  @brief Contains the declaration of the MeshWriter class.
+ *
+ *  The MeshWriter saves surface meshes to disk, as PLY or OBJ files.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _MESH_WRITER_H_
+#define _MESH_WRITER_H_
+
+#include <string>
+
+#include "surfaceextractor.h"
+
+/**
+ * @class MeshWriter
+ * @brief Writes triangle meshes to disk
+ */
+class MeshWriter {
+    public:
+        /**
+         * @brief Writes a mesh, with the format given by the file extension
+         * @details Files ending in .obj are written as Wavefront OBJ, any
+         *          other as binary PLY.
+         *
+         * @param path Path of the file.
+         * @param mesh The mesh to write.
+         * @throws RunTimeException if the file can not be written.
+         */
+        static void write(const std::string& path, const SurfaceMesh& mesh);
+
+        /**
+         * @brief Writes a mesh as a binary little endian PLY file
+         * @details Every vertex has position and normal, and every face is
+         *          a list of three indices.
+         *
+         * @param path Path of the file.
+         * @param mesh The mesh to write.
+         * @throws RunTimeException if the file can not be written.
+         */
+        static void write_ply(const std::string& path, const SurfaceMesh& mesh);
+
+        /**
+         * @brief Writes a mesh as a Wavefront OBJ file
+         *
+         * @param path Path of the file.
+         * @param mesh The mesh to write.
+         * @throws RunTimeException if the file can not be written.
+         */
+        static void write_obj(const std::string& path, const SurfaceMesh& mesh);
+
+    private:
+        MeshWriter();
+};
+
+#endif // _MESH_WRITER_H_
@@ -0,0 +1,328 @@
+#include "surfaceextractor.h"
+#include "opencl/clallocator.h"
+#include "opencl/clenvironment.h"
+#include "opencl/algorithms/clscan.h"
+#include "fluid/simulation/mullerconstants.h"
+
+#include <sstream>
+
+using namespace std;
+
+SurfaceExtractor::SurfaceExtractor(int resolution, float iso_level) :
+_resolution(resolution),
+_iso_level(iso_level),
+_support_radius(0.0f),
+_density_scale(0.0f),
+_block_flags(nullptr),
+_block_offsets(nullptr),
+_cell_blocks(nullptr),
+_block_cells(nullptr),
+_cell_capacity(0),
+_samples(nullptr),
+_triangle_counts(nullptr),
+_triangle_offsets(nullptr),
+_edge_flags(nullptr),
+_vertex_offsets(nullptr),
+_block_capacity(0),
+_vertices(nullptr),
+_normals(nullptr),
+_indices(nullptr),
+_vertex_capacity(0),
+_triangle_capacity(0),
+_vertex_count(0),
+_triangle_count(0) {
+
+}
+
+SurfaceExtractor::~SurfaceExtractor() {
+    CLAllocator::release_buffer(_block_flags);
+    CLAllocator::release_buffer(_block_offsets);
+    CLAllocator::release_buffer(_cell_blocks);
+    CLAllocator::release_buffer(_block_cells);
+    CLAllocator::release_buffer(_samples);
+    CLAllocator::release_buffer(_triangle_counts);
+    CLAllocator::release_buffer(_triangle_offsets);
+    CLAllocator::release_buffer(_edge_flags);
+    CLAllocator::release_buffer(_vertex_offsets);
+    CLAllocator::release_buffer(_vertices);
+    CLAllocator::release_buffer(_normals);
+    CLAllocator::release_buffer(_indices);
+}
+
+void SurfaceExtractor::extract(const ParticleGrid& particles) {
+    // The kernel constants depend on the fluid, rebuild only when it changes
+    float density_scale = particles.particle_mass
+                        * MullerConstants::default_eval(particles.support_radius)
+                        / particles.rest_density;
+    if (!_program ||
+        particles.support_radius != _support_radius ||
+        density_scale != _density_scale) {
+        _build_kernels(particles.support_radius, density_scale);
+    }
+
+    GridInfo grid_info = particles.grid_info;
+    int cell_count = grid_info.cells_count;
+    _reserve_cells(cell_count);
+
+    // Find the active blocks, and compact them
+    _kernel_mark->set_arg(0, &particles.cell_intervals);
+    _kernel_mark->set_arg(1, &_block_flags);
+    _kernel_mark->set_arg(2, &grid_info);
+    auto err = _kernel_mark->run(cell_count);
+    CLError::check(err);
+
+    int block_count = _scan_total(_block_flags, _block_offsets, cell_count);
+
+    _kernel_compact->set_arg(0, &_block_flags);
+    _kernel_compact->set_arg(1, &_block_offsets);
+    _kernel_compact->set_arg(2, &_block_cells);
+    _kernel_compact->set_arg(3, &_cell_blocks);
+    _kernel_compact->set_arg(4, &cell_count);
+    err = _kernel_compact->run(cell_count);
+    CLError::check(err);
+
+    _vertex_count = 0;
+    _triangle_count = 0;
+    if (block_count == 0) {
+        return;
+    }
+
+    _reserve_blocks(block_count);
+
+    size_t samples_per_block = (_resolution + 1) * (_resolution + 1) * (_resolution + 1);
+    size_t voxels_per_block = _resolution * _resolution * _resolution;
+    size_t voxel_count = block_count * voxels_per_block;
+
+    // Sample the density, and classify every voxel
+    _kernel_samples->set_arg(0, &_block_cells);
+    _kernel_samples->set_arg(1, &particles.positions);
+    _kernel_samples->set_arg(2, &particles.cell_intervals);
+    _kernel_samples->set_arg(3, &_samples);
+    _kernel_samples->set_arg(4, &grid_info);
+    _kernel_samples->set_arg(5, &block_count);
+    err = _kernel_samples->run(block_count * samples_per_block);
+    CLError::check(err);
+
+    _kernel_classify->set_arg(0, &_samples);
+    _kernel_classify->set_arg(1, &_triangle_counts);
+    _kernel_classify->set_arg(2, &_edge_flags);
+    _kernel_classify->set_arg(3, &block_count);
+    err = _kernel_classify->run(voxel_count);
+    CLError::check(err);
+
+    size_t vertex_count = _scan_total(_edge_flags, _vertex_offsets, 3 * voxel_count);
+    size_t triangle_count = _scan_total(_triangle_counts, _triangle_offsets, voxel_count);
+    _reserve_mesh(vertex_count, triangle_count);
+
+    // Finally, build the mesh
+    _kernel_vertices->set_arg(0, &_block_cells);
+    _kernel_vertices->set_arg(1, &_samples);
+    _kernel_vertices->set_arg(2, &_edge_flags);
+    _kernel_vertices->set_arg(3, &_vertex_offsets);
+    _kernel_vertices->set_arg(4, &_vertices);
+    _kernel_vertices->set_arg(5, &_normals);
+    _kernel_vertices->set_arg(6, &grid_info);
+    _kernel_vertices->set_arg(7, &block_count);
+    err = _kernel_vertices->run(3 * voxel_count);
+    CLError::check(err);
+
+    _kernel_triangles->set_arg(0, &_block_cells);
+    _kernel_triangles->set_arg(1, &_cell_blocks);
+    _kernel_triangles->set_arg(2, &_samples);
+    _kernel_triangles->set_arg(3, &_triangle_offsets);
+    _kernel_triangles->set_arg(4, &_vertex_offsets);
+    _kernel_triangles->set_arg(5, &_indices);
+    _kernel_triangles->set_arg(6, &grid_info);
+    _kernel_triangles->set_arg(7, &block_count);
+    err = _kernel_triangles->run(voxel_count);
+    CLError::check(err);
+
+    _vertex_count = vertex_count;
+    _triangle_count = triangle_count;
+}
+
+size_t SurfaceExtractor::vertex_count() const {
+    return _vertex_count;
+}
+
+size_t SurfaceExtractor::triangle_count() const {
+    return _triangle_count;
+}
+
+cl_mem SurfaceExtractor::vertices() const {
+    return _vertices;
+}
+
+cl_mem SurfaceExtractor::normals() const {
+    return _normals;
+}
+
+cl_mem SurfaceExtractor::indices() const {
+    return _indices;
+}
+
+void SurfaceExtractor::download(SurfaceMesh& mesh) const {
+    mesh.vertices.resize(_vertex_count);
+    mesh.normals.resize(_vertex_count);
+    mesh.indices.resize(3 * _triangle_count);
+
+    if (_triangle_count == 0) {
+        return;
+    }
+
+    CLAllocator::download_buffer(_vertices, mesh.vertices);
+    CLAllocator::download_buffer(_normals, mesh.normals);
+    CLAllocator::download_buffer(_indices, mesh.indices);
+}
+
+void SurfaceExtractor::copy_to_gl(GLuint vbo_vertices, GLuint vbo_normals, GLuint ibo) const {
+    // Zero sized buffers can not be shared with OpenCL
+    size_t vertex_count = max<size_t>(_vertex_count, 1);
+    size_t index_count = max<size_t>(3 * _triangle_count, 3);
+
+    auto gl_vertices = CLAllocator::alloc_gl_buffer<cl_float4>("surface/gl_vertices", vertex_count, vbo_vertices);
+    auto gl_normals = CLAllocator::alloc_gl_buffer<cl_float4>("surface/gl_normals", vertex_count, vbo_normals);
+    auto gl_indices = CLAllocator::alloc_gl_buffer<cl_uint>("surface/gl_indices", index_count, ibo);
+
+    vector<cl_mem> gl_buffers = {gl_vertices, gl_normals, gl_indices};
+    CLAllocator::lock_gl_buffers(gl_buffers);
+    if (_triangle_count > 0) {
+        CLAllocator::copy_full_buffer<cl_float4>(_vertices, gl_vertices, _vertex_count);
+        CLAllocator::copy_full_buffer<cl_float4>(_normals, gl_normals, _vertex_count);
+        CLAllocator::copy_full_buffer<cl_uint>(_indices, gl_indices, 3 * _triangle_count);
+    }
+    CLAllocator::unlock_gl_buffers(gl_buffers);
+
+    auto err = clFinish(CLEnvironment::queue());
+    CLError::check(err);
+
+    for (auto b : gl_buffers) {
+        CLAllocator::release_buffer(b);
+    }
+}
+
+void SurfaceExtractor::_build_kernels(float support_radius, float density_scale) {
+    // The density scale may be very large or very small, so it can not
+    // be written with a fixed number of decimals
+    ostringstream scale;
+    scale.precision(9);
+    scale << scientific << density_scale << "f";
+
+    CLCompiler compiler;
+    compiler.add_file_source("kernels/marchingcubes.cl");
+    compiler.add_build_option("-cl-std=CL1.2");
+    compiler.add_build_option("-cl-fast-relaxed-math");
+    compiler.add_build_option("-cl-mad-enable");
+    compiler.add_include_path("kernels");
+    compiler.define_constant("MC_RESOLUTION", _resolution);
+    compiler.define_constant("ISO_LEVEL", _iso_level);
+    compiler.define_constant("SUPPORT_RADIUS", support_radius, 9);
+    compiler.define_constant("DENSITY_SCALE", scale.str());
+
+    _program = compiler.build();
+
+    _kernel_mark = _program->get_kernel("mark_active_blocks");
+    _kernel_compact = _program->get_kernel("compact_blocks");
+    _kernel_samples = _program->get_kernel("compute_block_samples");
+    _kernel_classify = _program->get_kernel("classify_voxels");
+    _kernel_vertices = _program->get_kernel("generate_vertices");
+    _kernel_triangles = _program->get_kernel("generate_triangles");
+
+    _support_radius = support_radius;
+    _density_scale = density_scale;
+}
+
+void SurfaceExtractor::_reserve_cells(size_t count) {
+    if (count <= _cell_capacity) {
+        return;
+    }
+
+    CLAllocator::release_buffer(_block_flags);
+    CLAllocator::release_buffer(_block_offsets);
+    CLAllocator::release_buffer(_cell_blocks);
+    CLAllocator::release_buffer(_block_cells);
+
+    _block_flags = CLAllocator::alloc_buffer<cl_uint>("surface/block_flags", count);
+    _block_offsets = CLAllocator::alloc_buffer<cl_uint>("surface/block_offsets", count);
+    _cell_blocks = CLAllocator::alloc_buffer<cl_int>("surface/cell_blocks", count);
+    _block_cells = CLAllocator::alloc_buffer<cl_int>("surface/block_cells", count);
+    _cell_capacity = count;
+}
+
+void SurfaceExtractor::_reserve_blocks(size_t count) {
+    if (count <= _block_capacity) {
+        return;
+    }
+
+    // Leave some room, so the buffers are not reallocated every frame as
+    // the fluid moves around
+    count += count / 4;
+
+    CLAllocator::release_buffer(_samples);
+    CLAllocator::release_buffer(_triangle_counts);
+    CLAllocator::release_buffer(_triangle_offsets);
+    CLAllocator::release_buffer(_edge_flags);
+    CLAllocator::release_buffer(_vertex_offsets);
+
+    size_t samples = count * (_resolution + 1) * (_resolution + 1) * (_resolution + 1);
+    size_t voxels = count * _resolution * _resolution * _resolution;
+
+    _samples = CLAllocator::alloc_buffer<cl_float>("surface/samples", samples);
+    _triangle_counts = CLAllocator::alloc_buffer<cl_uint>("surface/triangle_counts", voxels);
+    _triangle_offsets = CLAllocator::alloc_buffer<cl_uint>("surface/triangle_offsets", voxels);
+    _edge_flags = CLAllocator::alloc_buffer<cl_uint>("surface/edge_flags", 3 * voxels);
+    _vertex_offsets = CLAllocator::alloc_buffer<cl_uint>("surface/vertex_offsets", 3 * voxels);
+    _block_capacity = count;
+}
+
+void SurfaceExtractor::_reserve_mesh(size_t vertex_count, size_t triangle_count) {
+    vertex_count = max<size_t>(vertex_count, 1);
+    triangle_count = max<size_t>(triangle_count, 1);
+
+    if (vertex_count > _vertex_capacity) {
+        vertex_count += vertex_count / 4;
+        CLAllocator::release_buffer(_vertices);
+        CLAllocator::release_buffer(_normals);
+        _vertices = CLAllocator::alloc_buffer<cl_float4>("surface/vertices", vertex_count);
+        _normals = CLAllocator::alloc_buffer<cl_float4>("surface/normals", vertex_count);
+        _vertex_capacity = vertex_count;
+    }
+
+    if (triangle_count > _triangle_capacity) {
+        triangle_count += triangle_count / 4;
+        CLAllocator::release_buffer(_indices);
+        _indices = CLAllocator::alloc_buffer<cl_uint>("surface/indices", 3 * triangle_count);
+        _triangle_capacity = triangle_count;
+    }
+}
+
+cl_uint SurfaceExtractor::_scan_total(cl_mem flags, cl_mem offsets, size_t count) {
+    auto err = clscan<cl_uint>(flags, offsets, count);
+    CLError::check(err);
+
+    // The scan is exclusive, so the total is the last offset plus the
+    // last flag
+    cl_uint last[2];
+    err = clEnqueueReadBuffer(CLEnvironment::queue(),
+                              offsets,
+                              CL_FALSE,
+                              (count - 1) * sizeof(cl_uint),
+                              sizeof(cl_uint),
+                              &last[0],
+                              0,
+                              nullptr,
+                              nullptr);
+    CLError::check(err);
+    err = clEnqueueReadBuffer(CLEnvironment::queue(),
+                              flags,
+                              CL_TRUE,
+                              (count - 1) * sizeof(cl_uint),
+                              sizeof(cl_uint),
+                              &last[1],
+                              0,
+                              nullptr,
+                              nullptr);
+    CLError::check(err);
+
+    return last[0] + last[1];
+}
@@ -0,0 +1,164 @@
+/**
+ *  @file surfaceextractor.h
+ *  @brief Contains the declaration of the SurfaceExtractor class.
+ *
+ *  This contains the prototype for the SurfaceExtractor class, that builds
+ *  a triangle mesh of the fluid surface on the device.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _SURFACE_EXTRACTOR_H_
+#define _SURFACE_EXTRACTOR_H_
+
+#include <memory>
+#include <vector>
+#include <GL/gl.h>
+#include <CL/cl.h>
+
+#include "opencl/clcompiler.h"
+#include "fluid/simulation/grid.h"
+
+/**
+ * @brief A host copy of a triangle mesh
+ */
+struct SurfaceMesh {
+    std::vector<cl_float4> vertices;
+    std::vector<cl_float4> normals;
+    // Three indices per triangle, counter clockwise seen from outside
+    std::vector<cl_uint> indices;
+};
+
+/**
+ * @class SurfaceExtractor
+ * @brief Extracts the fluid surface with marching cubes
+ * @details Every cell of the uniform grid that has particles around is
+ *          an active block, divided into resolution^3 voxels. The density
+ *          is sampled at the corners of the voxels of the active blocks
+ *          only, using the cell intervals the solver already computed, and
+ *          marching cubes is run over them. Active blocks, crossed edges and
+ *          triangles are compacted with prefix sums, so the result is an
+ *          indexed triangle mesh with no duplicated vertices, left in device
+ *          buffers.
+ */
+class SurfaceExtractor {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param resolution Number of voxels per side of every grid cell.
+         * @param iso_level The surface is where the density is this fraction
+         *                  of the rest density.
+         */
+        SurfaceExtractor(int resolution=4, float iso_level=0.5f);
+
+        /**
+         * @brief Destructor
+         * @details Releases all the device buffers.
+         */
+        ~SurfaceExtractor();
+
+        /**
+         * @brief Extracts the surface of a set of particles
+         * @details Device buffers grow as needed, and are never shrunk.
+         *
+         * @param particles The particles, as binned by the solver.
+         */
+        void extract(const ParticleGrid& particles);
+
+        /**
+         * @brief Returns the number of vertices of the last mesh
+         */
+        size_t vertex_count() const;
+
+        /**
+         * @brief Returns the number of triangles of the last mesh
+         */
+        size_t triangle_count() const;
+
+        /**
+         * @brief Device buffer of cl_float4 with the vertices of the mesh
+         */
+        cl_mem vertices() const;
+
+        /**
+         * @brief Device buffer of cl_float4 with the normals of the mesh
+         */
+        cl_mem normals() const;
+
+        /**
+         * @brief Device buffer of cl_uint with three indices per triangle
+         */
+        cl_mem indices() const;
+
+        /**
+         * @brief Downloads the last mesh to the host
+         *
+         * @param mesh The mesh where to copy the vertices, normals and indices.
+         */
+        void download(SurfaceMesh& mesh) const;
+
+        /**
+         * @brief Copies the last mesh to OpenGL buffers
+         * @details The buffers are resized to fit the mesh exactly, and
+         *          filled on the device, without going through the host.
+         *
+         * @param vbo_vertices The VBO for the vertices, as vec4.
+         * @param vbo_normals The VBO for the normals, as vec4.
+         * @param ibo The buffer for the indices, as unsigned int.
+         */
+        void copy_to_gl(GLuint vbo_vertices, GLuint vbo_normals, GLuint ibo) const;
+
+    private:
+        int _resolution;
+        float _iso_level;
+
+        // Parameters the program was built with
+        float _support_radius;
+        float _density_scale;
+
+        std::unique_ptr<CLProgram> _program;
+        std::shared_ptr<CLKernel> _kernel_mark;
+        std::shared_ptr<CLKernel> _kernel_compact;
+        std::shared_ptr<CLKernel> _kernel_samples;
+        std::shared_ptr<CLKernel> _kernel_classify;
+        std::shared_ptr<CLKernel> _kernel_vertices;
+        std::shared_ptr<CLKernel> _kernel_triangles;
+
+        // One element per grid cell
+        cl_mem _block_flags;
+        cl_mem _block_offsets;
+        cl_mem _cell_blocks;
+        cl_mem _block_cells;
+        size_t _cell_capacity;
+
+        // One element per voxel (or sample) of the active blocks
+        cl_mem _samples;
+        cl_mem _triangle_counts;
+        cl_mem _triangle_offsets;
+        cl_mem _edge_flags;
+        cl_mem _vertex_offsets;
+        size_t _block_capacity;
+
+        // The mesh
+        cl_mem _vertices;
+        cl_mem _normals;
+        cl_mem _indices;
+        size_t _vertex_capacity;
+        size_t _triangle_capacity;
+
+        size_t _vertex_count;
+        size_t _triangle_count;
+
+        void _build_kernels(float support_radius, float density_scale);
+
+        void _reserve_cells(size_t count);
+
+        void _reserve_blocks(size_t count);
+
+        void _reserve_mesh(size_t vertex_count, size_t triangle_count);
+
+        cl_uint _scan_total(cl_mem flags, cl_mem offsets, size_t count);
+};
+
+#endif // _SURFACE_EXTRACTOR_H_
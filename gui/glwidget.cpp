@@ -9,20 +9,30 @@
 #include "glwidget.h"
 #include "opengl/openglfunctions.h"
 #include "scene/fluid.h"
+#include "fluid/simulation/replaysimulation.h"
 #include "opencl/clenvironment.h"
+#include "profiling/frameprofiler.h"
 #include <QOpenGLFunctions_4_5_Core>
 
 using namespace std;
 
 GLWidget::GLWidget(QWidget *parent)
     : QOpenGLWidget(parent),
-      _paused(false) {
+      _paused(false),
+      _failed(false),
+      _checkpoint_interval(0),
+      _last_checkpoint_step(0),
+      _record_interval(0),
+      _surface_interval(0) {
 
     setMouseTracking(false);
 }
 
 GLWidget::~GLWidget() {
-
+    // The profiler holds queries of this context
+    makeCurrent();
+    FrameProfiler::release();
+    doneCurrent();
 }
 
 QSize GLWidget::minimumSizeHint() const {
@@ -48,13 +58,47 @@ void GLWidget::initializeGL() {
 
 void GLWidget::paintGL() {
     auto t0 = chrono::high_resolution_clock::now();
+    FrameProfiler::begin_frame();
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!scene) {
+        FrameProfiler::end_frame();
+        return;
+    }
+
     float time_step = Settings::simulation().time_step;
-    if (_paused) {
+    if (_paused || _failed) {
         time_step = 0.0f;
     }
-    scene->render(time_step, defaultFramebufferObject());
+
+    // Emitters and neighbour lists grow while the simulation runs, and may
+    // not fit in the device
+    try {
+        scene->render(time_step, defaultFramebufferObject());
+    }
+    catch (const exception& e) {
+        _report_failure(tr("Simulation"), e);
+    }
+
+    auto replay = _replay();
+    if (replay) {
+        emit(replay_position_changed(replay->current_frame(), replay->frame_count()));
+    }
+
+    if (_checkpoint_interval > 0) {
+        auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+        auto step = fluid->simulation().step_count();
+        if (step < _last_checkpoint_step) {
+            // The simulation has been reset
+            _last_checkpoint_step = step;
+        }
+        else if (step - _last_checkpoint_step >= (unsigned long)_checkpoint_interval) {
+            fluid->save_checkpoint(_checkpoint_file);
+            _last_checkpoint_step = step;
+        }
+    }
+
+    FrameProfiler::end_frame();
 
     auto tf = chrono::high_resolution_clock::now();
     auto d = chrono::duration_cast<chrono::milliseconds>(tf-t0);
@@ -86,7 +130,9 @@ void GLWidget::resizeGL(int w, int h) {
     p.fov = 45.0;
     p.width = w;
     p.height = h;
-    scene->camera().set_perspective(p);
+    if (scene) {
+        scene->camera().set_perspective(p);
+    }
 }
 
 void GLWidget::mousePressEvent(QMouseEvent *event) {
@@ -96,7 +142,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event) {
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent *event) {
-    if (event->buttons() & Qt::RightButton) {
+    if (scene && event->buttons() & Qt::RightButton) {
         QVector2D currentPos = QVector2D(event->pos());
         QVector2D v = mousePressPosition - currentPos;
         float pitch = v.x();
@@ -110,10 +156,27 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event) {
 }
 
 void GLWidget::wheelEvent(QWheelEvent * event) {
-    scene->camera().add_zoom(event->delta() * -0.005);
+    if (scene) {
+        scene->camera().add_zoom(event->delta() * -0.005);
+    }
 }
 
 void GLWidget::init_scene() {
+    try {
+        _load_scene();
+    }
+    catch (const exception& e) {
+        // There is nothing to show without a scene
+        scene.reset();
+        auto message = QString::fromStdString(e.what());
+        QTimer::singleShot(0, this, [this, message]() {
+            QMessageBox::critical(this, tr("Load scene"), message);
+            qApp->quit();
+        });
+    }
+}
+
+void GLWidget::_load_scene() {
     int w = width();
     int h = height();
 
@@ -125,18 +188,63 @@ void GLWidget::init_scene() {
                             QVector3D(0,1,0));
 
     auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+    if (_restore_file != "") {
+        fluid->load_checkpoint(_restore_file);
+        _last_checkpoint_step = fluid->simulation().step_count();
+    }
+    if (_record_file != "") {
+        fluid->start_recording(_record_file, _record_interval);
+    }
+    if (_surface_file != "") {
+        fluid->set_surface_export(_surface_file, _surface_interval);
+    }
     emit(particle_count_changed(fluid->particle_count(), fluid->boundary_particle_count()));
 }
 
 void GLWidget::reset(SimulationSettings s_settings,
                      PhysicsSettings p_settings,
                      GraphicsSettings g_settings) {
+    if (!scene) {
+        return;
+    }
+
     makeCurrent();
 
-    scene->reset(s_settings, p_settings, g_settings);
-    auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
-    if (fluid) {
-        emit(particle_count_changed(fluid->particle_count(), fluid->boundary_particle_count()));
+    // A reset allocates everything again, so it also recovers from a
+    // failure
+    try {
+        scene->reset(s_settings, p_settings, g_settings);
+        _failed = false;
+        auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+        if (fluid) {
+            emit(particle_count_changed(fluid->particle_count(), fluid->boundary_particle_count()));
+        }
+    }
+    catch (const exception& e) {
+        _report_failure(tr("Reset"), e);
+    }
+
+    doneCurrent();
+}
+
+void GLWidget::apply_settings(SimulationSettings s_settings,
+                              PhysicsSettings p_settings,
+                              GraphicsSettings g_settings) {
+    if (!scene) {
+        return;
+    }
+
+    makeCurrent();
+
+    try {
+        scene->apply_settings(s_settings, p_settings, g_settings);
+        auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+        if (fluid) {
+            emit(particle_count_changed(fluid->particle_count(), fluid->boundary_particle_count()));
+        }
+    }
+    catch (const exception& e) {
+        _report_failure(tr("Apply settings"), e);
     }
 
     doneCurrent();
@@ -148,4 +256,104 @@ void GLWidget::pause_simulation() {
 
 void GLWidget::unpause_simulation() {
     _paused = false;
-}
\ No newline at end of file
+}
+
+void GLWidget::set_checkpointing(const string& path, int interval) {
+    _checkpoint_file = path;
+    _checkpoint_interval = interval;
+}
+
+void GLWidget::set_restore_checkpoint(const string& path) {
+    _restore_file = path;
+}
+
+void GLWidget::set_recording(const string& path, int interval) {
+    _record_file = path;
+    _record_interval = interval;
+}
+
+void GLWidget::set_surface_export(const string& path, int interval) {
+    _surface_file = path;
+    _surface_interval = interval;
+}
+
+void GLWidget::save_checkpoint(const QString& path) {
+    if (!scene) {
+        return;
+    }
+
+    makeCurrent();
+
+    auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+    if (fluid) {
+        // A bad path must not take the whole application down
+        try {
+            fluid->save_checkpoint(path.toStdString());
+        }
+        catch (const exception& e) {
+            QMessageBox::warning(this, tr("Save checkpoint"), QString::fromStdString(e.what()));
+        }
+    }
+
+    doneCurrent();
+}
+
+void GLWidget::load_checkpoint(const QString& path) {
+    if (!scene) {
+        return;
+    }
+
+    makeCurrent();
+
+    auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+    if (fluid) {
+        // The solvers check the file before changing their state, so the
+        // simulation goes on as it was
+        try {
+            fluid->load_checkpoint(path.toStdString());
+            _last_checkpoint_step = fluid->simulation().step_count();
+            emit(particle_count_changed(fluid->particle_count(), fluid->boundary_particle_count()));
+        }
+        catch (const exception& e) {
+            QMessageBox::warning(this, tr("Load checkpoint"), QString::fromStdString(e.what()));
+        }
+    }
+
+    doneCurrent();
+}
+
+void GLWidget::seek_replay(int frame) {
+    if (_replay()) {
+        // Through the fluid, so the renderer follows the particle count
+        auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+        makeCurrent();
+        fluid->seek_replay(frame);
+        doneCurrent();
+        update();
+    }
+}
+
+void GLWidget::_report_failure(const QString& title, const exception& e) {
+    // Any step could need the memory that is missing
+    _failed = true;
+
+    // Not from within a paint or a slot that holds the context
+    auto message = QString::fromStdString(e.what()) +
+                   tr("\n\nThe simulation is stopped until it is reset.");
+    QTimer::singleShot(0, this, [this, title, message]() {
+        QMessageBox::critical(this, title, message);
+    });
+}
+
+ReplaySimulation* GLWidget::_replay() {
+    if (!scene) {
+        return nullptr;
+    }
+
+    auto fluid = std::dynamic_pointer_cast<Fluid>(scene->get_object("fluid"));
+    if (!fluid) {
+        return nullptr;
+    }
+
+    return dynamic_cast<ReplaySimulation*>(&fluid->simulation());
+}
@@ -1,6 +1,7 @@
 #ifndef _GLWIDGET_H_
 #define _GLWIDGET_H_
 
+#include <exception>
 #include <memory>
 
 #include <QOpenGLWidget>
@@ -9,6 +10,8 @@
 #include "scene/scene.h"
 #include "settings/settings.h"
 
+class ReplaySimulation;
+
 class GLWidget : public QOpenGLWidget {
     Q_OBJECT
 
@@ -19,12 +22,50 @@ class GLWidget : public QOpenGLWidget {
         QSize minimumSizeHint() const;
         QSize sizeHint() const;
 
+        /**
+         * @brief Configures periodic checkpoints of the simulation
+         * 
+         * @param path The checkpoint file, overwritten on every save
+         * @param interval Number of simulation steps between checkpoints. 
+         *                 Zero disables periodic checkpoints.
+         */
+        void set_checkpointing(const std::string& path, int interval);
+
+        /**
+         * @brief Sets a checkpoint to restore once the scene is loaded
+         * 
+         * @param path The checkpoint file
+         */
+        void set_restore_checkpoint(const std::string& path);
+
+        /**
+         * @brief Records the fluid particles once the scene is loaded
+         * 
+         * @param path The recording file
+         * @param interval Number of simulation steps between frames
+         */
+        void set_recording(const std::string& path, int interval);
+
+        /**
+         * @brief Exports the fluid surface meshes once the scene is loaded
+         * 
+         * @param path The mesh files path, the step is appended to it
+         * @param interval Number of simulation steps between meshes
+         */
+        void set_surface_export(const std::string& path, int interval);
+
     public slots:
         void reset(SimulationSettings s_settings,
                    PhysicsSettings p_settings,
                    GraphicsSettings g_settings);
+        void apply_settings(SimulationSettings s_settings,
+                            PhysicsSettings p_settings,
+                            GraphicsSettings g_settings);
         void pause_simulation();
         void unpause_simulation();
+        void save_checkpoint(const QString& path);
+        void load_checkpoint(const QString& path);
+        void seek_replay(int frame);
 
     protected:
         void initializeGL();
@@ -38,13 +79,45 @@ class GLWidget : public QOpenGLWidget {
     signals:
         void new_frame(float current_fps);
         void particle_count_changed(int fluid_count, int boundary_count);
+        void replay_position_changed(int frame, int frame_count);
 
     private:
         //The scene holds all renderable objects as well
         //as the camera with its projection
         std::unique_ptr<Scene> scene;
         bool _paused;
+
+        // Set when the simulation could not get its memory. Nothing is
+        // simulated until a reset succeeds
+        bool _failed;
+
         QVector2D mousePressPosition;
+
+        // Periodic checkpoints
+        std::string _checkpoint_file;
+        int _checkpoint_interval;
+        unsigned long _last_checkpoint_step;
+
+        // Checkpoint to restore when the scene is initialized
+        std::string _restore_file;
+
+        // Recording started when the scene is initialized
+        std::string _record_file;
+        int _record_interval;
+
+        // Surface export started when the scene is initialized
+        std::string _surface_file;
+        int _surface_interval;
+
+        // Returns the fluid simulation if it is a replay, or null
+        ReplaySimulation* _replay();
+
+        // Stops the simulation, and shows why once the current event is
+        // done
+        void _report_failure(const QString& title, const std::exception& e);
+
+        // Loads the scene of the settings, and what it starts with
+        void _load_scene();
 };
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "graphicsoptionstab.h"
 #include <QFormLayout>
 #include <QIntValidator>
+#include <QDoubleValidator>
 #include <QColorDialog>
 
 #include <iostream>
@@ -28,15 +29,70 @@ QWidget(parent) {
     connect(_sspace_filter_iterations, SIGNAL(textEdited(const QString&)),
             this, SLOT(_text_edited(const QString&)));
 
+    _sspace_depth_filter = new QComboBox(this);
+    _sspace_depth_filter->addItem("Bilateral", BILATERAL);
+    _sspace_depth_filter->addItem("Separable bilateral", SEPARABLE_BILATERAL);
+    _sspace_depth_filter->addItem("Bilateral (compute shader)", COMPUTE_BILATERAL);
+    _sspace_depth_filter->addItem("Curvature flow (compute shader)", COMPUTE_CURVATURE_FLOW);
+    connect(_sspace_depth_filter,
+            SIGNAL(currentIndexChanged(int)),
+            this,
+            SLOT(_option_changed(int)));
+
+    _sspace_resolution_scale = new QLineEdit(this);
+    _sspace_resolution_scale->setValidator(new QDoubleValidator(0.25, 1.0, 2, this));
+    connect(_sspace_resolution_scale, SIGNAL(textEdited(const QString&)),
+            this, SLOT(_text_edited(const QString&)));
+
+    _sspace_target_frame_time = new QLineEdit(this);
+    _sspace_target_frame_time->setValidator(new QDoubleValidator(0.0, 1000.0, 1, this));
+    _sspace_target_frame_time->setToolTip(tr("Milliseconds, 0 keeps the resolution fixed"));
+    connect(_sspace_target_frame_time, SIGNAL(textEdited(const QString&)),
+            this, SLOT(_text_edited(const QString&)));
+
+    _sspace_reduced_precision = new QCheckBox(this);
+    _sspace_reduced_precision->setToolTip(tr("16 bit depth, and 10 bit background color"));
+    connect(_sspace_reduced_precision, SIGNAL(toggled(bool)),
+            this, SLOT(_option_toggled(bool)));
+
     _sspace_group = new QGroupBox("Screen space method properties", this);
     QFormLayout* sspace_group_layout = new QFormLayout();
     sspace_group_layout->addRow(tr("&Filter iterations:"), _sspace_filter_iterations);
+    sspace_group_layout->addRow(tr("&Depth filter:"), _sspace_depth_filter);
+    sspace_group_layout->addRow(tr("&Resolution scale:"), _sspace_resolution_scale);
+    sspace_group_layout->addRow(tr("&Target frame time:"), _sspace_target_frame_time);
+    sspace_group_layout->addRow(tr("Reduced &precision:"), _sspace_reduced_precision);
     _sspace_group->setLayout(sspace_group_layout);
 
+    _particles_lod_distance = new QLineEdit(this);
+    _particles_lod_distance->setValidator(new QDoubleValidator(0.0, 1000.0, 2, this));
+    _particles_lod_distance->setToolTip(tr("Distance where particles start being subsampled, 0 draws them all"));
+    connect(_particles_lod_distance, SIGNAL(textEdited(const QString&)),
+            this, SLOT(_text_edited(const QString&)));
+
+    _particles_coloring = new QComboBox(this);
+    _particles_coloring->addItem("Fluid color", FLUID_COLOR);
+    _particles_coloring->addItem("Neighbour count", NEIGHBOUR_COUNT);
+    _particles_coloring->addItem("Truncated neighbour lists", TRUNCATED_LISTS);
+    _particles_coloring->addItem("Density error (PCISPH)", DENSITY_ERROR);
+    _particles_coloring->addItem("Boundary neighbours", BOUNDARY_NEIGHBOURS);
+    _particles_coloring->setToolTip(tr("Costs of the particles, from blue to red"));
+    connect(_particles_coloring,
+            SIGNAL(currentIndexChanged(int)),
+            this,
+            SLOT(_option_changed(int)));
+
+    _particles_group = new QGroupBox("Particles method properties", this);
+    QFormLayout* particles_group_layout = new QFormLayout();
+    particles_group_layout->addRow(tr("&LOD distance:"), _particles_lod_distance);
+    particles_group_layout->addRow(tr("&Coloring:"), _particles_coloring);
+    _particles_group->setLayout(particles_group_layout);
+
     QFormLayout* form_layout = new QFormLayout();
     form_layout->addRow(tr("&Fluid color:"), _fluid_color_button);
     form_layout->addRow(tr("&Method:"), _render_method);
     form_layout->addRow(_sspace_group);
+    form_layout->addRow(_particles_group);
     
     setLayout(form_layout);
 
@@ -52,6 +108,12 @@ void GraphicsOptionsTab::set_settings(const GraphicsSettings& s) {
     _set_button_color(_fluid_color_button, s.fluid_color);
     _render_method->setCurrentIndex(s.render_method);
     _sspace_filter_iterations->setText(QString::number(s.sspace_filter_iterations));
+    _sspace_depth_filter->setCurrentIndex(_sspace_depth_filter->findData(s.sspace_depth_filter));
+    _sspace_resolution_scale->setText(QString::number(s.sspace_resolution_scale));
+    _sspace_target_frame_time->setText(QString::number(s.sspace_target_frame_time));
+    _sspace_reduced_precision->setChecked(s.sspace_reduced_precision);
+    _particles_lod_distance->setText(QString::number(s.particles_lod_distance));
+    _particles_coloring->setCurrentIndex(_particles_coloring->findData(s.particles_coloring));
 }
 
 GraphicsSettings GraphicsOptionsTab::get_settings() const {
@@ -60,6 +122,12 @@ GraphicsSettings GraphicsOptionsTab::get_settings() const {
     s.fluid_color = _get_button_color(_fluid_color_button);
     s.render_method = (RenderMethod)_render_method->itemData(_render_method->currentIndex()).value<int>();
     s.sspace_filter_iterations = _sspace_filter_iterations->text().toInt();
+    s.sspace_depth_filter = (DepthFilter)_sspace_depth_filter->itemData(_sspace_depth_filter->currentIndex()).value<int>();
+    s.sspace_resolution_scale = _sspace_resolution_scale->text().toFloat();
+    s.sspace_target_frame_time = _sspace_target_frame_time->text().toFloat();
+    s.sspace_reduced_precision = _sspace_reduced_precision->isChecked();
+    s.particles_lod_distance = _particles_lod_distance->text().toFloat();
+    s.particles_coloring = (ParticleColoring)_particles_coloring->itemData(_particles_coloring->currentIndex()).value<int>();
 
     return s;
 }
@@ -86,6 +154,7 @@ QColor GraphicsOptionsTab::_get_button_color(QPushButton* b) const {
 void GraphicsOptionsTab::_change_render_method(int idx) {
     auto new_method = (RenderMethod)_render_method->itemData(idx).value<int>();
     _display_sspace_options(new_method == SCREEN_SPACE);
+    _display_particles_options(new_method == PARTICLES);
     emit(settings_changed());
 }
 
@@ -98,6 +167,23 @@ void GraphicsOptionsTab::_display_sspace_options(bool show) {
     }
 }
 
+void GraphicsOptionsTab::_display_particles_options(bool show) {
+    if (show) {
+        _particles_group->show();
+    }
+    else {
+        _particles_group->hide();
+    }
+}
+
 void GraphicsOptionsTab::_text_edited(const QString&) {
     emit(settings_changed());
-}
\ No newline at end of file
+}
+
+void GraphicsOptionsTab::_option_changed(int) {
+    emit(settings_changed());
+}
+
+void GraphicsOptionsTab::_option_toggled(bool) {
+    emit(settings_changed());
+}
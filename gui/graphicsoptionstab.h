@@ -6,6 +6,7 @@
 #include <QPushButton>
 #include <QComboBox>
 #include <QGroupBox>
+#include <QCheckBox>
 
 #include <settings/settings.h>
 
@@ -34,15 +35,27 @@ class GraphicsOptionsTab : public QWidget {
         // Screen space fluid rendering controls
         QGroupBox* _sspace_group;
         QLineEdit* _sspace_filter_iterations;
+        QComboBox* _sspace_depth_filter;
+        QLineEdit* _sspace_resolution_scale;
+        QLineEdit* _sspace_target_frame_time;
+        QCheckBox* _sspace_reduced_precision;
+
+        // Particles rendering controls
+        QGroupBox* _particles_group;
+        QLineEdit* _particles_lod_distance;
+        QComboBox* _particles_coloring;
 
         void _set_button_color(QPushButton* b, const QColor& c);
         QColor _get_button_color(QPushButton* b) const;
         void _display_sspace_options(bool show);
+        void _display_particles_options(bool show);
 
     private slots:
         void _pick_fluid_color();
         void _change_render_method(int idx);
         void _text_edited(const QString&);
+        void _option_changed(int);
+        void _option_toggled(bool);
 };
 
 #endif // _GRAPHICS_OPTIONS_TAB_H_
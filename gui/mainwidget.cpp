@@ -12,6 +12,11 @@ MainWidget::MainWidget(QWidget* parent) :
     connect(_options_widget,
             SIGNAL(settings_changed(SimulationSettings, PhysicsSettings, GraphicsSettings)),
             _gl_widget,
+            SLOT(apply_settings(SimulationSettings, PhysicsSettings, GraphicsSettings)));
+
+    connect(_options_widget,
+            SIGNAL(reset_simulation(SimulationSettings, PhysicsSettings, GraphicsSettings)),
+            _gl_widget,
             SLOT(reset(SimulationSettings, PhysicsSettings, GraphicsSettings)));
 
     connect(_options_widget,
@@ -1,14 +1,23 @@
 #include "mainwindow.h"
+#include "opencl/clenvironment.h"
+#include "opencl/clallocator.h"
+#include "profiling/frameprofiler.h"
 #include <QMenuBar>
 #include <QStatusBar>
 #include <QMessageBox>
 #include <QLabel>
 #include <QFrame>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QSignalBlocker>
+#include <QDockWidget>
 
 using namespace std;
 
 MainWindow::MainWindow(const string& fps_prof_output, QWidget *parent)
-    : QMainWindow(parent)
+    : QMainWindow(parent),
+      _memory_generation(~(uint64_t)0),
+      _phase_json(false)
 {
     //Configure window
     setWindowTitle("Smoothed Particle Hydrodynamics");
@@ -20,6 +29,8 @@ MainWindow::MainWindow(const string& fps_prof_output, QWidget *parent)
     _main_widget = new MainWidget(this);
     setCentralWidget(_main_widget);
 
+    setUpPerfHud();
+
     connect(&_main_widget->get_gl_widget(),
             SIGNAL(new_frame(float)),
             this,
@@ -30,6 +41,21 @@ MainWindow::MainWindow(const string& fps_prof_output, QWidget *parent)
             this,
             SLOT(update_particle_count(int, int)));
 
+    connect(&_main_widget->get_gl_widget(),
+            SIGNAL(new_frame(float)),
+            this,
+            SLOT(update_memory()));
+
+    connect(&_main_widget->get_gl_widget(),
+            SIGNAL(replay_position_changed(int, int)),
+            this,
+            SLOT(update_replay_position(int, int)));
+
+    connect(_replay_slider,
+            SIGNAL(valueChanged(int)),
+            &_main_widget->get_gl_widget(),
+            SLOT(seek_replay(int)));
+
     if (fps_prof_output != "") {
         _fps_prof_fp.open(fps_prof_output.c_str());
         if (_fps_prof_fp.good()) {
@@ -45,15 +71,35 @@ MainWindow::~MainWindow() {
     if (_fps_prof_fp.is_open()) {
         _fps_prof_fp.close();
     }
+    if (_phase_fp.is_open()) {
+        _phase_fp.close();
+    }
+
+    // Written while the scene still holds its buffers
+    if (_memory_report_file != "") {
+        ofstream f(_memory_report_file);
+        f << CLAllocator::memory_report().to_json();
+    }
 }
 
 void MainWindow::setUpMenuBar() {
     //File menu
     QMenu* menu = menuBar()->addMenu(tr("&File"));
 
-    QAction *action = menu->addAction(tr("Quit"));
+    QAction *action = menu->addAction(tr("Save checkpoint..."));
+    connect(action, SIGNAL(triggered()), this, SLOT(saveCheckpoint()));
+
+    action = menu->addAction(tr("Load checkpoint..."));
+    connect(action, SIGNAL(triggered()), this, SLOT(loadCheckpoint()));
+
+    menu->addSeparator();
+
+    action = menu->addAction(tr("Quit"));
     connect(action, SIGNAL(triggered()), this, SLOT(close()));
 
+    //View menu, filled in by the docks
+    _view_menu = menuBar()->addMenu(tr("&View"));
+
     //Help menu
     menu = menuBar()->addMenu(tr("&Help"));
 
@@ -73,6 +119,39 @@ void MainWindow::setUpStatusBar() {
 
     _boundary_particles_count = new QLabel("Boundary particles: 0");
     sBar->addPermanentWidget(_boundary_particles_count, 0);
+
+    _memory_label = new QLabel("Device memory: 0 MB");
+    sBar->addPermanentWidget(_memory_label, 0);
+
+    _replay_slider = new QSlider(Qt::Horizontal);
+    _replay_slider->setMinimumWidth(300);
+    _replay_slider->setVisible(false);
+    sBar->addPermanentWidget(_replay_slider, 0);
+}
+
+void MainWindow::setUpPerfHud() {
+    _perf_hud = new PerfHud(this);
+
+    auto dock = new QDockWidget(tr("Performance"), this);
+    dock->setWidget(_perf_hud);
+    dock->setFloating(true);
+    dock->setVisible(false);
+    addDockWidget(Qt::RightDockWidgetArea, dock);
+
+    auto action = dock->toggleViewAction();
+    action->setShortcut(Qt::Key_F3);
+    _view_menu->addAction(action);
+
+    // Refreshed along with the fps, from frames already read back
+    connect(&_main_widget->get_gl_widget(),
+            SIGNAL(new_frame(float)),
+            _perf_hud,
+            SLOT(refresh()));
+
+    connect(&_main_widget->get_gl_widget(),
+            SIGNAL(particle_count_changed(int, int)),
+            _perf_hud,
+            SLOT(update_particle_count(int, int)));
 }
 
 void MainWindow::showAboutDialog() {
@@ -87,6 +166,67 @@ void MainWindow::resetSimulation() {
 
 }
 
+void MainWindow::set_checkpointing(const string& checkpoint_file,
+                                   int checkpoint_interval,
+                                   const string& restore_file) {
+    auto& gl_widget = _main_widget->get_gl_widget();
+    if (checkpoint_file != "") {
+        gl_widget.set_checkpointing(checkpoint_file, checkpoint_interval);
+    }
+    if (restore_file != "") {
+        gl_widget.set_restore_checkpoint(restore_file);
+    }
+}
+
+void MainWindow::set_recording(const string& record_file, int record_interval) {
+    if (record_file != "") {
+        _main_widget->get_gl_widget().set_recording(record_file, record_interval);
+    }
+}
+
+void MainWindow::set_surface_export(const string& surface_file, int surface_interval) {
+    if (surface_file != "") {
+        _main_widget->get_gl_widget().set_surface_export(surface_file, surface_interval);
+    }
+}
+
+void MainWindow::set_memory_report(const string& memory_report_file) {
+    _memory_report_file = memory_report_file;
+}
+
+void MainWindow::set_phase_output(const string& phase_output_file) {
+    if (phase_output_file == "") {
+        return;
+    }
+
+    _phase_fp.open(phase_output_file.c_str());
+    if (_phase_fp.good()) {
+        auto ext = QFileInfo(QString::fromStdString(phase_output_file)).suffix().toLower();
+        _phase_json = ext == "json";
+        if (!_phase_json) {
+            _phase_fp << FrameStats::csv_header();
+        }
+        connect(&_main_widget->get_gl_widget(),
+                SIGNAL(new_frame(float)),
+                this,
+                SLOT(save_phases()));
+    }
+}
+
+void MainWindow::saveCheckpoint() {
+    auto path = QFileDialog::getSaveFileName(this, tr("Save checkpoint"), "", tr("Checkpoints (*.ckp)"));
+    if (!path.isEmpty()) {
+        _main_widget->get_gl_widget().save_checkpoint(path);
+    }
+}
+
+void MainWindow::loadCheckpoint() {
+    auto path = QFileDialog::getOpenFileName(this, tr("Load checkpoint"), "", tr("Checkpoints (*.ckp)"));
+    if (!path.isEmpty()) {
+        _main_widget->get_gl_widget().load_checkpoint(path);
+    }
+}
+
 void MainWindow::update_particle_count(int fluid_count, int boundary_count) {
     _fluid_particles_count->setText(QString("Fluid particles: ") + QString::number(fluid_count));
     _boundary_particles_count->setText(QString("Boundary particles: ") + QString::number(boundary_count));
@@ -96,6 +236,46 @@ void MainWindow::update_fps(float fps) {
     _fps_label->setText(QString("FPS: ") + QString::number(fps));
 }
 
+void MainWindow::update_memory() {
+    // Building the report takes the allocator lock, only do it when the
+    // memory changed
+    auto generation = CLAllocator::generation();
+    if (generation == _memory_generation) {
+        return;
+    }
+    _memory_generation = generation;
+
+    auto report = CLAllocator::memory_report();
+    auto mb = [](size_t bytes) { return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB"; };
+
+    _memory_label->setText(QString("Device memory: ") + mb(report.allocated_bytes) +
+                           QString(" (peak ") + mb(report.high_water_mark) + QString(")"));
+
+    // The breakdown by owner and attribute
+    QString details;
+    for (auto& owner : report.attributes) {
+        details += QString::fromStdString(owner.first) + ": " + mb(report.owners[owner.first]) + "\n";
+        for (auto& attribute : owner.second) {
+            details += "    " + QString::fromStdString(attribute.first) + ": " + mb(attribute.second) + "\n";
+        }
+    }
+    _memory_label->setToolTip(details.trimmed());
+}
+
 void MainWindow::save_fps(float fps) {
     _fps_prof_fp << fps << "\n";    
 }
+
+void MainWindow::save_phases() {
+    auto stats = FrameProfiler::stats();
+    auto frame = FrameProfiler::frame_count();
+    _phase_fp << (_phase_json ? stats.to_json(frame) : stats.to_csv(frame));
+}
+
+void MainWindow::update_replay_position(int frame, int frame_count) {
+    // Moving the slider here must not seek again
+    QSignalBlocker blocker(_replay_slider);
+    _replay_slider->setVisible(true);
+    _replay_slider->setMaximum(frame_count - 1);
+    _replay_slider->setValue(frame);
+}
@@ -5,9 +5,11 @@
 #include <QMainWindow>
 #include <QMenu>
 #include <QLabel>
+#include <QSlider>
 #include <QSharedPointer>
 
 #include "mainwidget.h"
+#include "perfhud.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -16,25 +18,79 @@ class MainWindow : public QMainWindow {
         MainWindow(const std::string& fps_prof_output, QWidget *parent = 0);
         ~MainWindow();
 
+        /**
+         * @brief Configures periodic checkpoints and the checkpoint to 
+         *        restore at startup. Empty paths disable each feature.
+         */
+        void set_checkpointing(const std::string& checkpoint_file,
+                               int checkpoint_interval,
+                               const std::string& restore_file);
+
+        /**
+         * @brief Records the fluid particles to a file every few steps. An
+         *        empty path disables the recording.
+         */
+        void set_recording(const std::string& record_file, int record_interval);
+
+        /**
+         * @brief Exports the fluid surface as a mesh every few steps. An
+         *        empty path disables the export.
+         */
+        void set_surface_export(const std::string& surface_file, int surface_interval);
+
+        /**
+         * @brief Writes the device memory report, as JSON, to a file when
+         *        the window is closed. An empty path disables the report.
+         */
+        void set_memory_report(const std::string& memory_report_file);
+
+        /**
+         * @brief Writes the rolling percentiles of the frame phases along
+         *        with the fps, as JSON lines if the path ends in .json, or
+         *        as CSV otherwise. An empty path disables the output.
+         */
+        void set_phase_output(const std::string& phase_output_file);
+
     public slots:
         void showAboutDialog();
         void resetSimulation();
+        void saveCheckpoint();
+        void loadCheckpoint();
 
     private slots:
         void update_fps(float fps);
+        void update_memory();
         void save_fps(float fps);
+        void save_phases();
         void update_particle_count(int fluid_count, int boudnary_count);
+        void update_replay_position(int frame, int frame_count);
 
     private:
         void setUpMenuBar();
         void setUpStatusBar();
+        void setUpPerfHud();
 
         // GUI Elements
         QLabel* _fps_label;
         QLabel* _fluid_particles_count;
         QLabel* _boundary_particles_count;
+        QLabel* _memory_label;
+        // The allocator generation the label shows, the report is only
+        // rebuilt when it changes
+        uint64_t _memory_generation;
+
+        // Scrubs through the frames of a replay, only shown when replaying
+        QSlider* _replay_slider;
+
+        // Per-phase frame times and solver counters, in a dock hidden by
+        // default
+        PerfHud* _perf_hud;
+        QMenu* _view_menu;
 
         std::ofstream _fps_prof_fp;
+        std::string _memory_report_file;
+        std::ofstream _phase_fp;
+        bool _phase_json;
 
         MainWidget* _main_widget;
 };
@@ -84,8 +84,7 @@ void OptionsWidget::settings_changed() {
 void OptionsWidget::reset_simulation_click() {
     // Undo any change on the settings
     reset_click();
-    // emit a fake settings changed to restart simulation
-    apply_click();
+    emit(reset_simulation(_simulation_settings, _physics_settings, _graphics_settings));
 }
 
 void OptionsWidget::pause_simulation_click() {
@@ -22,6 +22,10 @@ class OptionsWidget : public QWidget {
                               PhysicsSettings p_settings,
                               GraphicsSettings g_settings);
 
+        void reset_simulation(SimulationSettings s_settings,
+                              PhysicsSettings p_settings,
+                              GraphicsSettings g_settings);
+
         void pause_simulation();
         void unpause_simulation();
 
@@ -0,0 +1,152 @@
+#include "perfhud.h"
+#include "opencl/clenvironment.h"
+#include "opencl/clallocator.h"
+#include <QPainter>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Frames shown, one bar each
+#define HUD_FRAMES          200
+#define HUD_LINE_HEIGHT     16
+#define HUD_BARS_HEIGHT     160
+#define HUD_LEGEND_COLUMNS  3
+
+static const QColor PHASE_COLORS[] = {
+    QColor(141, 211, 199),
+    QColor(255, 255, 179),
+    QColor(190, 186, 218),
+    QColor(251, 128, 114),
+    QColor(128, 177, 211),
+    QColor(253, 180, 98),
+    QColor(179, 222, 105),
+    QColor(252, 205, 229),
+    QColor(217, 217, 217),
+    QColor(188, 128, 189),
+    QColor(204, 235, 197),
+    QColor(255, 237, 111)
+};
+
+PerfHud::PerfHud(QWidget *parent) :
+QWidget(parent),
+_boundary_count(0) {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+PerfHud::~PerfHud() {
+
+}
+
+QSize PerfHud::sizeHint() const {
+    return QSize(HUD_FRAMES * 2, 7 * HUD_LINE_HEIGHT + HUD_BARS_HEIGHT + 5 * HUD_LINE_HEIGHT);
+}
+
+void PerfHud::refresh() {
+    // Hidden, it is not worth even the copy
+    if (!isVisible()) {
+        return;
+    }
+
+    _frames = FrameProfiler::recent_frames(HUD_FRAMES);
+    _stats = FrameProfiler::stats();
+    update();
+}
+
+void PerfHud::update_particle_count(int, int boundary_count) {
+    _boundary_count = boundary_count;
+}
+
+void PerfHud::paintEvent(QPaintEvent*) {
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(25, 25, 25));
+    painter.setPen(Qt::white);
+
+    int top = _paint_counters(painter);
+    _paint_bars(painter, top);
+    _paint_legend(painter, top + HUD_BARS_HEIGHT + HUD_LINE_HEIGHT / 2);
+}
+
+int PerfHud::_paint_counters(QPainter& painter) {
+    auto& c = _stats.counters;
+    auto memory = CLAllocator::memory_report();
+    auto mb = [](size_t bytes) { return QString::number(bytes / (1024.0 * 1024.0), 'f', 1); };
+
+    QStringList lines;
+    lines << QString("Frame: %1 ms p50, %2 ms p95, %3 ms p99")
+                 .arg(_stats.frame_wall.p50, 0, 'f', 2)
+                 .arg(_stats.frame_wall.p95, 0, 'f', 2)
+                 .arg(_stats.frame_wall.p99, 0, 'f', 2);
+    lines << QString("Sim steps per frame: %1")
+                 .arg(c[(int)FrameCounter::SIM_STEPS].p50, 0, 'f', 0);
+    lines << QString("PCISPH iterations: %1 p50, %2 p95")
+                 .arg(c[(int)FrameCounter::PCISPH_ITERATIONS].p50, 0, 'f', 0)
+                 .arg(c[(int)FrameCounter::PCISPH_ITERATIONS].p95, 0, 'f', 0);
+    lines << QString("Neighbours: %1 mean, %2 max, %3 truncated")
+                 .arg(c[(int)FrameCounter::NEIGHBOURS_MEAN].p50, 0, 'f', 1)
+                 .arg(c[(int)FrameCounter::NEIGHBOURS_MAX].p50, 0, 'f', 0)
+                 .arg(c[(int)FrameCounter::NEIGHBOUR_TRUNCATIONS].p50, 0, 'f', 0);
+    lines << QString("Boundary neighbours: %1 max, %2 truncated")
+                 .arg(c[(int)FrameCounter::BOUNDARY_NEIGHBOURS_MAX].p50, 0, 'f', 0)
+                 .arg(c[(int)FrameCounter::BOUNDARY_NEIGHBOUR_TRUNCATIONS].p50, 0, 'f', 0);
+    lines << QString("Boundary particles: %1").arg(_boundary_count);
+    lines << QString("Device memory: %1 MB, peak %2 MB")
+                 .arg(mb(memory.allocated_bytes))
+                 .arg(mb(memory.high_water_mark));
+
+    int y = 0;
+    for (auto& line : lines) {
+        y += HUD_LINE_HEIGHT;
+        painter.drawText(4, y - 4, line);
+    }
+    return y;
+}
+
+void PerfHud::_paint_bars(QPainter& painter, int top) {
+    if (_frames.empty()) {
+        return;
+    }
+
+    // The scale fits the slowest frame shown
+    float max_time = 0.0f;
+    for (auto& frame : _frames) {
+        float total = 0.0f;
+        for (int p = 0; p < (int)FramePhase::COUNT; ++p) {
+            total += frame.time((FramePhase)p);
+        }
+        max_time = max(max_time, max(total, frame.frame_wall));
+    }
+    if (max_time <= 0.0f) {
+        return;
+    }
+    float scale = HUD_BARS_HEIGHT / max_time;
+
+    int bar_width = max(1, width() / HUD_FRAMES);
+    int bottom = top + HUD_BARS_HEIGHT;
+    int x = width() - bar_width * _frames.size();
+    for (auto& frame : _frames) {
+        float y = bottom;
+        for (int p = 0; p < (int)FramePhase::COUNT; ++p) {
+            float h = frame.time((FramePhase)p) * scale;
+            painter.fillRect(QRectF(x, y - h, bar_width, h), PHASE_COLORS[p]);
+            y -= h;
+        }
+
+        // The whole frame on the host, as a tick over the bar
+        painter.fillRect(QRectF(x, bottom - frame.frame_wall * scale, bar_width, 1), Qt::white);
+        x += bar_width;
+    }
+
+    painter.drawText(4, top + HUD_LINE_HEIGHT - 4, QString("%1 ms").arg(max_time, 0, 'f', 1));
+}
+
+void PerfHud::_paint_legend(QPainter& painter, int top) {
+    int column_width = width() / HUD_LEGEND_COLUMNS;
+    for (int p = 0; p < (int)FramePhase::COUNT; ++p) {
+        int x = (p % HUD_LEGEND_COLUMNS) * column_width + 4;
+        int y = top + (p / HUD_LEGEND_COLUMNS) * HUD_LINE_HEIGHT;
+
+        painter.fillRect(x, y + 3, 10, 10, PHASE_COLORS[p]);
+        painter.drawText(x + 14, y + HUD_LINE_HEIGHT - 4, FrameProfiler::name((FramePhase)p));
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef _PERF_HUD_H_
+#define _PERF_HUD_H_
+
+#include <QWidget>
+#include <vector>
+#include "profiling/frameprofiler.h"
+
+/**
+ * @class PerfHud
+ * @brief Shows where the time of the last frames went
+ * @details A stacked bar per frame, with the time of every phase, and the
+ *          counters of the solver below. Everything comes from the frames
+ *          the FrameProfiler already read back, so refreshing the panel
+ *          never waits for OpenCL or OpenGL.
+ */
+class PerfHud : public QWidget {
+    Q_OBJECT
+
+    public:
+        PerfHud(QWidget *parent = 0);
+        ~PerfHud();
+
+        QSize sizeHint() const;
+
+    public slots:
+        /**
+         * @brief Takes the last frames from the profiler and repaints
+         */
+        void refresh();
+
+        void update_particle_count(int fluid_count, int boundary_count);
+
+    protected:
+        void paintEvent(QPaintEvent* event);
+
+    private:
+        std::vector<FrameRecord> _frames;
+        FrameStats _stats;
+        int _boundary_count;
+
+        // Draws the text lines from the top, and returns where they end
+        int _paint_counters(QPainter& painter);
+        void _paint_bars(QPainter& painter, int top);
+        void _paint_legend(QPainter& painter, int top);
+};
+
+#endif // _PERF_HUD_H_
@@ -37,6 +37,7 @@ QWidget(parent) {
     _simulation_method = new QComboBox();
     _simulation_method->addItem("WCSPH", SimulationSettings::Method::WCSPH);
     _simulation_method->addItem("PCISPH", SimulationSettings::Method::PCISPH);
+    _simulation_method->addItem("Replay", SimulationSettings::Method::REPLAY);
     connect(_simulation_method, SIGNAL(currentIndexChanged(int)),
             this, SLOT(_method_changed(int)));
     _simulation_method->setEditable(false);
@@ -97,6 +98,8 @@ void SimulationOptionsTab::set_settings(const SimulationSettings& s) {
 
     int index = _simulation_method->findData(s.sim_method);
     _simulation_method->setCurrentIndex(index);
+
+    _replay_file = s.replay_file;
 }
 
 SimulationSettings SimulationOptionsTab::get_settings() const {
@@ -108,6 +111,7 @@ SimulationSettings SimulationOptionsTab::get_settings() const {
     s.pcisph_max_iterations = _pcisph_max_iterations->text().toInt();
     s.pcisph_error_ratio = _pcisph_error_ratio->text().toFloat();
     s.sim_method = (SimulationSettings::Method)_simulation_method->currentData().toInt();
+    s.replay_file = _replay_file;
 
     return s;
 }
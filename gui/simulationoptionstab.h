@@ -41,6 +41,9 @@ class SimulationOptionsTab : public QWidget {
         // Boundary options
         QLineEdit* _pcisph_max_iterations;
         QLineEdit* _pcisph_error_ratio;
+
+        // The recording being replayed, it can not be edited
+        std::string _replay_file;
 };
 
 #endif // _SIMULATION_OPTIONS_TAB_H_
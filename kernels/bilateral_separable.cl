@@ -0,0 +1,115 @@
+// Separable version of the bilateral depth filter. Every pass filters along
+// one axis, reading a tile of the image plus an apron of FILTER_RADIUS pixels
+// on each side into local memory, so each pixel is read from the image only
+// once per work group instead of once per neighbour.
+//
+// Build constants:
+//  FILTER_RADIUS       The filter window is 2*FILTER_RADIUS+1 pixels wide
+//  GROUP_SIZE          Work group size along the filtered axis
+//  GROUP_ROWS          Work group size along the other axis
+//  DEPTH_THRESHOLD     Samples farther than this in depth are ignored
+
+__constant sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+#define TILE_SIZE   (GROUP_SIZE + 2 * FILTER_RADIUS)
+
+/**
+ * @brief Filters one pixel along a row of the local tile
+ *
+ * @param center Pointer to the pixel within the tile. The row must hold
+ *               FILTER_RADIUS pixels on each side.
+ * @param weights The spatial weights, indexed by the distance to the center.
+ * @return The filtered depth.
+ */
+inline float bilateral_1d(local const float* center, constant float* weights) {
+    float depth = center[0];
+    if (depth <= 0.0f) {
+        return 0.0f;
+    }
+
+    // The center always counts, so wsum is never zero
+    float sum = 0.0f;
+    float wsum = 0.0f;
+    for (int d = -FILTER_RADIUS; d <= FILTER_RADIUS; ++d) {
+        float sample_depth = center[d];
+        float w = (fabs(sample_depth - depth) < DEPTH_THRESHOLD) ? weights[abs(d)] : 0.0f;
+        sum += sample_depth * w;
+        wsum += w;
+    }
+
+    return sum / wsum;
+}
+
+/**
+ * @brief Filters the depth image along the x axis
+ * @details The local size must be (GROUP_SIZE, GROUP_ROWS).
+ *
+ * @param input_img The depth image to filter.
+ * @param output_img The filtered depth image.
+ * @param weights The spatial weights, FILTER_RADIUS+1 values.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ */
+__kernel void bilateral_horizontal(__read_only image2d_t input_img,
+                                   __write_only image2d_t output_img,
+                                   constant float* weights,
+                                   const int width,
+                                   const int height) {
+    local float tile[GROUP_ROWS][TILE_SIZE];
+
+    const int lx = get_local_id(0);
+    const int ly = get_local_id(1);
+    const int y = get_global_id(1);
+    const int x0 = get_group_id(0) * GROUP_SIZE - FILTER_RADIUS;
+
+    // Every work item loads its pixel, and some of them the apron too
+    for (int t = lx; t < TILE_SIZE; t += GROUP_SIZE) {
+        tile[ly][t] = read_imagef(input_img, sampler, (int2)(x0 + t, y)).x;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    const int x = get_global_id(0);
+    if (x >= width || y >= height) {
+        return;
+    }
+
+    float out_depth = bilateral_1d(&tile[ly][lx + FILTER_RADIUS], weights);
+    write_imagef(output_img, (int2)(x, y), (float4)(out_depth, 0, 0, 0));
+}
+
+/**
+ * @brief Filters the depth image along the y axis
+ * @details The local size must be (GROUP_ROWS, GROUP_SIZE). The tile is
+ *          stored transposed, so the filter always runs along a local row.
+ *
+ * @param input_img The depth image to filter.
+ * @param output_img The filtered depth image.
+ * @param weights The spatial weights, FILTER_RADIUS+1 values.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ */
+__kernel void bilateral_vertical(__read_only image2d_t input_img,
+                                 __write_only image2d_t output_img,
+                                 constant float* weights,
+                                 const int width,
+                                 const int height) {
+    local float tile[GROUP_ROWS][TILE_SIZE];
+
+    const int lx = get_local_id(0);
+    const int ly = get_local_id(1);
+    const int x = get_global_id(0);
+    const int y0 = get_group_id(1) * GROUP_SIZE - FILTER_RADIUS;
+
+    for (int t = ly; t < TILE_SIZE; t += GROUP_SIZE) {
+        tile[lx][t] = read_imagef(input_img, sampler, (int2)(x, y0 + t)).x;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    const int y = get_global_id(1);
+    if (x >= width || y >= height) {
+        return;
+    }
+
+    float out_depth = bilateral_1d(&tile[lx][ly + FILTER_RADIUS], weights);
+    write_imagef(output_img, (int2)(x, y), (float4)(out_depth, 0, 0, 0));
+}
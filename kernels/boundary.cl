@@ -1,6 +1,9 @@
 #include "grid.h"
 #include "kernels.h"
 
+// The volume of a boundary particle is estimated from the density of the
+// particles around it, so sparse samplings (e.g. Poisson disk) get larger
+// phi values and the boundary contributes the same density
 kernel void compute_boundary_phi(const global float4* positions,
                                  global write_only float* boundary_phi,
                                  const float rest_density,
@@ -90,12 +93,12 @@ kernel void compute_fluid_force(global float4* boundary_positions,
     float4 f_pressure = {0, 0, 0, 0};
     //float4 f_viscosity = {0, 0, 0, 0};
 
-    int neigh_count = 0;
-    for (int offset=0; (neigh_count < NEIGH_LIST_MAX_LENGTH) && offset<27; ++offset) {
+    // Every fluid neighbour is visited, there is no list to overflow
+    for (int offset=0; offset<27; ++offset) {
         // Search for particles in the grid's cell
         int4 neigh_cell_coord = cell_coord + CELL_NEIGH_OFFSET[offset];
         int2 interval = fluid_cell_intervals[CELL_ID(neigh_cell_coord.x, neigh_cell_coord.y, neigh_cell_coord.z, grid_info)];
-        for (int j=interval.x; (neigh_count < 50) && (j < interval.y); ++j) {
+        for (int j=interval.x; j < interval.y; ++j) {
             float4 pos_j = read_imagef(fluid_positions, j);
             float4 vel_j = read_imagef(fluid_velocities, j);
             float4 r = pos_j - pos_i;
@@ -104,7 +107,6 @@ kernel void compute_fluid_force(global float4* boundary_positions,
             if (rnorm < SUPPORT_RADIUS) {
                 float fluid_density = read_imagef(fluid_densities, j).x; 
                 float C = read_imagef(fluid_pressures, j).x / SQR(fluid_density);
-                ++neigh_count;
                 f_pressure += r * (spiky_grad/rnorm)*SQR(SUPPORT_RADIUS-rnorm) * 2 * C;
                 //f_viscosity += ((vel_j - vel_i) * (SUPPORT_RADIUS-rnorm)) / SQR(fluid_density);
             }
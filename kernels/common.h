@@ -1,7 +1,9 @@
 #ifndef _CL_COMMON_H_
 #define _CL_COMMON_H_
 
-#define NEIGH_LIST_MAX_LENGTH   50
+// The length the neighbourhood lists start with. The solvers grow them when
+// a particle has more neighbours, and shrink them when the fluid is sparse
+#define NEIGH_LIST_DEFAULT_LENGTH   50
 
 // These structs are used to pass parameters to
 // kernels, and avoid passing too many parameters
@@ -34,4 +36,27 @@ typedef struct {
 
 } SmoothingConstants;
 
+typedef struct {
+    // The number of live fluid particles. Buffers may hold more, the
+    // extra work items return early. It is also the stride of the
+    // neighbourhood lists
+    int particle_count;
+    // The mass of a fluid particle. Every particle has the same mass
+    float particle_mass;
+    // The rest density of the fluid
+    float rest_density;
+} FluidParams;
+
+typedef struct {
+    // Position of the first particle of the lattice
+    float origin[3];
+    // The spacing between particles along each axis
+    float delta[3];
+    // The number of particles along each axis
+    int size[3];
+    // Index of the first particle of the lattice in the positions buffer.
+    // It is the exclusive scan of the sizes of the previous lattices
+    int offset;
+} VolumeLattice;
+
 #endif // _CL_COMMON_H_
\ No newline at end of file
@@ -10,6 +10,8 @@
  *          Also, initializes the mask buffer for later use 
  *          (it is faster to initialize it here than doing a copy 
  *          buffer later)
+ *          Dead particles, those with w = 0, get the highest hash, so 
+ *          sorting moves them to the end of the buffers
  * 
  * @param positions A buffer of particle positions
  * @param hashes A buffer to write each particle hash
@@ -32,7 +34,7 @@ kernel void compute_hashes(const global float4* positions,
     float4 pos = positions[i];
     int4 cell = get_grid_coordinates(&pos, &grid_info);
 
-    hashes[i] = CELL_HASH(cell.x, cell.y, cell.z, grid_info);
+    hashes[i] = pos.w > 0.0f ? CELL_HASH(cell.x, cell.y, cell.z, grid_info) : UINT_MAX;
 
     // Initialize mask for later use
     mask[i] = i;
@@ -127,6 +129,11 @@ kernel void compute_cell_intervals(const global float4* positions,
  * @details This kernel computes, for every particle in the reference 
  *          buffer, a neighbourhood list. This list is made from particles 
  *          in the neigh_positions buffer.
+ *          Neighbours beyond the max length are counted, but not stored,
+ *          so the solver can grow the lists.
+ *          The statistics of the lists are summed up first in local memory
+ *          and then in neigh_stats, so there is one global atomic per work
+ *          group.
  *
  * @param ref_positions The buffer of reference particle positions
  * @param neigh_positions The buffer of particles to build the neighbourhood 
@@ -137,46 +144,71 @@ kernel void compute_cell_intervals(const global float4* positions,
  * @param neigh_list A buffer to write the neigh list for every ref particle.
  * @param neigh_list_lenth A buffer to write the length of the neigh list 
  *                         for every ref particle.
+ * @param neigh_stats The sum of the list lengths, the most neighbours of a
+ *                    particle, and the count of truncated lists, added to.
  * @param grid_info A struct with info about the grid.
- * @param sqr_support_radius The sqr of the support radius.
- * @param list_max_length The max length of each neigh list.
  * @param particle_count The total number of particles.
+ * @param max_list_length The most neighbours a list holds.
  */
 kernel void compute_neigh_list(const global float4* ref_positions,
                                read_only image1d_buffer_t neigh_positions,
                                const global int2* cell_interval,
                                global write_only int* neigh_list,
                                global write_only int* neigh_list_length,
+                               global int* neigh_stats,
                                const GridInfo grid_info,
-                               const int particle_count) {
+                               const int particle_count,
+                               const int max_list_length) {
+    local int group_stats[3];
+
     // Current particle index
     int i = get_global_id(0);
+    int lid = get_local_id(0);
 
-    // Validate that we are not out of bound
-    if(i >= particle_count) {
-        return;
+    if (lid == 0) {
+        group_stats[0] = group_stats[1] = group_stats[2] = 0;
     }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-    float4 pos_i = ref_positions[i];
-    int4 cell_coord = get_grid_coordinates(&pos_i, &grid_info);
-    int list_length = 0;
-    for (int offset=0; (list_length < NEIGH_LIST_MAX_LENGTH) && offset<27; ++offset) {
-        // Search for particles in the grid's cell
-        int4 neigh_cell_coord = cell_coord + CELL_NEIGH_OFFSET[offset];
-        int2 interval = cell_interval[CELL_ID(neigh_cell_coord.x, neigh_cell_coord.y, neigh_cell_coord.z, grid_info)];
-        for (int j=interval.x; (list_length < NEIGH_LIST_MAX_LENGTH) && (j < interval.y); ++j) {
-            float4 pos_j = read_imagef(neigh_positions, j);
-
-            float4 r = pos_i - pos_j;
-            float r2 = dot(r, r);
-            if (r2 < SQR_SUPPORT_RADIUS) {
-                // Build the neigh list
-                neigh_list[mad24(list_length, particle_count, i)] = j;
-                ++list_length;
+    // Out of bound items only take part in the reduction
+    if (i < particle_count) {
+        float4 pos_i = ref_positions[i];
+        int4 cell_coord = get_grid_coordinates(&pos_i, &grid_info);
+        int neigh_count = 0;
+        for (int offset=0; offset<27; ++offset) {
+            // Search for particles in the grid's cell
+            int4 neigh_cell_coord = cell_coord + CELL_NEIGH_OFFSET[offset];
+            int2 interval = cell_interval[CELL_ID(neigh_cell_coord.x, neigh_cell_coord.y, neigh_cell_coord.z, grid_info)];
+            for (int j=interval.x; j < interval.y; ++j) {
+                float4 pos_j = read_imagef(neigh_positions, j);
+
+                float4 r = pos_i - pos_j;
+                float r2 = dot(r, r);
+                if (r2 < SQR_SUPPORT_RADIUS) {
+                    // Build the neigh list
+                    if (neigh_count < max_list_length) {
+                        neigh_list[mad24(neigh_count, particle_count, i)] = j;
+                    }
+                    ++neigh_count;
+                }
             }
         }
+
+        // Update the length of the neighbourhood
+        int list_length = min(neigh_count, max_list_length);
+        neigh_list_length[i] = list_length;
+
+        atomic_add(&group_stats[0], list_length);
+        atomic_max(&group_stats[1], neigh_count);
+        if (neigh_count > max_list_length) {
+            atomic_inc(&group_stats[2]);
+        }
     }
 
-    // Update the length of the neighbourhood
-    neigh_list_length[i] = list_length;
-}
\ No newline at end of file
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid == 0) {
+        atomic_add(&neigh_stats[0], group_stats[0]);
+        atomic_max(&neigh_stats[1], group_stats[1]);
+        atomic_add(&neigh_stats[2], group_stats[2]);
+    }
+}
@@ -0,0 +1,42 @@
+#include "common.h"
+
+// Fills the positions of the particles of a list of lattices, one work item
+// per particle. Each work item finds its lattice by a binary search over the
+// offsets, so every lattice is filled by a single launch
+kernel void fill_lattices(global float4* positions,
+                          const global VolumeLattice* lattices,
+                          const int lattice_count,
+                          const int count) {
+    int i = get_global_id(0);
+
+    if (i >= count) {
+        return;
+    }
+
+    // The last lattice that starts at or before this particle
+    int lo = 0;
+    int hi = lattice_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (lattices[mid].offset <= i) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+
+    const global VolumeLattice* l = &lattices[lo];
+
+    // Particles are laid out with z varying fastest, then x, then y
+    int n = i - l->offset;
+    int z = n % l->size[2];
+    n /= l->size[2];
+    int x = n % l->size[0];
+    int y = n / l->size[0];
+
+    positions[i] = (float4)(l->origin[0] + x * l->delta[0],
+                            l->origin[1] + y * l->delta[1],
+                            l->origin[2] + z * l->delta[2],
+                            1.0f);
+}
@@ -0,0 +1,325 @@
+#ifndef _MARCHING_CUBES_H_
+#define _MARCHING_CUBES_H_
+
+// Lookup tables of the marching cubes algorithm.
+//
+// Corners of a voxel are numbered as follows, being (x,y,z) the offset of 
+// the corner from the voxel origin:
+//   0:(0,0,0) 1:(1,0,0) 2:(1,1,0) 3:(0,1,0)
+//   4:(0,0,1) 5:(1,0,1) 6:(1,1,1) 7:(0,1,1)
+// Bit i of the cube index is set if corner i is inside the fluid. Edges are
+// numbered as in Bourke's "Polygonising a scalar field". Ambiguous faces are
+// always resolved separating the inside corners, so adjacent voxels agree and
+// the surface is closed. Triangles are wound counter clockwise when seen from
+// outside the fluid.
+
+// Offset of every corner from the voxel origin
+constant int4 MC_CORNERS[8] = {
+    (int4)(0, 0, 0, 0),
+    (int4)(1, 0, 0, 0),
+    (int4)(1, 1, 0, 0),
+    (int4)(0, 1, 0, 0),
+    (int4)(0, 0, 1, 0),
+    (int4)(1, 0, 1, 0),
+    (int4)(1, 1, 1, 0),
+    (int4)(0, 1, 1, 0)
+};
+
+// For every edge, the offset of the corner it starts at (the one with the
+// lowest coordinates), and in .w the axis it runs along (0=x, 1=y, 2=z)
+constant int4 MC_EDGE_OWNER[12] = {
+    (int4)(0, 0, 0, 0),
+    (int4)(1, 0, 0, 1),
+    (int4)(0, 1, 0, 0),
+    (int4)(0, 0, 0, 1),
+    (int4)(0, 0, 1, 0),
+    (int4)(1, 0, 1, 1),
+    (int4)(0, 1, 1, 0),
+    (int4)(0, 0, 1, 1),
+    (int4)(0, 0, 0, 2),
+    (int4)(1, 0, 0, 2),
+    (int4)(1, 1, 0, 2),
+    (int4)(0, 1, 0, 2)
+};
+
+// Number of triangles generated for every cube index
+constant uchar MC_TRIANGLE_COUNT[256] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 2,
+    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+    2, 3, 3, 2, 3, 4, 4, 3, 3, 4, 4, 3, 4, 5, 5, 2,
+    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
+    2, 3, 3, 4, 3, 4, 2, 3, 3, 4, 4, 5, 4, 5, 3, 2,
+    3, 4, 4, 3, 4, 5, 3, 2, 4, 5, 5, 4, 5, 2, 4, 1,
+    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+    2, 3, 3, 4, 3, 4, 4, 5, 3, 2, 4, 3, 4, 3, 5, 2,
+    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
+    3, 4, 4, 3, 4, 5, 5, 4, 4, 3, 5, 2, 5, 4, 2, 1,
+    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 2, 3, 3, 2,
+    3, 4, 4, 5, 4, 5, 5, 2, 4, 3, 5, 4, 3, 2, 4, 1,
+    3, 4, 4, 5, 4, 5, 3, 4, 4, 5, 5, 2, 3, 4, 2, 1,
+    2, 3, 3, 2, 3, 4, 2, 1, 3, 2, 4, 1, 2, 1, 1, 0
+};
+
+// Edges of every triangle generated for every cube index, -1 terminated
+constant char MC_TRIANGLES[256][16] = {
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  9,  1,  3,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 10,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  1, 10,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  2,  0,  9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  9, 10,  2,  8,  9,  2,  3,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 2, 11,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  8,  0,  2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  2, 11,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  9,  1, 11,  8,  1,  2, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 11,  3,  1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  8,  0, 10, 11,  0,  1, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  3,  0, 10, 11,  0,  9, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 8, 10, 11,  8,  9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 4,  8,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  4,  0,  3,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  9,  1,  7,  4,  1,  3,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 10,  2,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  4,  0,  3,  7,  1, 10,  2, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  2,  0,  9, 10,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  9, 10,  2,  4,  9,  2,  7,  4,  2,  3,  7, -1, -1, -1, -1},
+    { 2, 11,  3,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  4,  0, 11,  7,  0,  2, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  2, 11,  3,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  9,  1,  7,  4,  1, 11,  7,  1,  2, 11, -1, -1, -1, -1},
+    { 1, 11,  3,  1, 10, 11,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  4,  0, 11,  7,  0, 10, 11,  0,  1, 10, -1, -1, -1, -1},
+    { 0, 11,  3,  0, 10, 11,  0,  9, 10,  4,  8,  7, -1, -1, -1, -1},
+    { 4, 11,  7,  4, 10, 11,  4,  9, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  5,  1,  8,  4,  1,  3,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 10,  2,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  1, 10,  2,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  2,  0,  5, 10,  0,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  5, 10,  2,  4,  5,  2,  8,  4,  2,  3,  8, -1, -1, -1, -1},
+    { 2, 11,  3,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  8,  0,  2, 11,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  4,  5,  2, 11,  3, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  5,  1,  8,  4,  1, 11,  8,  1,  2, 11, -1, -1, -1, -1},
+    { 1, 11,  3,  1, 10, 11,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  8,  0, 10, 11,  0,  1, 10,  4,  5,  9, -1, -1, -1, -1},
+    { 0, 11,  3,  0, 10, 11,  0,  5, 10,  0,  4,  5, -1, -1, -1, -1},
+    { 4, 11,  8,  4, 10, 11,  4,  5, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 5,  8,  7,  5,  9,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  9,  0,  7,  5,  0,  3,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  7,  5,  0,  8,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  7,  5,  1,  3,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 10,  2,  5,  8,  7,  5,  9,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  9,  0,  7,  5,  0,  3,  7,  1, 10,  2, -1, -1, -1, -1},
+    { 0, 10,  2,  0,  5, 10,  0,  7,  5,  0,  8,  7, -1, -1, -1, -1},
+    { 2,  5, 10,  2,  7,  5,  2,  3,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 2, 11,  3,  5,  8,  7,  5,  9,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  9,  0,  7,  5,  0, 11,  7,  0,  2, 11, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  7,  5,  0,  8,  7,  2, 11,  3, -1, -1, -1, -1},
+    { 1,  7,  5,  1, 11,  7,  1,  2, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 11,  3,  1, 10, 11,  5,  8,  7,  5,  9,  8, -1, -1, -1, -1},
+    { 0,  5,  9,  0,  7,  5,  0, 11,  7,  0, 10, 11,  0,  1, 10, -1},
+    { 0, 11,  3,  0, 10, 11,  0,  5, 10,  0,  7,  5,  0,  8,  7, -1},
+    { 5, 11,  7,  5, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  9,  1,  3,  8,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  6,  2,  1,  5,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  1,  6,  2,  1,  5,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  6,  2,  0,  5,  6,  0,  9,  5, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  5,  6,  2,  9,  5,  2,  8,  9,  2,  3,  8, -1, -1, -1, -1},
+    { 2, 11,  3,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  8,  0,  2, 11,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  2, 11,  3,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  9,  1, 11,  8,  1,  2, 11,  5,  6, 10, -1, -1, -1, -1},
+    { 1, 11,  3,  1,  6, 11,  1,  5,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  8,  0,  6, 11,  0,  5,  6,  0,  1,  5, -1, -1, -1, -1},
+    { 0, 11,  3,  0,  6, 11,  0,  5,  6,  0,  9,  5, -1, -1, -1, -1},
+    { 5,  8,  9,  5, 11,  8,  5,  6, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 4,  8,  7,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  4,  0,  3,  7,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  4,  8,  7,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  9,  1,  7,  4,  1,  3,  7,  5,  6, 10, -1, -1, -1, -1},
+    { 1,  6,  2,  1,  5,  6,  4,  8,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  4,  0,  3,  7,  1,  6,  2,  1,  5,  6, -1, -1, -1, -1},
+    { 0,  6,  2,  0,  5,  6,  0,  9,  5,  4,  8,  7, -1, -1, -1, -1},
+    { 2,  5,  6,  2,  9,  5,  2,  4,  9,  2,  7,  4,  2,  3,  7, -1},
+    { 2, 11,  3,  4,  8,  7,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  4,  0, 11,  7,  0,  2, 11,  5,  6, 10, -1, -1, -1, -1},
+    { 0,  9,  1,  2, 11,  3,  4,  8,  7,  5,  6, 10, -1, -1, -1, -1},
+    { 1,  4,  9,  1,  7,  4,  1, 11,  7,  1,  2, 11,  5,  6, 10, -1},
+    { 1, 11,  3,  1,  6, 11,  1,  5,  6,  4,  8,  7, -1, -1, -1, -1},
+    { 0,  7,  4,  0, 11,  7,  0,  6, 11,  0,  5,  6,  0,  1,  5, -1},
+    { 0, 11,  3,  0,  6, 11,  0,  5,  6,  0,  9,  5,  4,  8,  7, -1},
+    { 4, 11,  7,  4,  6, 11,  4,  5,  6,  4,  9,  5, -1, -1, -1, -1},
+    { 4, 10,  9,  4,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  4, 10,  9,  4,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  1,  0,  6, 10,  0,  4,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  6, 10,  1,  4,  6,  1,  8,  4,  1,  3,  8, -1, -1, -1, -1},
+    { 1,  6,  2,  1,  4,  6,  1,  9,  4, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  1,  6,  2,  1,  4,  6,  1,  9,  4, -1, -1, -1, -1},
+    { 0,  6,  2,  0,  4,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  4,  6,  2,  8,  4,  2,  3,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 2, 11,  3,  4, 10,  9,  4,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  8,  0,  2, 11,  4, 10,  9,  4,  6, 10, -1, -1, -1, -1},
+    { 0, 10,  1,  0,  6, 10,  0,  4,  6,  2, 11,  3, -1, -1, -1, -1},
+    { 1,  6, 10,  1,  4,  6,  1,  8,  4,  1, 11,  8,  1,  2, 11, -1},
+    { 1, 11,  3,  1,  6, 11,  1,  4,  6,  1,  9,  4, -1, -1, -1, -1},
+    { 0, 11,  8,  0,  6, 11,  0,  4,  6,  0,  9,  4,  0,  1,  9, -1},
+    { 0, 11,  3,  0,  6, 11,  0,  4,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 4, 11,  8,  4,  6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 6,  8,  7,  6,  9,  8,  6, 10,  9, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  9,  0,  6, 10,  0,  7,  6,  0,  3,  7, -1, -1, -1, -1},
+    { 0, 10,  1,  0,  6, 10,  0,  7,  6,  0,  8,  7, -1, -1, -1, -1},
+    { 1,  6, 10,  1,  7,  6,  1,  3,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  6,  2,  1,  7,  6,  1,  8,  7,  1,  9,  8, -1, -1, -1, -1},
+    { 0,  1,  9,  0,  2,  1,  0,  6,  2,  0,  7,  6,  0,  3,  7, -1},
+    { 0,  6,  2,  0,  7,  6,  0,  8,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  7,  6,  2,  3,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2, 11,  3,  6,  8,  7,  6,  9,  8,  6, 10,  9, -1, -1, -1, -1},
+    { 0, 10,  9,  0,  6, 10,  0,  7,  6,  0, 11,  7,  0,  2, 11, -1},
+    { 0, 10,  1,  0,  6, 10,  0,  7,  6,  0,  8,  7,  2, 11,  3, -1},
+    { 1,  6, 10,  1,  7,  6,  1, 11,  7,  1,  2, 11, -1, -1, -1, -1},
+    { 1, 11,  3,  1,  6, 11,  1,  7,  6,  1,  8,  7,  1,  9,  8, -1},
+    { 0,  1,  9,  6, 11,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 11,  3,  0,  6, 11,  0,  7,  6,  0,  8,  7, -1, -1, -1, -1},
+    { 6, 11,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  9,  1,  3,  8,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 10,  2,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  1, 10,  2,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  2,  0,  9, 10,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  9, 10,  2,  8,  9,  2,  3,  8,  6,  7, 11, -1, -1, -1, -1},
+    { 2,  7,  3,  2,  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  6,  7,  0,  2,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  2,  7,  3,  2,  6,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  9,  1,  7,  8,  1,  6,  7,  1,  2,  6, -1, -1, -1, -1},
+    { 1,  7,  3,  1,  6,  7,  1, 10,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  6,  7,  0, 10,  6,  0,  1, 10, -1, -1, -1, -1},
+    { 0,  7,  3,  0,  6,  7,  0, 10,  6,  0,  9, 10, -1, -1, -1, -1},
+    { 6,  9, 10,  6,  8,  9,  6,  7,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 4, 11,  6,  4,  8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  6,  4,  0, 11,  6,  0,  3, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  4, 11,  6,  4,  8, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  9,  1,  6,  4,  1, 11,  6,  1,  3, 11, -1, -1, -1, -1},
+    { 1, 10,  2,  4, 11,  6,  4,  8, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  6,  4,  0, 11,  6,  0,  3, 11,  1, 10,  2, -1, -1, -1, -1},
+    { 0, 10,  2,  0,  9, 10,  4, 11,  6,  4,  8, 11, -1, -1, -1, -1},
+    { 2,  9, 10,  2,  4,  9,  2,  6,  4,  2, 11,  6,  2,  3, 11, -1},
+    { 2,  8,  3,  2,  4,  8,  2,  6,  4, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  6,  4,  0,  2,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  2,  8,  3,  2,  4,  8,  2,  6,  4, -1, -1, -1, -1},
+    { 1,  4,  9,  1,  6,  4,  1,  2,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  3,  1,  4,  8,  1,  6,  4,  1, 10,  6, -1, -1, -1, -1},
+    { 0,  6,  4,  0, 10,  6,  0,  1, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  8,  3,  0,  4,  8,  0,  6,  4,  0, 10,  6,  0,  9, 10, -1},
+    { 4, 10,  6,  4,  9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 4,  5,  9,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  4,  5,  9,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  4,  5,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  4,  5,  1,  8,  4,  1,  3,  8,  6,  7, 11, -1, -1, -1, -1},
+    { 1, 10,  2,  4,  5,  9,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  1, 10,  2,  4,  5,  9,  6,  7, 11, -1, -1, -1, -1},
+    { 0, 10,  2,  0,  5, 10,  0,  4,  5,  6,  7, 11, -1, -1, -1, -1},
+    { 2,  5, 10,  2,  4,  5,  2,  8,  4,  2,  3,  8,  6,  7, 11, -1},
+    { 2,  7,  3,  2,  6,  7,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  6,  7,  0,  2,  6,  4,  5,  9, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  4,  5,  2,  7,  3,  2,  6,  7, -1, -1, -1, -1},
+    { 1,  4,  5,  1,  8,  4,  1,  7,  8,  1,  6,  7,  1,  2,  6, -1},
+    { 1,  7,  3,  1,  6,  7,  1, 10,  6,  4,  5,  9, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  6,  7,  0, 10,  6,  0,  1, 10,  4,  5,  9, -1},
+    { 0,  7,  3,  0,  6,  7,  0, 10,  6,  0,  5, 10,  0,  4,  5, -1},
+    { 4,  7,  8,  4,  6,  7,  4, 10,  6,  4,  5, 10, -1, -1, -1, -1},
+    { 5, 11,  6,  5,  8, 11,  5,  9,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  9,  0,  6,  5,  0, 11,  6,  0,  3, 11, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  6,  5,  0, 11,  6,  0,  8, 11, -1, -1, -1, -1},
+    { 1,  6,  5,  1, 11,  6,  1,  3, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 10,  2,  5, 11,  6,  5,  8, 11,  5,  9,  8, -1, -1, -1, -1},
+    { 0,  5,  9,  0,  6,  5,  0, 11,  6,  0,  3, 11,  1, 10,  2, -1},
+    { 0, 10,  2,  0,  5, 10,  0,  6,  5,  0, 11,  6,  0,  8, 11, -1},
+    { 2,  5, 10,  2,  6,  5,  2, 11,  6,  2,  3, 11, -1, -1, -1, -1},
+    { 2,  8,  3,  2,  9,  8,  2,  5,  9,  2,  6,  5, -1, -1, -1, -1},
+    { 0,  5,  9,  0,  6,  5,  0,  2,  6, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  1,  0,  6,  5,  0,  2,  6,  0,  3,  2,  0,  8,  3, -1},
+    { 1,  6,  5,  1,  2,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  3,  1,  9,  8,  1,  5,  9,  1,  6,  5,  1, 10,  6, -1},
+    { 0,  5,  9,  0,  6,  5,  0, 10,  6,  0,  1, 10, -1, -1, -1, -1},
+    { 0,  8,  3,  5, 10,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 5, 10,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 5, 11, 10,  5,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  5, 11, 10,  5,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  5, 11, 10,  5,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  9,  1,  3,  8,  5, 11, 10,  5,  7, 11, -1, -1, -1, -1},
+    { 1, 11,  2,  1,  7, 11,  1,  5,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  1, 11,  2,  1,  7, 11,  1,  5,  7, -1, -1, -1, -1},
+    { 0, 11,  2,  0,  7, 11,  0,  5,  7,  0,  9,  5, -1, -1, -1, -1},
+    { 2,  7, 11,  2,  5,  7,  2,  9,  5,  2,  8,  9,  2,  3,  8, -1},
+    { 2,  7,  3,  2,  5,  7,  2, 10,  5, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  5,  7,  0, 10,  5,  0,  2, 10, -1, -1, -1, -1},
+    { 0,  9,  1,  2,  7,  3,  2,  5,  7,  2, 10,  5, -1, -1, -1, -1},
+    { 1,  8,  9,  1,  7,  8,  1,  5,  7,  1, 10,  5,  1,  2, 10, -1},
+    { 1,  7,  3,  1,  5,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  5,  7,  0,  1,  5, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  3,  0,  5,  7,  0,  9,  5, -1, -1, -1, -1, -1, -1, -1},
+    { 5,  8,  9,  5,  7,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 4, 10,  5,  4, 11, 10,  4,  8, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  4,  0, 10,  5,  0, 11, 10,  0,  3, 11, -1, -1, -1, -1},
+    { 0,  9,  1,  4, 10,  5,  4, 11, 10,  4,  8, 11, -1, -1, -1, -1},
+    { 1,  4,  9,  1,  5,  4,  1, 10,  5,  1, 11, 10,  1,  3, 11, -1},
+    { 1, 11,  2,  1,  8, 11,  1,  4,  8,  1,  5,  4, -1, -1, -1, -1},
+    { 0,  5,  4,  0,  1,  5,  0,  2,  1,  0, 11,  2,  0,  3, 11, -1},
+    { 0, 11,  2,  0,  8, 11,  0,  4,  8,  0,  5,  4,  0,  9,  5, -1},
+    { 2,  3, 11,  4,  9,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  8,  3,  2,  4,  8,  2,  5,  4,  2, 10,  5, -1, -1, -1, -1},
+    { 0,  5,  4,  0, 10,  5,  0,  2, 10, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  9,  1,  2,  8,  3,  2,  4,  8,  2,  5,  4,  2, 10,  5, -1},
+    { 1,  4,  9,  1,  5,  4,  1, 10,  5,  1,  2, 10, -1, -1, -1, -1},
+    { 1,  8,  3,  1,  4,  8,  1,  5,  4, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  5,  4,  0,  1,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  8,  3,  0,  4,  8,  0,  5,  4,  0,  9,  5, -1, -1, -1, -1},
+    { 4,  9,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 4, 10,  9,  4, 11, 10,  4,  7, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  3,  8,  4, 10,  9,  4, 11, 10,  4,  7, 11, -1, -1, -1, -1},
+    { 0, 10,  1,  0, 11, 10,  0,  7, 11,  0,  4,  7, -1, -1, -1, -1},
+    { 1, 11, 10,  1,  7, 11,  1,  4,  7,  1,  8,  4,  1,  3,  8, -1},
+    { 1, 11,  2,  1,  7, 11,  1,  4,  7,  1,  9,  4, -1, -1, -1, -1},
+    { 0,  3,  8,  1, 11,  2,  1,  7, 11,  1,  4,  7,  1,  9,  4, -1},
+    { 0, 11,  2,  0,  7, 11,  0,  4,  7, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  7, 11,  2,  4,  7,  2,  8,  4,  2,  3,  8, -1, -1, -1, -1},
+    { 2,  7,  3,  2,  4,  7,  2,  9,  4,  2, 10,  9, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  4,  7,  0,  9,  4,  0, 10,  9,  0,  2, 10, -1},
+    { 0, 10,  1,  0,  2, 10,  0,  3,  2,  0,  7,  3,  0,  4,  7, -1},
+    { 1,  2, 10,  4,  7,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  7,  3,  1,  4,  7,  1,  9,  4, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  7,  8,  0,  4,  7,  0,  9,  4,  0,  1,  9, -1, -1, -1, -1},
+    { 0,  7,  3,  0,  4,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 4,  7,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 8, 10,  9,  8, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  9,  0, 11, 10,  0,  3, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  1,  0, 11, 10,  0,  8, 11, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 11, 10,  1,  3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1, 11,  2,  1,  8, 11,  1,  9,  8, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  1,  9,  0,  2,  1,  0, 11,  2,  0,  3, 11, -1, -1, -1, -1},
+    { 0, 11,  2,  0,  8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 2,  8,  3,  2,  9,  8,  2, 10,  9, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  9,  0,  2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0, 10,  1,  0,  2, 10,  0,  3,  2,  0,  8,  3, -1, -1, -1, -1},
+    { 1,  2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 1,  8,  3,  1,  9,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  1,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    { 0,  8,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
+};
+
+#endif // _MARCHING_CUBES_H_
@@ -0,0 +1,378 @@
+#include "grid.h"
+#include "macros.h"
+#include "muller_kernels.h"
+#include "marching_cubes.h"
+
+// Every active cell of the uniform grid is a block of
+// MC_RESOLUTION^3 voxels. The density is sampled at the corners of the
+// voxels, so a block holds MC_SAMPLES^3 samples
+#define MC_SAMPLES          (MC_RESOLUTION + 1)
+#define BLOCK_VOXELS        (MC_RESOLUTION * MC_RESOLUTION * MC_RESOLUTION)
+#define BLOCK_SAMPLES       (MC_SAMPLES * MC_SAMPLES * MC_SAMPLES)
+
+#define VOXEL_SIZE          (SUPPORT_RADIUS / MC_RESOLUTION)
+#define SQR_SUPPORT_RADIUS  (SUPPORT_RADIUS * SUPPORT_RADIUS)
+
+#define SAMPLE_ID(i, j, k)  (mad24(MC_SAMPLES, mad24(MC_SAMPLES, (k), (j)), (i)))
+#define VOXEL_ID(i, j, k)   (mad24(MC_RESOLUTION, mad24(MC_RESOLUTION, (k), (j)), (i)))
+
+/**
+ * @brief Returns the (x,y,z) coordinates of a cell given its id
+ */
+inline int4 cell_coordinates(int cell_id, const GridInfo* grid_info) {
+    int4 c;
+    c.x = cell_id % grid_info->cells_per_side;
+    c.y = (cell_id / grid_info->cells_per_side) % grid_info->cells_per_side;
+    c.z = cell_id / (grid_info->cells_per_side * grid_info->cells_per_side);
+    c.w = 0;
+    return c;
+}
+
+/**
+ * @brief Tells if cell coordinates are within the grid
+ */
+inline bool cell_in_grid(int4 c, const GridInfo* grid_info) {
+    int last = grid_info->cells_per_side - 1;
+    return c.x >= 0 && c.y >= 0 && c.z >= 0 && c.x <= last && c.y <= last && c.z <= last;
+}
+
+/**
+ * @brief Returns the (x,y,z) coordinates of a voxel within its block
+ */
+inline int4 voxel_coordinates(int voxel_id) {
+    int4 v;
+    v.x = voxel_id % MC_RESOLUTION;
+    v.y = (voxel_id / MC_RESOLUTION) % MC_RESOLUTION;
+    v.z = voxel_id / (MC_RESOLUTION * MC_RESOLUTION);
+    v.w = 0;
+    return v;
+}
+
+/**
+ * @brief Returns the position in space of a sample of a block
+ * @details The position is computed from the global sample coordinates, so
+ *          samples shared by neighbour blocks get exactly the same position,
+ *          and the same density.
+ */
+inline float4 sample_position(int4 cell, int4 sample, const GridInfo* grid_info) {
+    int4 g = cell * MC_RESOLUTION + sample;
+    float voxel_size = grid_info->cell_size / MC_RESOLUTION;
+
+    float4 p;
+    p.x = g.x * voxel_size - grid_info->size/2.0f;
+    p.y = g.y * voxel_size - grid_info->size/2.0f;
+    p.z = g.z * voxel_size - grid_info->size/2.0f;
+    p.w = 1.0f;
+    return p;
+}
+
+/**
+ * @brief Returns the density gradient at a sample, by finite differences
+ *        of the samples of the same block
+ */
+inline float4 sample_gradient(const global float* samples, int4 s) {
+    int4 lo = max(s - (int4)(1), (int4)(0));
+    int4 hi = min(s + (int4)(1), (int4)(MC_RESOLUTION));
+
+    float4 g;
+    g.x = (samples[SAMPLE_ID(hi.x, s.y, s.z)] - samples[SAMPLE_ID(lo.x, s.y, s.z)]) / ((hi.x - lo.x) * VOXEL_SIZE);
+    g.y = (samples[SAMPLE_ID(s.x, hi.y, s.z)] - samples[SAMPLE_ID(s.x, lo.y, s.z)]) / ((hi.y - lo.y) * VOXEL_SIZE);
+    g.z = (samples[SAMPLE_ID(s.x, s.y, hi.z)] - samples[SAMPLE_ID(s.x, s.y, lo.z)]) / ((hi.z - lo.z) * VOXEL_SIZE);
+    g.w = 0.0f;
+    return g;
+}
+
+/**
+ * @brief Flags the cells of the grid that may hold part of the surface
+ * @details A cell is active if itself, or any of its neighbour cells, holds
+ *          particles. Any other cell has zero density everywhere, so no
+ *          surface goes through it. Neighbours of the cells on the border
+ *          of the grid are clamped to it, so fluid in the outermost layer
+ *          gets its surface too.
+ *
+ * @param cell_intervals For every cell, the interval of particles within.
+ * @param block_flags For every cell, 1 if it is active, 0 if not.
+ * @param grid_info A struct with info about the grid.
+ */
+kernel void mark_active_blocks(const global int2* cell_intervals,
+                               global uint* block_flags,
+                               const GridInfo grid_info) {
+    int cell_id = get_global_id(0);
+    if (cell_id >= grid_info.cells_count) {
+        return;
+    }
+
+    int4 c = cell_coordinates(cell_id, &grid_info);
+    int last = grid_info.cells_per_side - 1;
+
+    uint active = 0;
+    for (int n = 0; n < 27 && !active; ++n) {
+        int4 nc = clamp(c + CELL_NEIGH_OFFSET[n], (int4)(0), (int4)(last));
+        int2 interval = cell_intervals[CELL_ID(nc.x, nc.y, nc.z, grid_info)];
+        active = interval.y > interval.x;
+    }
+
+    block_flags[cell_id] = active;
+}
+
+/**
+ * @brief Builds the list of active blocks from the scan of the flags
+ *
+ * @param block_flags For every cell, 1 if it is active, 0 if not.
+ * @param block_offsets The exclusive scan of block_flags.
+ * @param block_cells For every active block, the id of its cell.
+ * @param cell_blocks For every cell, the index of its block, or -1.
+ * @param cell_count Number of cells of the grid.
+ */
+kernel void compact_blocks(const global uint* block_flags,
+                           const global uint* block_offsets,
+                           global int* block_cells,
+                           global int* cell_blocks,
+                           const int cell_count) {
+    int cell_id = get_global_id(0);
+    if (cell_id >= cell_count) {
+        return;
+    }
+
+    if (block_flags[cell_id]) {
+        int block = block_offsets[cell_id];
+        block_cells[block] = cell_id;
+        cell_blocks[cell_id] = block;
+    }
+    else {
+        cell_blocks[cell_id] = -1;
+    }
+}
+
+/**
+ * @brief Samples the normalized fluid density at the corners of the voxels
+ *        of every active block
+ * @details The density is gathered from the particles of the neighbour
+ *          cells, using the cell intervals of the uniform grid. It is
+ *          normalized by the rest density, so it is ~1 inside the fluid.
+ *
+ * @param block_cells For every active block, the id of its cell.
+ * @param positions Sorted particle positions.
+ * @param cell_intervals For every cell, the interval of particles within.
+ * @param samples The density at every sample of every block.
+ * @param grid_info A struct with info about the grid.
+ * @param block_count Number of active blocks.
+ */
+kernel void compute_block_samples(const global int* block_cells,
+                                  const global float4* positions,
+                                  const global int2* cell_intervals,
+                                  global float* samples,
+                                  const GridInfo grid_info,
+                                  const int block_count) {
+    int i = get_global_id(0);
+    int block = i / BLOCK_SAMPLES;
+    if (block >= block_count) {
+        return;
+    }
+
+    int local_id = i - block * BLOCK_SAMPLES;
+    int4 s;
+    s.x = local_id % MC_SAMPLES;
+    s.y = (local_id / MC_SAMPLES) % MC_SAMPLES;
+    s.z = local_id / (MC_SAMPLES * MC_SAMPLES);
+    s.w = 0;
+
+    int4 cell = cell_coordinates(block_cells[block], &grid_info);
+    float4 p = sample_position(cell, s, &grid_info);
+
+    // Blocks on the border of the grid skip the neighbours out of it
+    float density = 0.0f;
+    for (int n = 0; n < 27; ++n) {
+        int4 nc = cell + CELL_NEIGH_OFFSET[n];
+        if (!cell_in_grid(nc, &grid_info)) {
+            continue;
+        }
+        int2 interval = cell_intervals[CELL_ID(nc.x, nc.y, nc.z, grid_info)];
+        for (int j = interval.x; j < interval.y; ++j) {
+            float4 r = p - positions[j];
+            r.w = 0.0f;
+            float r2 = dot(r, r);
+            if (r2 < SQR_SUPPORT_RADIUS) {
+                density += W_POLY6(r2, SUPPORT_RADIUS);
+            }
+        }
+    }
+
+    samples[i] = density * DENSITY_SCALE;
+}
+
+/**
+ * @brief Classifies the voxels of every active block
+ * @details For every voxel, computes how many triangles it generates, and
+ *          flags which of the three edges it owns (the ones that start at
+ *          its origin corner) are crossed by the surface.
+ *
+ * @param samples The density at every sample of every block.
+ * @param triangle_counts For every voxel, the number of triangles.
+ * @param edge_flags For every voxel and axis, 1 if the edge is crossed.
+ * @param block_count Number of active blocks.
+ */
+kernel void classify_voxels(const global float* samples,
+                            global uint* triangle_counts,
+                            global uint* edge_flags,
+                            const int block_count) {
+    int i = get_global_id(0);
+    int block = i / BLOCK_VOXELS;
+    if (block >= block_count) {
+        return;
+    }
+
+    int4 v = voxel_coordinates(i - block * BLOCK_VOXELS);
+    const global float* block_samples = samples + block * BLOCK_SAMPLES;
+
+    uint cube_index = 0;
+    for (int c = 0; c < 8; ++c) {
+        int4 s = v + MC_CORNERS[c];
+        if (block_samples[SAMPLE_ID(s.x, s.y, s.z)] > ISO_LEVEL) {
+            cube_index |= (1 << c);
+        }
+    }
+    triangle_counts[i] = MC_TRIANGLE_COUNT[cube_index];
+
+    // The origin is corner 0, and the edges along x, y and z end at the
+    // corners 1, 3 and 4
+    uint inside = cube_index & 1;
+    edge_flags[3*i + 0] = inside != ((cube_index >> 1) & 1);
+    edge_flags[3*i + 1] = inside != ((cube_index >> 3) & 1);
+    edge_flags[3*i + 2] = inside != ((cube_index >> 4) & 1);
+}
+
+/**
+ * @brief Generates a vertex for every edge crossed by the surface
+ *
+ * @param block_cells For every active block, the id of its cell.
+ * @param samples The density at every sample of every block.
+ * @param edge_flags For every voxel and axis, 1 if the edge is crossed.
+ * @param vertex_offsets The exclusive scan of edge_flags.
+ * @param vertices The position of every vertex.
+ * @param normals The normal of every vertex.
+ * @param grid_info A struct with info about the grid.
+ * @param block_count Number of active blocks.
+ */
+kernel void generate_vertices(const global int* block_cells,
+                              const global float* samples,
+                              const global uint* edge_flags,
+                              const global uint* vertex_offsets,
+                              global float4* vertices,
+                              global float4* normals,
+                              const GridInfo grid_info,
+                              const int block_count) {
+    int i = get_global_id(0);
+    int voxel = i / 3;
+    int block = voxel / BLOCK_VOXELS;
+    if (block >= block_count || !edge_flags[i]) {
+        return;
+    }
+
+    int axis = i - 3 * voxel;
+    int4 s0 = voxel_coordinates(voxel - block * BLOCK_VOXELS);
+    int4 s1 = s0;
+    if (axis == 0) s1.x += 1;
+    else if (axis == 1) s1.y += 1;
+    else s1.z += 1;
+
+    const global float* block_samples = samples + block * BLOCK_SAMPLES;
+    float d0 = block_samples[SAMPLE_ID(s0.x, s0.y, s0.z)];
+    float d1 = block_samples[SAMPLE_ID(s1.x, s1.y, s1.z)];
+    float t = clamp((ISO_LEVEL - d0) / (d1 - d0), 0.0f, 1.0f);
+
+    int4 cell = cell_coordinates(block_cells[block], &grid_info);
+    float4 p0 = sample_position(cell, s0, &grid_info);
+    float4 p1 = sample_position(cell, s1, &grid_info);
+
+    // The density decreases outwards, so the normal is the negated gradient
+    float4 g = mix(sample_gradient(block_samples, s0),
+                   sample_gradient(block_samples, s1),
+                   t);
+
+    uint vertex = vertex_offsets[i];
+    vertices[vertex] = mix(p0, p1, t);
+    normals[vertex] = -normalize(g);
+}
+
+/**
+ * @brief Generates the indices of the triangles of every voxel
+ * @details Every triangle vertex lies on an edge, and every edge is owned by
+ *          the voxel at its origin, that may belong to a neighbour block.
+ *          The index of the vertex is then looked up in the vertex offsets.
+ *
+ * @param block_cells For every active block, the id of its cell.
+ * @param cell_blocks For every cell, the index of its block, or -1.
+ * @param samples The density at every sample of every block.
+ * @param triangle_offsets The exclusive scan of the triangle counts.
+ * @param vertex_offsets The exclusive scan of the edge flags.
+ * @param indices The three vertex indices of every triangle.
+ * @param grid_info A struct with info about the grid.
+ * @param block_count Number of active blocks.
+ */
+kernel void generate_triangles(const global int* block_cells,
+                               const global int* cell_blocks,
+                               const global float* samples,
+                               const global uint* triangle_offsets,
+                               const global uint* vertex_offsets,
+                               global uint* indices,
+                               const GridInfo grid_info,
+                               const int block_count) {
+    int i = get_global_id(0);
+    int block = i / BLOCK_VOXELS;
+    if (block >= block_count) {
+        return;
+    }
+
+    int4 v = voxel_coordinates(i - block * BLOCK_VOXELS);
+    const global float* block_samples = samples + block * BLOCK_SAMPLES;
+
+    uint cube_index = 0;
+    for (int c = 0; c < 8; ++c) {
+        int4 s = v + MC_CORNERS[c];
+        if (block_samples[SAMPLE_ID(s.x, s.y, s.z)] > ISO_LEVEL) {
+            cube_index |= (1 << c);
+        }
+    }
+
+    int triangle_count = MC_TRIANGLE_COUNT[cube_index];
+    if (triangle_count == 0) {
+        return;
+    }
+
+    int4 cell = cell_coordinates(block_cells[block], &grid_info);
+    uint first = triangle_offsets[i];
+
+    for (int t = 0; t < 3 * triangle_count; ++t) {
+        int4 owner = MC_EDGE_OWNER[MC_TRIANGLES[cube_index][t]];
+        int4 ov = v + (int4)(owner.x, owner.y, owner.z, 0);
+
+        // Edges on the far faces of the block are owned by the neighbours
+        int4 oc = cell;
+        if (ov.x == MC_RESOLUTION) { ov.x = 0; oc.x += 1; }
+        if (ov.y == MC_RESOLUTION) { ov.y = 0; oc.y += 1; }
+        if (ov.z == MC_RESOLUTION) { ov.z = 0; oc.z += 1; }
+
+        // Past the far border of the grid there is no owner
+        int owner_block = block;
+        if (!cell_in_grid(oc, &grid_info)) {
+            owner_block = -1;
+        }
+        else if (oc.x != cell.x || oc.y != cell.y || oc.z != cell.z) {
+            owner_block = cell_blocks[CELL_ID(oc.x, oc.y, oc.z, grid_info)];
+        }
+
+        // A crossed edge always belongs to an active block. Should it not,
+        // the triangle degenerates to a point instead of reading garbage
+        uint vertex = 0;
+        if (owner_block >= 0) {
+            int voxel = mad24(owner_block, BLOCK_VOXELS, VOXEL_ID(ov.x, ov.y, ov.z));
+            vertex = vertex_offsets[3*voxel + owner.w];
+        }
+        else if (t % 3 != 0) {
+            vertex = indices[3*first + t - 1];
+        }
+
+        indices[3*first + t] = vertex;
+    }
+}
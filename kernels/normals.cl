@@ -27,7 +27,8 @@ kernel void compute_normals(read_only image1d_buffer_t positions,
                             const global int* neighbourhood_list,
                             const float w_grad_constant,
                             local float4* pos_cache,
-                            local float* dens_cache) {
+                            local float* dens_cache,
+                            const FluidParams fluid) {
     // Current fluid particle index
     int i = get_global_id(0);
     int local_id = get_local_id(0);
@@ -35,7 +36,7 @@ kernel void compute_normals(read_only image1d_buffer_t positions,
     int local_upper_bound = get_local_size(0) * (get_group_id(0) + 1);
 
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -50,7 +51,7 @@ kernel void compute_normals(read_only image1d_buffer_t positions,
     int list_lenght = neigh_list_length[i];
 
     for (int k = 0; k < list_lenght; ++k) {
-        int j = neighbourhood_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = neighbourhood_list[mad24(k, fluid.particle_count, i)];
         float4 pos_j;
         float d;
         if (local_lower_bound <= j && j < local_upper_bound) {
@@ -66,5 +67,5 @@ kernel void compute_normals(read_only image1d_buffer_t positions,
         normal += GRAD_W_DEFAULT(r, dot(r,r), SUPPORT_RADIUS) / d;
     }
 
-    normals[i] = w_grad_constant * normal * PARTICLE_MASS * SUPPORT_RADIUS;
+    normals[i] = w_grad_constant * normal * fluid.particle_mass * SUPPORT_RADIUS;
 } 
@@ -0,0 +1,23 @@
+// Copies the positions, and the velocities if there are any, of a chunk of
+// an array of particle records. The stride and the offsets are in floats
+kernel void unpack_particles(const global float* records,
+                             global float4* positions,
+                             global float4* velocities,
+                             const int stride,
+                             const int position_offset,
+                             const int velocity_offset,
+                             const int first,
+                             const int count) {
+    int i = get_global_id(0);
+
+    if (i >= count) {
+        return;
+    }
+
+    const global float* r = records + i * stride;
+    positions[first + i] = (float4)(vload3(0, r + position_offset), 1.0f);
+
+    if (velocity_offset >= 0) {
+        velocities[first + i] = (float4)(vload3(0, r + velocity_offset), 0.0f);
+    }
+}
@@ -39,7 +39,8 @@ kernel void compute_initial_density(read_only image1d_buffer_t fluid_position,
                                     read_only image1d_buffer_t sb_positions,
                                     read_only image1d_buffer_t sb_phi,
                                     const float w_eval_constant,
-                                    local float4* pos_cache) {
+                                    local float4* pos_cache,
+                                    const FluidParams fluid) {
     // Current fluid particle index
     int i = get_global_id(0);
     int local_id = get_local_id(0);
@@ -47,7 +48,7 @@ kernel void compute_initial_density(read_only image1d_buffer_t fluid_position,
     int local_upper_bound = get_local_size(0) * (get_group_id(0) + 1);
     
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -65,7 +66,7 @@ kernel void compute_initial_density(read_only image1d_buffer_t fluid_position,
     // Iterate over the fluid neighbourhood. Every neighbour is always 
     // within the support radius.
     for (int k = 0; k < list_lenght; ++k) {
-        int j = fluid_neighlist[mad24(k, PARTICLE_COUNT, i)];
+        int j = fluid_neighlist[mad24(k, fluid.particle_count, i)];
         
         float4 pos_j;
         if (local_lower_bound <= j && j < local_upper_bound) {
@@ -88,7 +89,7 @@ kernel void compute_initial_density(read_only image1d_buffer_t fluid_position,
     // Iterate over the fluid neighbourhood. Every neighbour is always 
     // within the support radius.
     for (int k = 0; k < list_lenght; ++k) {
-        int j = sb_neigh_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = sb_neigh_list[mad24(k, fluid.particle_count, i)];
 
         float4 pos_j = read_imagef(sb_positions, j);
         float4 r = pos_i - pos_j;
@@ -98,7 +99,7 @@ kernel void compute_initial_density(read_only image1d_buffer_t fluid_position,
     }
     #endif
 
-    fluid_density[i] = w_eval_constant * ((density_i * PARTICLE_MASS) + b_density_i);
+    fluid_density[i] = w_eval_constant * ((density_i * fluid.particle_mass) + b_density_i);
 }
 
 
@@ -147,7 +148,8 @@ kernel void compute_initial_forces(
     local float4* pos_cache,
     local float4* vel_cache,
     local float* dens_cache,
-    local float4* normal_cache)
+    local float4* normal_cache,
+    const FluidParams fluid)
 {   
     // Current fluid particle index
     int i = get_global_id(0);
@@ -156,7 +158,7 @@ kernel void compute_initial_forces(
     int local_upper_bound = get_local_size(0) * (get_group_id(0) + 1);
 
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -182,7 +184,7 @@ kernel void compute_initial_forces(
     int list_lenght = neigh_list_length[i];
 
     for (int k = 0; k < list_lenght; ++k) {
-        int j = neighbourhood_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = neighbourhood_list[mad24(k, fluid.particle_count, i)];
 
         float4 pos_j;
         float4 vel_j;
@@ -207,16 +209,16 @@ kernel void compute_initial_forces(
 
         f_viscosity += (vel_j - vel_i) * (LAPL_W_VISCOSITY(r_norm, SUPPORT_RADIUS) / density_j);
 
-        f_curvature += (normal_i - normal_j) * st_correction_factor(REST_DENSITY, density_i, density_j);
-        f_cohesion += fast_normalize(r) * st_kernel(r_norm, SUPPORT_RADIUS, st_kernel_c2) * st_correction_factor(REST_DENSITY, density_i, density_j);
+        f_curvature += (normal_i - normal_j) * st_correction_factor(fluid.rest_density, density_i, density_j);
+        f_cohesion += fast_normalize(r) * st_kernel(r_norm, SUPPORT_RADIUS, st_kernel_c2) * st_correction_factor(fluid.rest_density, density_i, density_j);
     }
 
     // We can take out the particle mass term of the sum
     // as every particle has constant mass
-    f_viscosity *= k_viscosity * SQR(PARTICLE_MASS) * (w_visc_lapl_constant / density_i);
+    f_viscosity *= k_viscosity * SQR(fluid.particle_mass) * (w_visc_lapl_constant / density_i);
 
-    f_cohesion *= PARTICLE_MASS * st_kernel_c1;
-    float4 f_tension = -surface_tension_coef * PARTICLE_MASS * (f_curvature + f_cohesion);
+    f_cohesion *= fluid.particle_mass * st_kernel_c1;
+    float4 f_tension = -surface_tension_coef * fluid.particle_mass * (f_curvature + f_cohesion);
 
     other_force[i] = f_viscosity + f_tension;
 }
@@ -236,6 +238,9 @@ kernel void compute_initial_forces(
  * @param dt Delta T.
  * @param particle_mass The mass of a particle.
  * @param g The gravity acceleration.
+ * @param sinks The lowest and highest corners of every sink box.
+ * @param sink_count The number of sinks.
+ * @param dead_count A counter of the particles that entered a sink.
  */
 kernel void predict_vel_n_pos(const global float4* position,
                               const global float4* velocity,
@@ -246,18 +251,22 @@ kernel void predict_vel_n_pos(const global float4* position,
                               const float dt,
                               const float4 g,
                               const float max_vel,
-                              const float4 container_limits) {
+                              const float4 container_limits,
+                              const FluidParams fluid,
+                              const global float4* sinks,
+                              const int sink_count,
+                              global int* dead_count) {
     // Current fluid particle index
     int i = get_global_id(0);
     
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
     float4 pos = position[i];
     float4 vel = velocity[i]; 
-    float4 acc = g + (pressure_force[i] + other_force[i]) / PARTICLE_MASS;
+    float4 acc = g + (pressure_force[i] + other_force[i]) / fluid.particle_mass;
 
     vel += clamp(acc * dt, -max_vel, max_vel);
     pos += vel * dt;
@@ -279,6 +288,17 @@ kernel void predict_vel_n_pos(const global float4* position,
     pos.w = 1.0f;
     vel.w = 0.0f;
 
+    // Particles that enter a sink die. They are moved to the end of the 
+    // buffers by the next sort, and dropped from the count
+    for (int s = 0; s < sink_count; ++s) {
+        if (all(isgreaterequal(pos.xyz, sinks[2*s].xyz)) &&
+            all(islessequal(pos.xyz, sinks[2*s + 1].xyz))) {
+            pos.w = 0.0f;
+            atomic_inc(dead_count);
+            break;
+        }
+    }
+
     predicted_pos[i] = pos;
     predicted_vel[i] = vel;
 }
@@ -307,18 +327,19 @@ kernel void predict_pos(const global float4* position,
                         const float dt,
                         const float4 g,
                         const float max_vel,
-                        const float4 container_limits) {
+                        const float4 container_limits,
+                        const FluidParams fluid) {
     // Current fluid particle index
     int i = get_global_id(0);
     
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
     float4 pos = position[i];
     float4 vel = velocity[i]; 
-    float4 acc = g + (pressure_force[i] + other_force[i]) / PARTICLE_MASS;
+    float4 acc = g + (pressure_force[i] + other_force[i]) / fluid.particle_mass;
 
     vel += clamp(acc * dt, -max_vel, max_vel);
     pos += vel * dt;
@@ -357,14 +378,15 @@ kernel void update_pressure(read_only image1d_buffer_t particles_predicted_pos,
                             read_only image1d_buffer_t sb_positions,
                             read_only image1d_buffer_t sb_phi,
                             const float w_default_constant,
-                            local float4* pos_cache) {
+                            local float4* pos_cache,
+                            const FluidParams fluid) {
     int i = get_global_id(0);
     int local_id = get_local_id(0);
     int local_lower_bound = get_local_size(0) * get_group_id(0);
     int local_upper_bound = get_local_size(0) * (get_group_id(0) + 1);
     
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -381,7 +403,7 @@ kernel void update_pressure(read_only image1d_buffer_t particles_predicted_pos,
     // Now iterate over the fluid particles
     int list_lenght = neigh_list_length[i];
     for (int k = 0; k < list_lenght; ++k) {
-        int j = neighbourhood_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = neighbourhood_list[mad24(k, fluid.particle_count, i)];
         float4 pred_pos_j;
         if (local_lower_bound <= j && j < local_upper_bound) {
             pred_pos_j = pos_cache[j - local_lower_bound];
@@ -395,12 +417,12 @@ kernel void update_pressure(read_only image1d_buffer_t particles_predicted_pos,
         float r_norm2 = dot(r,r);
         pred_density += W_DEFAULT(r_norm2, SUPPORT_RADIUS); 
     }
-    pred_density *= w_default_constant * PARTICLE_MASS;
+    pred_density *= w_default_constant * fluid.particle_mass;
 
     #ifdef COMPUTE_BOUNDARY
     list_lenght = sb_neigh_list_length[i];
     for (int k = 0; k < list_lenght; ++k) {
-        int j = sb_neigh_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = sb_neigh_list[mad24(k, fluid.particle_count, i)];
         float4 pos_j = read_imagef(sb_positions, j);
         float r_norm2 = dot(pred_pos_i-pos_j, pred_pos_i-pos_j);
         float phi = read_imagef(sb_phi, j).x;
@@ -409,7 +431,7 @@ kernel void update_pressure(read_only image1d_buffer_t particles_predicted_pos,
     pred_density_b *= w_default_constant;
     #endif
 
-    float density_variation = max(0.f, pred_density + pred_density_b - REST_DENSITY);
+    float density_variation = max(0.f, pred_density + pred_density_b - fluid.rest_density);
     
     mass_density_variation[i] = density_variation;
 
@@ -431,14 +453,15 @@ kernel void compute_pressure_force(read_only image1d_buffer_t particles_position
                                    const float w_pressure_grad_constant,
                                    local float4* pos_cache,
                                    local float* dens_cache,
-                                   local float* pressure_cache) {
+                                   local float* pressure_cache,
+                                   const FluidParams fluid) {
     int i = get_global_id(0);
     int local_id = get_local_id(0);
     int local_lower_bound = get_local_size(0) * get_group_id(0);
     int local_upper_bound = get_local_size(0) * (get_group_id(0) + 1);
     
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -459,7 +482,7 @@ kernel void compute_pressure_force(read_only image1d_buffer_t particles_position
     // Load how many neigbours this particle has
     int list_lenght = neigh_list_length[i];
     for (int k = 0; k < list_lenght; ++k) {
-        int j = neighbourhood_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = neighbourhood_list[mad24(k, fluid.particle_count, i)];
 
         float4 pos_j;
         float density_j;
@@ -483,13 +506,13 @@ kernel void compute_pressure_force(read_only image1d_buffer_t particles_position
         }
     }
 
-    f_pressure *= -SQR(PARTICLE_MASS) * w_pressure_grad_constant;
+    f_pressure *= -SQR(fluid.particle_mass) * w_pressure_grad_constant;
 
     #ifdef COMPUTE_BOUNDARY
     // Now compute the force exerted by the boundary
     list_lenght = sb_neigh_list_length[i];
     for (int k = 0; k < list_lenght; ++k) {
-        int j = sb_neigh_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = sb_neigh_list[mad24(k, fluid.particle_count, i)];
         float4 pos_j = read_imagef(sb_positions, j);
 
         float4 r = pos_i - pos_j;
@@ -497,8 +520,56 @@ kernel void compute_pressure_force(read_only image1d_buffer_t particles_position
 
         f_pressure_b += read_imagef(sb_phi, j).x * (2 * C) * GRAD_W_PRESSURE(r, l, SUPPORT_RADIUS);
     }
-    f_pressure_b *= -PARTICLE_MASS * w_pressure_grad_constant;
+    f_pressure_b *= -fluid.particle_mass * w_pressure_grad_constant;
     #endif
 
     pressure_force[i] = f_pressure + f_pressure_b;
 }
+
+/**
+ * @brief Writes the cost of every particle, for the particles renderer
+ * @details Run after the pressure solve, so the density error is the one
+ *          the step ends with. The particles are in the order the time 
+ *          integration writes them to the positions VBO.
+ * 
+ * @param neigh_list_length The length of the fluid neighbourhood lists.
+ * @param sb_neigh_list_length The length of the boundary neighbourhood 
+ *                             lists.
+ * @param mass_density_variation The predicted compression of every 
+ *                               particle, from the last iteration.
+ * @param metrics A buffer to write, for every particle, the fluid 
+ *                neighbours, 1 if a list is full, the density error 
+ *                relative to the rest density, and the boundary neighbours.
+ * @param max_list_length The most neighbours a fluid list holds.
+ * @param max_sb_list_length The most neighbours a boundary list holds.
+ * @param fluid The fluid parameters.
+ */
+kernel void write_particle_metrics(const global int* neigh_list_length,
+                                   const global int* sb_neigh_list_length,
+                                   const global float* mass_density_variation,
+                                   global write_only float4* metrics,
+                                   const int max_list_length,
+                                   const int max_sb_list_length,
+                                   const FluidParams fluid) {
+    int i = get_global_id(0);
+
+    // Validate that we are not out of bound
+    if(i >= fluid.particle_count) {
+        return;
+    }
+
+    int fluid_neighbours = neigh_list_length[i];
+    int boundary_neighbours = 0;
+    #ifdef COMPUTE_BOUNDARY
+    boundary_neighbours = sb_neigh_list_length[i];
+    #endif
+
+    // A full list may have dropped neighbours
+    bool truncated = fluid_neighbours >= max_list_length ||
+                     boundary_neighbours >= max_sb_list_length;
+
+    metrics[i] = (float4)(fluid_neighbours,
+                          truncated ? 1.0f : 0.0f,
+                          mass_density_variation[i] / fluid.rest_density,
+                          boundary_neighbours);
+}
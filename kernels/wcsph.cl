@@ -42,12 +42,13 @@ kernel void compute_density_pressure(const global float4* fluid_positions,
                                      const global int* boundary_neigh_indices,
                                      const global int* boundary_neigh_list_lengths,
                                      const global float4* boundary_positions,
-                                     const global float* boundary_phis) {
+                                     const global float* boundary_phis,
+                                     const FluidParams fluid) {
     // The id of the current particle
     int i = get_global_id(0);
 
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -57,7 +58,7 @@ kernel void compute_density_pressure(const global float4* fluid_positions,
 
     int list_lenght = fluid_neigh_list_lengths[i];
     for (int k = 0; k < list_lenght; ++k) {
-        int j = fluid_neigh_indices[mad24(k, PARTICLE_COUNT, i)];
+        int j = fluid_neigh_indices[mad24(k, fluid.particle_count, i)];
         float r_norm = distance(pos_i, fluid_positions[j]);
         density_i += W_DEFAULT(r_norm, support_radius);
     }
@@ -66,7 +67,7 @@ kernel void compute_density_pressure(const global float4* fluid_positions,
     // Now iterate over the static boundary particles
     list_lenght = boundary_neigh_list_lengths[i];
     for (int k = 0; k < list_lenght; ++k) {
-        int j = boundary_neigh_indices[mad24(k, PARTICLE_COUNT, i)];
+        int j = boundary_neigh_indices[mad24(k, fluid.particle_count, i)];
         float r_norm = distance(pos_i, boundary_positions[j]);
         b_density_i += W_DEFAULT(r_norm, support_radius) * boundary_phis[j];
     }
@@ -99,12 +100,13 @@ kernel void compute_acceleration(const global float4* fluid_position,
                                  global float4* sb_position,
                                  global float* sb_phi,
                                  const float st_kernel_main_c,
-                                 const float st_kernel_term_c) {
+                                 const float st_kernel_term_c,
+                                 const FluidParams fluid) {
     // Current fluid particle index
     int i = get_global_id(0);
 
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -128,7 +130,7 @@ kernel void compute_acceleration(const global float4* fluid_position,
     // exerted by the boundary particles
     int b_list_lenght = sb_neigh_list_length[i];
     for (int k = 0; k < b_list_lenght; ++k) {
-        int j = sb_neigh_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = sb_neigh_list[mad24(k, fluid.particle_count, i)];
         float4 r = pos_i - sb_position[j];
         float rnorm = length(r);
 
@@ -137,7 +139,7 @@ kernel void compute_acceleration(const global float4* fluid_position,
     
     int list_lenght = fluid_neigh_list_length[i];
     for (int k = 0; k < list_lenght; ++k) {
-        int j = fluid_neigh_list[mad24(k, PARTICLE_COUNT, i)];
+        int j = fluid_neigh_list[mad24(k, fluid.particle_count, i)];
 
         float4 vel_j = fluid_velocity[j];
         float4 normal_j = fluid_normal[j];
@@ -182,12 +184,13 @@ kernel void predict_vel_n_pos(global float4* position,
                               global float4* predicted_velocity_t,
                               global float4* predicted_velocity_half_t,
                               const float max_vel,
-                              const float4 container_limits) {
+                              const float4 container_limits,
+                              const FluidParams fluid) {
     // Current particle index
     int i = get_global_id(0);
     
     // Validate that we are not out of bound
-    if(i >= PARTICLE_COUNT) {
+    if(i >= fluid.particle_count) {
         return;
     }
 
@@ -1,5 +1,6 @@
 #include "gui/mainwindow.h"
 #include "settings/settings.h"
+#include "mesh/meshcache.h"
 #include <QDir>
 #include <QApplication>
 #include <QStyleFactory>
@@ -16,7 +17,18 @@ int main(int argc, char *argv[]) {
         ("help", "Print help")
         ("s,scene", "Scene file path", cxxopts::value<std::string>())
         ("c,config", "Config file path", cxxopts::value<std::string>())
-        ("o,performance_output", "Fps performance output file path", cxxopts::value<std::string>());
+        ("o,performance_output", "Fps performance output file path", cxxopts::value<std::string>())
+        ("phase_output", "Frame phase timings output file path, with the rolling p50/p95/p99 of every phase, JSON lines if it ends in .json, CSV otherwise", cxxopts::value<std::string>())
+        ("r,restore", "Checkpoint file to restore the simulation from", cxxopts::value<std::string>())
+        ("checkpoint", "Checkpoint file path, saved periodically", cxxopts::value<std::string>())
+        ("checkpoint_interval", "Simulation steps between checkpoints", cxxopts::value<int>())
+        ("record", "Record the fluid particles to this file", cxxopts::value<std::string>())
+        ("record_interval", "Simulation steps between recorded frames", cxxopts::value<int>())
+        ("replay", "Play back a recording instead of simulating", cxxopts::value<std::string>())
+        ("surface_output", "Export the fluid surface mesh to this .ply or .obj path", cxxopts::value<std::string>())
+        ("surface_interval", "Simulation steps between exported surface meshes", cxxopts::value<int>())
+        ("mesh_cache", "Directory to cache preprocessed models and boundary samplings in, empty to disable", cxxopts::value<std::string>())
+        ("memory_report", "Write the device memory by owner and attribute, and its peak, to this JSON file on exit", cxxopts::value<std::string>());
     
     try {
         options.parse(argc, argv);
@@ -35,6 +47,51 @@ int main(int argc, char *argv[]) {
             profiling_filename = options["performance_output"].as<std::string>();
         }
 
+        string phase_filename = "";
+        if (options.count("phase_output")) {
+            phase_filename = options["phase_output"].as<std::string>();
+        }
+
+        string checkpoint_filename = "";
+        int checkpoint_interval = 1000;
+        string restore_filename = "";
+        if (options.count("checkpoint")) {
+            checkpoint_filename = options["checkpoint"].as<std::string>();
+        }
+        if (options.count("checkpoint_interval")) {
+            checkpoint_interval = options["checkpoint_interval"].as<int>();
+        }
+        if (options.count("restore")) {
+            restore_filename = options["restore"].as<std::string>();
+        }
+
+        string record_filename = "";
+        int record_interval = 10;
+        if (options.count("record")) {
+            record_filename = options["record"].as<std::string>();
+        }
+        if (options.count("record_interval")) {
+            record_interval = options["record_interval"].as<int>();
+        }
+
+        string surface_filename = "";
+        int surface_interval = 10;
+        if (options.count("surface_output")) {
+            surface_filename = options["surface_output"].as<std::string>();
+        }
+        if (options.count("surface_interval")) {
+            surface_interval = options["surface_interval"].as<int>();
+        }
+
+        string memory_report_filename = "";
+        if (options.count("memory_report")) {
+            memory_report_filename = options["memory_report"].as<std::string>();
+        }
+
+        if (options.count("mesh_cache")) {
+            MeshCache::set_directory(options["mesh_cache"].as<std::string>());
+        }
+
         // Create directory for kernels profile
         if (!QDir("k_profile").exists()) {
             QDir().mkdir("k_profile");
@@ -46,6 +103,11 @@ int main(int argc, char *argv[]) {
         // Before initializing Qt Application, settings must be loaded
         Settings::load(config_filename, scene_filename);
 
+        if (options.count("replay")) {
+            Settings::simulation().sim_method = SimulationSettings::Method::REPLAY;
+            Settings::simulation().replay_file = options["replay"].as<std::string>();
+        }
+
         // Configure the application to use OpenGL 4.5
         QSurfaceFormat format;
         format.setVersion(4, 5);
@@ -79,6 +141,11 @@ int main(int argc, char *argv[]) {
         a.setStyleSheet("QToolTip { color: #ffffff; background-color: #2a82da; border: 1px solid white; }");
 
         MainWindow w(profiling_filename);
+        w.set_checkpointing(checkpoint_filename, checkpoint_interval, restore_filename);
+        w.set_recording(record_filename, record_interval);
+        w.set_surface_export(surface_filename, surface_interval);
+        w.set_memory_report(memory_report_filename);
+        w.set_phase_output(phase_filename);
         w.show();
 
         return a.exec();
@@ -3,7 +3,9 @@
 
 #include <cstddef>
 
-typedef unsigned short mesh_index;
+// 32 bit, so models with more than 65535 unique vertices can be indexed.
+// Draw with GL_UNSIGNED_INT
+typedef unsigned int mesh_index;
 
 class Mesh {
 
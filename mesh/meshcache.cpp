@@ -0,0 +1,252 @@
+#include "meshcache.h"
+#include "runtimeexception.h"
+
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Every array of a cache file starts at a multiple of this
+#define MESH_CACHE_ALIGNMENT    16
+
+string MeshCache::_directory = "mesh_cache";
+
+static size_t align(size_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(size_t)(MESH_CACHE_ALIGNMENT - 1);
+}
+
+CachedMesh::CachedMesh(const string& path) :
+_path(path),
+_data(nullptr),
+_size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw RunTimeException("Could not open cached mesh " + path + ": " + strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw RunTimeException("Could not stat cached mesh " + path + ": " + strerror(errno));
+    }
+    _size = st.st_size;
+
+    if (_size < sizeof(MeshCacheHeader)) {
+        close(fd);
+        throw RunTimeException("Invalid cached mesh " + path + ": file too small");
+    }
+
+    _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        throw RunTimeException("Could not map cached mesh " + path + ": " + strerror(errno));
+    }
+
+    // Anything wrong makes the entry a miss, and the mesh is rebuilt
+    auto fail = [&](const string& reason) {
+        munmap(_data, _size);
+        _data = nullptr;
+        throw RunTimeException("Invalid cached mesh " + path + ": " + reason);
+    };
+
+    auto& h = header();
+    if (memcmp(h.magic, MESH_CACHE_MAGIC, sizeof(h.magic)) != 0 || h.version != MESH_CACHE_VERSION) {
+        fail("bad magic number or version");
+    }
+    if (h.lod_count == 0) {
+        fail("no levels of detail");
+    }
+
+    // Walk the arrays, checking that all of them fit in the file. The sizes
+    // come from the file, so they are checked before any product or sum
+    // could overflow
+    auto base = static_cast<const char*>(_data);
+    uint64_t offset = sizeof(MeshCacheHeader);
+    auto take = [&](uint64_t count, uint64_t element_size) {
+        if (offset > _size || count > (_size - offset) / element_size) {
+            fail("truncated");
+        }
+        auto array = base + offset;
+        offset = align(offset + count * element_size);
+        return array;
+    };
+
+    auto counts = reinterpret_cast<const uint64_t*>(take(h.lod_count, sizeof(uint64_t)));
+    _vertices = reinterpret_cast<const float*>(take(h.vertex_count, 3 * sizeof(float)));
+    _normals = reinterpret_cast<const float*>(take(h.vertex_count, 3 * sizeof(float)));
+    for (uint32_t l = 0; l < h.lod_count; ++l) {
+        _lod_indices.push_back(reinterpret_cast<const mesh_index*>(take(counts[l], sizeof(mesh_index))));
+        _lod_counts.push_back(counts[l]);
+    }
+    _hull_points = reinterpret_cast<const float*>(take(h.hull_point_count, 3 * sizeof(float)));
+
+    // Checked once, so the renderer and the samplers can trust them
+    for (uint32_t l = 0; l < h.lod_count; ++l) {
+        for (size_t i = 0; i < _lod_counts[l]; ++i) {
+            if (_lod_indices[l][i] >= h.vertex_count) {
+                fail("index out of range");
+            }
+        }
+    }
+}
+
+CachedMesh::~CachedMesh() {
+    if (_data) {
+        munmap(_data, _size);
+    }
+}
+
+const MeshCacheHeader& CachedMesh::header() const {
+    return *static_cast<const MeshCacheHeader*>(_data);
+}
+
+const float* CachedMesh::vertices() const {
+    return _vertices;
+}
+
+const float* CachedMesh::normals() const {
+    return _normals;
+}
+
+const mesh_index* CachedMesh::lod_indices(size_t level) const {
+    return _lod_indices[level];
+}
+
+size_t CachedMesh::lod_indices_count(size_t level) const {
+    return _lod_counts[level];
+}
+
+const float* CachedMesh::hull_points() const {
+    return _hull_points;
+}
+
+void MeshCache::set_directory(const string& directory) {
+    _directory = directory;
+}
+
+const string& MeshCache::directory() {
+    return _directory;
+}
+
+string MeshCache::entry_path(const string& model_filename, int lod_levels) {
+    if (_directory.empty()) {
+        return "";
+    }
+
+    int fd = open(model_filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return "";
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return "";
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return "";
+    }
+
+    // The source is read once, front to back
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    uint64_t h = hash(data, st.st_size);
+    munmap(data, st.st_size);
+
+    // Anything the contents of the entry depend on
+    uint32_t options[2] = {MESH_CACHE_VERSION, (uint32_t)lod_levels};
+    h = hash(options, sizeof(options), h);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)h);
+    return _directory + "/" + name;
+}
+
+void MeshCache::write(const string& path,
+                      const float* vertices,
+                      const float* normals,
+                      size_t vertex_count,
+                      const vector<pair<const mesh_index*, size_t> >& lods,
+                      const float* hull_points,
+                      size_t hull_point_count,
+                      const float bounding_center[3],
+                      float bounding_radius) {
+    if (path.empty()) {
+        return;
+    }
+
+    // Only the last component is created, the cache lives in an existing
+    // directory
+    if (mkdir(_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        cerr << "Could not create mesh cache " << _directory << ": " << strerror(errno) << endl;
+        return;
+    }
+
+    MeshCacheHeader h;
+    memcpy(h.magic, MESH_CACHE_MAGIC, sizeof(h.magic));
+    h.version = MESH_CACHE_VERSION;
+    h.vertex_count = vertex_count;
+    h.lod_count = lods.size();
+    h.hull_point_count = hull_point_count;
+    memcpy(h.bounding_center, bounding_center, sizeof(h.bounding_center));
+    h.bounding_radius = bounding_radius;
+
+    string tmp_path = path + ".tmp";
+    ofstream out(tmp_path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Could not write cached mesh " << tmp_path << endl;
+        return;
+    }
+
+    size_t offset = 0;
+    auto put = [&](const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), size);
+        offset += size;
+    };
+    auto pad = [&]() {
+        static const char zeros[MESH_CACHE_ALIGNMENT] = {0};
+        put(zeros, align(offset) - offset);
+    };
+
+    put(&h, sizeof(h));
+    for (auto& lod : lods) {
+        uint64_t count = lod.second;
+        put(&count, sizeof(count));
+    }
+    pad();
+    put(vertices, 3 * vertex_count * sizeof(float));
+    pad();
+    put(normals, 3 * vertex_count * sizeof(float));
+    for (auto& lod : lods) {
+        pad();
+        put(lod.first, lod.second * sizeof(mesh_index));
+    }
+    pad();
+    put(hull_points, 3 * hull_point_count * sizeof(float));
+    out.close();
+
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        cerr << "Could not write cached mesh " << path << endl;
+        remove(tmp_path.c_str());
+    }
+}
+
+uint64_t MeshCache::hash(const void* data, size_t size, uint64_t seed) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
@@ -0,0 +1,149 @@
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include "mesh.h"
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#define MESH_CACHE_MAGIC    "FMSH"
+#define MESH_CACHE_VERSION  1
+
+// Layout of a cached mesh. The header is followed by the number of indices
+// of every level of detail, as uint64_t, and then by the vertices, normals,
+// the indices of every level and the hull points. Every array starts at a
+// multiple of 16 bytes, so it can be used in place once mapped
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t vertex_count;
+    uint32_t lod_count;
+    uint32_t hull_point_count;
+    float bounding_center[3];
+    float bounding_radius;
+};
+
+/**
+ * @class CachedMesh
+ * @brief A mesh mapped from the cache
+ * @details The file is mapped, not read, so the arrays can go straight to
+ *          glBufferData or Bullet, and only the pages that are used are
+ *          ever loaded.
+ */
+class CachedMesh {
+    public:
+        /**
+         * @brief Maps a cached mesh
+         *
+         * @param path The path of the cache file.
+         * @throws RunTimeException if the file can not be mapped, or is not
+         *         a valid cached mesh of the current version.
+         */
+        CachedMesh(const std::string& path);
+
+        ~CachedMesh();
+
+        const MeshCacheHeader& header() const;
+
+        // x,y,z components of every vertex
+        const float* vertices() const;
+
+        // x,y,z components of the normal of every vertex
+        const float* normals() const;
+
+        // Three indices per triangle, of a level of detail
+        const mesh_index* lod_indices(std::size_t level) const;
+
+        // Number of indices of a level of detail
+        std::size_t lod_indices_count(std::size_t level) const;
+
+        // x,y,z components of every point of the convex hull
+        const float* hull_points() const;
+
+    private:
+        std::string _path;
+        void* _data;
+        std::size_t _size;
+
+        std::vector<const mesh_index*> _lod_indices;
+        std::vector<std::size_t> _lod_counts;
+        const float* _vertices;
+        const float* _normals;
+        const float* _hull_points;
+};
+
+/**
+ * @class MeshCache
+ * @brief A directory of preprocessed meshes
+ * @details Meshes are addressed by a hash of the contents of their source
+ *          file and of the options they were built with, so an edited model
+ *          never hits a stale entry, and a renamed or copied one still hits.
+ */
+class MeshCache {
+    public:
+        /**
+         * @brief Sets the directory of the cache
+         *
+         * @param directory The directory, created when first written. Empty
+         *                  disables the cache.
+         */
+        static void set_directory(const std::string& directory);
+
+        // Returns the directory of the cache, empty if disabled
+        static const std::string& directory();
+
+        /**
+         * @brief Returns the path of the cache entry of a model
+         *
+         * @param model_filename The path of the source file of the model.
+         * @param lod_levels The levels of detail the mesh is built with.
+         * @return The path of the entry, that may not exist yet. Empty if
+         *         the cache is disabled or the model can not be read.
+         */
+        static std::string entry_path(const std::string& model_filename,
+                                      int lod_levels);
+
+        /**
+         * @brief Writes a cache entry
+         * @details The entry is written to a temporary file and renamed, so
+         *          a partial entry is never mapped. Failures are reported,
+         *          but not fatal, the mesh is just not cached.
+         *
+         * @param path The path of the entry, from entry_path.
+         * @param vertices x,y,z components of every vertex.
+         * @param normals x,y,z components of the normal of every vertex.
+         * @param vertex_count The number of vertices.
+         * @param lods The indices and number of indices of every level.
+         * @param hull_points x,y,z components of every hull point.
+         * @param hull_point_count The number of hull points.
+         * @param bounding_center The center of the bounding box.
+         * @param bounding_radius The radius of the bounding sphere.
+         */
+        static void write(const std::string& path,
+                          const float* vertices,
+                          const float* normals,
+                          std::size_t vertex_count,
+                          const std::vector<std::pair<const mesh_index*, std::size_t> >& lods,
+                          const float* hull_points,
+                          std::size_t hull_point_count,
+                          const float bounding_center[3],
+                          float bounding_radius);
+
+        /**
+         * @brief Hashes a block of memory (FNV-1a)
+         *
+         * @param data The memory to hash.
+         * @param size The size of the block, in bytes.
+         * @param seed The hash of the previous blocks, to hash several
+         *             blocks as one.
+         */
+        static uint64_t hash(const void* data,
+                             std::size_t size,
+                             uint64_t seed=14695981039346656037ull);
+
+    private:
+        static std::string _directory;
+};
+
+#endif // _MESH_CACHE_H_
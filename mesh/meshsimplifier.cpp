@@ -0,0 +1,306 @@
+#include "meshsimplifier.h"
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Border edges are held in place by a plane perpendicular to their triangle,
+// weighted this much more than the planes of the triangles themselves
+#define BOUNDARY_WEIGHT     (1000.0)
+
+// Hashes the exact bits of a position, to weld vertices
+struct PositionKey {
+    uint32_t bits[3];
+
+    bool operator==(const PositionKey& k) const {
+        return bits[0] == k.bits[0] && bits[1] == k.bits[1] && bits[2] == k.bits[2];
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        return (k.bits[0] * 73856093u) ^ (k.bits[1] * 19349663u) ^ (k.bits[2] * 83492791u);
+    }
+};
+
+static uint64_t edge_key(int a, int b) {
+    if (a > b) {
+        swap(a, b);
+    }
+    return ((uint64_t)a << 32) | (uint32_t)b;
+}
+
+MeshSimplifier::Quadric::Quadric() {
+    memset(m, 0, sizeof(m));
+}
+
+MeshSimplifier::Quadric::Quadric(double a, double b, double c, double d, double w) {
+    m[0] = w*a*a; m[1] = w*a*b; m[2] = w*a*c; m[3] = w*a*d;
+                  m[4] = w*b*b; m[5] = w*b*c; m[6] = w*b*d;
+                                m[7] = w*c*c; m[8] = w*c*d;
+                                              m[9] = w*d*d;
+}
+
+MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(const Quadric& q) {
+    for (int i = 0; i < 10; ++i) {
+        m[i] += q.m[i];
+    }
+    return *this;
+}
+
+double MeshSimplifier::Quadric::error(const btVector3& p) const {
+    double x = p.x(), y = p.y(), z = p.z();
+    return m[0]*x*x + 2*m[1]*x*y + 2*m[2]*x*z + 2*m[3]*x
+                    +   m[4]*y*y + 2*m[5]*y*z + 2*m[6]*y
+                                 +   m[7]*z*z + 2*m[8]*z
+                                              +   m[9];
+}
+
+MeshSimplifier::MeshSimplifier(const vector<float>& vertices,
+                               const vector<mesh_index>& indices) :
+_triangle_count(0) {
+    _weld(vertices, indices);
+    _init_quadrics();
+
+    for (size_t t = 0; t < _triangles.size(); ++t) {
+        if (!_removed[t]) {
+            for (int k = 0; k < 3; ++k) {
+                _queue_edge(_triangles[t][k], _triangles[t][(k + 1) % 3]);
+            }
+        }
+    }
+}
+
+void MeshSimplifier::_weld(const vector<float>& vertices,
+                           const vector<mesh_index>& indices) {
+    size_t vertex_count = vertices.size() / 3;
+    unordered_map<PositionKey, int, PositionKeyHash> welded;
+    welded.reserve(vertex_count);
+
+    _position_of.resize(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        PositionKey key;
+        memcpy(key.bits, &vertices[3*v], sizeof(key.bits));
+
+        auto it = welded.find(key);
+        if (it != welded.end()) {
+            _position_of[v] = it->second;
+        }
+        else {
+            int p = _positions.size();
+            welded[key] = p;
+            _position_of[v] = p;
+            _positions.push_back(btVector3(vertices[3*v + 0],
+                                           vertices[3*v + 1],
+                                           vertices[3*v + 2]));
+            _vertex_of.push_back(v);
+        }
+    }
+
+    size_t triangle_count = indices.size() / 3;
+    _triangles.resize(triangle_count);
+    _corners.resize(triangle_count);
+    _removed.resize(triangle_count, false);
+    _position_triangles.resize(_positions.size());
+    for (size_t t = 0; t < triangle_count; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            _corners[t][k] = indices[3*t + k];
+            _triangles[t][k] = _position_of[indices[3*t + k]];
+        }
+
+        // Triangles that welding made degenerate are dropped
+        auto& tri = _triangles[t];
+        if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) {
+            _removed[t] = true;
+            continue;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            _position_triangles[tri[k]].push_back(t);
+        }
+        ++_triangle_count;
+    }
+
+    _alive.resize(_positions.size(), true);
+    _version.resize(_positions.size(), 0);
+}
+
+void MeshSimplifier::_init_quadrics() {
+    _quadrics.resize(_positions.size());
+
+    // Number of triangles every edge belongs to, to find the borders
+    unordered_map<uint64_t, int> edge_triangles;
+    edge_triangles.reserve(3 * _triangle_count);
+
+    for (size_t t = 0; t < _triangles.size(); ++t) {
+        if (_removed[t]) {
+            continue;
+        }
+
+        auto& tri = _triangles[t];
+        btVector3 n = (_positions[tri[1]] - _positions[tri[0]]).cross(_positions[tri[2]] - _positions[tri[0]]);
+        double area = 0.5 * n.length();
+        if (area > 0.0) {
+            n.normalize();
+            Quadric q(n.x(), n.y(), n.z(), -n.dot(_positions[tri[0]]), area);
+            for (int k = 0; k < 3; ++k) {
+                _quadrics[tri[k]] += q;
+            }
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            ++edge_triangles[edge_key(tri[k], tri[(k + 1) % 3])];
+        }
+    }
+
+    for (size_t t = 0; t < _triangles.size(); ++t) {
+        if (_removed[t]) {
+            continue;
+        }
+
+        auto& tri = _triangles[t];
+        btVector3 n = (_positions[tri[1]] - _positions[tri[0]]).cross(_positions[tri[2]] - _positions[tri[0]]);
+        for (int k = 0; k < 3; ++k) {
+            int a = tri[k];
+            int b = tri[(k + 1) % 3];
+            if (edge_triangles[edge_key(a, b)] != 1) {
+                continue;
+            }
+
+            btVector3 e = _positions[b] - _positions[a];
+            btVector3 m = e.cross(n);
+            if (m.length2() == 0.0f) {
+                continue;
+            }
+            m.normalize();
+            Quadric q(m.x(), m.y(), m.z(), -m.dot(_positions[a]), BOUNDARY_WEIGHT * e.length2());
+            _quadrics[a] += q;
+            _quadrics[b] += q;
+        }
+    }
+}
+
+void MeshSimplifier::_queue_edge(int a, int b) {
+    Quadric q = _quadrics[a];
+    q += _quadrics[b];
+
+    // Collapse onto the endpoint with the smallest error
+    double a_to_b = q.error(_positions[b]);
+    double b_to_a = q.error(_positions[a]);
+    if (a_to_b <= b_to_a) {
+        _queue.push({a_to_b, a, b, _version[a], _version[b]});
+    }
+    else {
+        _queue.push({b_to_a, b, a, _version[b], _version[a]});
+    }
+}
+
+bool MeshSimplifier::_flips(int from, int to) const {
+    for (int t : _position_triangles[from]) {
+        auto& tri = _triangles[t];
+        if (_removed[t] || tri[0] == to || tri[1] == to || tri[2] == to) {
+            continue;
+        }
+
+        btVector3 p[3], q[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = _positions[tri[k]];
+            q[k] = (tri[k] == from) ? _positions[to] : p[k];
+        }
+
+        btVector3 n_before = (p[1] - p[0]).cross(p[2] - p[0]);
+        btVector3 n_after = (q[1] - q[0]).cross(q[2] - q[0]);
+        if (n_before.dot(n_after) <= 0.0f) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void MeshSimplifier::_collapse(int from, int to) {
+    _alive[from] = false;
+    _quadrics[to] += _quadrics[from];
+    ++_version[to];
+
+    for (int t : _position_triangles[from]) {
+        if (_removed[t]) {
+            continue;
+        }
+
+        auto& tri = _triangles[t];
+        if (tri[0] == to || tri[1] == to || tri[2] == to) {
+            // The collapsed edge was one of its sides
+            _removed[t] = true;
+            --_triangle_count;
+            continue;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            if (tri[k] == from) {
+                tri[k] = to;
+            }
+        }
+        _position_triangles[to].push_back(t);
+    }
+    _position_triangles[from].clear();
+    _position_triangles[from].shrink_to_fit();
+
+    // Drop the removed triangles, and queue the edges around the position
+    // again, with its new quadric
+    auto& around = _position_triangles[to];
+    size_t live = 0;
+    for (size_t i = 0; i < around.size(); ++i) {
+        int t = around[i];
+        if (_removed[t]) {
+            continue;
+        }
+        around[live++] = t;
+
+        for (int k = 0; k < 3; ++k) {
+            if (_triangles[t][k] != to) {
+                _queue_edge(to, _triangles[t][k]);
+            }
+        }
+    }
+    around.resize(live);
+}
+
+vector<mesh_index> MeshSimplifier::simplify(size_t target_triangles) {
+    while (_triangle_count > target_triangles && !_queue.empty()) {
+        Collapse c = _queue.top();
+        _queue.pop();
+
+        bool stale = !_alive[c.from] || !_alive[c.to] ||
+                     _version[c.from] != c.from_version ||
+                     _version[c.to] != c.to_version;
+        if (stale || _flips(c.from, c.to)) {
+            continue;
+        }
+
+        _collapse(c.from, c.to);
+    }
+
+    // Corners keep their original vertex, and so their normal, unless their
+    // position was collapsed onto another one
+    vector<mesh_index> indices;
+    indices.reserve(3 * _triangle_count);
+    for (size_t t = 0; t < _triangles.size(); ++t) {
+        if (_removed[t]) {
+            continue;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            int p = _triangles[t][k];
+            mesh_index v = _corners[t][k];
+            indices.push_back(_position_of[v] == p ? v : _vertex_of[p]);
+        }
+    }
+
+    return indices;
+}
+
+size_t MeshSimplifier::triangle_count() const {
+    return _triangle_count;
+}
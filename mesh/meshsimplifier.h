@@ -0,0 +1,100 @@
+#ifndef _MESH_SIMPLIFIER_H_
+#define _MESH_SIMPLIFIER_H_
+
+#include "mesh.h"
+#include <vector>
+#include <array>
+#include <queue>
+#include <LinearMath/btVector3.h>
+
+/**
+ * @class MeshSimplifier
+ * @brief Simplifies a triangle mesh by collapsing edges
+ * @details Edges are collapsed in order of their quadric error, as in
+ *          "Surface Simplification Using Quadric Error Metrics" (Garland and
+ *          Heckbert). Every edge collapses onto one of its endpoints, so the
+ *          simplified meshes index a subset of the original vertices, and
+ *          all the levels of detail of a mesh can share its vertex buffer.
+ *          Vertices that only differ in their normal are welded while
+ *          simplifying.
+ */
+class MeshSimplifier {
+    public:
+        /**
+         * @brief Prepares a mesh for simplification
+         *
+         * @param vertices x,y,z components of every vertex.
+         * @param indices Three indices per triangle.
+         */
+        MeshSimplifier(const std::vector<float>& vertices,
+                       const std::vector<mesh_index>& indices);
+
+        /**
+         * @brief Collapses edges until at most target_triangles are left
+         * @details Each call continues from where the previous one stopped,
+         *          so a chain of levels of detail is built by calling this
+         *          with decreasing targets. Collapses that would flip a
+         *          triangle are skipped, so the target may not be reached.
+         *
+         * @param target_triangles The number of triangles to reduce to.
+         * @return The remaining triangles, indexing the original vertices.
+         */
+        std::vector<mesh_index> simplify(std::size_t target_triangles);
+
+        /**
+         * @brief Returns the number of triangles left
+         */
+        std::size_t triangle_count() const;
+
+    private:
+        // Symmetric 4x4 matrix, upper triangle by rows
+        struct Quadric {
+            double m[10];
+
+            Quadric();
+            Quadric(double a, double b, double c, double d, double w);
+            Quadric& operator+=(const Quadric& q);
+            double error(const btVector3& p) const;
+        };
+
+        // Candidate collapse of the position from onto the position to.
+        // It is stale if any of them changed after it was queued
+        struct Collapse {
+            double cost;
+            int from, to;
+            int from_version, to_version;
+
+            bool operator>(const Collapse& c) const { return cost > c.cost; }
+        };
+
+        // Welded positions, and the vertices they came from
+        std::vector<btVector3> _positions;
+        std::vector<int> _position_of;
+        std::vector<mesh_index> _vertex_of;
+
+        std::vector<Quadric> _quadrics;
+
+        // Positions collapsed onto another one are no longer alive
+        std::vector<bool> _alive;
+        std::vector<int> _version;
+
+        // Triangles, as positions, and the original vertices of the corners
+        std::vector<std::array<int, 3> > _triangles;
+        std::vector<std::array<mesh_index, 3> > _corners;
+        std::vector<bool> _removed;
+        std::size_t _triangle_count;
+
+        // Triangles around every position. Removed ones are skipped lazily
+        std::vector<std::vector<int> > _position_triangles;
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > _queue;
+
+        void _weld(const std::vector<float>& vertices,
+                   const std::vector<mesh_index>& indices);
+        void _init_quadrics();
+        void _queue_edge(int a, int b);
+        bool _flips(int from, int to) const;
+        void _collapse(int from, int to);
+};
+
+#endif // _MESH_SIMPLIFIER_H_
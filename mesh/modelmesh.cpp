@@ -1,19 +1,63 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "modelmesh.h"
+#include "meshsimplifier.h"
+#include "meshcache.h"
+#include "runtimeexception.h"
+#include "BulletCollision/CollisionShapes/btShapeHull.h"
+#include "btBulletCollisionCommon.h"
 #include "external/tinyobj/tiny_obj_loader.h"
 #include <algorithm>
 #include <iostream>
-#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <unistd.h>
 
 using namespace std;
 
+// Levels of detail are not simplified below this number of triangles
+#define MIN_LOD_TRIANGLES   64
+
 /**
  * This implementation uses tinyobj
  * @see https://github.com/syoyo/tinyobjloader
  */
 
-ModelMesh::ModelMesh(const string& model_filename) {
+ModelMesh::ModelMesh(const string& model_filename, int lod_levels) {
+    // A cached mesh is used in place, nothing is parsed nor built
+    auto cache_path = MeshCache::entry_path(model_filename, lod_levels);
+    if (!cache_path.empty() && access(cache_path.c_str(), R_OK) == 0) {
+        try {
+            _cached = unique_ptr<CachedMesh>(new CachedMesh(cache_path));
+            _use_cached_mesh();
+            return;
+        }
+        catch (const RunTimeException& e) {
+            // A bad entry is just rebuilt, and overwritten
+            cerr << e.what() << endl;
+            _cached.reset();
+        }
+    }
+
+    _load_obj(model_filename);
+    _compute_bounds();
+    _build_lods(lod_levels);
+    _build_hull();
+    _use_own_mesh();
+
+    float center[3] = {_bounding_center.x(), _bounding_center.y(), _bounding_center.z()};
+    MeshCache::write(cache_path,
+                     _vertex_data,
+                     _normal_data,
+                     _vertex_count,
+                     _lod_data,
+                     _hull_data,
+                     _hull_point_count,
+                     center,
+                     _bounding_radius);
+}
+
+void ModelMesh::_load_obj(const string& model_filename) {
     tinyobj::attrib_t attrib;
     vector<tinyobj::shape_t> shapes;
     vector<tinyobj::material_t> materials;
@@ -35,8 +79,15 @@ ModelMesh::ModelMesh(const string& model_filename) {
     // I use this map to keep track of already seen pairs of vertex/normal
     // If a vertex has already been loaded, but with a different normal, then
     // we must load a copy of that vertex to use the new normal
-    // This is how OpenGL Array Buffer expects things
-    map<pair<int, int>, int> loaded_indices;
+    // This is how OpenGL Array Buffer expects things. The pair is packed in
+    // a 64 bit key, and hashed
+    size_t corner_count = 0;
+    for (auto& shape : shapes) {
+        corner_count += shape.mesh.indices.size();
+    }
+    unordered_map<uint64_t, mesh_index> loaded_indices;
+    loaded_indices.reserve(corner_count);
+    _indices.reserve(corner_count);
 
     // Loop over shapes
     for (size_t s = 0; s < shapes.size(); s++) {
@@ -50,7 +101,7 @@ ModelMesh::ModelMesh(const string& model_filename) {
                 // Access to vertex
                 tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
                 
-                auto p = pair<int, int>(idx.vertex_index, idx.normal_index);
+                auto p = ((uint64_t)(uint32_t)idx.vertex_index << 32) | (uint32_t)idx.normal_index;
                 auto i = loaded_indices.find(p);
 
                 if (i != loaded_indices.end()) {
@@ -66,7 +117,7 @@ ModelMesh::ModelMesh(const string& model_filename) {
                     float ny = attrib.normals[3*idx.normal_index+1];
                     float nz = attrib.normals[3*idx.normal_index+2];
 
-                    int new_idx = _vertices.size()/3;
+                    mesh_index new_idx = _vertices.size()/3;
                     
                     _vertices.push_back(vx);
                     _vertices.push_back(vy);
@@ -81,7 +132,131 @@ ModelMesh::ModelMesh(const string& model_filename) {
 
             index_offset += fv;
         }
-    }   
+    }
+}
+
+void ModelMesh::_use_own_mesh() {
+    _vertex_data = _vertices.data();
+    _normal_data = _normals.data();
+    _vertex_count = _vertices.size() / 3;
+
+    _lod_data.clear();
+    _lod_data.push_back(make_pair(_indices.data(), _indices.size()));
+    for (auto& lod : _lods) {
+        _lod_data.push_back(make_pair(lod.data(), lod.size()));
+    }
+
+    _hull_data = _hull_points.data();
+    _hull_point_count = _hull_points.size() / 3;
+
+    _hash_geometry();
+}
+
+void ModelMesh::_use_cached_mesh() {
+    auto& h = _cached->header();
+
+    _vertex_data = _cached->vertices();
+    _normal_data = _cached->normals();
+    _vertex_count = h.vertex_count;
+
+    _lod_data.clear();
+    for (uint32_t l = 0; l < h.lod_count; ++l) {
+        _lod_data.push_back(make_pair(_cached->lod_indices(l), _cached->lod_indices_count(l)));
+    }
+
+    _hull_data = _cached->hull_points();
+    _hull_point_count = h.hull_point_count;
+
+    _bounding_center = btVector3(h.bounding_center[0], h.bounding_center[1], h.bounding_center[2]);
+    _bounding_radius = h.bounding_radius;
+
+    _hash_geometry();
+}
+
+void ModelMesh::_hash_geometry() {
+    uint64_t h = MeshCache::hash(_vertex_data, 3 * _vertex_count * sizeof(float));
+    _geometry_hash = MeshCache::hash(_lod_data[0].first, _lod_data[0].second * sizeof(mesh_index), h);
+}
+
+void ModelMesh::_build_hull() {
+    // The hull is built from the coarsest level of detail, as a hull of
+    // the full mesh is slow to build for high resolution models
+    auto& indices = _lods.empty() ? _indices : _lods.back();
+    if (indices.empty()) {
+        return;
+    }
+
+    vector<int> bt_indices(indices.begin(), indices.end());
+    vector<btScalar> bt_vertices(_vertices.begin(), _vertices.end());
+    btTriangleIndexVertexArray index_vertex_arrays(bt_indices.size() / 3,
+                                                   bt_indices.data(),
+                                                   3 * sizeof(int),
+                                                   _vertices.size() / 3,
+                                                   bt_vertices.data(),
+                                                   3 * sizeof(btScalar));
+    btConvexTriangleMeshShape convex_shape(&index_vertex_arrays);
+
+    // Create a hull approximation
+    btShapeHull hull(&convex_shape);
+    hull.buildHull(convex_shape.getMargin());
+    for (int i = 0; i < hull.numVertices(); ++i) {
+        auto& p = hull.getVertexPointer()[i];
+        _hull_points.push_back(p.x());
+        _hull_points.push_back(p.y());
+        _hull_points.push_back(p.z());
+    }
+}
+
+void ModelMesh::_compute_bounds() {
+    if (_vertices.empty()) {
+        _bounding_center = btVector3(0, 0, 0);
+        _bounding_radius = 0.0f;
+        return;
+    }
+
+    btVector3 lo(_vertices[0], _vertices[1], _vertices[2]);
+    btVector3 hi = lo;
+    for (size_t i = 0; i < _vertices.size(); i += 3) {
+        btVector3 v(_vertices[i], _vertices[i+1], _vertices[i+2]);
+        lo.setMin(v);
+        hi.setMax(v);
+    }
+
+    _bounding_center = 0.5f * (lo + hi);
+    _bounding_radius = 0.5f * (hi - lo).length();
+}
+
+void ModelMesh::_build_lods(int lod_levels) {
+    if (lod_levels <= 0) {
+        return;
+    }
+
+    cout << "Simplifying model..." << flush;
+
+    // Every level continues simplifying where the previous one stopped
+    MeshSimplifier simplifier(_vertices, _indices);
+    size_t triangles = _indices.size() / 3;
+    for (int level = 0; level < lod_levels; ++level) {
+        triangles /= 2;
+        if (triangles < MIN_LOD_TRIANGLES) {
+            break;
+        }
+
+        size_t before = simplifier.triangle_count();
+        auto indices = simplifier.simplify(triangles);
+
+        // No collapse was possible, the level would repeat the previous one
+        if (simplifier.triangle_count() == before) {
+            break;
+        }
+        _lods.push_back(move(indices));
+    }
+
+    cout << "done! " << _lods.size() << " levels";
+    for (auto& lod : _lods) {
+        cout << " " << lod.size() / 3;
+    }
+    cout << " triangles" << endl;
 }
 
 ModelMesh::~ModelMesh() {
@@ -89,25 +264,57 @@ ModelMesh::~ModelMesh() {
 }
 
 const float* ModelMesh::vertices() const {
-    return _vertices.data();
+    return _vertex_data;
 }
 
 const float* ModelMesh::normals() const {
-    return _normals.data();
+    return _normal_data;
 }
 
 const mesh_index* ModelMesh::mesh_indices() const {
-    return _indices.data();
+    return _lod_data[0].first;
 }
 
 size_t ModelMesh::vertices_count() const {
-    return _vertices.size() / 3;
+    return _vertex_count;
 }
 
 size_t ModelMesh::indices_count() const {
-    return _indices.size();
+    return _lod_data[0].second;
 }
 
 Mesh::Mode ModelMesh::mode() const {
     return TRIANGLES;
-}
\ No newline at end of file
+}
+
+size_t ModelMesh::lod_count() const {
+    return _lod_data.size();
+}
+
+const mesh_index* ModelMesh::lod_indices(size_t level) const {
+    return _lod_data[min(level, _lod_data.size() - 1)].first;
+}
+
+size_t ModelMesh::lod_indices_count(size_t level) const {
+    return _lod_data[min(level, _lod_data.size() - 1)].second;
+}
+
+const float* ModelMesh::hull_points() const {
+    return _hull_data;
+}
+
+size_t ModelMesh::hull_point_count() const {
+    return _hull_point_count;
+}
+
+btVector3 ModelMesh::bounding_center() const {
+    return _bounding_center;
+}
+
+float ModelMesh::bounding_radius() const {
+    return _bounding_radius;
+}
+
+uint64_t ModelMesh::geometry_hash() const {
+    return _geometry_hash;
+}
@@ -2,18 +2,29 @@
 #define _OBJ_MESH_H_
 
 #include "mesh.h"
+#include "meshcache.h"
 #include <vector>
 #include <string>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <LinearMath/btVector3.h>
 
 
 class ModelMesh : public Mesh {
     public:
         /**
          * @brief Create a new model mesh from a valid OBJ
+         * @details If the mesh cache has an entry for the contents of the
+         *          file, it is mapped instead, and nothing is parsed nor
+         *          built. Otherwise the entry is written once built.
          * 
          * @param model_filename The path to the OBJ filename.
+         * @param lod_levels Number of simplified levels of detail to build,
+         *                   each with about half the triangles of the
+         *                   previous one. Zero builds none.
          */
-        ModelMesh(const std::string& model_filename);
+        ModelMesh(const std::string& model_filename, int lod_levels=0);
 
         ~ModelMesh();
 
@@ -42,8 +53,51 @@ class ModelMesh : public Mesh {
         // Returns the mode in which the index data is organized
         Mesh::Mode mode() const;
 
+        /**
+         * @brief Returns the number of levels of detail, including the full
+         *        mesh as level 0
+         */
+        std::size_t lod_count() const;
+
+        /**
+         * @brief Returns the triangles of a level of detail
+         * @details All the levels index the same vertices, the ones returned
+         *          by vertices() and normals().
+         *
+         * @param level The level, from 0 (full mesh) to lod_count() - 1.
+         */
+        const mesh_index* lod_indices(std::size_t level) const;
+
+        // Returns the number of indices of a level of detail
+        std::size_t lod_indices_count(std::size_t level) const;
+
+        /**
+         * @brief Returns the points of the convex hull of the mesh, x,y,z
+         *        components for each one
+         */
+        const float* hull_points() const;
+
+        // Returns the number of points of the convex hull
+        std::size_t hull_point_count() const;
+
+        // Returns the center of the bounding box of the mesh
+        btVector3 bounding_center() const;
+
+        // Returns the radius of the sphere around the bounding box
+        float bounding_radius() const;
+
+        /**
+         * @brief Returns a hash of the vertices and triangles of the full
+         *        mesh
+         * @details Meshes with the same hash have the same geometry, no
+         *          matter the file they were loaded from. It is computed
+         *          once, when the mesh is loaded.
+         */
+        uint64_t geometry_hash() const;
+
     private:
-        // Vertices of the sphere
+        // The mesh as built from the OBJ, empty if it comes from the cache.
+        // Vertices of the model
         std::vector<float> _vertices;
 
         // Normals
@@ -51,6 +105,36 @@ class ModelMesh : public Mesh {
 
         // Pointer to the vertex indices
         std::vector<mesh_index> _indices;
+
+        // Simplified levels of detail, from finest to coarsest
+        std::vector<std::vector<mesh_index> > _lods;
+
+        std::vector<float> _hull_points;
+
+        // Or the mesh mapped from the cache
+        std::unique_ptr<CachedMesh> _cached;
+
+        // Either of them, as returned by the accessors. Level 0 is the
+        // full mesh
+        const float* _vertex_data;
+        const float* _normal_data;
+        std::size_t _vertex_count;
+        std::vector<std::pair<const mesh_index*, std::size_t> > _lod_data;
+        const float* _hull_data;
+        std::size_t _hull_point_count;
+
+        btVector3 _bounding_center;
+        float _bounding_radius;
+
+        uint64_t _geometry_hash;
+
+        void _load_obj(const std::string& model_filename);
+        void _compute_bounds();
+        void _build_lods(int lod_levels);
+        void _build_hull();
+        void _use_own_mesh();
+        void _use_cached_mesh();
+        void _hash_geometry();
 };
 
 #endif // _MODEL_MESH_H_
@@ -0,0 +1,45 @@
+#ifndef _CL_SCAN_H_
+#define _CL_SCAN_H_
+
+#include "opencl/clenvironment.h"
+#include "opencl/algorithms/clsort.h"
+#include <clogs/clogs.h>
+#include <typeindex>
+
+/**
+ * @brief Computes the exclusive prefix sum of a buffer
+ * @details out[i] = in[0] + ... + in[i-1], and out[0] = 0. The input and
+ *          output buffers may be the same.
+ *
+ * @param in The input buffer.
+ * @param out The output buffer.
+ * @param size The number of elements to scan.
+ * @param event An event to wait for the scan to finish.
+ * @tparam value_type Type of the elements. It must be an integral type.
+ * @return CL_SUCCESS, or the error code if the scan failed.
+ */
+template<typename value_type>
+int clscan(cl_mem in, cl_mem out, int size, cl_event* event=nullptr) {
+    // Initialize clog scanner
+    static clogs::Scan scanner(CLEnvironment::context(),
+                               CLEnvironment::device(),
+                               __clType_2_clogsType(typeid(value_type)));
+
+    try {
+        scanner.enqueue(CLEnvironment::queue(),
+                        in,
+                        out,
+                        size,
+                        NULL,
+                        0,
+                        NULL,
+                        event);
+    }
+    catch (const clogs::Error& e) {
+        return e.err();
+    }
+
+    return CL_SUCCESS;
+}
+
+#endif // _CL_SCAN_H_
@@ -0,0 +1,295 @@
+#include "clenvironment.h"
+#include "clallocator.h"
+#include "runtimeexception.h"
+#include "external/json/json11.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+// Buffers are rounded up to a size class: a multiple of a quarter of the
+// largest power of two below their size, so at most a fourth is wasted
+#define POOL_MIN_SIZE           4096
+#define POOL_DEFAULT_LIMIT      ((size_t)512 << 20)
+
+mutex CLAllocator::_mutex;
+map<cl_mem, CLAllocator::_Allocation> CLAllocator::_allocations;
+map<pair<cl_mem_flags, size_t>, vector<cl_mem> > CLAllocator::_pool;
+size_t CLAllocator::_allocated_bytes = 0;
+size_t CLAllocator::_pooled_bytes = 0;
+size_t CLAllocator::_high_water_mark = 0;
+size_t CLAllocator::_pool_limit = POOL_DEFAULT_LIMIT;
+size_t CLAllocator::_budget = 0;
+size_t CLAllocator::_device_bytes = 0;
+atomic<uint64_t> CLAllocator::_generation(0);
+
+static size_t size_class(size_t bytes) {
+    if (bytes <= POOL_MIN_SIZE) {
+        return POOL_MIN_SIZE;
+    }
+
+    size_t power = POOL_MIN_SIZE;
+    while (power <= bytes / 2) {
+        power *= 2;
+    }
+    size_t step = power / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+static string owner_of(const string& tag) {
+    return tag.substr(0, tag.find('/'));
+}
+
+static string attribute_of(const string& tag) {
+    auto slash = tag.find('/');
+    return slash == string::npos ? "" : tag.substr(slash + 1);
+}
+
+static string megabytes(size_t bytes) {
+    ostringstream out;
+    out.precision(1);
+    out << fixed << bytes / (1024.0 * 1024.0) << " MB";
+    return out.str();
+}
+
+string CLMemoryReport::to_json() const {
+    map<string, json11::Json> owners_data;
+    for (auto& owner : attributes) {
+        map<string, json11::Json> attributes_data;
+        for (auto& attribute : owner.second) {
+            attributes_data[attribute.first] = json11::Json((double)attribute.second);
+        }
+
+        map<string, json11::Json> owner_data;
+        owner_data["bytes"] = json11::Json((double)owners.at(owner.first));
+        owner_data["attributes"] = json11::Json(attributes_data);
+        owners_data[owner.first] = json11::Json(owner_data);
+    }
+
+    map<string, json11::Json> out_data;
+    out_data["owners"] = json11::Json(owners_data);
+    out_data["allocated_bytes"] = json11::Json((double)allocated_bytes);
+    out_data["pooled_bytes"] = json11::Json((double)pooled_bytes);
+    out_data["high_water_mark"] = json11::Json((double)high_water_mark);
+    out_data["device_bytes"] = json11::Json((double)device_bytes);
+
+    string dump_string;
+    json11::Json(out_data).dump(dump_string);
+    return dump_string;
+}
+
+cl_mem CLAllocator::_alloc(size_t bytes, cl_mem_flags flags, const _Usage& usage, bool exact) {
+    lock_guard<mutex> lock(_mutex);
+
+    size_t size = exact ? bytes : size_class(bytes);
+
+    _Usage tagged = usage;
+    if (size > bytes && !tagged.empty()) {
+        tagged.push_back(make_pair(owner_of(tagged.front().first) + "/rounding", size - bytes));
+    }
+
+    auto it = _pool.find(make_pair(flags, size));
+    if (it != _pool.end() && !it->second.empty()) {
+        cl_mem buffer = it->second.back();
+        it->second.pop_back();
+        _allocations[buffer].idle = false;
+        _allocations[buffer].usage = tagged;
+        _pooled_bytes -= size;
+        _allocated_bytes += size;
+        ++_generation;
+        return buffer;
+    }
+
+    // Pooled buffers are released below if needed, so only what is in use
+    // counts against the device
+    _check_device_memory(tagged.empty() ? "" : tagged.front().first, size);
+
+    if (_budget > 0 && _allocated_bytes + _pooled_bytes + size > _budget) {
+        _trim_pool();
+        if (_allocated_bytes + size > _budget) {
+            CLError::check(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+        }
+    }
+
+    cl_int err;
+    cl_mem buffer = clCreateBuffer(CLEnvironment::context(), flags, size, nullptr, &err);
+    if (err == CL_MEM_OBJECT_ALLOCATION_FAILURE || err == CL_OUT_OF_RESOURCES) {
+        // The pool may hold what is missing
+        _trim_pool();
+        buffer = clCreateBuffer(CLEnvironment::context(), flags, size, nullptr, &err);
+    }
+    CLError::check(err);
+
+    _Allocation allocation = {size, flags, true, false, tagged};
+    _allocations[buffer] = allocation;
+    _allocated_bytes += size;
+    ++_generation;
+    _high_water_mark = max(_high_water_mark, _allocated_bytes + _pooled_bytes);
+
+    return buffer;
+}
+
+void CLAllocator::_release(cl_mem buffer) {
+    lock_guard<mutex> lock(_mutex);
+
+    auto it = _allocations.find(buffer);
+    if (it == _allocations.end()) {
+        // Images, sub-buffers and anything not allocated here
+        CLError::check(clReleaseMemObject(buffer));
+        return;
+    }
+
+    auto& allocation = it->second;
+    if (allocation.idle) {
+        // Released twice, as the driver would report
+        CLError::check(CL_INVALID_MEM_OBJECT);
+    }
+    _allocated_bytes -= allocation.bytes;
+    ++_generation;
+
+    if (allocation.pooled && _pooled_bytes + allocation.bytes <= _pool_limit) {
+        allocation.idle = true;
+        _pool[make_pair(allocation.flags, allocation.bytes)].push_back(buffer);
+        _pooled_bytes += allocation.bytes;
+        return;
+    }
+
+    _allocations.erase(it);
+    CLError::check(clReleaseMemObject(buffer));
+}
+
+cl_mem CLAllocator::alloc_gl_texture(const string& tag, GLuint texture) {
+    cl_int err;
+    cl_mem image = clCreateFromGLTexture2D(CLEnvironment::context(),
+                                           CL_MEM_READ_WRITE,
+                                           GL_TEXTURE_2D,
+                                           0,
+                                           texture,
+                                           &err);
+    CLError::check(err);
+
+    size_t width = 0, height = 0, element_size = 0;
+    clGetImageInfo(image, CL_IMAGE_WIDTH, sizeof(width), &width, nullptr);
+    clGetImageInfo(image, CL_IMAGE_HEIGHT, sizeof(height), &height, nullptr);
+    clGetImageInfo(image, CL_IMAGE_ELEMENT_SIZE, sizeof(element_size), &element_size, nullptr);
+    _track(image, width * height * element_size, tag);
+
+    return image;
+}
+
+void CLAllocator::_track(cl_mem buffer, size_t bytes, const string& tag) {
+    lock_guard<mutex> lock(_mutex);
+
+    _Allocation allocation = {bytes, 0, false, false, _Usage(1, make_pair(tag, bytes))};
+    _allocations[buffer] = allocation;
+    _allocated_bytes += bytes;
+    ++_generation;
+    _high_water_mark = max(_high_water_mark, _allocated_bytes + _pooled_bytes);
+}
+
+void CLAllocator::_check_device_memory(const string& tag, size_t bytes) {
+    if (_device_bytes == 0 || _allocated_bytes + bytes <= _device_bytes) {
+        return;
+    }
+
+    auto report = _memory_report();
+    ostringstream message;
+    message << "The scene does not fit in the device memory: allocating "
+            << megabytes(bytes) << " for " << tag << " would take "
+            << megabytes(_allocated_bytes + bytes) << " of the "
+            << megabytes(_device_bytes) << " of the device (CL_DEVICE_GLOBAL_MEM_SIZE). In use:";
+    for (auto& owner : report.owners) {
+        if (owner.first != "pool") {
+            message << " " << owner.first << " " << megabytes(owner.second) << ";";
+        }
+    }
+    throw RunTimeException(message.str());
+}
+
+CLMemoryReport CLAllocator::_memory_report() {
+    CLMemoryReport report;
+    report.allocated_bytes = _allocated_bytes;
+    report.pooled_bytes = _pooled_bytes;
+    report.high_water_mark = _high_water_mark;
+    report.device_bytes = _device_bytes;
+
+    for (auto& entry : _allocations) {
+        auto& allocation = entry.second;
+        if (allocation.idle) {
+            report.owners["pool"] += allocation.bytes;
+            report.attributes["pool"]["idle"] += allocation.bytes;
+            continue;
+        }
+        for (auto& part : allocation.usage) {
+            report.owners[owner_of(part.first)] += part.second;
+            report.attributes[owner_of(part.first)][attribute_of(part.first)] += part.second;
+        }
+    }
+
+    return report;
+}
+
+void CLAllocator::_trim_pool() {
+    for (auto& entry : _pool) {
+        for (auto buffer : entry.second) {
+            _allocations.erase(buffer);
+            clReleaseMemObject(buffer);
+        }
+    }
+    _pool.clear();
+    _pooled_bytes = 0;
+    ++_generation;
+}
+
+size_t CLAllocator::allocated_bytes() {
+    lock_guard<mutex> lock(_mutex);
+    return _allocated_bytes;
+}
+
+size_t CLAllocator::pooled_bytes() {
+    lock_guard<mutex> lock(_mutex);
+    return _pooled_bytes;
+}
+
+size_t CLAllocator::high_water_mark() {
+    lock_guard<mutex> lock(_mutex);
+    return _high_water_mark;
+}
+
+void CLAllocator::reset_high_water_mark() {
+    lock_guard<mutex> lock(_mutex);
+    _high_water_mark = _allocated_bytes + _pooled_bytes;
+}
+
+void CLAllocator::set_pool_limit(size_t bytes) {
+    lock_guard<mutex> lock(_mutex);
+    _pool_limit = bytes;
+    if (_pooled_bytes > _pool_limit) {
+        _trim_pool();
+    }
+}
+
+void CLAllocator::trim_pool() {
+    lock_guard<mutex> lock(_mutex);
+    _trim_pool();
+}
+
+void CLAllocator::set_budget(size_t bytes) {
+    lock_guard<mutex> lock(_mutex);
+    _budget = bytes;
+}
+
+void CLAllocator::set_device_memory(size_t bytes) {
+    lock_guard<mutex> lock(_mutex);
+    _device_bytes = bytes;
+}
+
+CLMemoryReport CLAllocator::memory_report() {
+    lock_guard<mutex> lock(_mutex);
+    return _memory_report();
+}
+
+uint64_t CLAllocator::generation() {
+    return _generation;
+}
@@ -5,6 +5,15 @@
  *  This contains the declaration of the class CLAllocator, which facilitates
  *  the allocation of device buffers.
  *
+ *  Released buffers are kept in a pool, by size class, and handed out again
+ *  to later allocations of the same class, so resets and re-samplings do
+ *  not go back to the driver. Every allocation is accounted, which gives the
+ *  high-water mark of the device memory, and a single place to enforce a
+ *  memory budget.
+ *
+ *  Allocations are tagged "owner/attribute", e.g. "boundary/phi", so the
+ *  memory can be reported by subsystem (see CLMemoryReport).
+ *
  *  @author Santiago Daniel Pivetta
  */
 
@@ -14,10 +23,38 @@
 #include <GL/gl.h>
 #include <CL/cl.h>
 #include <CL/cl_gl.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 #include "clerror.h"
 #include "opengl/openglfunctions.h"
 
+/**
+ * @brief Snapshot of the device memory held by CLAllocator
+ * @details Bytes are of size classes, so they include the rounding of each
+ *          allocation, reported as the "rounding" attribute of its owner.
+ *          Buffers released to the pool are under the "pool" owner.
+ */
+struct CLMemoryReport {
+    // Bytes by owner, and by attribute of each owner
+    std::map<std::string, size_t> owners;
+    std::map<std::string, std::map<std::string, size_t> > attributes;
+
+    size_t allocated_bytes;
+    size_t pooled_bytes;
+    size_t high_water_mark;
+    // CL_DEVICE_GLOBAL_MEM_SIZE, 0 if unknown
+    size_t device_bytes;
+
+    /**
+     * @brief Returns the report as a JSON object
+     */
+    std::string to_json() const;
+};
+
 class CLAllocator {
     public:
         
@@ -57,6 +94,7 @@ class CLAllocator {
          * @details Allocates a new cl_mem buffer on the device. The
          * size of the buffer is size * sizeof(T).
          *
+         * @param tag The owner and attribute of the buffer, "owner/attribute"
          * @param size Number of elements of the buffer
          * @param mem_flag Memory flag modifier
          * @tparam T Type of each element of the buffer. The types must be
@@ -65,16 +103,8 @@ class CLAllocator {
          * @throws CLError if the buffer could not be allocated.
          */
         template<class T>
-        static cl_mem alloc_buffer(size_t size, cl_mem_flags mem_flag=CL_MEM_READ_WRITE) {
-            cl_int err;
-            cl_mem buffer = clCreateBuffer(CLEnvironment::context(),
-                                           mem_flag,
-                                           size * sizeof(T),
-                                           nullptr,
-                                           &err);
-            CLError::check(err);
-
-            return buffer;
+        static cl_mem alloc_buffer(const std::string& tag, size_t size, cl_mem_flags mem_flag=CL_MEM_READ_WRITE) {
+            return _alloc(size * sizeof(T), mem_flag, _Usage(1, std::make_pair(tag, size * sizeof(T))));
         }
 
         /**
@@ -83,6 +113,7 @@ class CLAllocator {
          *          buffer is size * sizeof(T). The buffer is filled with the
          *          initialization data provided by the values vector.
          *
+         * @param tag The owner and attribute of the buffer, "owner/attribute"
          * @param size Number of elements of the buffer
          * @param values The vector with the initial values
          * @param mem_flag Memory flag modifier
@@ -92,8 +123,8 @@ class CLAllocator {
          * @throws CLError if the buffer could not be allocated.
          */
         template<class T>
-        static cl_mem alloc_buffer(size_t size, const std::vector<T>& values, cl_mem_flags mem_flag=CL_MEM_READ_WRITE) {
-            cl_mem buffer = CLAllocator::alloc_buffer<T>(size, mem_flag);
+        static cl_mem alloc_buffer(const std::string& tag, size_t size, const std::vector<T>& values, cl_mem_flags mem_flag=CL_MEM_READ_WRITE) {
+            cl_mem buffer = CLAllocator::alloc_buffer<T>(tag, size, mem_flag);
 
             cl_int err = clEnqueueWriteBuffer(CLEnvironment::queue(),
                                               buffer,
@@ -115,6 +146,7 @@ class CLAllocator {
          *          buffer is size * sizeof(T). The buffer is filled with the
          *          value by the default_value parameter.
          *
+         * @param tag The owner and attribute of the buffer, "owner/attribute"
          * @param size Number of elements of the buffer
          * @param default_value The initial value of all elements of the buffer
          * @param mem_flag Memory flag modifier
@@ -124,9 +156,9 @@ class CLAllocator {
          * @throws CLError if the buffer could not be allocated.
          */
         template<class T>
-        static cl_mem alloc_buffer(size_t size, T default_value, cl_mem_flags mem_flag=CL_MEM_READ_WRITE) {
+        static cl_mem alloc_buffer(const std::string& tag, size_t size, T default_value, cl_mem_flags mem_flag=CL_MEM_READ_WRITE) {
             std::vector<T> values(size, default_value);
-            cl_mem buffer = CLAllocator::alloc_buffer<T>(size, values, mem_flag);
+            cl_mem buffer = CLAllocator::alloc_buffer<T>(tag, size, values, mem_flag);
 
             return buffer;
         }
@@ -134,7 +166,9 @@ class CLAllocator {
         /**
          * @brief Releases a device buffer
          * @details This function releases a cl_mem buffer. There is no
-         *          validation wether the buffer is valid or not.
+         *          validation wether the buffer is valid or not. Buffers
+         *          allocated by alloc_buffer go back to the pool, so any
+         *          image or sub-buffer of them must be released first.
          *
          * @param buffer The buffer to be released
          *
@@ -142,17 +176,86 @@ class CLAllocator {
          */
         static void release_buffer(cl_mem buffer) {
             if (buffer) {
-                cl_int err = clReleaseMemObject(buffer);
-                CLError::check(err);
+                _release(buffer);
             }
         }
 
+        /**
+         * @brief Returns the bytes of the buffers in use, allocated by this
+         *        class
+         */
+        static size_t allocated_bytes();
+
+        /**
+         * @brief Returns the bytes of the released buffers kept in the pool
+         */
+        static size_t pooled_bytes();
+
+        /**
+         * @brief Returns the peak of the device memory held by this class,
+         *        in use or pooled, since the start or the last reset
+         */
+        static size_t high_water_mark();
+
+        /**
+         * @brief Restarts the high-water mark from the memory held now
+         */
+        static void reset_high_water_mark();
+
+        /**
+         * @brief Sets the most memory the pool keeps
+         * @details Buffers released beyond it go back to the driver.
+         *
+         * @param bytes The limit, in bytes.
+         */
+        static void set_pool_limit(size_t bytes);
+
+        /**
+         * @brief Releases every buffer in the pool
+         */
+        static void trim_pool();
+
+        /**
+         * @brief Sets the most memory this class may hold
+         * @details Allocations beyond it first trim the pool, and then fail
+         *          with CL_MEM_OBJECT_ALLOCATION_FAILURE.
+         *
+         * @param bytes The budget, in bytes, or 0 for no budget.
+         */
+        static void set_budget(size_t bytes);
+
+        /**
+         * @brief Sets the global memory of the device
+         * @details Allocations that would take the memory held by this class
+         *          beyond it throw a RunTimeException with a report of the
+         *          memory by owner, instead of failing later in the driver.
+         *          The GUI catches it where the scene is loaded, reset or
+         *          stepped, and stops the simulation until a reset.
+         *
+         * @param bytes CL_DEVICE_GLOBAL_MEM_SIZE, or 0 for no check.
+         */
+        static void set_device_memory(size_t bytes);
+
+        /**
+         * @brief Returns the memory held now, by owner and attribute
+         */
+        static CLMemoryReport memory_report();
+
+        /**
+         * @brief Returns a number that changes every time memory is taken
+         *        or given back
+         * @details It is cheap, and can be read without the lock, so a
+         *          view only builds a new report when it changes.
+         */
+        static uint64_t generation();
+
         /**
          * @brief Allocates a new device buffer, shared with OpenGL
          * @details Uses the OpenCL-OpenGL interop api to allocate a new,
          *          shared buffer. The new buffer will have
          *          size * sizeof(T) bytes
          *
+         * @param tag The owner and attribute of the buffer, "owner/attribute"
          * @param size The number of elements of the buffer
          * @param vbo The OpenGL Vertex Buffer Object id
          * @tparam T Type of each element of the buffer. The types must be
@@ -162,10 +265,16 @@ class CLAllocator {
          * @throws CLError if the buffer could not be allocated.
          */
         template<class T>
-        static cl_mem alloc_gl_buffer(size_t size, GLuint vbo) {
+        static cl_mem alloc_gl_buffer(const std::string& tag, size_t size, GLuint vbo) {
             cl_int err;
             auto& gl = OpenGLFunctions::getFunctions();
 
+            // Before OpenGL takes the memory
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _check_device_memory(tag, size * sizeof(T));
+            }
+
             // Resize the OpenGL VBO's
             gl.glBindBuffer(GL_ARRAY_BUFFER, vbo);
             gl.glBufferData(GL_ARRAY_BUFFER,
@@ -179,9 +288,25 @@ class CLAllocator {
                                                  &err);
             CLError::check(err);
 
+            // The memory belongs to OpenGL, it is only accounted
+            _track(buffer, size * sizeof(T), tag);
+
             return buffer;
         }
 
+        /**
+         * @brief Creates an image of an OpenGL 2D texture
+         * @details The memory belongs to OpenGL, the image is only
+         *          accounted, by its size and element size.
+         *
+         * @param tag The owner and attribute of the image, "owner/attribute"
+         * @param texture The OpenGL texture id.
+         * @return An instance of cl_mem.
+         *
+         * @throws CLError if the image could not be created.
+         */
+        static cl_mem alloc_gl_texture(const std::string& tag, GLuint texture);
+
         /**
          * @brief Copies a buffer
          * @details Copies the whole buffer to another one. The copy begins at
@@ -209,6 +334,42 @@ class CLAllocator {
             CLError::check(err);
         }
 
+        /**
+         * @brief Copies a range of a buffer
+         * @details Copies a range of elements to another buffer, possibly at
+         *          another offset.
+         *
+         * @param src Source device buffer.
+         * @param dst Destination device buffer.
+         * @param src_offset First element to copy from src.
+         * @param dst_offset First element to copy to in dst.
+         * @param size Number of elements to be copied.
+         * @tparam T Type of each element of the buffer. The types must be
+         *           compliant with the types OpenCL provides.
+         *
+         * @throws CLError if the copy fails.
+         */
+        template<class T>
+        static void copy_buffer_range(cl_mem src,
+                                      cl_mem dst,
+                                      size_t src_offset,
+                                      size_t dst_offset,
+                                      size_t size) {
+            if (size == 0) {
+                return;
+            }
+            cl_int err = clEnqueueCopyBuffer(CLEnvironment::queue(),
+                                             src,
+                                             dst,
+                                             src_offset * sizeof(T),
+                                             dst_offset * sizeof(T),
+                                             size * sizeof(T),
+                                             0,
+                                             nullptr,
+                                             nullptr);
+            CLError::check(err);
+        }
+
         /**
          * @brief Downloads a buffer to a std::vector
          * @details Downloads a full device buffer to a host std::vector,
@@ -283,6 +444,38 @@ class CLAllocator {
             CLError::check(err);
         }
 
+        /**
+         * @brief Uploads host memory to a range of a device buffer
+         *
+         * @param src Source host memory.
+         * @param size Number of elements to upload.
+         * @param dst Destination device buffer.
+         * @param dst_offset First element to write in dst.
+         * @tparam T Type of each element of the buffer. The types must be
+         *           compliant with the types OpenCL provides.
+         *
+         * @throws CLError if the write operation fails.
+         */
+        template<class T>
+        static void upload_to_buffer_range(const T* src,
+                                           size_t size,
+                                           cl_mem dst,
+                                           size_t dst_offset) {
+            if (size == 0) {
+                return;
+            }
+            cl_int err = clEnqueueWriteBuffer(CLEnvironment::queue(),
+                                              dst,
+                                              CL_TRUE,
+                                              dst_offset * sizeof(T),
+                                              size * sizeof(T),
+                                              src,
+                                              0,
+                                              nullptr,
+                                              nullptr);
+            CLError::check(err);
+        }
+
         /**
          * @brief Uploads the contents of a local buffer to a device buffer
          * @details Uploads a full host std::vector to a device buffer. Device
@@ -377,6 +570,69 @@ class CLAllocator {
         CLAllocator();
         CLAllocator(const CLAllocator& e);
         CLAllocator& operator=(const CLAllocator& e);
+
+        // Arenas allocate blocks shared by many attributes
+        friend class CLArena;
+
+        // Bytes of an allocation by tag
+        typedef std::vector<std::pair<std::string, size_t> > _Usage;
+
+        struct _Allocation {
+            size_t bytes;
+            cl_mem_flags flags;
+            // Whether it goes back to the pool when released
+            bool pooled;
+            // Whether it is in the pool now
+            bool idle;
+            _Usage usage;
+        };
+
+        static std::mutex _mutex;
+        static std::map<cl_mem, _Allocation> _allocations;
+        // Released buffers, by flags and size class
+        static std::map<std::pair<cl_mem_flags, size_t>, std::vector<cl_mem> > _pool;
+        static size_t _allocated_bytes;
+        static size_t _pooled_bytes;
+        static size_t _high_water_mark;
+        static size_t _pool_limit;
+        static size_t _budget;
+        static size_t _device_bytes;
+        static std::atomic<uint64_t> _generation;
+
+        /**
+         * @brief Takes a buffer from the pool, or creates one
+         * @details The usage adds up to the bytes requested, the rounding
+         *          to the size class is added to the owner of the first tag.
+         *          An exact buffer is not rounded, and is pooled under its
+         *          own size.
+         */
+        static cl_mem _alloc(size_t bytes, cl_mem_flags flags, const _Usage& usage, bool exact = false);
+
+        /**
+         * @brief Puts a buffer back in the pool, or releases it
+         */
+        static void _release(cl_mem buffer);
+
+        /**
+         * @brief Accounts a buffer that is not pooled
+         */
+        static void _track(cl_mem buffer, size_t bytes, const std::string& tag);
+
+        /**
+         * @brief Throws if allocating the bytes would exceed the memory of
+         *        the device. The mutex must be held
+         */
+        static void _check_device_memory(const std::string& tag, size_t bytes);
+
+        /**
+         * @brief Builds the memory report. The mutex must be held
+         */
+        static CLMemoryReport _memory_report();
+
+        /**
+         * @brief Releases every buffer in the pool. The mutex must be held
+         */
+        static void _trim_pool();
 };
 
 #endif // _CL_ALLOCATOR_H_
@@ -0,0 +1,97 @@
+#include "clenvironment.h"
+#include "clarena.h"
+#include "clallocator.h"
+
+using namespace std;
+
+CLArena::CLArena() :
+_size(0) {
+
+}
+
+CLArena::~CLArena() {
+    // The reserved handles may already be gone, only the buffers are freed
+    for (auto buffer : _buffers) {
+        CLAllocator::release_buffer(buffer);
+    }
+    for (auto block : _blocks) {
+        CLAllocator::release_buffer(block);
+    }
+}
+
+void CLArena::_reserve(cl_mem* buffer, size_t bytes, const string& tag) {
+    _Reservation r = {buffer, bytes, tag};
+    _reservations.push_back(r);
+}
+
+void CLArena::commit() {
+    cl_uint align_bits;
+    cl_ulong max_alloc;
+    clGetDeviceInfo(CLEnvironment::device(), CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, nullptr);
+    clGetDeviceInfo(CLEnvironment::device(), CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, nullptr);
+    size_t align = align_bits / 8;
+
+    // Lay out the reservations in blocks, one after the other
+    vector<size_t> block_sizes(1, 0);
+    vector<CLAllocator::_Usage> block_usages(1);
+    vector<pair<size_t, size_t> > places;
+    for (auto& r : _reservations) {
+        size_t bytes = (max(r.bytes, (size_t)1) + align - 1) / align * align;
+        if (block_sizes.back() > 0 && block_sizes.back() + bytes > max_alloc) {
+            block_sizes.push_back(0);
+            block_usages.push_back(CLAllocator::_Usage());
+        }
+        places.push_back(make_pair(block_sizes.size() - 1, block_sizes.back()));
+        block_sizes.back() += bytes;
+        // Each buffer is accounted with the padding after it
+        block_usages.back().push_back(make_pair(r.tag, bytes));
+    }
+
+    for (size_t b = 0; b < block_sizes.size(); ++b) {
+        auto size = block_sizes[b];
+        // Blocks are not rounded to a size class, the rounding could take
+        // them past the max allocation size
+        _blocks.push_back(size > 0 ? CLAllocator::_alloc(size, CL_MEM_READ_WRITE, block_usages[b], true) : nullptr);
+        _size += size;
+    }
+
+    for (size_t i = 0; i < _reservations.size(); ++i) {
+        auto& r = _reservations[i];
+
+        cl_buffer_region region;
+        region.origin = places[i].second;
+        region.size = max(r.bytes, (size_t)1);
+
+        cl_int err;
+        *r.buffer = clCreateSubBuffer(_blocks[places[i].first],
+                                      CL_MEM_READ_WRITE,
+                                      CL_BUFFER_CREATE_TYPE_REGION,
+                                      &region,
+                                      &err);
+        CLError::check(err);
+        _buffers.push_back(*r.buffer);
+    }
+}
+
+void CLArena::release() {
+    // Sub-buffers first, so the blocks can be reused right away
+    for (auto buffer : _buffers) {
+        CLAllocator::release_buffer(buffer);
+    }
+    _buffers.clear();
+
+    for (auto& r : _reservations) {
+        *r.buffer = nullptr;
+    }
+    _reservations.clear();
+
+    for (auto block : _blocks) {
+        CLAllocator::release_buffer(block);
+    }
+    _blocks.clear();
+    _size = 0;
+}
+
+size_t CLArena::size() const {
+    return _size;
+}
@@ -0,0 +1,94 @@
+/**
+ *  @file clarena.h
+ *  @brief Contains the declaration of the CLArena class.
+ *
+ *  An arena lays out many device buffers in a few large allocations, as
+ *  sub-buffers, so a solver allocates its attributes with one call to the
+ *  driver, and releases them all at once.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _CL_ARENA_H_
+#define _CL_ARENA_H_
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+
+/**
+ * @class CLArena
+ * @brief Sub-allocates device buffers from a few large allocations
+ * @details Buffers are first reserved, and all of them are created by
+ *          commit. Each one starts at the base address alignment of the
+ *          device, and the allocations are split so none exceeds the max
+ *          allocation size. The allocations come from CLAllocator at their
+ *          exact size, so they are pooled and accounted. Sub-buffers can not be split further
+ *          into sub-buffers.
+ */
+class CLArena {
+    public:
+        CLArena();
+
+        /**
+         * @brief Releases the buffers of the arena
+         */
+        ~CLArena();
+
+        /**
+         * @brief Reserves a buffer
+         * @details The buffer is created by the next commit.
+         *
+         * @param buffer Where the buffer is stored when created. It must
+         *        outlive the arena, or its release.
+         * @param size The number of elements of the buffer.
+         * @param tag The owner and attribute of the buffer, "owner/attribute",
+         *        under which its bytes are accounted.
+         * @tparam T Type of each element of the buffer.
+         */
+        template<class T>
+        void reserve(cl_mem* buffer, size_t size, const std::string& tag) {
+            _reserve(buffer, size * sizeof(T), tag);
+        }
+
+        /**
+         * @brief Creates every reserved buffer
+         * @details An arena is committed once. To lay it out again, it must
+         *          be released and reserved from scratch.
+         *
+         * @throws CLError if the buffers could not be allocated.
+         */
+        void commit();
+
+        /**
+         * @brief Releases every buffer of the arena
+         * @details The buffers are set to null, and the reservations are
+         *          cleared. Any image of the buffers must be released first.
+         */
+        void release();
+
+        /**
+         * @brief Returns the bytes allocated by the arena
+         */
+        size_t size() const;
+
+    private:
+        struct _Reservation {
+            cl_mem* buffer;
+            size_t bytes;
+            std::string tag;
+        };
+
+        std::vector<_Reservation> _reservations;
+        // The sub-buffers, and the allocations they are in
+        std::vector<cl_mem> _buffers;
+        std::vector<cl_mem> _blocks;
+        size_t _size;
+
+        CLArena(const CLArena&);
+        CLArena& operator=(const CLArena&);
+
+        void _reserve(cl_mem* buffer, size_t bytes, const std::string& tag);
+};
+
+#endif // _CL_ARENA_H_
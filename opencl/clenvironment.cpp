@@ -1,4 +1,5 @@
 #include "clenvironment.h"
+#include "clallocator.h"
 #include <GL/gl.h>
 #include <GL/glx.h>
 #include <CL/cl_gl.h>
@@ -47,6 +48,12 @@ void CLEnvironment::init() {
                                   CL_QUEUE_PROFILING_ENABLE,
                                   &status);
     CLError::check(status);
+
+    // Scenes that do not fit in the device fail on the first allocation
+    // beyond it, with a report of the memory, and not midway in the driver
+    cl_ulong global_mem_size;
+    clGetDeviceInfo(_devices[0], CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(global_mem_size), &global_mem_size, NULL);
+    CLAllocator::set_device_memory(global_mem_size);
 }
 
 cl_context& CLEnvironment::context() {
@@ -21,3 +21,17 @@ unique_ptr<QOpenGLShaderProgram> create_shader_program(const string& vertex_shad
 
     return shader;
 }
+
+unique_ptr<QOpenGLShaderProgram> create_compute_program(const string& compute_shader_filename) {
+    auto shader = unique_ptr<QOpenGLShaderProgram>(new QOpenGLShaderProgram());
+
+    if (!shader->addShaderFromSourceFile(QOpenGLShader::Compute, compute_shader_filename.c_str())) {
+        throw RunTimeException(string("Could not load compute shader") + compute_shader_filename);
+    }
+
+    if (!shader->link()) {
+        throw RunTimeException("Could not link shader program");
+    }
+
+    return shader;
+}
@@ -8,4 +8,6 @@
 std::unique_ptr<QOpenGLShaderProgram> create_shader_program(const std::string& vertex_shader_filename,
                                                             const std::string& fragment_shader_filename);
 
+std::unique_ptr<QOpenGLShaderProgram> create_compute_program(const std::string& compute_shader_filename);
+
 #endif // _OGL_UTILS_H_
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include "frameprofiler.h"
+#include "opencl/clenvironment.h"
+#include "opengl/openglfunctions.h"
+#include "external/json/json11.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+// Frames the statistics are taken from
+#define PROFILER_WINDOW         240
+// Frames kept waiting for their device times before waiting for the device
+#define PROFILER_MAX_PENDING    8
+
+bool FrameProfiler::_in_frame = false;
+FrameProfiler::_Clock::time_point FrameProfiler::_frame_start;
+FrameProfiler::_Clock::time_point FrameProfiler::_phase_start[(int)FramePhase::COUNT];
+FrameProfiler::_Span FrameProfiler::_open[(int)FramePhase::COUNT];
+FrameProfiler::_Frame FrameProfiler::_current;
+unsigned long FrameProfiler::_frame_count = 0;
+float FrameProfiler::_levels[(int)FrameCounter::COUNT] = {0};
+bool FrameProfiler::_is_level[(int)FrameCounter::COUNT] = {false};
+deque<FrameProfiler::_Frame> FrameProfiler::_pending;
+deque<FrameProfiler::_Frame> FrameProfiler::_window;
+vector<GLuint> FrameProfiler::_free_queries;
+
+static const char* PHASE_NAMES[] = {
+    "boundary_sync",
+    "sort",
+    "neighbours",
+    "density",
+    "forces",
+    "pressure_solve",
+    "rigid_coupling",
+    "integration",
+    "bullet_step",
+    "render_depth",
+    "render_blur",
+    "render_final"
+};
+
+static const char* COUNTER_NAMES[] = {
+    "pcisph_iterations",
+    "sim_steps",
+    "neighbours_mean",
+    "neighbours_max",
+    "neighbour_truncations",
+    "boundary_neighbours_max",
+    "boundary_neighbour_truncations"
+};
+
+static bool on_queue(FramePhase phase) {
+    return phase < FramePhase::BULLET_STEP;
+}
+
+static bool on_gl(FramePhase phase) {
+    return phase > FramePhase::BULLET_STEP;
+}
+
+static FramePercentiles percentiles(vector<float> values) {
+    FramePercentiles p = {0.0f, 0.0f, 0.0f};
+    if (values.empty()) {
+        return p;
+    }
+
+    sort(values.begin(), values.end());
+    auto rank = [&](float q) {
+        return values[min(values.size() - 1, (size_t)(q * values.size()))];
+    };
+    p.p50 = rank(0.50f);
+    p.p95 = rank(0.95f);
+    p.p99 = rank(0.99f);
+    return p;
+}
+
+float FrameRecord::time(FramePhase phase) const {
+    return phase == FramePhase::BULLET_STEP ? wall[(int)phase] : device[(int)phase];
+}
+
+string FrameStats::csv_header() {
+    return "frame,measure,wall_p50,wall_p95,wall_p99,device_p50,device_p95,device_p99\n";
+}
+
+string FrameStats::to_csv(unsigned long frame) const {
+    ostringstream out;
+    auto row = [&](const char* measure, const FramePercentiles& w, const FramePercentiles& d) {
+        out << frame << "," << measure << ","
+            << w.p50 << "," << w.p95 << "," << w.p99 << ","
+            << d.p50 << "," << d.p95 << "," << d.p99 << "\n";
+    };
+
+    FramePercentiles none = {0.0f, 0.0f, 0.0f};
+    row("frame", frame_wall, none);
+    for (int i = 0; i < (int)FramePhase::COUNT; ++i) {
+        row(PHASE_NAMES[i], wall[i], device[i]);
+    }
+    // Counters are not times, they go in the wall columns
+    for (int i = 0; i < (int)FrameCounter::COUNT; ++i) {
+        row(COUNTER_NAMES[i], counters[i], none);
+    }
+    return out.str();
+}
+
+string FrameStats::to_json(unsigned long frame) const {
+    auto json = [](const FramePercentiles& p) {
+        map<string, json11::Json> data;
+        data["p50"] = json11::Json(p.p50);
+        data["p95"] = json11::Json(p.p95);
+        data["p99"] = json11::Json(p.p99);
+        return json11::Json(data);
+    };
+
+    map<string, json11::Json> phases_data;
+    for (int i = 0; i < (int)FramePhase::COUNT; ++i) {
+        map<string, json11::Json> phase_data;
+        phase_data["wall"] = json(wall[i]);
+        phase_data["device"] = json(device[i]);
+        phases_data[PHASE_NAMES[i]] = json11::Json(phase_data);
+    }
+
+    map<string, json11::Json> counters_data;
+    for (int i = 0; i < (int)FrameCounter::COUNT; ++i) {
+        counters_data[COUNTER_NAMES[i]] = json(counters[i]);
+    }
+
+    map<string, json11::Json> out_data;
+    out_data["frame"] = json11::Json((double)frame);
+    out_data["frames"] = json11::Json(frames);
+    out_data["frame_wall"] = json(frame_wall);
+    out_data["phases"] = json11::Json(phases_data);
+    out_data["counters"] = json11::Json(counters_data);
+
+    string dump_string;
+    json11::Json(out_data).dump(dump_string);
+    return dump_string + "\n";
+}
+
+void FrameProfiler::begin_frame() {
+    _resolve(false);
+
+    memset(_current.wall, 0, sizeof(_current.wall));
+    memset(_current.device, 0, sizeof(_current.device));
+    memset(_current.counters, 0, sizeof(_current.counters));
+    _current.spans.clear();
+
+    _frame_start = _Clock::now();
+    _in_frame = true;
+}
+
+void FrameProfiler::end_frame() {
+    if (!_in_frame) {
+        return;
+    }
+    _in_frame = false;
+
+    _current.frame_wall = chrono::duration<float, milli>(_Clock::now() - _frame_start).count();
+    for (int i = 0; i < (int)FrameCounter::COUNT; ++i) {
+        if (_is_level[i]) {
+            _current.counters[i] = _levels[i];
+        }
+    }
+    _pending.push_back(_current);
+    ++_frame_count;
+
+    // A device far behind would hold every event, so the oldest frames are
+    // waited for
+    while (_pending.size() > PROFILER_MAX_PENDING) {
+        _resolve(true);
+    }
+}
+
+void FrameProfiler::begin(FramePhase phase, FrameTimer timer) {
+    if (!_in_frame) {
+        return;
+    }
+
+    auto& span = _open[(int)phase];
+    span.phase = phase;
+    span.start = span.end = nullptr;
+    span.query = 0;
+
+    bool queue = timer == FrameTimer::QUEUE || (timer == FrameTimer::DEFAULT && on_queue(phase));
+    bool gl = timer == FrameTimer::GL || (timer == FrameTimer::DEFAULT && on_gl(phase));
+
+    if (queue) {
+        CLError::check(clEnqueueMarkerWithWaitList(CLEnvironment::queue(), 0, nullptr, &span.start));
+    }
+    else if (gl) {
+        auto& gl = OpenGLFunctions::getFunctions();
+        if (_free_queries.empty()) {
+            GLuint query;
+            gl.glGenQueries(1, &query);
+            _free_queries.push_back(query);
+        }
+        span.query = _free_queries.back();
+        _free_queries.pop_back();
+        gl.glBeginQuery(GL_TIME_ELAPSED, span.query);
+    }
+
+    _phase_start[(int)phase] = _Clock::now();
+}
+
+void FrameProfiler::end(FramePhase phase) {
+    if (!_in_frame) {
+        return;
+    }
+
+    auto& span = _open[(int)phase];
+    _current.wall[(int)phase] += chrono::duration<float, milli>(_Clock::now() - _phase_start[(int)phase]).count();
+
+    // The span knows which timer it was started with
+    if (span.start) {
+        CLError::check(clEnqueueMarkerWithWaitList(CLEnvironment::queue(), 0, nullptr, &span.end));
+        _current.spans.push_back(span);
+    }
+    else if (span.query) {
+        OpenGLFunctions::getFunctions().glEndQuery(GL_TIME_ELAPSED);
+        _current.spans.push_back(span);
+    }
+}
+
+void FrameProfiler::count(FrameCounter counter, int value) {
+    if (_in_frame) {
+        _current.counters[(int)counter] += value;
+    }
+}
+
+FrameStats FrameProfiler::stats() {
+    FrameStats stats;
+    stats.frames = _window.size();
+
+    vector<float> values(_window.size());
+    auto over_window = [&](function<float(const _Frame&)> measure) {
+        transform(_window.begin(), _window.end(), values.begin(), measure);
+        return percentiles(values);
+    };
+
+    stats.frame_wall = over_window([](const _Frame& f) { return f.frame_wall; });
+    for (int i = 0; i < (int)FramePhase::COUNT; ++i) {
+        stats.wall[i] = over_window([i](const _Frame& f) { return f.wall[i]; });
+        stats.device[i] = over_window([i](const _Frame& f) { return f.device[i]; });
+    }
+    for (int i = 0; i < (int)FrameCounter::COUNT; ++i) {
+        stats.counters[i] = over_window([i](const _Frame& f) { return f.counters[i]; });
+    }
+
+    return stats;
+}
+
+void FrameProfiler::set(FrameCounter counter, float value) {
+    _levels[(int)counter] = value;
+    _is_level[(int)counter] = true;
+}
+
+vector<FrameRecord> FrameProfiler::recent_frames(size_t count) {
+    size_t first = _window.size() > count ? _window.size() - count : 0;
+    return vector<FrameRecord>(_window.begin() + first, _window.end());
+}
+
+unsigned long FrameProfiler::frame_count() {
+    return _frame_count;
+}
+
+const char* FrameProfiler::name(FramePhase phase) {
+    return PHASE_NAMES[(int)phase];
+}
+
+const char* FrameProfiler::name(FrameCounter counter) {
+    return COUNTER_NAMES[(int)counter];
+}
+
+void FrameProfiler::release() {
+    while (!_pending.empty()) {
+        _resolve(true);
+    }
+
+    if (!_free_queries.empty()) {
+        OpenGLFunctions::getFunctions().glDeleteQueries(_free_queries.size(), _free_queries.data());
+        _free_queries.clear();
+    }
+    _window.clear();
+}
+
+void FrameProfiler::_resolve(bool wait) {
+    while (!_pending.empty()) {
+        auto& frame = _pending.front();
+
+        bool available = true;
+        for (auto& span : frame.spans) {
+            if (!wait && !_available(span)) {
+                available = false;
+                break;
+            }
+        }
+        if (!available) {
+            return;
+        }
+
+        for (auto& span : frame.spans) {
+            frame.device[(int)span.phase] += _read(span);
+        }
+        frame.spans.clear();
+
+        _window.push_back(frame);
+        if (_window.size() > PROFILER_WINDOW) {
+            _window.pop_front();
+        }
+        _pending.pop_front();
+
+        // Only the oldest frame is waited for
+        wait = false;
+    }
+}
+
+bool FrameProfiler::_available(const _Span& span) {
+    if (span.query) {
+        GLuint available = 0;
+        OpenGLFunctions::getFunctions().glGetQueryObjectuiv(span.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        return available;
+    }
+
+    cl_int status;
+    clGetEventInfo(span.end, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, nullptr);
+    return status == CL_COMPLETE;
+}
+
+float FrameProfiler::_read(_Span& span) {
+    if (span.query) {
+        GLuint64 elapsed = 0;
+        OpenGLFunctions::getFunctions().glGetQueryObjectui64v(span.query, GL_QUERY_RESULT, &elapsed);
+        _free_queries.push_back(span.query);
+        span.query = 0;
+        return elapsed * 1e-6f;
+    }
+
+    // Markers complete once everything before them is done, so the time
+    // between the two is that of the commands of the phase
+    clWaitForEvents(1, &span.end);
+    cl_ulong start = 0, end = 0;
+    clGetEventProfilingInfo(span.start, CL_PROFILING_COMMAND_END, sizeof(start), &start, nullptr);
+    clGetEventProfilingInfo(span.end, CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
+    clReleaseEvent(span.start);
+    clReleaseEvent(span.end);
+    span.start = span.end = nullptr;
+
+    return end > start ? (end - start) * 1e-6f : 0.0f;
+}
@@ -0,0 +1,260 @@
+/**
+ *  @file frameprofiler.h
+ *  @brief Contains the declaration of the FrameProfiler class.
+ *
+ *  The profiler times the phases of every frame, the steps of the solver,
+ *  the rigid body step and the stages of the renderer, so a slow frame can
+ *  be attributed to a phase without attaching a profiler. It is always on,
+ *  and cheap: the device time of a solver phase is taken from two markers
+ *  in the OpenCL queue, and that of a render stage from a GL_TIME_ELAPSED
+ *  query, or from queue markers too when the stage runs in OpenCL. Both are
+ *  read frames later, once available, so the profiler never waits for the
+ *  device.
+ *
+ *  @author Santiago Daniel Pivetta
+ */
+
+#ifndef _FRAME_PROFILER_H_
+#define _FRAME_PROFILER_H_
+
+#include <CL/cl.h>
+#include <GL/gl.h>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+enum class FramePhase {
+    BOUNDARY_SYNC,
+    SORT,
+    NEIGHBOURS,
+    DENSITY,
+    FORCES,
+    PRESSURE_SOLVE,
+    RIGID_COUPLING,
+    INTEGRATION,
+    BULLET_STEP,
+    // The particles renderer has a single stage, timed as the final one
+    RENDER_DEPTH,
+    RENDER_BLUR,
+    RENDER_FINAL,
+    COUNT
+};
+
+/**
+ * @brief Where the device time of a phase is taken from
+ */
+enum class FrameTimer {
+    // The OpenCL queue for the solver phases, OpenGL for the render stages
+    DEFAULT,
+    QUEUE,
+    GL
+};
+
+enum class FrameCounter {
+    PCISPH_ITERATIONS,
+    SIM_STEPS,
+    NEIGHBOURS_MEAN,
+    NEIGHBOURS_MAX,
+    NEIGHBOUR_TRUNCATIONS,
+    BOUNDARY_NEIGHBOURS_MAX,
+    BOUNDARY_NEIGHBOUR_TRUNCATIONS,
+    COUNT
+};
+
+/**
+ * @brief Percentiles of a measure over the frames of the window
+ */
+struct FramePercentiles {
+    float p50;
+    float p95;
+    float p99;
+};
+
+/**
+ * @brief The times, in milliseconds, and the counters of a frame
+ */
+struct FrameRecord {
+    float frame_wall;
+    float wall[(int)FramePhase::COUNT];
+    float device[(int)FramePhase::COUNT];
+    float counters[(int)FrameCounter::COUNT];
+
+    /**
+     * @brief Returns the time a phase took: on the device if it is timed
+     *        there, or else on the host
+     */
+    float time(FramePhase phase) const;
+};
+
+/**
+ * @brief Rolling statistics of the frames of the window. Times are in
+ *        milliseconds, summed over every span of the phase in the frame.
+ */
+struct FrameStats {
+    // Frames the statistics are taken from
+    int frames;
+    FramePercentiles frame_wall;
+    FramePercentiles wall[(int)FramePhase::COUNT];
+    FramePercentiles device[(int)FramePhase::COUNT];
+    FramePercentiles counters[(int)FrameCounter::COUNT];
+
+    /**
+     * @brief Returns the header of the CSV rows
+     */
+    static std::string csv_header();
+
+    /**
+     * @brief Returns the statistics as CSV rows, one per phase
+     *
+     * @param frame The number of the frame, the first column of every row.
+     */
+    std::string to_csv(unsigned long frame) const;
+
+    /**
+     * @brief Returns the statistics as a single line JSON object
+     *
+     * @param frame The number of the frame.
+     */
+    std::string to_json(unsigned long frame) const;
+};
+
+/**
+ * @class FrameProfiler
+ * @brief Times the phases of every frame
+ * @details A phase is timed between begin and end, and may be timed more
+ *          than once in a frame, the times are summed. Phases outside of a
+ *          frame are not timed. The wall time is the time on the host, the
+ *          device time that of the OpenCL queue or of OpenGL, depending on
+ *          the phase or on the timer it is started with. Bullet runs on the host, it only has wall time. The
+ *          statistics are taken from the last frames whose device times
+ *          are known.
+ */
+class FrameProfiler {
+    public:
+        /**
+         * @brief Starts a frame. Reads the device times of earlier frames
+         *        that are available by now
+         */
+        static void begin_frame();
+
+        /**
+         * @brief Ends the frame
+         */
+        static void end_frame();
+
+        /**
+         * @brief Starts timing a phase
+         *
+         * @param phase The phase.
+         * @param timer Where the device time is taken from. A render stage
+         *              run in OpenCL is timed on the queue, a GL query would
+         *              only see the acquire and release of the images.
+         */
+        static void begin(FramePhase phase, FrameTimer timer=FrameTimer::DEFAULT);
+
+        /**
+         * @brief Stops timing a phase, on the timer it was started with
+         */
+        static void end(FramePhase phase);
+
+        /**
+         * @brief Adds to a counter of the frame
+         */
+        static void count(FrameCounter counter, int value);
+
+        /**
+         * @brief Sets a level counter, kept by the next frames until set
+         *        again. For measures that are not read every frame
+         */
+        static void set(FrameCounter counter, float value);
+
+        /**
+         * @brief Returns the statistics of the window
+         */
+        static FrameStats stats();
+
+        /**
+         * @brief Returns the last frames whose device times are known,
+         *        oldest first
+         *
+         * @param count The most frames returned.
+         */
+        static std::vector<FrameRecord> recent_frames(size_t count);
+
+        /**
+         * @brief Returns the number of frames ended
+         */
+        static unsigned long frame_count();
+
+        /**
+         * @brief Returns the name of a phase, as in the reports
+         */
+        static const char* name(FramePhase phase);
+
+        /**
+         * @brief Returns the name of a counter, as in the reports
+         */
+        static const char* name(FrameCounter counter);
+
+        /**
+         * @brief Releases the events and queries. The OpenCL queue and the
+         *        OpenGL context must still be alive
+         */
+        static void release();
+
+    private:
+        FrameProfiler();
+        FrameProfiler(const FrameProfiler&);
+        FrameProfiler& operator=(const FrameProfiler&);
+
+        typedef std::chrono::steady_clock _Clock;
+
+        // A timed span of a phase, on the OpenCL queue or OpenGL
+        struct _Span {
+            FramePhase phase;
+            cl_event start;
+            cl_event end;
+            GLuint query;
+        };
+
+        struct _Frame : public FrameRecord {
+            std::vector<_Span> spans;
+        };
+
+        static bool _in_frame;
+        static _Clock::time_point _frame_start;
+        static _Clock::time_point _phase_start[(int)FramePhase::COUNT];
+        static _Span _open[(int)FramePhase::COUNT];
+        static _Frame _current;
+        static unsigned long _frame_count;
+        static float _levels[(int)FrameCounter::COUNT];
+        static bool _is_level[(int)FrameCounter::COUNT];
+
+        // Frames waiting for their device times, oldest first
+        static std::deque<_Frame> _pending;
+        // Frames of the statistics, oldest first
+        static std::deque<_Frame> _window;
+        static std::vector<GLuint> _free_queries;
+
+        /**
+         * @brief Reads the device times of the pending frames, in order,
+         *        up to the first one not available
+         *
+         * @param wait Whether to wait for the oldest frame.
+         */
+        static void _resolve(bool wait);
+
+        /**
+         * @brief Returns whether the device times of a span are available
+         */
+        static bool _available(const _Span& span);
+
+        /**
+         * @brief Reads the device time of a span, and releases it
+         * @return The device time, in milliseconds.
+         */
+        static float _read(_Span& span);
+};
+
+#endif // _FRAME_PROFILER_H_
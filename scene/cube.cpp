@@ -119,7 +119,7 @@ void Cube::render(const Camera& camera,
 
     // Render the cube
     gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo_ids[2]);
-    gl.glDrawElements(GL_TRIANGLES, _box_mesh->indices_count(), GL_UNSIGNED_SHORT, nullptr);
+    gl.glDrawElements(GL_TRIANGLES, _box_mesh->indices_count(), GL_UNSIGNED_INT, nullptr);
 }
 
 float Cube::side() const {
@@ -168,4 +168,10 @@ vector<btVector3> Cube::surface_sampling(float particle_spacing) const {
     }
 
     return particles;
-}
\ No newline at end of file
+}
+
+string Cube::sampling_key() const {
+    ostringstream key;
+    key << "cube " << hexfloat << _side;
+    return key.str();
+}
@@ -1,5 +1,6 @@
 #include "fishtank.h"
 #include "opengl/glutils.h"
+#include <sstream>
 
 using namespace std;
 
@@ -75,7 +76,7 @@ void FishTank::render(const Camera& camera,
 
     // Render grid
     gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo_ids[1]);
-    gl.glDrawElements(GL_LINES, _box_mesh->indices_count(), GL_UNSIGNED_SHORT, 0);
+    gl.glDrawElements(GL_LINES, _box_mesh->indices_count(), GL_UNSIGNED_INT, 0);
 }
 
 float FishTank::width() const {
@@ -179,4 +180,15 @@ void FishTank::_init_physics() {
     _motion_state = new btDefaultMotionState(_transform);
     _bt_collision_shape->calculateLocalInertia(_mass, _local_inertia);
     _bt_rigid_body = new btRigidBody(_mass, _motion_state, _bt_collision_shape, _local_inertia);
-}
\ No newline at end of file
+}
+
+string FishTank::sampling_key() const {
+    // The sampling is done with the transform applied
+    auto p = _transform.getOrigin();
+    auto q = _transform.getRotation();
+    ostringstream key;
+    key << "fishtank " << hexfloat << _width << " " << _height << " " << _depth
+        << " " << p.x() << " " << p.y() << " " << p.z()
+        << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w();
+    return key.str();
+}
@@ -51,6 +51,9 @@ class FishTank : public RigidBody {
          */
         std::vector<btVector3> surface_sampling(float particle_spacing) const;
 
+        // Returns the key of the surface, see RigidBody::sampling_key
+        std::string sampling_key() const;
+
     private:
         float _width, _height, _depth;
         QColor _color;
@@ -1,12 +1,18 @@
 #include "fluid.h"
 #include "fluid/simulation/fluidsimulation.h"
+#include "fluid/simulation/replaysimulation.h"
 #include "fluid/render/sspacefluidrenderer.h"
 #include "fluid/render/particlesrenderer.h"
+#include "fluid/surface/meshwriter.h"
 #include "opengl/glutils.h"
+#include "settings/settings.h"
+#include "profiling/frameprofiler.h"
 
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <cstdio>
+#include <iostream>
 
 using namespace std;
 
@@ -16,7 +22,9 @@ Fluid::Fluid(int viewport_width,
              const SimulationSettings& sim_settings,
              const GraphicsSettings& g_settings) :
 _viewport_w(viewport_width),
-_viewport_h(viewport_height) {
+_viewport_h(viewport_height),
+_batching(false),
+_surface_interval(1) {
     auto& gl = OpenGLFunctions::getFunctions();
 
     //Default color
@@ -27,6 +35,9 @@ _viewport_h(viewport_height) {
     gl.glGenBuffers(1, &_vbo_fluid_particles);
     // This one is not being used right now
     gl.glGenBuffers(1, &_vbo_boundary_particles); 
+    // The solver writes the costs of the particles here, only while the
+    // particles renderer colors them by one
+    gl.glGenBuffers(1, &_vbo_particle_metrics);
 
     // Now initialize the simulation
     _simulation = FluidSimulationFactory::build_simulation(fluid_settings, 
@@ -37,12 +48,29 @@ _viewport_h(viewport_height) {
 }
 
 Fluid::~Fluid() {
-
+    // The recorder must finish while the simulation and the CL queue are alive
+    _recorder.reset();
 }
 
 void Fluid::simulate() {
     // Simulate fluid state and then render it
+    int count = _simulation->particle_count();
     _simulation->simulate();
+    FrameProfiler::count(FrameCounter::SIM_STEPS, 1);
+
+    // Emitters, sinks and replayed recordings change the particle count
+    // between frames
+    if (_simulation->particle_count() != count) {
+        _renderer->reset(_simulation->particle_count());
+    }
+
+    if (_recorder && _simulation->step_count() % _recorder->interval() == 0) {
+        _recorder->capture(*_simulation);
+    }
+
+    if (_surface && _simulation->step_count() % _surface_interval == 0) {
+        _export_surface();
+    }
 }
 
 void Fluid::render(const Camera& camera,
@@ -95,13 +123,68 @@ void Fluid::reset(const SimulationSettings& s_settings,
     _init_renderer(p_settings, s_settings, g_settings);
 }
 
+// Whether two settings build the same renderer
+static bool same_renderer(const GraphicsSettings& a, const GraphicsSettings& b) {
+    return a.render_method == b.render_method &&
+           a.sspace_filter_iterations == b.sspace_filter_iterations &&
+           a.sspace_depth_filter == b.sspace_depth_filter &&
+           a.sspace_resolution_scale == b.sspace_resolution_scale &&
+           a.sspace_target_frame_time == b.sspace_target_frame_time &&
+           a.sspace_reduced_precision == b.sspace_reduced_precision &&
+           a.particles_lod_distance == b.particles_lod_distance &&
+           a.particles_coloring == b.particles_coloring;
+}
+
+bool Fluid::apply_settings(const SimulationSettings& s_settings,
+                           const PhysicsSettings& p_settings,
+                           const GraphicsSettings& g_settings) {
+    int count = _simulation->particle_count();
+    bool reset = !_simulation->update_settings(p_settings, s_settings);
+    if (reset) {
+        _simulation->reset(p_settings, s_settings);
+    }
+
+    if (!same_renderer(g_settings, _graphics_settings) ||
+        2 * s_settings.fluid_particle_radius != _particle_spacing) {
+        _init_renderer(p_settings, s_settings, g_settings);
+    }
+    else if (_simulation->particle_count() != count) {
+        _renderer->reset(_simulation->particle_count());
+    }
+
+    return reset;
+}
+
 void Fluid::_init_renderer(const PhysicsSettings& p_settings,
                            const SimulationSettings& s_settings,
                            const GraphicsSettings& g_settings) {
+    _graphics_settings = g_settings;
+    _particle_spacing = 2 * s_settings.fluid_particle_radius;
+
+    // Writing the metrics costs a kernel per step, so the solver only does
+    // it while they are drawn
+    GLuint vbo_metrics = 0;
+    if (g_settings.render_method == PARTICLES && g_settings.particles_coloring != FLUID_COLOR) {
+        if (_simulation->set_metrics_buffer(_vbo_particle_metrics)) {
+            vbo_metrics = _vbo_particle_metrics;
+        }
+        else {
+            cerr << "The solver does not compute the costs of the particles, "
+                 << "drawing the fluid color" << endl;
+        }
+    }
+    else {
+        _simulation->set_metrics_buffer(0);
+    }
+
     if (g_settings.render_method == SCREEN_SPACE) {
         _renderer = make_unique<SSpaceFluidRenderer>(_viewport_w,
                                                      _viewport_h,
                                                      g_settings.sspace_filter_iterations,
+                                                     g_settings.sspace_depth_filter,
+                                                     g_settings.sspace_resolution_scale,
+                                                     g_settings.sspace_target_frame_time,
+                                                     g_settings.sspace_reduced_precision,
                                                      _simulation->particle_count(),
                                                      _vbo_fluid_particles);
     }
@@ -109,7 +192,11 @@ void Fluid::_init_renderer(const PhysicsSettings& p_settings,
         _renderer = make_unique<ParticlesRenderer>(_viewport_w,
                                                    _viewport_h,
                                                    _simulation->particle_count(),
-                                                   _vbo_fluid_particles);
+                                                   g_settings.particles_lod_distance,
+                                                   _particle_spacing,
+                                                   _vbo_fluid_particles,
+                                                   g_settings.particles_coloring,
+                                                   vbo_metrics);
     }
 }
 
@@ -117,22 +204,129 @@ void Fluid::add_boundary(const std::shared_ptr<RigidBody> boundary,
                          const string& id,
                          bool can_move) {
     _simulation->add_boundary(boundary, id, can_move);
-    _renderer->reset(_simulation->particle_count());
+    if (!_batching) {
+        _renderer->reset(_simulation->particle_count());
+    }
 }
 
 int Fluid::particle_count() const {
     return _simulation->particle_count();
 }
 
+bool Fluid::composites_background() const {
+    return _renderer->composites_background();
+}
+
 int Fluid::boundary_particle_count() const {
     return _simulation->boundary_particle_count();
 }
 
 void Fluid::add_volume(std::shared_ptr<FluidVolume> volume) {
     _simulation->add_volume(volume);
+    if (!_batching) {
+        _renderer->reset(_simulation->particle_count());
+    }
+}
+
+void Fluid::add_emitter(std::shared_ptr<FluidEmitter> emitter) {
+    _simulation->add_emitter(emitter);
+    if (!_batching) {
+        _renderer->reset(_simulation->particle_count());
+    }
+}
+
+void Fluid::add_sink(std::shared_ptr<FluidSink> sink) {
+    _simulation->add_sink(sink);
+    if (!_batching) {
+        _renderer->reset(_simulation->particle_count());
+    }
+}
+
+void Fluid::begin_batch() {
+    _batching = true;
+    _simulation->begin_batch();
+}
+
+void Fluid::commit() {
+    _batching = false;
+    _simulation->commit();
     _renderer->reset(_simulation->particle_count());
 }
 
 void Fluid::set_rect_limits(float width, float height, float depth) {
     _simulation->set_rect_limits(width, height, depth);
-}
\ No newline at end of file
+}
+
+void Fluid::save_checkpoint(const string& path) {
+    _simulation->save_checkpoint(path);
+}
+
+void Fluid::load_checkpoint(const string& path) {
+    _simulation->load_checkpoint(path);
+    _renderer->reset(_simulation->particle_count());
+}
+
+void Fluid::seek_replay(size_t frame) {
+    auto replay = dynamic_cast<ReplaySimulation*>(_simulation.get());
+    if (!replay) {
+        return;
+    }
+
+    int count = _simulation->particle_count();
+    replay->seek(frame);
+    if (_simulation->particle_count() != count) {
+        _renderer->reset(_simulation->particle_count());
+    }
+}
+
+void Fluid::start_recording(const string& path, int interval) {
+    // Close the previous recording first, so its pending frames are written
+    _recorder.reset();
+
+    auto& s = Settings::simulation();
+    _recorder = make_unique<FrameWriter>(path,
+                                         interval,
+                                         s.time_step,
+                                         s.fluid_particle_radius);
+}
+
+void Fluid::stop_recording() {
+    _recorder.reset();
+}
+
+void Fluid::set_surface_export(const string& path, int interval) {
+    if (path == "") {
+        _surface.reset();
+        return;
+    }
+
+    if (!_surface) {
+        _surface = make_unique<SurfaceExtractor>();
+    }
+    _surface_path = path;
+    _surface_interval = max(interval, 1);
+}
+
+void Fluid::_export_surface() {
+    ParticleGrid particles;
+    if (!_simulation->particle_grid(particles)) {
+        return;
+    }
+
+    _surface->extract(particles);
+
+    SurfaceMesh mesh;
+    _surface->download(mesh);
+
+    // Insert the step number before the extension
+    auto dot = _surface_path.find_last_of('.');
+    auto slash = _surface_path.find_last_of('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) {
+        dot = _surface_path.size();
+    }
+    char step[32];
+    snprintf(step, sizeof(step), "_%06lu", _simulation->step_count());
+    auto path = _surface_path.substr(0, dot) + step + _surface_path.substr(dot);
+
+    MeshWriter::write(path, mesh);
+}
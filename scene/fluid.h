@@ -8,6 +8,8 @@
 #include "sceneobject.h"
 #include "rigidbody.h"
 #include "fluid/render/fluidrenderer.h"
+#include "fluid/recording/framewriter.h"
+#include "fluid/surface/surfaceextractor.h"
 #include <memory>
 #include <QColor>
 
@@ -87,6 +89,22 @@ class Fluid : public SceneObject {
                    const PhysicsSettings& p_settings,
                    const GraphicsSettings& g_settings);
 
+        /**
+         * @brief Applies new settings to the running fluid
+         * @details Coefficients are updated in place, keeping the state of
+         *          the fluid. It is only reset if a structural setting, like
+         *          the particle radius, changed. The renderer is only rebuilt
+         *          if the graphics settings changed.
+         *
+         * @param s_settings Settings related to the simulation method
+         * @param p_settings Settings related to the physics of the fluid
+         * @param g_settings Settings related to the rendering of the fluid
+         * @return Whether the fluid was reset
+         */
+        bool apply_settings(const SimulationSettings& s_settings,
+                            const PhysicsSettings& p_settings,
+                            const GraphicsSettings& g_settings);
+
         /**
          * @brief Adds a new rigid body to the fluid as a boundary. Depending
          *        on the mass, it will be treated as static or dynamic.
@@ -104,6 +122,34 @@ class Fluid : public SceneObject {
          */
         void add_volume(std::shared_ptr<FluidVolume> volume);
 
+        /**
+         * @brief Add a new inflow to the fluid
+         * 
+         * @param emitter Fluid emitter
+         */
+        void add_emitter(std::shared_ptr<FluidEmitter> emitter);
+
+        /**
+         * @brief Add a new outflow to the fluid
+         * 
+         * @param sink Fluid sink
+         */
+        void add_sink(std::shared_ptr<FluidSink> sink);
+
+        /**
+         * @brief Starts a batch of volumes and boundaries
+         * @details Until commit is called, the volumes and boundaries added
+         *          are only recorded. The simulation and the renderer are 
+         *          then initialized once for all of them.
+         */
+        void begin_batch();
+
+        /**
+         * @brief Applies all the volumes and boundaries added since 
+         *        begin_batch
+         */
+        void commit();
+
         /**
          * @brief Returns the number of fluid particles.
          */
@@ -114,13 +160,74 @@ class Fluid : public SceneObject {
          */
         int boundary_particle_count() const;
 
+        /**
+         * @brief Tells if the renderer of the fluid writes the background
+         *        itself, so it needs no copy of it in the destination
+         */
+        bool composites_background() const;
+
         void set_rect_limits(float width, float height, float depth);
 
+        /**
+         * @brief Saves the state of the fluid simulation to a checkpoint
+         * 
+         * @param path The path of the checkpoint file
+         */
+        void save_checkpoint(const std::string& path);
+
+        /**
+         * @brief Restores the state of the fluid simulation from a 
+         *        checkpoint. The renderer is updated with the restored 
+         *        particle count.
+         * 
+         * @param path The path of the checkpoint file
+         */
+        void load_checkpoint(const std::string& path);
+
+        /**
+         * @brief Moves a replayed recording to a frame. The renderer is 
+         *        updated if the particle count changes. Does nothing if the
+         *        fluid is not replaying a recording.
+         * 
+         * @param frame The index of the frame
+         */
+        void seek_replay(size_t frame);
+
+        /**
+         * @brief Starts recording the particles to a file every few 
+         *        simulation steps. Any previous recording is closed.
+         * 
+         * @param path The path of the recording file
+         * @param interval Number of simulation steps between frames
+         */
+        void start_recording(const std::string& path, int interval);
+
+        /**
+         * @brief Writes the pending frames and closes the recording
+         */
+        void stop_recording();
+
+        /**
+         * @brief Starts exporting the fluid surface as a triangle mesh every
+         *        few simulation steps
+         * @details Each mesh is written to path, with the simulation step 
+         *          appended before the extension (eg: surface_000120.ply).
+         *          The format is PLY, or OBJ if the extension is .obj.
+         * 
+         * @param path The path of the mesh files. An empty path stops the
+         *             export.
+         * @param interval Number of simulation steps between meshes
+         */
+        void set_surface_export(const std::string& path, int interval);
+
     private:
         int _viewport_w, _viewport_h;
 
         QColor _color;
 
+        // Set while a batch of volumes and boundaries is being added
+        bool _batching;
+
         // Fluid simulation, this is the one that calculates
         // particles positions
         std::unique_ptr<FluidSimulation> _simulation;
@@ -128,9 +235,23 @@ class Fluid : public SceneObject {
         // OpenGL particles buffers
         GLuint _vbo_fluid_particles; // Particle's centers
         GLuint _vbo_boundary_particles; // Particles mass densities
+        GLuint _vbo_particle_metrics; // Costs of the particles, when drawn
         QMatrix4x4 _qt_transformation;
 
         std::unique_ptr<FluidRenderer> _renderer;
+        // The settings the renderer was built with, and the particle spacing
+        GraphicsSettings _graphics_settings;
+        float _particle_spacing;
+
+        // Frame recorder, null if the fluid is not being recorded
+        std::unique_ptr<FrameWriter> _recorder;
+
+        // Surface mesh export, null if the surface is not being exported
+        std::unique_ptr<SurfaceExtractor> _surface;
+        std::string _surface_path;
+        int _surface_interval;
+
+        void _export_surface();
 
         void _init_renderer(const PhysicsSettings& fluid_settings,
                             const SimulationSettings& sim_settings,
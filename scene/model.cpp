@@ -1,8 +1,10 @@
 #include "model.h"
 #include "opengl/glutils.h"
-#include "BulletCollision/CollisionShapes/btShapeHull.h"
+#include "fluid/simulation/poissondisksampling.h"
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 #define VOXELIZER_IMPLEMENTATION
 #include "external/voxelizer/voxelizer.h"
@@ -12,9 +14,10 @@ using namespace std;
 Model::Model(const string& model_filename,
              float mass,
              const btVector3& pos,
-             const btQuaternion& q)
+             const btQuaternion& q,
+             int lod_levels)
     : RigidBody(mass, pos, q),
-      _model_mesh(new ModelMesh(model_filename)) {
+      _model_mesh(new ModelMesh(model_filename, lod_levels)) {
     
     // Initialize mesh
     auto& gl = OpenGLFunctions::getFunctions();
@@ -49,12 +52,25 @@ Model::Model(const string& model_filename,
     _shader->enableAttributeArray(vertex_loc);
     gl.glVertexAttribPointer(vertex_loc, 3, GL_FLOAT, GL_FALSE, 0, 0);
   
-    // Set up box indices
+    // Set up the indices, all the levels of detail one after the other
+    size_t total_indices = 0;
+    for (size_t l = 0; l < _model_mesh->lod_count(); ++l) {
+        _lod_offsets.push_back(total_indices);
+        _lod_sizes.push_back(_model_mesh->lod_indices_count(l));
+        total_indices += _lod_sizes.back();
+    }
+
     gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo_ids[2]);
     gl.glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                    _model_mesh->indices_count() * sizeof(mesh_index),
-                    _model_mesh->mesh_indices(),
+                    total_indices * sizeof(mesh_index),
+                    nullptr,
                     GL_STATIC_DRAW);
+    for (size_t l = 0; l < _model_mesh->lod_count(); ++l) {
+        gl.glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                           _lod_offsets[l] * sizeof(mesh_index),
+                           _lod_sizes[l] * sizeof(mesh_index),
+                           _model_mesh->lod_indices(l));
+    }
 
     set_material(get_random_material());
 
@@ -120,54 +136,61 @@ void Model::render(const Camera& camera,
     _shader->setUniformValue("material_shininess", _material.shininess);
 
     // Render the model
+    auto lod = _select_lod(camera, v_matrix);
     gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo_ids[2]);
-    gl.glDrawElements(GL_TRIANGLES, _model_mesh->indices_count(), GL_UNSIGNED_SHORT, nullptr);
+    gl.glDrawElements(GL_TRIANGLES,
+                      _lod_sizes[lod],
+                      GL_UNSIGNED_INT,
+                      (GLvoid*)(_lod_offsets[lod] * sizeof(mesh_index)));
 }
 
-void Model::_init_physics() {
-    // Extract vertices
-    btScalar* bt_vertices = new btScalar[_model_mesh->vertices_count()*3];
-    auto bt_indices = new int[_model_mesh->indices_count()];
-
-    int faces_count = (int)_model_mesh->indices_count() / 3;
-    for (int i=0; i<_model_mesh->vertices_count()*3; ++i) {
-        bt_vertices[i] = _model_mesh->vertices()[i];
+size_t Model::_select_lod(const Camera& camera, const QMatrix4x4& v_matrix) const {
+    if (_model_mesh->lod_count() == 1) {
+        return 0;
     }
 
-    for (int i=0; i<_model_mesh->indices_count(); ++i) {
-        bt_indices[i] = _model_mesh->mesh_indices()[i];
+    auto c = _model_mesh->bounding_center();
+    auto eye_center = v_matrix * _qt_transformation * QVector3D(c.x(), c.y(), c.z());
+    float dist = eye_center.length();
+    float radius = _model_mesh->bounding_radius();
+    if (dist <= radius) {
+        return 0;
     }
 
-    auto index_vertex_arrays = new btTriangleIndexVertexArray(faces_count,
-                                                              bt_indices, 
-                                                              3 * sizeof(int),
-                                                              _model_mesh->vertices_count(),
-                                                              bt_vertices, 
-                                                              sizeof(btScalar) * 3);
+    // Fraction of the height of the viewport the model covers
+    auto perspective = camera.perspective();
+    float screen_size = radius / (dist * tanf(perspective.fov * (0.5f * M_PI / 180.0f)));
+    if (screen_size >= 0.5f) {
+        return 0;
+    }
 
-    auto tmp_convex_shape = new btConvexTriangleMeshShape(index_vertex_arrays);
+    size_t level = (size_t)log2f(0.5f / screen_size);
+    return min(level, _model_mesh->lod_count() - 1);
+}
 
-    // Create a hull approximation
-    auto hull = new btShapeHull(tmp_convex_shape);
-    auto margin = tmp_convex_shape->getMargin();
-    hull->buildHull(margin);   
+void Model::_init_physics() {
+    // The hull points come with the mesh, built or cached
     auto convex_hull_shape = new btConvexHullShape();
-    for(int i= 0; i < hull->numVertices(); i++ ) {
-       convex_hull_shape->addPoint(hull->getVertexPointer()[i]);   
-    }    
+    auto points = _model_mesh->hull_points();
+    for (size_t i = 0; i < _model_mesh->hull_point_count(); ++i) {
+        convex_hull_shape->addPoint(btVector3(points[3*i + 0],
+                                              points[3*i + 1],
+                                              points[3*i + 2]),
+                                    false);
+    }
+    convex_hull_shape->recalcLocalAabb();
+
     _bt_collision_shape = convex_hull_shape;
     _motion_state = new btDefaultMotionState(_transform);
     _bt_collision_shape->calculateLocalInertia(_mass, _local_inertia);
     _bt_rigid_body = new btRigidBody(_mass, _motion_state, _bt_collision_shape, _local_inertia);
-
-    delete tmp_convex_shape;
-    delete hull;
-    delete bt_vertices;
-    delete bt_indices;
-    delete index_vertex_arrays;
 }
 
 vector<btVector3> Model::surface_sampling(float particle_spacing) const {
+    if (_sampling_method == POISSON_DISK) {
+        return poisson_disk_sampling(*_model_mesh, particle_spacing);
+    }
+
     vector<btVector3> sampling;
     vx_mesh_t* original_mesh;
     vx_mesh_t* voxelized_mesh;
@@ -212,4 +235,10 @@ vector<btVector3> Model::surface_sampling(float particle_spacing) const {
     delete voxelized_mesh;
 
     return sampling;
-}
\ No newline at end of file
+}
+
+string Model::sampling_key() const {
+    ostringstream key;
+    key << "model " << hex << _model_mesh->geometry_hash();
+    return key.str();
+}
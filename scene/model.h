@@ -20,11 +20,16 @@ class Model : public RigidBody {
          * @param mass The mass of this new rigid body
          * @param pos The initial position in space
          * @param q The initial rotation
+         * @param lod_levels Number of simplified levels of detail to build.
+         *                   They are drawn as the model gets smaller on
+         *                   screen, and the coarsest one is used to build
+         *                   the collision hull.
          */
         Model(const std::string& model_filename, 
               float mass,
               const btVector3& pos,
-              const btQuaternion& q);
+              const btQuaternion& q,
+              int lod_levels=0);
 
         /* Destructor */
         ~Model();
@@ -53,6 +58,9 @@ class Model : public RigidBody {
          */
         std::vector<btVector3> surface_sampling(float particle_spacing) const;
 
+        // Returns the key of the surface, see RigidBody::sampling_key
+        std::string sampling_key() const;
+
     private:
         // The mesh of the cube
         std::unique_ptr<ModelMesh> _model_mesh;
@@ -62,6 +70,11 @@ class Model : public RigidBody {
 
         GLuint _vao;
         GLuint _vbo_ids[3];
+
+        // Where every level of detail starts in the indices buffer, and its
+        // number of indices
+        std::vector<std::size_t> _lod_offsets;
+        std::vector<std::size_t> _lod_sizes;
         QMatrix4x4 _qt_transformation;
 
         btTriangleMesh* _bt_mesh_interface;
@@ -70,6 +83,13 @@ class Model : public RigidBody {
          * @brief Initializes physics of the model
          */
         void _init_physics();
+
+        /**
+         * @brief Chooses the level of detail to draw
+         * @details Every time the model halves its size on screen, the next
+         *          level, with about half the triangles, is drawn.
+         */
+        std::size_t _select_lod(const Camera& camera, const QMatrix4x4& v_matrix) const;
 };
 
 #endif // _MODEL_H_
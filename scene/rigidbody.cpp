@@ -3,6 +3,7 @@
 
 RigidBody::RigidBody(float mass) : 
 _mass(mass),
+_sampling_method(LATTICE),
 _bt_rigid_body(nullptr),
 _bt_collision_shape(nullptr) {
 
@@ -11,6 +12,7 @@ _bt_collision_shape(nullptr) {
 RigidBody::RigidBody(float mass, float x, float y, float z) : 
 SceneObject(x,y,z),
 _mass(mass),
+_sampling_method(LATTICE),
 _bt_rigid_body(nullptr),
 _bt_collision_shape(nullptr) {
 
@@ -19,6 +21,7 @@ _bt_collision_shape(nullptr) {
 RigidBody::RigidBody(float mass, const btVector3& pos, const btQuaternion& q) : 
 SceneObject(pos, q),
 _mass(mass),
+_sampling_method(LATTICE),
 _bt_rigid_body(nullptr),
 _bt_collision_shape(nullptr) {
 
@@ -28,6 +31,14 @@ float RigidBody::mass() const {
     return _mass;
 }
 
+void RigidBody::set_sampling_method(SamplingMethod method) {
+    _sampling_method = method;
+}
+
+RigidBody::SamplingMethod RigidBody::sampling_method() const {
+    return _sampling_method;
+}
+
 void RigidBody::set_position(float x, float y, float z) {
     set_position(btVector3(x, y, z));
 }
@@ -61,6 +72,16 @@ btVector3 RigidBody::linear_vel() const {
     return _bt_rigid_body->getLinearVelocity();
 }
 
+void RigidBody::set_angular_vel(const btVector3& v) {
+    _bt_rigid_body->setAngularVelocity(v);
+    _bt_rigid_body->activate();
+}
+
+void RigidBody::set_linear_vel(const btVector3& v) {
+    _bt_rigid_body->setLinearVelocity(v);
+    _bt_rigid_body->activate();
+}
+
 btQuaternion RigidBody::rotation() const {
     return _bt_rigid_body->getCenterOfMassTransform().getRotation();
 }
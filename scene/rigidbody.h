@@ -2,6 +2,7 @@
 #define _RIGID_BODY_H_
 
 #include <memory>
+#include <string>
 #include "sceneobject.h"
 #include "mesh/mesh.h"
 #include "btBulletDynamicsCommon.h"
@@ -22,6 +23,15 @@ class RigidBody : public SceneObject {
     public:
         friend class Scene;
 
+        // How the surface is sampled with boundary particles
+        enum SamplingMethod {
+            // A regular lattice, or a voxelization for models
+            LATTICE,
+            // A Poisson disk distribution over the triangles of the surface,
+            // only for models
+            POISSON_DISK
+        };
+
         /**
          * @brief Initializes rigid body with a mass at location (0,0,0)
          * 
@@ -103,6 +113,34 @@ class RigidBody : public SceneObject {
          */
         virtual std::vector<btVector3> surface_sampling(float particle_spacing) const = 0;
 
+        /**
+         * @brief Returns a key that identifies the sampled surface
+         * @details Bodies with the same key must return the same 
+         *          surface_sampling for any spacing, so the key must 
+         *          include every parameter the sampling depends on. It is
+         *          used to cache samplings, and to share them between 
+         *          equal bodies.
+         * 
+         * @return The key of the surface.
+         */
+        virtual std::string sampling_key() const = 0;
+
+        /**
+         * @brief Sets how the surface is sampled
+         * @details Only models are sampled with a Poisson disk. Their
+         *          voxelization layers particles on curved surfaces, while
+         *          the lattice of the other bodies is already sparser than
+         *          a Poisson disk, so they always keep it.
+         * 
+         * @param method The sampling method.
+         */
+        void set_sampling_method(SamplingMethod method);
+
+        /**
+         * @brief Returns how the surface is sampled
+         */
+        SamplingMethod sampling_method() const;
+
         /**
          * @brief Returns the angular velocity of the center of mass
          * @return The angular vel
@@ -115,6 +153,20 @@ class RigidBody : public SceneObject {
          */
         btVector3 linear_vel() const;
 
+        /**
+         * @brief Sets the angular velocity of the center of mass
+         * 
+         * @param v The angular velocity
+         */
+        void set_angular_vel(const btVector3& v);
+
+        /**
+         * @brief Sets the linear velocity of the center of mass
+         * 
+         * @param v The velocity
+         */
+        void set_linear_vel(const btVector3& v);
+
         /**
          * @brief Applies a given force to the center of mass
          * 
@@ -126,6 +178,8 @@ class RigidBody : public SceneObject {
         // Rigid body mass
         float _mass;
 
+        SamplingMethod _sampling_method;
+
         btRigidBody* _bt_rigid_body;
         btCollisionShape* _bt_collision_shape;
         btVector3 _local_inertia;
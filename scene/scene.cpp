@@ -10,6 +10,10 @@
 #include "scene/wall.h"
 #include "scene/model.h"
 #include "fluid/simulation/boxvolume.h"
+#include "fluid/simulation/particlesfilevolume.h"
+#include "fluid/simulation/nozzleemitter.h"
+#include "fluid/simulation/planeemitter.h"
+#include "profiling/frameprofiler.h"
 
 #include <QImage>
 #include <QGLWidget>
@@ -25,7 +29,8 @@ using namespace std;
 Scene::Scene(int viewport_width, 
              int viewport_height): 
 _viewport_w(viewport_width), 
-_viewport_h(viewport_height) {
+_viewport_h(viewport_height),
+_bkg_color_format(Settings::graphics().sspace_reduced_precision ? GL_RGB10_A2 : GL_RGB32F) {
     //_initialize_scene_fbo(viewport_width, viewport_height);
     _initialize_fbo(viewport_width, 
                     viewport_height,
@@ -89,7 +94,11 @@ void Scene::render(float dt, GLuint dest_fbo) {
         (*it)->render(_camera, _dir_lights, _bkg_fbo, _bkg_color_tex, _bkg_depth_tex, _skybox_texture);
     }
 
-    _copy_fbo(_bkg_fbo, dest_fbo);
+    // When the fluid writes the background itself, where there is no fluid,
+    // copying it to the destination first is just wasted bandwidth
+    if (!_translucent_composites_background()) {
+        _copy_fbo(_bkg_fbo, dest_fbo);
+    }
 
     for (auto it = _translucent_objects.begin(); it != _translucent_objects.end(); ++it) {
         (*it)->render(_camera, _dir_lights, dest_fbo, _bkg_color_tex, _bkg_depth_tex, _skybox_texture);
@@ -106,7 +115,9 @@ void Scene::render(float dt, GLuint dest_fbo) {
     }
 
     // Update the physics of the rigid bodies
+    FrameProfiler::begin(FramePhase::BULLET_STEP);
     _bt_world->stepSimulation(dt, 0);
+    FrameProfiler::end(FramePhase::BULLET_STEP);
 }
 
 void Scene::_initialize_fbo(int viewport_width, 
@@ -132,7 +143,7 @@ void Scene::_initialize_fbo(int viewport_width,
     gl.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
     gl.glTexImage2D(GL_TEXTURE_2D,
                     0,
-                    GL_RGB32F,
+                    _bkg_color_format,
                     viewport_width,
                     viewport_height,
                     0,
@@ -381,6 +392,9 @@ unique_ptr<Scene> Scene::load_scene(const std::string& filename,
     scene->add_rigid_body("container", container);
     fluid->set_rect_limits(width, height, depth);
 
+    // The solver is initialized once, with all the volumes and bodies
+    fluid->begin_batch();
+
     auto fluid_volumes = scene_config["fluid_volumes"].array_items();
     for (auto& v : fluid_volumes) {
         if (v["type"] == "box") {
@@ -389,6 +403,45 @@ unique_ptr<Scene> Scene::load_scene(const std::string& filename,
             auto vol = make_shared<BoxVolume>(size, center);
             fluid->add_volume(vol);
         }
+        else if (v["type"] == "particles_file") {
+            auto vol = make_shared<ParticlesFileVolume>(v["file"].string_value(), v["velocities"].bool_value());
+            fluid->add_volume(vol);
+        }
+    }
+
+    auto fluid_emitters = scene_config["fluid_emitters"].array_items();
+    for (auto& e : fluid_emitters) {
+        auto center = btVector3(e["center"][0].number_value(), e["center"][1].number_value(), e["center"][2].number_value());
+        auto direction = btVector3(e["direction"][0].number_value(), e["direction"][1].number_value(), e["direction"][2].number_value());
+        float speed = e["speed"].number_value();
+        shared_ptr<FluidEmitter> emitter = nullptr;
+
+        if (e["type"] == "nozzle") {
+            emitter = make_shared<NozzleEmitter>(center, direction, speed, e["radius"].number_value());
+        }
+        else if (e["type"] == "plane") {
+            emitter = make_shared<PlaneEmitter>(center,
+                                                direction,
+                                                speed,
+                                                e["size"][0].number_value(),
+                                                e["size"][1].number_value());
+        }
+
+        if (emitter) {
+            float stop = e["stop"].is_number() ? e["stop"].number_value() : -1.0f;
+            emitter->set_active_interval(e["start"].number_value(), stop);
+            emitter->set_max_particles(e["max_particles"].int_value());
+            fluid->add_emitter(emitter);
+        }
+    }
+
+    auto fluid_sinks = scene_config["fluid_sinks"].array_items();
+    for (auto& s : fluid_sinks) {
+        if (s["type"] == "box") {
+            auto size = btVector3(s["size"][0].number_value(), s["size"][1].number_value(), s["size"][2].number_value());
+            auto center = btVector3(s["center"][0].number_value(), s["center"][1].number_value(), s["center"][2].number_value());
+            fluid->add_sink(make_shared<FluidSink>(size, center));
+        }
     }
 
     auto rigid_bodies = scene_config["rigid_bodies"].array_items();
@@ -443,7 +496,8 @@ unique_ptr<Scene> Scene::load_scene(const std::string& filename,
             body = make_shared<Model>(obj_filename,
                                       mass,
                                       center,
-                                      rotation);
+                                      rotation,
+                                      r["lod_levels"].int_value());
         }
         else if (type == "wall") {
             center = btVector3(
@@ -467,14 +521,37 @@ unique_ptr<Scene> Scene::load_scene(const std::string& filename,
         }
 
         if (body) {
+            if (r["sampling"].string_value() == "poisson") {
+                if (type == "model") {
+                    body->set_sampling_method(RigidBody::POISSON_DISK);
+                }
+                else {
+                    cerr << "Only models can be sampled with a Poisson disk, "
+                         << name << " keeps its lattice" << endl;
+                }
+            }
             scene->add_rigid_body(name, body);
             fluid->add_boundary(body, name, mass > 0.0f);
         }
     }
 
+    fluid->commit();
+
     return scene;
 }
 
+void Scene::apply_settings(SimulationSettings s_settings,
+                           PhysicsSettings p_settings,
+                           GraphicsSettings g_settings) {
+    auto fluid = std::dynamic_pointer_cast<Fluid>(get_object("fluid"));
+    // A fluid reset starts over, so the objects must too
+    if (fluid && fluid->apply_settings(s_settings, p_settings, g_settings)) {
+        _restore_initial_poses();
+    }
+
+    _set_bkg_color_format(g_settings.sspace_reduced_precision ? GL_RGB10_A2 : GL_RGB32F);
+}
+
 void Scene::reset(SimulationSettings s_settings,
                   PhysicsSettings p_settings,
                   GraphicsSettings g_settings) {
@@ -483,6 +560,12 @@ void Scene::reset(SimulationSettings s_settings,
         fluid->reset(s_settings, p_settings, g_settings);
     }
 
+    _set_bkg_color_format(g_settings.sspace_reduced_precision ? GL_RGB10_A2 : GL_RGB32F);
+
+    _restore_initial_poses();
+}
+
+void Scene::_restore_initial_poses() {
     // Reset position and rotation of every object
     for (auto& key_val : _scene_objects) {
         auto id = key_val.first;
@@ -503,4 +586,36 @@ void Scene::_copy_fbo(GLuint from_fbo, GLuint dest_fbo) {
                          0, 0, _viewport_w, _viewport_h,
                          GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
                          GL_NEAREST);
-}
\ No newline at end of file
+}
+
+bool Scene::_translucent_composites_background() const {
+    // Only a single object can cover the whole destination
+    if (_translucent_objects.size() != 1) {
+        return false;
+    }
+
+    auto fluid = dynamic_pointer_cast<Fluid>(_translucent_objects.front());
+    return fluid && fluid->composites_background();
+}
+
+void Scene::_set_bkg_color_format(GLenum format) {
+    if (format == _bkg_color_format) {
+        return;
+    }
+
+    auto& gl = OpenGLFunctions::getFunctions();
+
+    // The texture keeps its name, so the fbo attachment is still valid
+    _bkg_color_format = format;
+    gl.glBindTexture(GL_TEXTURE_2D, _bkg_color_tex);
+    gl.glTexImage2D(GL_TEXTURE_2D,
+                    0,
+                    _bkg_color_format,
+                    _viewport_w,
+                    _viewport_h,
+                    0,
+                    GL_RGB,
+                    GL_FLOAT,
+                    0);
+    gl.glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -119,6 +119,20 @@ class Scene {
                    PhysicsSettings p_settings,
                    GraphicsSettings g_settings);
 
+        /**
+         * @brief Applies new settings to the running scene
+         * @details Unlike reset, the objects keep their state, and the fluid
+         *          is only reset if a structural setting changed. In that
+         *          case the objects go back to their initial poses too.
+         *
+         * @param s_settings Settings related to the simulation method
+         * @param p_settings Settings related to the physics of the fluid
+         * @param g_settings Settings related to the rendering
+         */
+        void apply_settings(SimulationSettings s_settings,
+                            PhysicsSettings p_settings,
+                            GraphicsSettings g_settings);
+
 
     private:
         // A list that points the all translucent objects within the scene
@@ -144,6 +158,10 @@ class Scene {
         GLuint _bkg_color_tex;
         GLuint _bkg_depth_tex;
 
+        // Internal format of the background color. The fluid reads it back
+        // every frame, so it may be stored with reduced precision
+        GLenum _bkg_color_format;
+
         // Skybox
         std::unique_ptr<QOpenGLShaderProgram> _shader;
         GLuint _skybox_vao;
@@ -160,6 +178,9 @@ class Scene {
         void _intialize_bullets();
         void _render_skybox();
         void _copy_fbo(GLuint from_fbo, GLuint dest_fbo); 
+        bool _translucent_composites_background() const;
+        void _set_bkg_color_format(GLenum format);
+        void _restore_initial_poses();
 
         // World rigid body physics
         btBroadphaseInterface* _bt_broadphase;
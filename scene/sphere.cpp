@@ -118,7 +118,7 @@ void Sphere::render(const Camera& camera,
 
     // Render the sphere
     gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo_ids[2]);
-    gl.glDrawElements(GL_TRIANGLES, _sphere_mesh->indices_count(), GL_UNSIGNED_SHORT, 0);
+    gl.glDrawElements(GL_TRIANGLES, _sphere_mesh->indices_count(), GL_UNSIGNED_INT, 0);
 }
 
 float Sphere::radius() const {
@@ -172,3 +172,9 @@ vector<btVector3> Sphere::surface_sampling(float particle_spacing) const {
 
     return particles;
 }
+
+string Sphere::sampling_key() const {
+    ostringstream key;
+    key << "sphere " << hexfloat << _radius;
+    return key.str();
+}
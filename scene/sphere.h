@@ -58,6 +58,9 @@ class Sphere : public RigidBody {
          */
         std::vector<btVector3> surface_sampling(float particle_spacing) const;
 
+        // Returns the key of the surface, see RigidBody::sampling_key
+        std::string sampling_key() const;
+
     private:
         // The radius of the sphere
         float _radius;
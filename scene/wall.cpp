@@ -121,7 +121,7 @@ void Wall::render(const Camera& camera,
 
     // Render the cube
     gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo_ids[2]);
-    gl.glDrawElements(GL_TRIANGLES, _quad_mesh->indices_count(), GL_UNSIGNED_SHORT, nullptr);
+    gl.glDrawElements(GL_TRIANGLES, _quad_mesh->indices_count(), GL_UNSIGNED_INT, nullptr);
 }
 
 float Wall::width() const {
@@ -149,4 +149,10 @@ vector<btVector3> Wall::surface_sampling(float particle_spacing) const {
     }
 
     return particles;
-}
\ No newline at end of file
+}
+
+string Wall::sampling_key() const {
+    ostringstream key;
+    key << "wall " << hexfloat << _width << " " << _height;
+    return key.str();
+}
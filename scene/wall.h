@@ -62,6 +62,9 @@ class Wall : public RigidBody {
          */
         std::vector<btVector3> surface_sampling(float particle_spacing) const;
 
+        // Returns the key of the surface, see RigidBody::sampling_key
+        std::string sampling_key() const;
+
     private:
         // The side of the cube
         float _width, _height;
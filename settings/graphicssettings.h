@@ -8,6 +8,32 @@ enum RenderMethod {
     SCREEN_SPACE
 };
 
+// Filters available to smooth the depth buffer in screen space rendering
+enum DepthFilter {
+    // Full 2D window, slow at high resolutions
+    BILATERAL,
+    // Horizontal and vertical passes using local memory
+    SEPARABLE_BILATERAL,
+    // Separable bilateral as an OpenGL compute shader
+    COMPUTE_BILATERAL,
+    // Curvature flow as an OpenGL compute shader
+    COMPUTE_CURVATURE_FLOW
+};
+
+// What the particles renderer colors the particles by. Other than the fluid
+// color, these are costs of the particles written by the solver
+enum ParticleColoring {
+    FLUID_COLOR,
+    // The length of the fluid neighbourhood list
+    NEIGHBOUR_COUNT,
+    // Whether a neighbourhood list is full, and may have dropped neighbours
+    TRUNCATED_LISTS,
+    // The compression left by the PCISPH pressure solve
+    DENSITY_ERROR,
+    // The length of the boundary neighbourhood list
+    BOUNDARY_NEIGHBOURS
+};
+
 struct GraphicsSettings {
     QColor fluid_color;
     RenderMethod render_method;
@@ -15,10 +41,37 @@ struct GraphicsSettings {
     // Screen space fluid rendering filter iterations
     int sspace_filter_iterations;
 
+    // Screen space fluid rendering depth filter
+    DepthFilter sspace_depth_filter;
+
+    // Fraction of the viewport the depth and blur stages render at
+    float sspace_resolution_scale;
+
+    // Frame time to hold by adjusting the resolution scale, in milliseconds.
+    // Zero keeps the scale fixed
+    float sspace_target_frame_time;
+
+    // Store the screen space depth as 16 bit floats, and the background as
+    // 10 bits per channel, to halve the bandwidth of the passes
+    bool sspace_reduced_precision;
+
+    // Distance from the camera where the particles renderer starts drawing
+    // a subsample of the particles. Zero draws every visible particle
+    float particles_lod_distance;
+
+    // What the particles renderer colors the particles by
+    ParticleColoring particles_coloring;
+
     GraphicsSettings()
         : fluid_color(9, 97, 168),
           render_method(PARTICLES),
-          sspace_filter_iterations(1)
+          sspace_filter_iterations(1),
+          sspace_depth_filter(SEPARABLE_BILATERAL),
+          sspace_resolution_scale(1.0f),
+          sspace_target_frame_time(0.0f),
+          sspace_reduced_precision(false),
+          particles_lod_distance(0.0f),
+          particles_coloring(FLUID_COLOR)
 
     {}
 };
@@ -34,9 +34,15 @@ void Settings::load(const string& config_file, const string& scene_file) {
     else if (method == "pcisph") {
         _simulation->sim_method = SimulationSettings::Method::PCISPH;
     }
+    else if (method == "replay") {
+        _simulation->sim_method = SimulationSettings::Method::REPLAY;
+    }
     else {
         throw RunTimeException("Unknown simulation method '" + method + "'!");
     }
+    if (parser.has_option("replay_file")) {
+        _simulation->replay_file = parser.option("replay_file");
+    }
 
     // Physics settings
     _physics->rest_density          = atof(parser.option("rest_density").c_str());
@@ -56,6 +62,58 @@ void Settings::load(const string& config_file, const string& scene_file) {
     else {
         throw RunTimeException("Unknown rendering method '" + render_method + "'!");
     }
+
+    if (parser.has_option("sspace_depth_filter")) {
+        auto depth_filter = parser.option("sspace_depth_filter");
+        if (depth_filter == "bilateral") {
+            _graphics->sspace_depth_filter = DepthFilter::BILATERAL;
+        }
+        else if (depth_filter == "separable") {
+            _graphics->sspace_depth_filter = DepthFilter::SEPARABLE_BILATERAL;
+        }
+        else if (depth_filter == "compute_bilateral") {
+            _graphics->sspace_depth_filter = DepthFilter::COMPUTE_BILATERAL;
+        }
+        else if (depth_filter == "compute_curvature_flow") {
+            _graphics->sspace_depth_filter = DepthFilter::COMPUTE_CURVATURE_FLOW;
+        }
+        else {
+            throw RunTimeException("Unknown depth filter '" + depth_filter + "'!");
+        }
+    }
+    if (parser.has_option("sspace_resolution_scale")) {
+        _graphics->sspace_resolution_scale = atof(parser.option("sspace_resolution_scale").c_str());
+    }
+    if (parser.has_option("sspace_target_frame_time")) {
+        _graphics->sspace_target_frame_time = atof(parser.option("sspace_target_frame_time").c_str());
+    }
+    if (parser.has_option("sspace_reduced_precision")) {
+        _graphics->sspace_reduced_precision = atoi(parser.option("sspace_reduced_precision").c_str()) != 0;
+    }
+    if (parser.has_option("particles_lod_distance")) {
+        _graphics->particles_lod_distance = atof(parser.option("particles_lod_distance").c_str());
+    }
+    if (parser.has_option("particles_coloring")) {
+        auto coloring = parser.option("particles_coloring");
+        if (coloring == "fluid") {
+            _graphics->particles_coloring = ParticleColoring::FLUID_COLOR;
+        }
+        else if (coloring == "neighbours") {
+            _graphics->particles_coloring = ParticleColoring::NEIGHBOUR_COUNT;
+        }
+        else if (coloring == "truncated") {
+            _graphics->particles_coloring = ParticleColoring::TRUNCATED_LISTS;
+        }
+        else if (coloring == "density_error") {
+            _graphics->particles_coloring = ParticleColoring::DENSITY_ERROR;
+        }
+        else if (coloring == "boundary_neighbours") {
+            _graphics->particles_coloring = ParticleColoring::BOUNDARY_NEIGHBOURS;
+        }
+        else {
+            throw RunTimeException("Unknown particles coloring '" + coloring + "'!");
+        }
+    }
 }
 
 GraphicsSettings& Settings::graphics() {
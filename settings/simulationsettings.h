@@ -1,6 +1,8 @@
 #ifndef _SIMULATION_SETTINGS_H_
 #define _SIMULATION_SETTINGS_H_
 
+#include <string>
+
 /**
  * @brief Simulation settings
  * @details Settings related with the simulation itself, rather than
@@ -22,11 +24,16 @@ struct SimulationSettings {
 
     enum Method {
         WCSPH,
-        PCISPH
+        PCISPH,
+        // Plays back a recording instead of simulating
+        REPLAY
     };
 
     Method sim_method;
 
+    // The recording played back by the REPLAY method
+    std::string replay_file;
+
     SimulationSettings()
         : time_step(0.01),
           max_vel(50.0),
@@ -6,21 +6,44 @@ uniform vec4 color;
 uniform float point_radius;
 uniform float point_scale;
 
+// The component of the metrics the particles are colored by, -1 for the
+// fluid color, and the value mapped to the hottest color
+uniform int metric;
+uniform float metric_max;
+
 out vec3 pos_eye; // Will be sent to the fragment shader interpolated
 
+// xyz is the position, w the factor to enlarge the point sprite by
 in vec4 particle_pos;
+// The costs of the particle written by the solver: fluid neighbours, full
+// list flag, relative density error and boundary neighbours
+in vec4 particle_metrics;
 out vec4 vertex_color;
 
+// Blue, cyan, green, yellow and red, from 0 to 1
+vec3 heat_color(float t)
+{
+    t = clamp(t, 0.0, 1.0);
+    return clamp(vec3(1.5 - abs(4.0 * t - 3.0),
+                      1.5 - abs(4.0 * t - 2.0),
+                      1.5 - abs(4.0 * t - 1.0)), 0.0, 1.0);
+}
+
 void main()
 {
     // Calculate the point size
     pos_eye = vec3(mv_matrix * vec4(particle_pos.xyz, 1.0));
     float dist = length(pos_eye);
-    gl_PointSize = point_radius * (point_scale / dist);
+    gl_PointSize = point_radius * particle_pos.w * (point_scale / dist);
     
     // Calculate vertex position in screen space
     gl_Position = pr_matrix * mv_matrix * vec4(particle_pos.xyz, 1);
     
     // Output the color
-    vertex_color = vec4(89/256.0, 152/256.0, 255/256.0, 1);
+    if (metric >= 0) {
+        vertex_color = vec4(heat_color(particle_metrics[metric] / metric_max), 1);
+    }
+    else {
+        vertex_color = vec4(89/256.0, 152/256.0, 255/256.0, 1);
+    }
 }
@@ -11,7 +11,6 @@ uniform float near_plane;
 // Textures
 uniform sampler2D depth_texture;
 uniform sampler2D blurred_depth_texture;
-uniform sampler2D normals_texture;
 uniform sampler2D background_texture;
 uniform samplerCube cube_map_texture;
 
@@ -30,12 +29,103 @@ vec3 uv_to_eye(vec2 tex_coord, float depth) {
     return view_pos.xyz / view_pos.w;
 }
 
+// Eye space position of a texel of the filtered depth
+vec3 texel_to_eye(ivec2 texel, ivec2 size) {
+    texel = clamp(texel, ivec2(0), size - 1);
+    vec2 tex_coord = (vec2(texel) + 0.5f) / vec2(size);
+    return uv_to_eye(tex_coord, texelFetch(blurred_depth_texture, texel, 0).r);
+}
+
+// Normal of a texel, from the differences with its neighbours. On each axis
+// the side with the smallest change in depth is used, so the normals do not
+// bend at the silhouette. This used to be a stage of its own, that wrote a
+// full screen texture only to be read back here.
+vec3 normal_at(ivec2 texel, ivec2 size) {
+    vec3 position = texel_to_eye(texel, size);
+
+    vec3 ddx = texel_to_eye(texel + ivec2(1, 0), size) - position;
+    vec3 ddx2 = position - texel_to_eye(texel - ivec2(1, 0), size);
+    if (abs(ddx.z) > abs(ddx2.z)) {
+        ddx = ddx2;
+    }
+
+    vec3 ddy = texel_to_eye(texel + ivec2(0, 1), size) - position;
+    vec3 ddy2 = position - texel_to_eye(texel - ivec2(0, 1), size);
+    if (abs(ddy.z) > abs(ddy2.z)) {
+        ddy = ddy2;
+    }
+
+    return normalize(cross(ddx, ddy));
+}
+
+// Depth and normals may be rendered at a fraction of the viewport. Plain
+// bilinear filtering would blend the fluid with the background (depth 0) at
+// the silhouette, and distant layers of fluid with each other. Instead, only
+// the low resolution texels that hold fluid close to the nearest one are
+// blended, with their bilinear weights.
+#define UPSAMPLE_DEPTH_THRESHOLD    0.015f
+
+bool upsample(vec2 tex_coord, out float depth, out vec3 normal) {
+    depth = 0.0f;
+    normal = vec3(0.0f, 0.0f, 1.0f);
+
+    ivec2 size = textureSize(blurred_depth_texture, 0);
+    vec2 t = tex_coord * vec2(size) - 0.5f;
+    ivec2 base = ivec2(floor(t));
+    vec2 f = fract(t);
+
+    ivec2 offsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+    float weights[4] = float[]((1 - f.x) * (1 - f.y), f.x * (1 - f.y), (1 - f.x) * f.y, f.x * f.y);
+
+    float depths[4];
+    float nearest = 1e30f;
+    float coverage = 0.0f;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 texel = clamp(base + offsets[i], ivec2(0), size - 1);
+        depths[i] = texelFetch(blurred_depth_texture, texel, 0).r;
+        if (depths[i] > 0.0f) {
+            nearest = min(nearest, depths[i]);
+            coverage += weights[i];
+        }
+    }
+
+    // Mostly background
+    if (coverage < 0.5f) {
+        return false;
+    }
+
+    float wsum = 0.0f;
+    normal = vec3(0.0f);
+    for (int i = 0; i < 4; ++i) {
+        if (depths[i] > 0.0f && depths[i] - nearest < UPSAMPLE_DEPTH_THRESHOLD) {
+            ivec2 texel = clamp(base + offsets[i], ivec2(0), size - 1);
+            depth += depths[i] * weights[i];
+            if (weights[i] > 0.0f) {
+                normal += normal_at(texel, size) * weights[i];
+            }
+            wsum += weights[i];
+        }
+    }
+
+    // The accepted texels may all lie exactly outside the pixel footprint
+    if (wsum <= 0.0f) {
+        depth = 0.0f;
+        normal = vec3(0.0f, 0.0f, 1.0f);
+        return false;
+    }
+
+    depth /= wsum;
+    normal = normalize(normal);
+    return true;
+}
+
 void main() {
     vec4 light_dir =  mv_matrix * vec4(0.7f, 1.0f, 0.0f, 0.0f);
 
     //Get Texture Information about the Pixel
-    float depth = texture(blurred_depth_texture, fs_quad_text_coord).r;
-    vec3 normal = texture(normals_texture, fs_quad_text_coord).xyz;
+    float depth;
+    vec3 normal;
+    upsample(fs_quad_text_coord, depth, normal);
     vec3 background_color = texture(background_texture, fs_quad_text_coord).xyz;
     vec3 position = uv_to_eye(fs_quad_text_coord, depth);
     vec3 incident = normalize(light_dir.xyz);